@@ -1,5 +1,6 @@
 #! /usr/bin/env python
-"""Tarball and compress (using bz2) Miriad UV files.
+"""Tarball and compress (using bz2) Miriad UV files, or (with -n) rewrite
+them with natively compressed visibility data, which can be read directly.
 Author: Aaron Parsons
 Date: 8/14/07"""
 
@@ -13,11 +14,27 @@ p.add_option('-d', '--delete', dest='delete', action='store_true',
     help='Delete a uv file after compressing it')
 p.add_option('-x', '--expand', dest='expand', action='store_true',
     help='Inflate tar.bz2 files')
+p.add_option('-n', '--native', dest='native', action='store_true',
+    help='Write a copy (with a "z" suffix) whose visdata is stored as compressed blocks')
 
 opts, args = p.parse_args(sys.argv[1:])
 
 for i in args:
     print i
+    if opts.native:
+        import aipy as a
+        cmp_name = i + 'z'
+        if os.path.exists(cmp_name):
+            print cmp_name, 'exists; skipping...'
+            continue
+        uvi = a.miriad.UV(i)
+        uvo = a.miriad.UV(cmp_name, status='new',
+            corrmode=uvi.vartable['corr'], compress=True)
+        uvo.init_from_uv(uvi)
+        uvo.pipe(uvi, append2hist='COMPRESS_UV: native\n')
+        del(uvo)
+        if opts.delete: os.system('rm -rf %s' % (i))
+        continue
     if opts.expand:
         rv = os.system('tar xjf %s' % i)
         if rv != 0: break
@@ -82,8 +82,6 @@ else:
     cat = a.src.get_catalog(srclist, cutoff, catalogs)
 
 m = a.coord.convert_m('eq', opts.osys, oepoch=opts.oepoch)
-ths,phis = h.px2crd(n.arange(h.npix()), ncrd=2)
-ras,decs = phis, n.pi/2 - ths
 afreq = n.array([opts.freq])
 for srcname in cat:
     src = cat[srcname]
@@ -92,7 +90,13 @@ for srcname in cat:
     ra,dec = eq.get()
     # Account for size of source
     a1,a2,th = src.srcshape
-    dras,ddecs = ras - ra, decs - dec
+    # Only pixels within sqrt(2)*max(a1,a2) can be inside the source
+    px = h.query_disc(n.sqrt(2)*max(a1,a2), n.array([n.pi/2 - dec]),
+        n.array([ra]))[0]
+    px = a.healpix.ranges2px(px)
+    if h.scheme() == 'NEST': px = h.nest_ring_conv(px, 'NEST')
+    ths,phis = h.px2crd(px, ncrd=2)
+    dras,ddecs = phis - ra, n.pi/2 - ths - dec
     print '--------------------------------------------------'
     src.update_jys(afreq)
     strength = src.get_jys()[0] * opts.sscale
@@ -102,7 +106,7 @@ for srcname in cat:
     da1 = dras*n.cos(th) - ddecs*n.sin(th)
     da2 = dras*n.sin(th) + ddecs*n.cos(th)
     delta = (da1/a1)**2 + (da2/a2)**2
-    px = n.where(delta <= 1)[0]
+    px = px.compress(delta <= 1)
     if len(px) == 0:
         print 'Treating as point source.'
         eq = a.coord.radec2eq((ra,dec))
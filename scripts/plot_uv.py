@@ -141,7 +141,7 @@ for uvfile in args:
     a.scripting.uv_selector(uv, opts.ant, opts.pol)
     uv.select('decimate', opts.decimate, opts.decphs)
     # Read data from a single UV file
-    for (uvw,t,(i,j)),d in uv.all():
+    for (uvw,t,(i,j)),d in uv.all(chans=chans):
         bl = '%d,%d,%d' % (i,j,uv['pol'])
         if len(times) == 0 or times[-1] != t:
             times.append(t)
@@ -156,7 +156,6 @@ for uvfile in args:
                 plot_t['jd'].append(t)
                 plot_t['cnt'].append(len(times)-1)
         if not use_this_time: continue
-        d = d.take(chans)
         if opts.ant.find('%d_%d' % (j,i)) != -1: d = d.conj() # obey antenna ordering, if possible
         #apply cal phases
         if not opts.cal is None:
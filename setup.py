@@ -38,6 +38,11 @@ def get_description():
 def indir(path, files):
     return [os.path.join(path, f) for f in files]
 
+# AIPY_NOSIMD=1 builds MIRIAD's plain C loops instead of the SSE2 ones, to
+# compare them with tests/miriad_benchmark.py
+if os.environ.get('AIPY_NOSIMD'): miriad_macros = [('MIR_NOSIMD', None)]
+else: miriad_macros = []
+
 setup(name = 'aipy',
     version = __version__,
     description = 'Astronomical Interferometry in PYthon',
@@ -62,7 +67,8 @@ setup(name = 'aipy',
     ext_modules = [
         Extension('aipy._healpix',
             ['src/_healpix/healpix_wrap.cpp', 
-            'src/_healpix/cxx/Healpix_cxx/healpix_base.cc'],
+            'src/_healpix/cxx/Healpix_cxx/healpix_base.cc',
+            'src/_healpix/cxx/Healpix_cxx/healpix_base2.cc'],
             include_dirs = [numpy.get_include(), 'src/_healpix/cxx/cxxsupport',
                 'src/_healpix/cxx/Healpix_cxx']),
         Extension('aipy._alm',
@@ -77,9 +83,11 @@ setup(name = 'aipy',
                 'src/_healpix/cxx/Healpix_cxx']),
         Extension('aipy._miriad', ['src/_miriad/miriad_wrap.cpp'] + \
             indir('src/_miriad/mir', ['uvio.c','hio.c','pack.c','bug.c',
-                'dio.c','headio.c','maskio.c']),
+                'dio.c','headio.c','maskio.c','zio.c','xyzio.c',
+                'sma_mirRead.c','sma_csub.c']),
             include_dirs = [numpy.get_include(), 'src/_miriad', 
-                'src/_miriad/mir']),
+                'src/_miriad/mir'],
+            define_macros = miriad_macros),
         Extension('aipy._deconv', ['src/_deconv/deconv.cpp'],
             include_dirs = [numpy.get_include()]),
         #Extension('aipy._img', ['src/_img/img.cpp'],
@@ -0,0 +1,791 @@
+/*
+ *  This file is part of Healpix_cxx.
+ *
+ *  Healpix_cxx is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Healpix_cxx is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Healpix_cxx; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *  For more information about HEALPix, see http://healpix.jpl.nasa.gov
+ */
+
+/*
+ *  Healpix_cxx is being developed at the Max-Planck-Institut fuer Astrophysik
+ *  and financially supported by the Deutsches Zentrum fuer Luft- und Raumfahrt
+ *  (DLR).
+ */
+
+/*
+ *  Copyright (C) 2003, 2004, 2005 Max-Planck-Society
+ *  Author: Martin Reinecke
+ */
+
+#include "healpix_base2.h"
+#include "cxxutils.h"
+#include "pointing.h"
+#include "arr.h"
+
+using namespace std;
+
+namespace {
+
+//! Returns the remainder of the division \a v1/v2 (non-negative).
+inline int64 modulo64 (int64 v1, int64 v2)
+  { return (v1>=0) ? ((v1<v2) ? v1 : (v1%v2)) : ((v1%v2)+v2); }
+
+//! Returns the integer \a n, which fulfills \a n*n<=arg<(n+1)*(n+1).
+/*! A double only holds 53 bits, so large arguments are corrected. */
+inline int64 isqrt64 (int64 arg)
+  {
+  int64 res = int64(sqrt(double(arg)+0.5));
+  if (arg<(int64(1)<<50)) return res;
+  if (res*res>arg)
+    --res;
+  else if ((res+1)*(res+1)<=arg)
+    ++res;
+  return res;
+  }
+
+} // namespace
+
+const int Healpix_Base2::jrll[] = { 2,2,2,2,3,3,3,3,4,4,4,4 };
+const int Healpix_Base2::jpll[] = { 1,3,5,7,0,2,4,6,1,3,5,7 };
+
+int Healpix_Base2::nside2order (int64 nside)
+  {
+  for (int m=0; m<=order_max; ++m)
+    {
+    int64 nstest = int64(1)<<m;
+    if (nside == nstest) return m;
+    if (nside < nstest) return -1;
+    }
+  return -1;
+  }
+int64 Healpix_Base2::npix2nside (int64 npix)
+  {
+  int64 res=isqrt64(npix/12);
+  planck_assert (npix==res*res*12, "npix2nside: invalid argument");
+  return res;
+  }
+
+void Healpix_Base2::nest2xyf (int64 pix, int &ix, int &iy, int &face_num)
+  const
+  {
+  face_num = int(pix>>(2*order_));
+  pix2xy(pix&(npface_-1),ix,iy);
+  }
+
+int64 Healpix_Base2::xyf2nest (int ix, int iy, int face_num) const
+  {
+  return (int64(face_num)<<(2*order_))+xy2pix(ix,iy);
+  }
+
+void Healpix_Base2::ring2xyf (int64 pix, int &ix, int &iy, int &face_num)
+  const
+  {
+  int64 iring, iphi, kshift, nr;
+
+  int64 nl2 = 2*nside_;
+
+  if (pix<ncap_) // North Polar cap
+    {
+    iring = int64(0.5*(1+isqrt64(1+2*pix))); //counted from North pole
+    iphi  = (pix+1) - 2*iring*(iring-1);
+    kshift = 0;
+    nr = iring;
+    face_num=0;
+    int64 tmp = iphi-1;
+    if (tmp>=(2*iring))
+      {
+      face_num=2;
+      tmp-=2*iring;
+      }
+    if (tmp>=iring) ++face_num;
+    }
+  else if (pix<(npix_-ncap_)) // Equatorial region
+    {
+    int64 ip = pix - ncap_;
+    if (order_>=0)
+      {
+      iring = (ip>>(order_+2)) + nside_; // counted from North pole
+      iphi  = (ip&(4*nside_-1)) + 1;
+      }
+    else
+      {
+      iring = (ip/(4*nside_)) + nside_; // counted from North pole
+      iphi  = (ip%(4*nside_)) + 1;
+      }
+    kshift = (iring+nside_)&1;
+    nr = nside_;
+    int64 ire = iring-nside_+1;
+    int64 irm = nl2+2-ire;
+    int64 ifm, ifp;
+    if (order_>=0)
+      {
+      ifm = (iphi - ire/2 + nside_ -1) >> order_;
+      ifp = (iphi - irm/2 + nside_ -1) >> order_;
+      }
+    else
+      {
+      ifm = (iphi - ire/2 + nside_ -1) / nside_;
+      ifp = (iphi - irm/2 + nside_ -1) / nside_;
+      }
+    if (ifp == ifm) // faces 4 to 7
+      face_num = (ifp==4) ? 4 : int(ifp)+4;
+    else if (ifp<ifm) // (half-)faces 0 to 3
+      face_num = int(ifp);
+    else // (half-)faces 8 to 11
+      face_num = int(ifm) + 8;
+    }
+  else // South Polar cap
+    {
+    int64 ip = npix_ - pix;
+    iring = int64(0.5*(1+isqrt64(2*ip-1))); //counted from South pole
+    iphi  = 4*iring + 1 - (ip - 2*iring*(iring-1));
+    kshift = 0;
+    nr = iring;
+    iring = 2*nl2-iring;
+    face_num=8;
+    int64 tmp = iphi-1;
+    if (tmp>=(2*nr))
+      {
+      face_num=10;
+      tmp-=2*nr;
+      }
+    if (tmp>=nr) ++face_num;
+    }
+
+  int64 irt = iring - (jrll[face_num]*nside_) + 1;
+  int64 ipt = 2*iphi- jpll[face_num]*nr - kshift -1;
+  if (ipt>=nl2) ipt-=8*nside_;
+
+  ix = int( (ipt-irt) >>1);
+  iy = int((-(ipt+irt))>>1);
+  }
+
+int64 Healpix_Base2::xyf2ring (int ix, int iy, int face_num) const
+  {
+  int64 nl4 = 4*nside_;
+  int64 jr = (jrll[face_num]*nside_) - ix - iy  - 1;
+
+  int64 nr, kshift, n_before;
+  if (jr<nside_)
+    {
+    nr = jr;
+    n_before = 2*nr*(nr-1);
+    kshift = 0;
+    }
+  else if (jr > 3*nside_)
+    {
+    nr = nl4-jr;
+    n_before = npix_ - 2*(nr+1)*nr;
+    kshift = 0;
+    }
+  else
+    {
+    nr = nside_;
+    n_before = ncap_ + (jr-nside_)*nl4;
+    kshift = (jr-nside_)&1;
+    }
+
+  int64 jp = (jpll[face_num]*nr + ix - iy + 1 + kshift) / 2;
+  if (jp>nl4)
+    jp-=nl4;
+  else
+    if (jp<1) jp+=nl4;
+
+  return n_before + jp - 1;
+  }
+
+int64 Healpix_Base2::nest2ring (int64 pix) const
+  {
+  planck_assert(order_>=0, "nest2ring: need hierarchical map");
+  int ix, iy, face_num;
+  nest2xyf (pix, ix, iy, face_num);
+  return xyf2ring (ix, iy, face_num);
+  }
+
+int64 Healpix_Base2::ring2nest (int64 pix) const
+  {
+  planck_assert(order_>=0, "ring2nest: need hierarchical map");
+  int ix, iy, face_num;
+  ring2xyf (pix, ix, iy, face_num);
+  return xyf2nest (ix, iy, face_num);
+  }
+
+int64 Healpix_Base2::ang2pix_z_phi (double z, double phi) const
+  {
+  double za = abs(z);
+  double tt = modulo(phi,twopi) * inv_halfpi; // in [0,4)
+
+  if (scheme_==RING)
+    {
+    if (za<=twothird) // Equatorial region
+      {
+      double temp1 = nside_*(0.5+tt);
+      double temp2 = nside_*z*0.75;
+      int64 jp = int64(temp1-temp2); // index of  ascending edge line
+      int64 jm = int64(temp1+temp2); // index of descending edge line
+
+      // ring number counted from z=2/3
+      int64 ir = nside_ + 1 + jp - jm; // in {1,2n+1}
+      int64 kshift = 1-(ir&1); // kshift=1 if ir even, 0 otherwise
+
+      int64 ip = (jp+jm-nside_+kshift+1)/2; // in {0,4n-1}
+      ip = modulo64(ip,4*nside_);
+
+      return ncap_ + (ir-1)*4*nside_ + ip;
+      }
+    else  // North & South polar caps
+      {
+      double tp = tt-int(tt);
+      double tmp = nside_*sqrt(3*(1-za));
+
+      int64 jp = int64(tp*tmp); // increasing edge line index
+      int64 jm = int64((1.0-tp)*tmp); // decreasing edge line index
+
+      int64 ir = jp+jm+1; // ring number counted from the closest pole
+      int64 ip = int64(tt*ir); // in {0,4*ir-1}
+      ip = modulo64(ip,4*ir);
+
+      if (z>0)
+        return 2*ir*(ir-1) + ip;
+      else
+        return npix_ - 2*ir*(ir+1) + ip;
+      }
+    }
+  else // scheme_ == NEST
+    {
+    const int64 ns_max = int64(1)<<order_max;
+    int face_num, ix, iy;
+
+    if (za<=twothird) // Equatorial region
+      {
+      double temp1 = ns_max*(0.5+tt);
+      double temp2 = ns_max*z*0.75;
+      int64 jp = int64(temp1-temp2); // index of  ascending edge line
+      int64 jm = int64(temp1+temp2); // index of descending edge line
+      int ifp = int(jp >> order_max);  // in {0,4}
+      int ifm = int(jm >> order_max);
+      if (ifp == ifm)           // faces 4 to 7
+        face_num = (ifp==4) ? 4: ifp+4;
+      else if (ifp < ifm)       // (half-)faces 0 to 3
+        face_num = ifp;
+      else                      // (half-)faces 8 to 11
+        face_num = ifm + 8;
+
+      ix = int(jm & (ns_max-1));
+      iy = int(ns_max - (jp & (ns_max-1)) - 1);
+      }
+    else // polar region, za > 2/3
+      {
+      int ntt = int(tt);
+      double tp = tt-ntt;
+      double tmp = ns_max*sqrt(3*(1-za));
+
+      int64 jp = int64(tp*tmp); // increasing edge line index
+      int64 jm = int64((1.0-tp)*tmp); // decreasing edge line index
+      if (jp>=ns_max) jp = ns_max-1; // for points too close to the boundary
+      if (jm>=ns_max) jm = ns_max-1;
+      if (z >= 0)
+        {
+        face_num = ntt;  // in {0,3}
+        ix = int(ns_max - jm - 1);
+        iy = int(ns_max - jp - 1);
+        }
+      else
+        {
+        face_num = ntt + 8; // in {8,11}
+        ix = int(jp);
+        iy = int(jm);
+        }
+      }
+
+    int64 ipf = xy2pix (ix, iy);
+
+    ipf >>= (2*(order_max-order_));  // in {0, nside**2 - 1}
+
+    return ipf + (int64(face_num)<<(2*order_)); // in {0, 12*nside**2 - 1}
+    }
+  }
+
+pointing Healpix_Base2::pix2ang (int64 pix) const
+  {
+  if (scheme_==RING)
+    {
+    if (pix<ncap_) // North Polar cap
+      {
+      int64 iring = int64(0.5*(1+isqrt64(1+2*pix))); //counted from North pole
+      int64 iphi  = (pix+1) - 2*iring*(iring-1);
+
+      return pointing (acos(1.0 - double(iring*iring)*fact2_),
+                       (iphi-0.5) * pi/(2.0*iring));
+      }
+    else if (pix<(npix_-ncap_)) // Equatorial region
+      {
+      int64 ip  = pix - ncap_;
+      int64 iring = ip/(4*nside_) + nside_; // counted from North pole
+      int64 iphi  = ip%(4*nside_) + 1;
+      // 1 if iring+nside is odd, 1/2 otherwise
+      double fodd = ((iring+nside_)&1) ? 1 : 0.5;
+
+      int64 nl2 = 2*nside_;
+      return pointing (acos((nl2-iring)*fact1_),
+                       (iphi-fodd) * pi/nl2);
+      }
+    else // South Polar cap
+      {
+      int64 ip = npix_ - pix;
+      int64 iring = int64(0.5*(1+isqrt64(2*ip-1))); //counted from South pole
+      int64 iphi  = 4*iring + 1 - (ip - 2*iring*(iring-1));
+
+      return pointing (acos(-1.0 + double(iring*iring)*fact2_),
+                       (iphi-0.5) * pi/(2.0*iring));
+      }
+    }
+  else
+    {
+    int64 nl4 = nside_*4;
+
+    int face_num = int(pix>>(2*order_));
+    int64 ipf = pix&(npface_-1);
+
+    int ix, iy;
+    pix2xy(ipf,ix,iy);
+
+    int64 jr = (int64(jrll[face_num])<<order_) - ix - iy - 1;
+
+    int64 nr, kshift;
+    double z;
+    if (jr<nside_)
+      {
+      nr = jr;
+      z = 1 - double(nr*nr)*fact2_;
+      kshift = 0;
+      }
+    else if (jr > 3*nside_)
+      {
+      nr = nl4-jr;
+      z = double(nr*nr)*fact2_ - 1;
+      kshift = 0;
+      }
+    else
+      {
+      nr = nside_;
+      z = (2*nside_-jr)*fact1_;
+      kshift = (jr-nside_)&1;
+      }
+
+    int64 jp = (jpll[face_num]*nr + ix -iy + 1 + kshift) / 2;
+    if (jp>nl4) jp-=nl4;
+    if (jp<1) jp+=nl4;
+
+    return pointing (acos(z), (jp-(kshift+1)*0.5)*(halfpi/nr));
+    }
+  }
+
+void Healpix_Base2::pix2z_phi_batch (const int64 *pix, double *z,
+  double *phi, int n) const
+  {
+  const int64 nl2 = 2*nside_, nl4 = 4*nside_;
+  if (scheme_==RING)
+    {
+    for (int i=0; i<n; ++i)
+      {
+      int64 p = pix[i];
+      bool north = p<ncap_, south = p>=(npix_-ncap_);
+      // polar caps, with the south mirrored onto the north
+      int64 q = north ? p : npix_-1-p;
+      int64 irp = int64(0.5*(1+isqrt64(1+2*q)));
+      int64 iphip = (q+1) - 2*irp*(irp-1);
+      if (south) iphip = 4*irp + 1 - iphip;
+      double zp = 1.0 - double(irp*irp)*fact2_;
+      // equatorial region
+      int64 ip = p - ncap_;
+      int64 ire = ((order_>=0) ? (ip>>(order_+2)) : (ip/nl4)) + nside_;
+      int64 iphie = ip - (ire-nside_)*nl4 + 1;
+      double fodd = ((ire+nside_)&1) ? 1 : 0.5;
+
+      bool polar = north||south;
+      int64 iphi = polar ? iphip : iphie;
+      z[i] = polar ? (north ? zp : -zp) : (nl2-ire)*fact1_;
+      phi[i] = polar ? (iphi-0.5) * pi/(2.0*irp) : (iphi-fodd) * pi/nl2;
+      }
+    }
+  else
+    {
+    for (int i=0; i<n; ++i)
+      {
+      int face_num = int(pix[i]>>(2*order_));
+      int ix, iy;
+      pix2xy(pix[i]&(npface_-1),ix,iy);
+
+      int64 jr = (int64(jrll[face_num])<<order_) - ix - iy - 1;
+      bool north = jr<nside_, south = jr>3*nside_;
+      int64 nr = north ? jr : (south ? nl4-jr : nside_);
+      int64 kshift = (north||south) ? 0 : (jr-nside_)&1;
+      double zp = 1 - double(nr*nr)*fact2_;
+      z[i] = north ? zp : (south ? -zp : (2*nside_-jr)*fact1_);
+
+      int64 jp = (jpll[face_num]*nr + ix -iy + 1 + kshift) / 2;
+      jp -= (jp>nl4)*nl4;
+      jp += (jp<1)*nl4;
+      phi[i] = (jp-(kshift+1)*0.5)*(halfpi/nr);
+      }
+    }
+  }
+
+int64 Healpix_Base2::ring_above (double z) const
+  {
+  double az=abs(z);
+  if (az>twothird) // polar caps
+    {
+    int64 iring = int64(nside_*sqrt(3*(1-az)));
+    return (z>0) ? iring : 4*nside_-iring-1;
+    }
+  else // ----- equatorial region ---------
+    return int64(nside_*(2-1.5*z));
+  }
+
+void Healpix_Base2::ring_info (int64 ring, int64 &startpix, int64 &ringpix,
+  double &z, bool &shifted) const
+  {
+  int64 northring = (ring>2*nside_) ? 4*nside_-ring : ring;
+  if (northring < nside_)
+    {
+    z = 1 - double(northring*northring)*fact2_;
+    ringpix = 4*northring;
+    shifted = true;
+    startpix = 2*northring*(northring-1);
+    }
+  else
+    {
+    z = (2*nside_-northring)*fact1_;
+    ringpix = 4*nside_;
+    shifted = ((northring-nside_) & 1) == 0;
+    startpix = ncap_ + (northring-nside_)*ringpix;
+    }
+  if (northring != ring) // southern hemisphere
+    {
+    z = -z;
+    startpix = npix_ - startpix - ringpix;
+    }
+  }
+
+/* On each ring from irmin to irmax, the pixel centers p with
+   normal[k]*p >= dist[k] for all k form one or two arcs; they are found by
+   intersecting the arc of each condition, and appended to ranges. */
+void Healpix_Base2::ring_ranges (const vec3 *normal, const double *dist,
+  int nc, int64 irmin, int64 irmax, vector<int64> &ranges) const
+  {
+  vector<int64> cur, arc, res;
+  for (int64 iz=irmin; iz<=irmax; ++iz)
+    {
+    int64 sp, nr;
+    double z;
+    bool shifted;
+    ring_info (iz, sp, nr, z, shifted);
+    double st = sqrt((1-z)*(1+z)), shift = shifted ? 0.5 : 0;
+    cur.assign(1,0); cur.push_back(nr);
+    for (int k=0; (k<nc) && !cur.empty(); ++k)
+      {
+      double r = sqrt(normal[k].x*normal[k].x+normal[k].y*normal[k].y);
+      double rhs = dist[k]-normal[k].z*z;
+      if (st*r<=0)
+        {
+        if (rhs>0) cur.clear();
+        continue;
+        }
+      double c = rhs/(st*r);
+      if (c<=-1) continue;
+      if (c>1) { cur.clear(); continue; }
+      // same rounding as Healpix_Base::in_ring
+      double phi0 = atan2(normal[k].y,normal[k].x), dphi = acos(c);
+      if (dphi > (pi-1e-7)) continue;
+      int64 ip_lo = int64(floor(nr*inv_twopi*(phi0-dphi) - shift))+1;
+      int64 ip_hi = int64(floor(nr*inv_twopi*(phi0+dphi) - shift));
+      if (ip_hi<ip_lo) { cur.clear(); continue; }
+      if (ip_hi-ip_lo+1>=nr) continue;
+      int64 lo = modulo64(ip_lo,nr), hi = lo+(ip_hi-ip_lo)+1;
+      arc.clear();
+      if (hi>nr)
+        { arc.push_back(0); arc.push_back(hi-nr); hi = nr; }
+      arc.push_back(lo); arc.push_back(hi);
+      // intersect the sorted interval lists cur and arc
+      res.clear();
+      for (unsigned int i=0, j=0; (i<cur.size()) && (j<arc.size()); )
+        {
+        int64 a = max(cur[i],arc[j]), b = min(cur[i+1],arc[j+1]);
+        if (a<b) { res.push_back(a); res.push_back(b); }
+        if (cur[i+1]<arc[j+1]) i+=2; else j+=2;
+        }
+      cur.swap(res);
+      }
+    for (unsigned int i=0; i<cur.size(); i+=2)
+      {
+      if (!ranges.empty() && (ranges.back()==sp+cur[i]))
+        ranges.back() = sp+cur[i+1];
+      else
+        { ranges.push_back(sp+cur[i]); ranges.push_back(sp+cur[i+1]); }
+      }
+    }
+  }
+
+void Healpix_Base2::query_disc_ranges (const pointing &dir, double radius,
+  vector<int64> &ranges) const
+  {
+  radius = min(radius,pi);
+  int64 irmin = 1, irmax = 4*nside_-1;
+  if (dir.theta-radius>0) irmin = ring_above (cos(dir.theta-radius))+1;
+  if (dir.theta+radius<pi) irmax = ring_above (cos(dir.theta+radius));
+  vec3 normal = dir.to_vec3();
+  double dist = cos(radius);
+  ring_ranges (&normal, &dist, 1, irmin, irmax, ranges);
+  }
+
+void Healpix_Base2::query_polygon_ranges (const vec3 *vertex, int nv,
+  vector<int64> &ranges) const
+  {
+  planck_assert(nv>=3, "query_polygon: need at least 3 vertices");
+  arr<vec3> normal(nv);
+  arr<double> dist(nv);
+  vec3 center(0,0,0);
+  for (int i=0; i<nv; ++i)
+    {
+    normal[i] = crossprod(vertex[i],vertex[(i+1)%nv]);
+    dist[i] = 0;
+    center = center + vertex[i]/vertex[i].Length();
+    }
+  // make the inside of every edge the positive side
+  if (dotprod(normal[0],vertex[2])<0)
+    for (int i=0; i<nv; ++i) normal[i].Flip();
+  // only rings that cross the cap around the vertices can hold pixels
+  int64 irmin = 1, irmax = 4*nside_-1;
+  if (center.Length()>0)
+    {
+    pointing ptg(center);
+    double radius = 0;
+    for (int i=0; i<nv; ++i)
+      radius = max(radius,
+        acos(min(1.,dotprod(center,vertex[i])/
+          (center.Length()*vertex[i].Length()))));
+    radius += 1e-10;
+    if (radius<halfpi)
+      {
+      if (ptg.theta-radius>0) irmin = ring_above (cos(ptg.theta-radius))+1;
+      if (ptg.theta+radius<pi) irmax = ring_above (cos(ptg.theta+radius));
+      }
+    }
+  ring_ranges (&normal[0], &dist[0], nv, irmin, irmax, ranges);
+  }
+
+void Healpix_Base2::neighbors (int64 pix, fix_arr<int64,8> &result) const
+  {
+  static const int xoffset[] = { -1,-1, 0, 1, 1, 1, 0,-1 };
+  static const int yoffset[] = {  0, 1, 1, 1, 0,-1,-1,-1 };
+  static const int facearray[][12] =
+        { {  8, 9,10,11,-1,-1,-1,-1,10,11, 8, 9 },   // S
+          {  5, 6, 7, 4, 8, 9,10,11, 9,10,11, 8 },   // SE
+          { -1,-1,-1,-1, 5, 6, 7, 4,-1,-1,-1,-1 },   // E
+          {  4, 5, 6, 7,11, 8, 9,10,11, 8, 9,10 },   // SW
+          {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11 },   // center
+          {  1, 2, 3, 0, 0, 1, 2, 3, 5, 6, 7, 4 },   // NE
+          { -1,-1,-1,-1, 7, 4, 5, 6,-1,-1,-1,-1 },   // W
+          {  3, 0, 1, 2, 3, 0, 1, 2, 4, 5, 6, 7 },   // NW
+          {  2, 3, 0, 1,-1,-1,-1,-1, 0, 1, 2, 3 } }; // N
+  static const int swaparray[][12] =
+        { {  0,0,0,0,0,0,0,0,3,3,3,3 },   // S
+          {  0,0,0,0,0,0,0,0,6,6,6,6 },   // SE
+          {  0,0,0,0,0,0,0,0,0,0,0,0 },   // E
+          {  0,0,0,0,0,0,0,0,5,5,5,5 },   // SW
+          {  0,0,0,0,0,0,0,0,0,0,0,0 },   // center
+          {  5,5,5,5,0,0,0,0,0,0,0,0 },   // NE
+          {  0,0,0,0,0,0,0,0,0,0,0,0 },   // W
+          {  6,6,6,6,0,0,0,0,0,0,0,0 },   // NW
+          {  3,3,3,3,0,0,0,0,0,0,0,0 } }; // N
+
+  int ix, iy, face_num;
+  (scheme_==RING) ?
+    ring2xyf(pix,ix,iy,face_num) : nest2xyf(pix,ix,iy,face_num);
+
+  const int nside = int(nside_);
+  const int nsm1 = nside-1;
+  if ((ix>0)&&(ix<nsm1)&&(iy>0)&&(iy<nsm1))
+    {
+    if (scheme_==RING)
+      for (int m=0; m<8; ++m)
+        result[m] = xyf2ring(ix+xoffset[m],iy+yoffset[m],face_num);
+    else
+      for (int m=0; m<8; ++m)
+        result[m] = xyf2nest(ix+xoffset[m],iy+yoffset[m],face_num);
+    }
+  else
+    {
+    for (int i=0; i<8; ++i)
+      {
+      int x=ix+xoffset[i];
+      int y=iy+yoffset[i];
+      int nbnum=4;
+      if (x<0)
+        { x+=nside; nbnum-=1; }
+      else if (x>=nside)
+        { x-=nside; nbnum+=1; }
+      if (y<0)
+        { y+=nside; nbnum-=3; }
+      else if (y>=nside)
+        { y-=nside; nbnum+=3; }
+
+      int f = facearray[nbnum][face_num];
+      if (f>=0)
+        {
+        if (swaparray[nbnum][face_num]&1) x=nside-x-1;
+        if (swaparray[nbnum][face_num]&2) y=nside-y-1;
+        if (swaparray[nbnum][face_num]&4) std::swap(x,y);
+        result[i] = (scheme_==RING) ? xyf2ring(x,y,f) : xyf2nest(x,y,f);
+        }
+      else
+        result[i] = -1;
+      }
+    }
+  }
+
+namespace {
+
+void add_weights (int64 p1, int64 p2, int64 p3, int64 p4, double xdiff,
+                  double ydiff, fix_arr<int64,4> &pix, fix_arr<double,4> &wgt)
+  {
+  pix[0] = p1;
+  pix[1] = p2;
+  pix[2] = p3;
+
+  if (p4>=0)
+    {
+    wgt[0] = (1-xdiff)*(1-ydiff);
+    wgt[1] = xdiff*(1-ydiff);
+    wgt[2] = ydiff*(1-xdiff);
+    pix[3] = p4;
+    wgt[3] = xdiff*ydiff;
+    }
+  else
+    {
+    wgt[0] = 1-xdiff-ydiff+fourthird*xdiff*ydiff;
+    wgt[1] = xdiff-twothird*xdiff*ydiff;
+    wgt[2] = ydiff-twothird*xdiff*ydiff;
+    pix[3] = 0;
+    wgt[3] = 0;
+    }
+  }
+
+} // namespace
+
+void Healpix_Base2::get_interpol (const pointing &ptg, fix_arr<int64,4> &pix,
+  fix_arr<double,4> &wgt) const
+  {
+  double z = cos(ptg.theta);
+  double za = abs(z);
+  double tt = modulo(ptg.phi,twopi) / halfpi; // in [0,4)
+  const double nside = double(nside_);
+
+  int face_num;
+  double ix, iy;
+  if (za<=twothird) // Equatorial region
+    {
+    double temp1 = nside*(0.5+tt);
+    double temp2 = nside*z*0.75;
+    double jp = temp1-temp2; // index of  ascending edge line
+    double jm = temp1+temp2; // index of descending edge line
+    int ifp = int(jp/nside);  // in {0,4}
+    int ifm = int(jm/nside);
+    if (ifp == ifm)           // faces 4 to 7
+      face_num = (ifp==4) ? 4 : (ifp+4);
+    else if (ifp < ifm)       // (half-)faces 0 to 3
+      face_num = ifp;
+    else                      // (half-)faces 8 to 11
+      face_num = ifm + 8;
+
+    ix = modulo(jm, nside);
+    iy = nside - modulo(jp, nside);
+    }
+  else // polar region, za > 2/3
+    {
+    int ntt = int(tt);
+    double tp = tt-ntt;
+    double tmp = nside*sqrt(3*(1-za));
+
+    double jp = tp*tmp; // increasing edge line index
+    double jm = (1.0-tp)*tmp; // decreasing edge line index
+    if (jp>=nside) jp = nside; // for points too close to the boundary
+    if (jm>=nside) jm = nside;
+    if (z >= 0)
+      {
+      face_num = ntt;  // in {0,3}
+      ix = nside - jm;
+      iy = nside - jp;
+      }
+    else
+      {
+      face_num = ntt + 8; // in {8,11}
+      ix = jp;
+      iy = jm;
+      }
+    }
+
+  if ((ix>0.5) && (ix<(nside-0.5)) && (iy>0.5) && (iy<(nside-0.5)))
+    {
+    int xpix=int(ix-0.5), ypix=int(iy-0.5);
+    double xdiff=ix-0.5-xpix, ydiff=iy-0.5-ypix;
+    wgt[0] = (1-xdiff)*(1-ydiff);
+    wgt[1] = xdiff*(1-ydiff);
+    wgt[2] = (1-xdiff)*ydiff;
+    wgt[3] = xdiff*ydiff;
+    if (scheme_==RING)
+      {
+      pix[0] = xyf2ring(xpix  ,ypix  ,face_num);
+      pix[1] = xyf2ring(xpix+1,ypix  ,face_num);
+      pix[2] = xyf2ring(xpix  ,ypix+1,face_num);
+      pix[3] = xyf2ring(xpix+1,ypix+1,face_num);
+      }
+    else
+      {
+      pix[0] = xyf2nest(xpix  ,ypix  ,face_num);
+      pix[1] = xyf2nest(xpix+1,ypix  ,face_num);
+      pix[2] = xyf2nest(xpix  ,ypix+1,face_num);
+      pix[3] = xyf2nest(xpix+1,ypix+1,face_num);
+      }
+    }
+  else
+    {
+    int xpix=int(ix-0.5), ypix=int(iy-0.5);
+    xpix=max(0,min(int(nside_)-1,xpix));
+    ypix=max(0,min(int(nside_)-1,ypix));
+    int64 pixnr = (scheme_==RING) ?
+      xyf2ring(xpix,ypix,face_num) : xyf2nest(xpix,ypix,face_num);
+    fix_arr<int64,8> nb;
+    neighbors (pixnr,nb);
+
+    double xdiff=ix-0.5-xpix, ydiff=iy-0.5-ypix;
+    if (xdiff>0)
+      {
+      if (ydiff>0)
+        add_weights(pixnr,nb[4],nb[2],nb[3], xdiff, ydiff,pix,wgt);
+      else
+        add_weights(pixnr,nb[4],nb[6],nb[5], xdiff,-ydiff,pix,wgt);
+      }
+    else
+      {
+      if (ydiff>0)
+        add_weights(pixnr,nb[0],nb[2],nb[1],-xdiff, ydiff,pix,wgt);
+      else
+        add_weights(pixnr,nb[0],nb[6],nb[7],-xdiff,-ydiff,pix,wgt);
+      }
+    }
+  }
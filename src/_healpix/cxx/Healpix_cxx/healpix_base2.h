@@ -0,0 +1,314 @@
+/*
+ *  This file is part of Healpix_cxx.
+ *
+ *  Healpix_cxx is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Healpix_cxx is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Healpix_cxx; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *  For more information about HEALPix, see http://healpix.jpl.nasa.gov
+ */
+
+/*
+ *  Healpix_cxx is being developed at the Max-Planck-Institut fuer Astrophysik
+ *  and financially supported by the Deutsches Zentrum fuer Luft- und Raumfahrt
+ *  (DLR).
+ */
+
+/*! \file healpix_base2.h
+ *  64-bit pixel indexing for maps with \a N_side up to 2^29.
+ *  Copyright (C) 2003, 2004 Max-Planck-Society
+ *  \author Martin Reinecke
+ */
+
+#ifndef HEALPIX_BASE2_H
+#define HEALPIX_BASE2_H
+
+#include "healpix_base.h"
+#include <vector>
+#include "datatypes.h"
+#include "arr.h"
+
+/*! Functionality related to the HEALPix pixelisation. Identical to
+    Healpix_Base, but with pixel numbers stored as int64, so that
+    \a N_side can go up to 2^29. */
+class Healpix_Base2
+  {
+  protected:
+    enum { order_max=29 };
+
+    static const int jrll[];
+    static const int jpll[];
+
+    /*! The order of the map; -1 for nonhierarchical map. */
+    int order_;
+    /*! The N_side parameter of the map; 0 if not allocated. */
+    int64 nside_;
+    int64 npface_, ncap_, npix_;
+    double fact1_, fact2_;
+    /*! The map's ordering scheme. */
+    Healpix_Ordering_Scheme scheme_;
+
+    static inline int64 xy2pix (int x, int y);
+    static inline void pix2xy (int64 pix, int &x, int &y);
+
+    int64 xyf2nest(int ix, int iy, int face_num) const;
+    void nest2xyf(int64 pix, int &ix, int &iy, int &face_num) const;
+    int64 xyf2ring(int ix, int iy, int face_num) const;
+    void ring2xyf(int64 pix, int &ix, int &iy, int &face_num) const;
+
+    inline int64 ring_above (double z) const;
+    void ring_info (int64 ring, int64 &startpix, int64 &ringpix, double &z,
+      bool &shifted) const;
+    void ring_ranges (const vec3 *normal, const double *dist, int nc,
+      int64 irmin, int64 irmax, std::vector<int64> &ranges) const;
+
+  public:
+    /*! Calculates the map order from its \a N_side parameter.
+        Returns -1 if \a nside is not a power of 2.
+        \param nside the \a N_side parameter */
+    static int nside2order (int64 nside);
+    /*! Calculates the \a N_side parameter from the number of pixels.
+        \param npix the number of pixels */
+    static int64 npix2nside (int64 npix);
+    /*! Constructs an unallocated object. */
+    Healpix_Base2 ()
+      : order_(-1), nside_(0), npface_(0), ncap_(0), npix_(0),
+        fact1_(0), fact2_(0), scheme_(RING) {}
+    /*! Constructs an object with a given \a order and the ordering
+        scheme \a scheme. */
+    Healpix_Base2 (int order, Healpix_Ordering_Scheme scheme)
+      { Set (order, scheme); }
+    /*! Constructs an object with a given \a nside and the ordering
+        scheme \a scheme. The \a nside_dummy parameter must be set to
+        SET_NSIDE. */
+    Healpix_Base2 (int64 nside, Healpix_Ordering_Scheme scheme,
+      const nside_dummy)
+      { SetNside (nside, scheme); }
+
+    /* Adjusts the object to \a order and \a scheme. */
+    void Set (int order, Healpix_Ordering_Scheme scheme)
+      {
+      planck_assert ((order>=0)&&(order<=order_max), "bad order");
+      order_  = order;
+      nside_  = int64(1)<<order;
+      npface_ = nside_*nside_;
+      ncap_   = 2*(npface_-nside_);
+      npix_   = 12*npface_;
+      fact2_  = 4./npix_;
+      fact1_  = 2*nside_*fact2_;
+      scheme_ = scheme;
+      }
+    /* Adjusts the object to \a nside and \a scheme. */
+    void SetNside (int64 nside, Healpix_Ordering_Scheme scheme)
+      {
+      planck_assert ((nside>0)&&(nside<=(int64(1)<<order_max)),
+        "SetNside: bad nside");
+      order_  = nside2order(nside);
+      planck_assert ((scheme!=NEST) || (order_>=0),
+        "SetNside: nside must be power of 2 for nested maps");
+      nside_  = nside;
+      npface_ = nside_*nside_;
+      ncap_   = 2*(npface_-nside_);
+      npix_   = 12*npface_;
+      fact2_  = 4./npix_;
+      fact1_  = 2*nside_*fact2_;
+      scheme_ = scheme;
+      }
+
+    /*! Translates a pixel number from NEST to RING. */
+    int64 nest2ring (int64 pix) const;
+    /*! Translates a pixel number from RING to NEST. */
+    int64 ring2nest (int64 pix) const;
+
+    int64 ang2pix_z_phi (double z, double phi) const;
+
+    /*! Returns the number of the pixel which contains the angular coordinates
+        \a ang. */
+    int64 ang2pix (const pointing &ang) const
+      { return ang2pix_z_phi (cos(ang.theta), ang.phi); }
+    /*! Returns the number of the pixel which contains the vector \a vec
+        (\a vec is normalized if necessary). */
+    int64 vec2pix (const vec3 &vec) const
+      { return ang2pix_z_phi (vec.z/vec.Length(), safe_atan2(vec.y,vec.x)); }
+    /*! Returns the angular coordinates of the center of the pixel with
+        number \a pix. */
+    pointing pix2ang (int64 pix) const;
+
+    /*! Returns cos(theta) and phi of the centers of the \a n pixels in
+        \a pix.  The polar and equatorial formulas are both evaluated and
+        selected without branching, so the order of the pixels does not
+        matter.  acos(\a z) and \a phi are exactly the result of pix2ang. */
+    void pix2z_phi_batch (const int64 *pix, double *z, double *phi, int n)
+      const;
+
+    /*! Appends to \a ranges the pixels whose centers lie within \a radius
+        of \a dir, as (start,stop) pairs of RING pixel numbers in increasing
+        order.  Adjacent ranges are merged.  The pixels are the same as
+        Healpix_Base::query_disc, but the numbering is always RING. */
+    void query_disc_ranges (const pointing &dir, double radius,
+      std::vector<int64> &ranges) const;
+    /*! Like query_disc_ranges, for the pixels whose centers lie inside the
+        convex spherical polygon with the \a nv vertices \a vertex (in
+        either winding order). */
+    void query_polygon_ranges (const vec3 *vertex, int nv,
+      std::vector<int64> &ranges) const;
+
+    /*! Returns the number of pixels on a side of the tiles used by
+        reorder_tiles. */
+    int reorder_tile () const
+      { return (order_<7) ? int(nside_) : 128; }
+    /*! Returns the number of tiles used by reorder_tiles. */
+    int64 reorder_ntiles () const
+      { return npix_/(int64(reorder_tile())*reorder_tile()); }
+    /*! Copies the pixels of tiles \a tile0 to \a tile1-1 from \a src to
+        \a dst, which both hold Npix() values, converting NEST to RING
+        order (or RING to NEST if \a to_ring is \a false).  A tile is a
+        square of contiguous NEST pixels in one face; within it, each
+        diagonal is a run of contiguous RING pixels, so both maps are
+        accessed in cache-sized pieces. */
+    template<typename T> void reorder_tiles (const T *src, T *dst,
+      bool to_ring, int64 tile0, int64 tile1) const;
+
+    /*! Returns the neighboring pixels of \a pix in \a result.
+        On exit, \a result contains (in this order)
+        the pixel numbers of the SW, W, NW, N, NE, E, SE and S neighbor
+        of \a pix. If a neighbor does not exist (this can only be the case
+        for the W, N, E and S neighbors), its entry is set to -1. */
+    void neighbors (int64 pix, fix_arr<int64,8> &result) const;
+    /*! Returns interpolation information for the direction \a ptg.
+        The surrounding pixels are returned in \a pix, their corresponding
+        weights in \a wgt. */
+    void get_interpol (const pointing &ptg, fix_arr<int64,4> &pix,
+                       fix_arr<double,4> &wgt) const;
+
+    /*! Returns the order parameter of the object. */
+    int Order() const { return order_; }
+    /*! Returns the \a N_side parameter of the object. */
+    int64 Nside() const { return nside_; }
+    /*! Returns the number of pixels of the object. */
+    int64 Npix() const { return npix_; }
+    /*! Returns the ordering scheme of the object. */
+    Healpix_Ordering_Scheme Scheme() const { return scheme_; }
+
+    /*! Returns \a true, if both objects have the same nside and scheme,
+        else  \a false. */
+    bool conformable (const Healpix_Base2 &other) const
+      { return ((nside_==other.nside_) && (scheme_==other.scheme_)); }
+
+    /*! Swaps the contents of two Healpix_Base2 objects. */
+    void swap (Healpix_Base2 &other)
+      {
+      std::swap(order_,other.order_);
+      std::swap(nside_,other.nside_);
+      std::swap(npface_,other.npface_);
+      std::swap(ncap_,other.ncap_);
+      std::swap(npix_,other.npix_);
+      std::swap(fact1_,other.fact1_);
+      std::swap(fact2_,other.fact2_);
+      std::swap(scheme_,other.scheme_);
+      }
+  };
+
+/* The bits of x and y are interleaved (x in the even bits, y in the odd
+   ones) by spreading each over twice its width with masks. */
+inline int64 Healpix_Base2::xy2pix (int x, int y)
+  {
+  uint64 rx = uint64(x)&0xffffffffull, ry = uint64(y)&0xffffffffull;
+  rx = (rx|(rx<<16)) & 0x0000ffff0000ffffull;
+  rx = (rx|(rx<< 8)) & 0x00ff00ff00ff00ffull;
+  rx = (rx|(rx<< 4)) & 0x0f0f0f0f0f0f0f0full;
+  rx = (rx|(rx<< 2)) & 0x3333333333333333ull;
+  rx = (rx|(rx<< 1)) & 0x5555555555555555ull;
+  ry = (ry|(ry<<16)) & 0x0000ffff0000ffffull;
+  ry = (ry|(ry<< 8)) & 0x00ff00ff00ff00ffull;
+  ry = (ry|(ry<< 4)) & 0x0f0f0f0f0f0f0f0full;
+  ry = (ry|(ry<< 2)) & 0x3333333333333333ull;
+  ry = (ry|(ry<< 1)) & 0x5555555555555555ull;
+  return int64(rx|(ry<<1));
+  }
+
+inline void Healpix_Base2::pix2xy (int64 pix, int &x, int &y)
+  {
+  uint64 raw = uint64(pix)&0x5555555555555555ull;
+  raw = (raw|(raw>> 1)) & 0x3333333333333333ull;
+  raw = (raw|(raw>> 2)) & 0x0f0f0f0f0f0f0f0full;
+  raw = (raw|(raw>> 4)) & 0x00ff00ff00ff00ffull;
+  raw = (raw|(raw>> 8)) & 0x0000ffff0000ffffull;
+  raw = (raw|(raw>>16)) & 0x00000000ffffffffull;
+  x = int(raw);
+  raw = (uint64(pix)>>1)&0x5555555555555555ull;
+  raw = (raw|(raw>> 1)) & 0x3333333333333333ull;
+  raw = (raw|(raw>> 2)) & 0x0f0f0f0f0f0f0f0full;
+  raw = (raw|(raw>> 4)) & 0x00ff00ff00ff00ffull;
+  raw = (raw|(raw>> 8)) & 0x0000ffff0000ffffull;
+  raw = (raw|(raw>>16)) & 0x00000000ffffffffull;
+  y = int(raw);
+  }
+
+template<typename T> void Healpix_Base2::reorder_tiles (const T *src,
+  T *dst, bool to_ring, int64 tile0, int64 tile1) const
+  {
+  planck_assert(order_>=0, "reorder_tiles: need hierarchical map");
+  const int b = reorder_tile();
+  const int64 nl4 = 4*nside_;
+  arr<int> loc(b*b); // NEST offset of (x,y) in a tile
+  for (int y=0; y<b; ++y)
+    for (int x=0; x<b; ++x)
+      loc[y*b+x] = int(xy2pix(x,y));
+
+  for (int64 t=tile0; t<tile1; ++t)
+    {
+    int64 pix0 = t*b*b;
+    int face_num = int(pix0>>(2*order_));
+    int x0, y0;
+    pix2xy(pix0&(npface_-1),x0,y0);
+    for (int d=0; d<2*b-1; ++d) // the diagonals x+y=d of the tile
+      {
+      int64 jr = (jrll[face_num]*nside_) - x0 - y0 - d - 1;
+      int64 nr, kshift, n_before;
+      if (jr<nside_)
+        {
+        nr = jr;
+        n_before = 2*nr*(nr-1);
+        kshift = 0;
+        }
+      else if (jr > 3*nside_)
+        {
+        nr = nl4-jr;
+        n_before = npix_ - 2*(nr+1)*nr;
+        kshift = 0;
+        }
+      else
+        {
+        nr = nside_;
+        n_before = ncap_ + (jr-nside_)*nl4;
+        kshift = (jr-nside_)&1;
+        }
+      int x1 = (d<b) ? 0 : d-b+1, x2 = (d<b) ? d : b-1;
+      // as in xyf2ring; each step in x moves one pixel along the ring
+      int64 jp = (jpll[face_num]*nr + (x0+x1) - (y0+d-x1) + 1 + kshift) / 2;
+      const int *l = &loc[(d-x1)*b+x1];
+      for (int x=x1; x<=x2; ++x, ++jp, l+=1-b)
+        {
+        int64 pr = n_before - 1 +
+          ((jp>nl4) ? jp-nl4 : ((jp<1) ? jp+nl4 : jp));
+        if (to_ring)
+          dst[pr] = src[pix0+*l];
+        else
+          dst[pix0+*l] = src[pr];
+        }
+      }
+    }
+  }
+
+#endif
@@ -15,12 +15,18 @@
 #include <Python.h>
 #include "numpy/arrayobject.h"
 #include "healpix_base.h"
+#include "healpix_base2.h"
 #include "healpix_map.h"
 #include "arr.h"
 #include "pointing.h"
 #include "vec3.h"
 
+#include <algorithm>
 #include <cmath>
+#include <complex>
+#include <exception>
+#include <pthread.h>
+#include <unistd.h>
 
 // Some macros...
 #define QUOTE(a) # a
@@ -57,16 +63,95 @@
 
 // Some helper functions
 
+/* Batch conversions are split into contiguous chunks, one per thread.
+ * Chunks are at least MIN_CHUNK long, so small batches stay on the
+ * calling thread. */
+#define MIN_CHUNK 8192
+#define MAX_THREADS 64
+// Pixels are handed to Healpix_Base2::pix2z_phi_batch BLOCK at a time
+#define BLOCK 256
+
+// A slice [start,end) of a batch job, with what went wrong in it
+typedef struct {
+    void *job;
+    void (*fn)(void *job, npy_intp start, npy_intp end, long *nbad);
+    npy_intp start, end;
+    long nbad;      // coordinates that had to be replaced
+    bool failed;
+    char msg[256];
+} Chunk;
+
+static void *run_chunk(void *arg) {
+    Chunk *c = (Chunk *)arg;
+    try {
+        c->fn(c->job, c->start, c->end, &c->nbad);
+    } catch (Message_error &e) {
+        c->failed = true;
+        strncpy(c->msg, e.what(), sizeof(c->msg)-1);
+    } catch (std::exception &e) {
+        // Nothing may escape a thread (or the interpreter), even bad_alloc
+        c->failed = true;
+        strncpy(c->msg, e.what(), sizeof(c->msg)-1);
+    } catch (...) {
+        c->failed = true;
+        strncpy(c->msg, "unknown error", sizeof(c->msg)-1);
+    }
+    return NULL;
+}
+
+/* Run fn over [0,n) on up to nthreads threads (0 = one per cpu), without
+ * the GIL, in chunks of at least min_chunk.  Returns the total of nbad, or
+ * -1 with a RuntimeError set if a chunk failed. */
+static long run_batch(void (*fn)(void *, npy_intp, npy_intp, long *),
+        void *job, npy_intp n, int nthreads, npy_intp min_chunk=MIN_CHUNK) {
+    Chunk chunks[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    bool started[MAX_THREADS];
+    long nbad=0;
+    if (nthreads <= 0) nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > (n + min_chunk - 1) / min_chunk)
+        nthreads = (n + min_chunk - 1) / min_chunk;
+    if (nthreads > MAX_THREADS) nthreads = MAX_THREADS;
+    if (nthreads < 1) nthreads = 1;
+    for (int t=0; t < nthreads; t++) {
+        chunks[t].job = job; chunks[t].fn = fn;
+        chunks[t].start = n * t / nthreads;
+        chunks[t].end = n * (t+1) / nthreads;
+        chunks[t].nbad = 0;
+        chunks[t].failed = false;
+        chunks[t].msg[0] = '\0';
+    }
+    Py_BEGIN_ALLOW_THREADS
+    for (int t=1; t < nthreads; t++)
+        started[t] = pthread_create(&threads[t], NULL, run_chunk,
+            &chunks[t]) == 0;
+    run_chunk(&chunks[0]);
+    for (int t=1; t < nthreads; t++) {
+        // Do the work here if a thread could not be started
+        if (started[t]) pthread_join(threads[t], NULL);
+        else run_chunk(&chunks[t]);
+    }
+    Py_END_ALLOW_THREADS
+    for (int t=0; t < nthreads; t++) {
+        if (chunks[t].failed) {
+            PyErr_SetString(PyExc_RuntimeError, chunks[t].msg);
+            return -1;
+        }
+        nbad += chunks[t].nbad;
+    }
+    return nbad;
+}
+
 /*____                           _                    _    
  / ___|_ __ ___  _   _ _ __   __| |_      _____  _ __| | __
 | |  _| '__/ _ \| | | | '_ \ / _` \ \ /\ / / _ \| '__| |/ /
 | |_| | | | (_) | |_| | | | | (_| |\ V  V / (_) | |  |   < 
  \____|_|  \___/ \__,_|_| |_|\__,_| \_/\_/ \___/|_|  |_|\_\
 */
-// Python object that holds instance of Healpix_Base
+// Python object that holds instance of Healpix_Base2 (64 bit pixel numbers)
 typedef struct {
     PyObject_HEAD
-    Healpix_Base hpb;
+    Healpix_Base2 hpb;
 } HPBObject;
 
 // Deallocate memory when Python object is deleted
@@ -74,7 +159,7 @@ static void HPBObject_dealloc(HPBObject* self) {
     self->ob_type->tp_free((PyObject*)self);
 }
 
-// Allocate memory for Python object and Healpix_Base (__new__)
+// Allocate memory for Python object and Healpix_Base2 (__new__)
 static PyObject *HPBObject_new(PyTypeObject *type, 
         PyObject *args, PyObject *kwds) {
     HPBObject *self;
@@ -84,11 +169,11 @@ static PyObject *HPBObject_new(PyTypeObject *type,
 
 // Initialize object (__init__)
 static int HPBObject_init(HPBObject *self, PyObject *args, PyObject *kwds) {
-    int nside=-1;
+    long nside=-1;
     Healpix_Ordering_Scheme scheme = RING;
     PyObject *scheme_str=NULL;
     static char *kwlist[] = {"nside", "scheme", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds,"|iO", kwlist, \
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"|lO", kwlist, \
             &nside, &scheme_str))
         return -1;
     if (scheme_str == NULL) scheme = RING;
@@ -97,10 +182,10 @@ static int HPBObject_init(HPBObject *self, PyObject *args, PyObject *kwds) {
         PyErr_Format(PyExc_ValueError, "scheme must be 'RING' or 'NEST'.");
         return -1;
     }
-    // Carefully try to create a new Healpix_Base
+    // Carefully try to create a new Healpix_Base2
     try {
-        if (nside == -1) self->hpb = Healpix_Base();
-        else self->hpb = Healpix_Base(nside, scheme, SET_NSIDE);
+        if (nside == -1) self->hpb = Healpix_Base2();
+        else self->hpb = Healpix_Base2(nside, scheme, SET_NSIDE);
     } catch (Message_error &e) {
         PyErr_Format(PyExc_RuntimeError, e.what());
         return -1;
@@ -115,10 +200,10 @@ static int HPBObject_init(HPBObject *self, PyObject *args, PyObject *kwds) {
   \___/|_.__// |\___|\___|\__| |_|  |_|\___|\__|_| |_|\___/ \__,_|___/
            |__/                                                       
 */
-// Thin wrapper over Healpix_Base::npix2nside
+// Thin wrapper over Healpix_Base2::npix2nside
 static PyObject * HPBObject_npix2nside(HPBObject *self, PyObject *args) {
-    int npix;
-    if (!PyArg_ParseTuple(args, "i", &npix)) return NULL;
+    long npix;
+    if (!PyArg_ParseTuple(args, "l", &npix)) return NULL;
     try {
         return PyInt_FromLong(self->hpb.npix2nside(npix));
     } catch (Message_error &e) {
@@ -127,75 +212,159 @@ static PyObject * HPBObject_npix2nside(HPBObject *self, PyObject *args) {
     }
 }
 
-/* Wrapper over Healpix_Base::nest2ring and Healpix_Base::ring2nest
+/* Wrapper over Healpix_Base2::nest2ring and Healpix_Base2::ring2nest
  * to convert an array of pixel indices into output order specified in
  * 'scheme'.  Modifies pixel array in place.
  */
 static PyObject * HPBObject_nest_ring_conv(HPBObject *self, PyObject *args) {
-    PyArrayObject *px;
+    PyArrayObject *px, *in;
     PyObject *scheme;
+    bool tonest;
+    long npix = self->hpb.Npix();
     // Parse and check input arguments
     if (!PyArg_ParseTuple(args, "O!O", &PyArray_Type, &px, &scheme))
         return NULL;
     CHK_ARRAY_TYPE(px,NPY_LONG);
     CHK_ARRAY_RANK(px,1);
+    if (strcmp(PyString_AsString(scheme), "NEST") == 0) tonest = true;
+    else if (strcmp(PyString_AsString(scheme), "RING") == 0) tonest = false;
+    else {
+        PyErr_Format(PyExc_ValueError,"scheme must be 'RING' or 'NEST'.");
+        return NULL;
+    }
+    // Work on a contiguous copy of a strided input, checked before any
+    // pixel is converted
+    in = (PyArrayObject *) PyArray_GETCONTIGUOUS(px);
+    CHK_NULL(in);
+    npy_intp sz = DIM(in,0);
+    long *pxs = (long *)in->data;
+    for (npy_intp i=0; i < sz; i++) {
+        if (pxs[i] < 0 || pxs[i] >= npix) {
+            Py_DECREF(in);
+            PyErr_Format(PyExc_ValueError, "pixel %ld not in [0,%ld).",
+                pxs[i], npix);
+            return NULL;
+        }
+    }
     try {
-        if (strcmp(PyString_AsString(scheme), "NEST") == 0) {
-            for (int i=0; i < DIM(px,0); i++)
-                IND1(px,i,long) = self->hpb.ring2nest(IND1(px,i,long));
-        } else if (strcmp(PyString_AsString(scheme), "RING") == 0) {
-            for (int i=0; i < DIM(px,0); i++)
-                IND1(px,i,long) = self->hpb.nest2ring(IND1(px,i,long));
+        if (tonest) {
+            for (npy_intp i=0; i < sz; i++)
+                pxs[i] = self->hpb.ring2nest(pxs[i]);
         } else {
-            PyErr_Format(PyExc_ValueError,"scheme must be 'RING' or 'NEST'.");
-            return NULL;
+            for (npy_intp i=0; i < sz; i++)
+                pxs[i] = self->hpb.nest2ring(pxs[i]);
         }
     } catch (Message_error &e) {
+        Py_DECREF(in);
         PyErr_Format(PyExc_RuntimeError, e.what());
         return NULL;
     }
+    if (in != px && PyArray_CopyInto(px, in) < 0) {
+        Py_DECREF(in);
+        return NULL;
+    }
+    Py_DECREF(in);
     Py_INCREF(px);
     return PyArray_Return(px);
 }
 
-// Thin wrapper over Healpix_Base::SetNside
+// Thin wrapper over Healpix_Base2::SetNside
 static PyObject * HPBObject_SetNside(HPBObject *self, PyObject *args) {
     Healpix_Ordering_Scheme hp_scheme = RING;
-    int nside;
+    long nside;
     PyObject *scheme = NULL;
-    if (!PyArg_ParseTuple(args, "iO", &nside, &scheme)) return NULL;
+    if (!PyArg_ParseTuple(args, "lO", &nside, &scheme)) return NULL;
     if (strcmp(PyString_AsString(scheme), "NEST") == 0) hp_scheme = NEST;
     else if (strcmp(PyString_AsString(scheme), "RING") != 0) {
         PyErr_Format(PyExc_ValueError, "scheme must be 'RING' or 'NEST'.");
         return NULL;
     }
-    self->hpb.SetNside(nside, hp_scheme);
+    try {
+        self->hpb.SetNside(nside, hp_scheme);
+    } catch (Message_error &e) {
+        PyErr_Format(PyExc_RuntimeError, e.what());
+        return NULL;
+    }
     Py_INCREF(Py_None);
     return Py_None;
 }
     
 
-/* Wraps ang2pix, and uses arrays to do many at once. */
-static PyObject * HPBObject_crd2px(HPBObject *self, PyObject *args,
-        PyObject *kwds) {
-    int interpolate=0;
-    double c1, c2, c3=0;
-    fix_arr<int,4> fix_pix;
+// The arrays of a crd2px batch; c3 is NULL for (theta,phi) input, and wgt
+// is NULL unless interpolating.  Jobs hold a copy of the HPBObject's base,
+// since set_nside_scheme may be called while they run without the GIL.
+typedef struct {
+    Healpix_Base2 hpb;
+    const double *c1, *c2, *c3;
+    long *px;
+    double *wgt;
+} Crd2pxJob;
+
+/* Read coordinate i of c1,c2(,c3), counting in nbad and replacing with
+ * the north pole any that are NaN/Inf. */
+static inline void read_crd(const double *c1, const double *c2,
+        const double *c3, npy_intp i, double &x1, double &x2, double &x3,
+        long *nbad) {
+    x1 = c1[i];
+    x2 = c2[i];
+    x3 = (c3 == NULL) ? 0 : c3[i];
+    if (!std::isfinite(x1) || !std::isfinite(x2) || !std::isfinite(x3)) {
+        (*nbad)++;
+        x1 = 0; x2 = 0; x3 = 1;
+    }
+}
+
+static void crd2px_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    Crd2pxJob *job = (Crd2pxJob *)arg;
+    double c1, c2, c3;
+    fix_arr<int64,4> fix_pix;
     fix_arr<double,4> fix_wgt;
     pointing p;
     vec3 v;
+    for (npy_intp i=start; i < end; i++) {
+        read_crd(job->c1, job->c2, job->c3, i, c1, c2, c3, nbad);
+        if (job->c3 == NULL) {
+            p.theta = c1; p.phi = c2;
+        } else {
+            v.x = c1; v.y = c2; v.z = c3;
+        }
+        if (job->wgt == NULL) {
+            if (job->c3 == NULL) job->px[i] = job->hpb.ang2pix(p);
+            else job->px[i] = job->hpb.vec2pix(v);
+        } else {    // Do interpolation
+            if (job->c3 != NULL) p = pointing(v);
+            job->hpb.get_interpol(p, fix_pix, fix_wgt);
+            for (int j=0; j < 4; j++) {
+                job->px[4*i+j] = fix_pix[j];
+                job->wgt[4*i+j] = fix_wgt[j];
+            }
+        }
+    }
+}
+
+/* Wraps ang2pix, and uses arrays to do many at once.  The coordinates are
+ * converted in parallel without the GIL; NaN/Inf coordinates are counted
+ * and reported in one warning. */
+static PyObject * HPBObject_crd2px(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    int interpolate=0, nthreads=0;
+    long nbad;
+    Crd2pxJob job;
     PyArrayObject *crd1, *crd2, *crd3=NULL, *rv, *wgt=NULL;
+    PyArrayObject *in[3] = {NULL, NULL, NULL};
     PyObject *rv2;
-    static char *kwlist[] = {"crd1", "crd2", "crd3", "interpolate", NULL};
+    static char *kwlist[] = {"crd1", "crd2", "crd3", "interpolate",
+        "nthreads", NULL};
     // Parse and check input arguments
-    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!O!|O!i", kwlist, 
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!O!|O!ii", kwlist, 
             &PyArray_Type, &crd1, &PyArray_Type, &crd2, &PyArray_Type, &crd3,
-            &interpolate))
+            &interpolate, &nthreads))
         return NULL;
     CHK_ARRAY_RANK(crd1,1);
     CHK_ARRAY_RANK(crd2,1);
     if (crd3 != NULL) CHK_ARRAY_RANK(crd3,1);
-    int sz = DIM(crd1,0);
+    npy_intp sz = DIM(crd1,0);
     if (DIM(crd2,0) != sz || (crd3 != NULL && DIM(crd3,0) != sz)) {
         PyErr_Format(PyExc_RuntimeError, "input crds must have same length.");
         return NULL;
@@ -203,6 +372,10 @@ static PyObject * HPBObject_crd2px(HPBObject *self, PyObject *args,
     CHK_ARRAY_TYPE(crd1, NPY_DOUBLE);
     CHK_ARRAY_TYPE(crd2, NPY_DOUBLE);
     if (crd3 != NULL) CHK_ARRAY_TYPE(crd3, NPY_DOUBLE);
+    if (self->hpb.Npix() == 0) {
+        PyErr_Format(PyExc_ValueError, "nside has not been set.");
+        return NULL;
+    }
     // Make array(s) to hold the results
     if (interpolate == 0) {
         npy_intp dimens[1] = {sz};
@@ -212,35 +385,37 @@ static PyObject * HPBObject_crd2px(HPBObject *self, PyObject *args,
         npy_intp dimens[2] = {sz, 4};
         rv = (PyArrayObject *) PyArray_SimpleNew(2, dimens, PyArray_LONG);
         wgt = (PyArrayObject *) PyArray_SimpleNew(2, dimens, PyArray_DOUBLE);
-        CHK_NULL(rv);
-        CHK_NULL(wgt);
-    }     
-    // Interpret coordinates
-    for (int i=0; i < sz; i++) {
-        c1 = IND1(crd1,i,double);
-        c2 = IND1(crd2,i,double);
-        if (crd3 != NULL) c3 = IND1(crd3,i,double);
-        if (!std::isfinite(c1) || !std::isfinite(c2) ||
-                (crd3 != NULL && !std::isfinite(c3))) {
-                    printf("Warning: encountered NaN/Inf in crd2px\n");
-                    c1 = 0; c2 = 0; c3 = 1;
-        }
-        if (crd3 == NULL) {
-            p.theta = c1; p.phi = c2;
-        } else {
-            v.x = c1; v.y = c2; v.z = c3;
-        }
-        if (interpolate == 0) {
-            if (crd3 == NULL) IND1(rv,i,long) = self->hpb.ang2pix(p);
-            else IND1(rv,i,long) = self->hpb.vec2pix(v);
-        } else {    // Do interpolation
-            if (crd3 != NULL) p = pointing(v);
-            self->hpb.get_interpol(p, fix_pix, fix_wgt);
-            for (int j=0; j < 4; j++) {
-                IND2(rv,i,j,long) = fix_pix[j];
-                IND2(wgt,i,j,double) = fix_wgt[j];
-            }
+        if (rv == NULL || wgt == NULL) {
+            Py_XDECREF(rv); Py_XDECREF(wgt);
+            PyErr_Format(PyExc_MemoryError, "Failed to allocate rv, wgt");
+            return NULL;
         }
+    }     
+    // Work on contiguous copies of strided inputs
+    in[0] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd1);
+    in[1] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd2);
+    if (crd3 != NULL) in[2] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd3);
+    if (in[0] == NULL || in[1] == NULL || (crd3 != NULL && in[2] == NULL)) {
+        nbad = -1;
+    } else {
+        job.hpb = self->hpb;
+        job.c1 = (double *)in[0]->data;
+        job.c2 = (double *)in[1]->data;
+        job.c3 = (crd3 == NULL) ? NULL : (double *)in[2]->data;
+        job.px = (long *)rv->data;
+        job.wgt = (wgt == NULL) ? NULL : (double *)wgt->data;
+        nbad = run_batch(crd2px_chunk, &job, sz, nthreads);
+    }
+    Py_XDECREF(in[0]); Py_XDECREF(in[1]); Py_XDECREF(in[2]);
+    if (nbad > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg),
+            "crd2px: %ld NaN/Inf coordinates were mapped to theta=0", nbad);
+        if (PyErr_WarnEx(PyExc_RuntimeWarning, msg, 1) < 0) nbad = -1;
+    }
+    if (nbad < 0) {
+        Py_DECREF(rv); Py_XDECREF(wgt);
+        return NULL;
     }
     if (interpolate == 0) return PyArray_Return(rv);
     // Otherwise build tuple to return.
@@ -250,20 +425,186 @@ static PyObject * HPBObject_crd2px(HPBObject *self, PyObject *args,
     return rv2;
     
 }
+
+// The arrays of an interp_get batch; map is nmap x npix (float or double)
+// and out is nmap x n
+typedef struct {
+    Healpix_Base2 hpb;
+    const double *c1, *c2, *c3;
+    const char *map;
+    bool isfloat;
+    npy_intp nmap, npix, n;
+    double *out;
+} InterpJob;
+
+static void interp_get_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    InterpJob *job = (InterpJob *)arg;
+    double c1, c2, c3, sum;
+    fix_arr<int64,4> pix;
+    fix_arr<double,4> wgt;
+    pointing p;
+    for (npy_intp i=start; i < end; i++) {
+        read_crd(job->c1, job->c2, job->c3, i, c1, c2, c3, nbad);
+        if (job->c3 == NULL) p = pointing(c1, c2);
+        else p = pointing(vec3(c1, c2, c3));
+        job->hpb.get_interpol(p, pix, wgt);
+        for (npy_intp k=0; k < job->nmap; k++) {
+            sum = 0;
+            if (job->isfloat) {
+                const float *m = (const float *)job->map + k * job->npix;
+                for (int j=0; j < 4; j++) sum += m[pix[j]] * wgt[j];
+            } else {
+                const double *m = (const double *)job->map + k * job->npix;
+                for (int j=0; j < 4; j++) sum += m[pix[j]] * wgt[j];
+            }
+            job->out[k * job->n + i] = sum;
+        }
+    }
+}
+
+/* Interpolates map(s) at many coordinates at once: get_interpol and the
+ * weighted sum of the 4 neighboring pixels are done in one pass, in
+ * parallel without the GIL, so no [N,4] temporaries are made. */
+static PyObject * HPBObject_interp_get(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    int nthreads=0;
+    long nbad;
+    InterpJob job;
+    PyObject *map_obj;
+    PyArrayObject *map, *crd1, *crd2, *crd3=NULL, *rv;
+    PyArrayObject *in[3] = {NULL, NULL, NULL};
+    static char *kwlist[] = {"map", "crd1", "crd2", "crd3", "nthreads", NULL};
+    // Parse and check input arguments
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"OO!O!|O!i", kwlist, 
+            &map_obj, &PyArray_Type, &crd1, &PyArray_Type, &crd2,
+            &PyArray_Type, &crd3, &nthreads))
+        return NULL;
+    CHK_ARRAY_RANK(crd1,1);
+    CHK_ARRAY_RANK(crd2,1);
+    if (crd3 != NULL) CHK_ARRAY_RANK(crd3,1);
+    npy_intp sz = DIM(crd1,0);
+    if (DIM(crd2,0) != sz || (crd3 != NULL && DIM(crd3,0) != sz)) {
+        PyErr_Format(PyExc_RuntimeError, "input crds must have same length.");
+        return NULL;
+    }
+    CHK_ARRAY_TYPE(crd1, NPY_DOUBLE);
+    CHK_ARRAY_TYPE(crd2, NPY_DOUBLE);
+    if (crd3 != NULL) CHK_ARRAY_TYPE(crd3, NPY_DOUBLE);
+    if (self->hpb.Npix() == 0) {
+        PyErr_Format(PyExc_ValueError, "nside has not been set.");
+        return NULL;
+    }
+    // float maps are read as they are, other real types as double
+    if (PyArray_Check(map_obj) && 
+            TYPE(((PyArrayObject *)map_obj)) == NPY_FLOAT)
+        map = (PyArrayObject *) PyArray_ContiguousFromAny(map_obj,
+            NPY_FLOAT, 1, 2);
+    else if (PyArray_Check(map_obj) &&
+            PyArray_ISCOMPLEX((PyArrayObject *)map_obj)) {
+        PyErr_Format(PyExc_ValueError, "map must be real.");
+        return NULL;
+    } else
+        map = (PyArrayObject *) PyArray_ContiguousFromAny(map_obj,
+            NPY_DOUBLE, 1, 2);
+    if (map == NULL) return NULL;
+    if (DIM(map,RANK(map)-1) != self->hpb.Npix()) {
+        Py_DECREF(map);
+        PyErr_Format(PyExc_ValueError, "map must have npix=%ld entries.",
+            (long)self->hpb.Npix());
+        return NULL;
+    }
+    npy_intp nmap = (RANK(map) == 2) ? DIM(map,0) : 1;
+    if (RANK(map) == 2) {
+        npy_intp dimens[2] = {nmap, sz};
+        rv = (PyArrayObject *) PyArray_SimpleNew(2, dimens, PyArray_DOUBLE);
+    } else {
+        npy_intp dimens[1] = {sz};
+        rv = (PyArrayObject *) PyArray_SimpleNew(1, dimens, PyArray_DOUBLE);
+    }
+    if (rv == NULL) {
+        Py_DECREF(map);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate rv");
+        return NULL;
+    }
+    // Work on contiguous copies of strided inputs
+    in[0] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd1);
+    in[1] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd2);
+    if (crd3 != NULL) in[2] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd3);
+    if (in[0] == NULL || in[1] == NULL || (crd3 != NULL && in[2] == NULL)) {
+        nbad = -1;
+    } else {
+        job.hpb = self->hpb;
+        job.c1 = (double *)in[0]->data;
+        job.c2 = (double *)in[1]->data;
+        job.c3 = (crd3 == NULL) ? NULL : (double *)in[2]->data;
+        job.map = map->data;
+        job.isfloat = (TYPE(map) == NPY_FLOAT);
+        job.nmap = nmap;
+        job.npix = self->hpb.Npix();
+        job.n = sz;
+        job.out = (double *)rv->data;
+        nbad = run_batch(interp_get_chunk, &job, sz, nthreads);
+    }
+    Py_XDECREF(in[0]); Py_XDECREF(in[1]); Py_XDECREF(in[2]);
+    Py_DECREF(map);
+    if (nbad > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg),
+            "interp_get: %ld NaN/Inf coordinates were mapped to theta=0",
+            nbad);
+        if (PyErr_WarnEx(PyExc_RuntimeWarning, msg, 1) < 0) nbad = -1;
+    }
+    if (nbad < 0) {
+        Py_DECREF(rv);
+        return NULL;
+    }
+    return PyArray_Return(rv);
+}
+
+// The arrays of a px2crd batch; c3 is NULL for (theta,phi) output
+typedef struct {
+    Healpix_Base2 hpb;
+    const long *px;
+    double *c1, *c2, *c3;
+} Px2crdJob;
+
+static void px2crd_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    Px2crdJob *job = (Px2crdJob *)arg;
+    double z[BLOCK], phi[BLOCK], sth;
+    for (npy_intp i0=start; i0 < end; i0 += BLOCK) {
+        int m = (end - i0 < BLOCK) ? end - i0 : BLOCK;
+        job->hpb.pix2z_phi_batch(job->px + i0, z, phi, m);
+        for (int j=0; j < m; j++) {
+            npy_intp i = i0 + j;
+            if (job->c3 == NULL) {
+                job->c1[i] = acos(z[j]);
+                job->c2[i] = phi[j];
+            } else {
+                // sin(theta) straight from z, rather than via acos
+                sth = sqrt((1 - z[j]) * (1 + z[j]));
+                job->c1[i] = sth * cos(phi[j]);
+                job->c2[i] = sth * sin(phi[j]);
+                job->c3[i] = z[j];
+            }
+        }
+    }
+}
     
 /* Wraps pix2ang, but adds option of vector output as well.  Similarly
- * uses array I/O to do many at once.
+ * uses array I/O to do many at once, in parallel without the GIL.
  */
 static PyObject * HPBObject_px2crd(HPBObject *self,
         PyObject *args, PyObject *kwds) {
-    pointing p;
-    vec3 v;
-    int ncrd=3;
-    PyArrayObject *px, *crd1, *crd2, *crd3;
-    static char *kwlist[] = {"px", "ncrd", NULL};
+    int ncrd=3, nthreads=0;
+    long npix = self->hpb.Npix(), nbad;
+    Px2crdJob job;
+    PyArrayObject *px, *in, *crd1, *crd2, *crd3=NULL;
+    static char *kwlist[] = {"px", "ncrd", "nthreads", NULL};
     // Parse and check input arguments
-    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!|i", kwlist, 
-            &PyArray_Type, &px, &ncrd))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!|ii", kwlist, 
+            &PyArray_Type, &px, &ncrd, &nthreads))
         return NULL;
     if (ncrd != 2 && ncrd != 3) {
         PyErr_Format(PyExc_ValueError, "ncrd must be 2 or 3.");
@@ -271,50 +612,764 @@ static PyObject * HPBObject_px2crd(HPBObject *self,
     }
     CHK_ARRAY_RANK(px,1);
     CHK_ARRAY_TYPE(px,NPY_LONG);
-    // Make an array to hold the results
-    int sz = px->dimensions[0];
+    in = (PyArrayObject *) PyArray_GETCONTIGUOUS(px);
+    CHK_NULL(in);
+    npy_intp sz = DIM(in,0);
+    long *pxs = (long *)in->data;
+    for (npy_intp i=0; i < sz; i++) {
+        if (pxs[i] < 0 || pxs[i] >= npix) {
+            Py_DECREF(in);
+            PyErr_Format(PyExc_ValueError, "pixel %ld not in [0,%ld).",
+                pxs[i], npix);
+            return NULL;
+        }
+    }
+    // Make arrays to hold the results
     npy_intp dimens[1] = {sz};
     crd1 = (PyArrayObject *) PyArray_SimpleNew(1, dimens, PyArray_DOUBLE);
     crd2 = (PyArrayObject *) PyArray_SimpleNew(1, dimens, PyArray_DOUBLE);
-    CHK_NULL(crd1);
-    CHK_NULL(crd2);
-    if (ncrd == 2) {
-        for (int i=0; i < sz; i++) {
-            p = self->hpb.pix2ang(IND1(px,i,int));
-            IND1(crd1,i,double) = p.theta;
-            IND1(crd2,i,double) = p.phi;
+    if (ncrd == 3)
+        crd3 = (PyArrayObject *) PyArray_SimpleNew(1, dimens, PyArray_DOUBLE);
+    if (crd1 == NULL || crd2 == NULL || (ncrd == 3 && crd3 == NULL)) {
+        Py_DECREF(in); Py_XDECREF(crd1); Py_XDECREF(crd2); Py_XDECREF(crd3);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate crds");
+        return NULL;
+    }
+    job.hpb = self->hpb;
+    job.px = pxs;
+    job.c1 = (double *)crd1->data;
+    job.c2 = (double *)crd2->data;
+    job.c3 = (crd3 == NULL) ? NULL : (double *)crd3->data;
+    nbad = run_batch(px2crd_chunk, &job, sz, nthreads);
+    Py_DECREF(in);
+    if (nbad < 0) {
+        Py_DECREF(crd1); Py_DECREF(crd2); Py_XDECREF(crd3);
+        return NULL;
+    }
+    if (ncrd == 2) 
+        return Py_BuildValue("(NN)",PyArray_Return(crd1),PyArray_Return(crd2));
+    return Py_BuildValue("(NNN)", PyArray_Return(crd1),
+        PyArray_Return(crd2), PyArray_Return(crd3));
+}
+        
+// Add (or with set, assign the sum of) val to map at the pixels in px.
+// val has n entries, or 1 to be used for every pixel.
+template<typename T> static void scatter_loop(char *map, const long *px,
+        npy_intp n, npy_intp npix, const char *val, npy_intp nval,
+        bool set) {
+    T *m = (T *)map;
+    const T *v = (const T *)val;
+    npy_intp vstep = (nval == 1) ? 0 : 1;
+    long p;
+    if (set) {
+        for (npy_intp i=0; i < n; i++) {
+            p = px[i];
+            m[p + (p < 0) * npix] = T(0);
+        }
+    }
+    for (npy_intp i=0; i < n; i++) {
+        p = px[i];
+        m[p + (p < 0) * npix] += v[i * vstep];
+    }
+}
+
+/* Accumulates values into any number of maps at once, touching only the
+ * pixels in px, so that a[px] += val behaves as expected for repeated
+ * pixels (this is what HealpixMap.__setitem__ and Map.add need). */
+static PyObject * HPBObject_scatter_add(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    int set=0, rv=0;
+    long npix = self->hpb.Npix(), p;
+    PyArrayObject *px, *in, *map;
+    PyObject *maps, *vals;
+    static char *kwlist[] = {"px", "maps", "vals", "set", NULL};
+    // Parse and check input arguments
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!OO|i", kwlist, 
+            &PyArray_Type, &px, &maps, &vals, &set))
+        return NULL;
+    CHK_ARRAY_RANK(px,1);
+    CHK_ARRAY_TYPE(px,NPY_LONG);
+    if (!PySequence_Check(maps) || !PySequence_Check(vals) ||
+            PySequence_Size(maps) != PySequence_Size(vals)) {
+        PyErr_Format(PyExc_ValueError,
+            "maps and vals must be sequences of the same length.");
+        return NULL;
+    }
+    in = (PyArrayObject *) PyArray_GETCONTIGUOUS(px);
+    CHK_NULL(in);
+    npy_intp sz = DIM(in,0);
+    long *pxs = (long *)in->data;
+    for (npy_intp i=0; i < sz; i++) {
+        p = pxs[i];
+        if (p < -npix || p >= npix) {
+            Py_DECREF(in);
+            PyErr_Format(PyExc_ValueError, "pixel %ld not in [0,%ld).",
+                p, npix);
+            return NULL;
+        }
+    }
+    for (Py_ssize_t k=0; k < PySequence_Size(maps) && rv == 0; k++) {
+        PyObject *m = PySequence_GetItem(maps, k);
+        PyObject *v = PySequence_GetItem(vals, k);
+        PyArrayObject *val = NULL;
+        map = (PyArrayObject *)m;
+        // Maps are modified in place, so they can't be copied
+        if (m == NULL || v == NULL || !PyArray_Check(m) || RANK(map) != 1 ||
+                DIM(map,0) != npix || !PyArray_ISCARRAY(map) ||
+                !PyArray_ISNOTSWAPPED(map)) {
+            if (!PyErr_Occurred()) PyErr_Format(PyExc_ValueError,
+                "maps must be writable, contiguous, native byte order "
+                "arrays of npix values.");
+            rv = -1;
+        } else {
+            val = (PyArrayObject *) PyArray_ContiguousFromAny(v,
+                TYPE(map), 0, 1);
+            if (val == NULL) rv = -1;
+            else if (PyArray_SIZE(val) != sz && PyArray_SIZE(val) != 1) {
+                PyErr_Format(PyExc_ValueError,
+                    "vals must have 1 or len(px) entries.");
+                rv = -1;
+            }
+        }
+        if (rv == 0) {
+            npy_intp nval = PyArray_SIZE(val);
+            int type = TYPE(map);
+            Py_BEGIN_ALLOW_THREADS
+            switch (type) {
+#define SCATTER(npy_type, T) \
+                case npy_type: scatter_loop<T>(map->data, pxs, sz, npix, \
+                    val->data, nval, set); break;
+                SCATTER(NPY_BOOL, bool)
+                SCATTER(NPY_BYTE, signed char)
+                SCATTER(NPY_UBYTE, unsigned char)
+                SCATTER(NPY_SHORT, short)
+                SCATTER(NPY_USHORT, unsigned short)
+                SCATTER(NPY_INT, int)
+                SCATTER(NPY_UINT, unsigned int)
+                SCATTER(NPY_LONG, long)
+                SCATTER(NPY_ULONG, unsigned long)
+                SCATTER(NPY_LONGLONG, long long)
+                SCATTER(NPY_ULONGLONG, unsigned long long)
+                SCATTER(NPY_FLOAT, float)
+                SCATTER(NPY_DOUBLE, double)
+                SCATTER(NPY_LONGDOUBLE, long double)
+                SCATTER(NPY_CFLOAT, std::complex<float>)
+                SCATTER(NPY_CDOUBLE, std::complex<double>)
+                SCATTER(NPY_CLONGDOUBLE, std::complex<long double>)
+#undef SCATTER
+                default: rv = -2;
+            }
+            Py_END_ALLOW_THREADS
+            if (rv == -2) PyErr_Format(PyExc_ValueError,
+                "Unsupported data type.");
+        }
+        Py_XDECREF(val); Py_XDECREF(m); Py_XDECREF(v);
+    }
+    Py_DECREF(in);
+    if (rv != 0) return NULL;
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+// The discs or polygons of a query batch, and the pixel ranges of each
+typedef struct {
+    Healpix_Base2 hpb;
+    const double *c1, *c2, *c3, *radius;
+    npy_intp nradius;
+    const double *vert;     // polygons: n x nv x 3
+    int nv;
+    std::vector<int64> *ranges;
+} QueryJob;
+
+static void query_disc_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    QueryJob *job = (QueryJob *)arg;
+    double c1, c2, c3, r;
+    pointing p;
+    for (npy_intp i=start; i < end; i++) {
+        r = job->radius[(job->nradius == 1) ? 0 : i];
+        c1 = job->c1[i];
+        c2 = job->c2[i];
+        c3 = (job->c3 == NULL) ? 0 : job->c3[i];
+        if (!std::isfinite(c1) || !std::isfinite(c2) || !std::isfinite(c3)
+                || !std::isfinite(r)) {
+            (*nbad)++;
+            continue;
+        }
+        if (job->c3 == NULL) p = pointing(c1, c2);
+        else p = pointing(vec3(c1, c2, c3));
+        job->hpb.query_disc_ranges(p, r, job->ranges[i]);
+    }
+}
+
+static void query_polygon_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    QueryJob *job = (QueryJob *)arg;
+    std::vector<vec3> v(job->nv);
+    for (npy_intp i=start; i < end; i++) {
+        const double *d = job->vert + 3 * job->nv * i;
+        bool ok = true;
+        for (int j=0; j < job->nv; j++) {
+            v[j] = vec3(d[3*j], d[3*j+1], d[3*j+2]);
+            if (!std::isfinite(v[j].SquaredLength())) ok = false;
+        }
+        if (!ok) {
+            (*nbad)++;
+            continue;
+        }
+        job->hpb.query_polygon_ranges(&v[0], job->nv, job->ranges[i]);
+    }
+}
+
+/* Return a list with a K x 2 array of (start,stop) for each of the n
+ * range lists in ranges. */
+static PyObject *ranges2list(const std::vector<int64> *ranges, npy_intp n) {
+    PyObject *rv = PyList_New(n);
+    CHK_NULL(rv);
+    for (npy_intp i=0; i < n; i++) {
+        npy_intp dimens[2] = {(npy_intp)ranges[i].size() / 2, 2};
+        PyArrayObject *r = (PyArrayObject *) PyArray_SimpleNew(2, dimens,
+            PyArray_LONG);
+        if (r == NULL) {
+            Py_DECREF(rv);
+            return NULL;
+        }
+        for (unsigned int j=0; j < ranges[i].size(); j++)
+            ((long *)r->data)[j] = ranges[i][j];
+        PyList_SET_ITEM(rv, i, (PyObject *)r);
+    }
+    return rv;
+}
+
+/* Wraps query_disc_ranges for a batch of discs, each searched on its own
+ * (in parallel, without the GIL).  Returns a list of pixel range arrays. */
+static PyObject * HPBObject_query_disc(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    int nthreads=0;
+    long nbad=-1;
+    QueryJob job;
+    PyObject *radius, *rv=NULL;
+    PyArrayObject *crd1, *crd2, *crd3=NULL;
+    PyArrayObject *in[4] = {NULL, NULL, NULL, NULL};
+    static char *kwlist[] = {"radius", "crd1", "crd2", "crd3", "nthreads",
+        NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"OO!O!|O!i", kwlist,
+            &radius, &PyArray_Type, &crd1, &PyArray_Type, &crd2,
+            &PyArray_Type, &crd3, &nthreads))
+        return NULL;
+    CHK_ARRAY_RANK(crd1,1);
+    CHK_ARRAY_RANK(crd2,1);
+    if (crd3 != NULL) CHK_ARRAY_RANK(crd3,1);
+    npy_intp sz = DIM(crd1,0);
+    if (DIM(crd2,0) != sz || (crd3 != NULL && DIM(crd3,0) != sz)) {
+        PyErr_Format(PyExc_RuntimeError, "input crds must have same length.");
+        return NULL;
+    }
+    CHK_ARRAY_TYPE(crd1, NPY_DOUBLE);
+    CHK_ARRAY_TYPE(crd2, NPY_DOUBLE);
+    if (crd3 != NULL) CHK_ARRAY_TYPE(crd3, NPY_DOUBLE);
+    if (self->hpb.Npix() == 0) {
+        PyErr_Format(PyExc_ValueError, "nside has not been set.");
+        return NULL;
+    }
+    in[3] = (PyArrayObject *) PyArray_ContiguousFromAny(radius, NPY_DOUBLE,
+        0, 1);
+    if (in[3] == NULL) return NULL;
+    if (PyArray_SIZE(in[3]) != 1 && PyArray_SIZE(in[3]) != sz) {
+        Py_DECREF(in[3]);
+        PyErr_Format(PyExc_ValueError,
+            "radius must be a scalar or have the same length as crds.");
+        return NULL;
+    }
+    in[0] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd1);
+    in[1] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd2);
+    if (crd3 != NULL) in[2] = (PyArrayObject *) PyArray_GETCONTIGUOUS(crd3);
+    if (in[0] != NULL && in[1] != NULL && (crd3 == NULL || in[2] != NULL)) {
+        std::vector<std::vector<int64> > ranges(sz);
+        job.hpb = self->hpb;
+        job.c1 = (double *)in[0]->data;
+        job.c2 = (double *)in[1]->data;
+        job.c3 = (crd3 == NULL) ? NULL : (double *)in[2]->data;
+        job.radius = (double *)in[3]->data;
+        job.nradius = PyArray_SIZE(in[3]);
+        job.ranges = (sz > 0) ? &ranges[0] : NULL;
+        nbad = run_batch(query_disc_chunk, &job, sz, nthreads, 1);
+        if (nbad >= 0) rv = ranges2list(job.ranges, sz);
+    }
+    for (int i=0; i < 4; i++) Py_XDECREF(in[i]);
+    if (rv != NULL && nbad > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg),
+            "query_disc: %ld discs with NaN/Inf inputs returned no pixels",
+            nbad);
+        if (PyErr_WarnEx(PyExc_RuntimeWarning, msg, 1) < 0) {
+            Py_DECREF(rv);
+            return NULL;
+        }
+    }
+    return rv;
+}
+
+/* Wraps query_polygon_ranges for a batch of convex polygons, like
+ * query_disc. */
+static PyObject * HPBObject_query_polygon(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    int nthreads=0;
+    long nbad;
+    QueryJob job;
+    PyObject *vert, *rv=NULL;
+    PyArrayObject *in;
+    static char *kwlist[] = {"vertices", "nthreads", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O|i", kwlist,
+            &vert, &nthreads))
+        return NULL;
+    if (self->hpb.Npix() == 0) {
+        PyErr_Format(PyExc_ValueError, "nside has not been set.");
+        return NULL;
+    }
+    in = (PyArrayObject *) PyArray_ContiguousFromAny(vert, NPY_DOUBLE, 3, 3);
+    if (in == NULL) return NULL;
+    if (DIM(in,1) < 3 || DIM(in,2) != 3) {
+        Py_DECREF(in);
+        PyErr_Format(PyExc_ValueError,
+            "vertices must be npoly x nv x 3, with nv >= 3.");
+        return NULL;
+    }
+    npy_intp sz = DIM(in,0);
+    std::vector<std::vector<int64> > ranges(sz);
+    job.hpb = self->hpb;
+    job.vert = (double *)in->data;
+    job.nv = DIM(in,1);
+    job.ranges = (sz > 0) ? &ranges[0] : NULL;
+    nbad = run_batch(query_polygon_chunk, &job, sz, nthreads, 1);
+    Py_DECREF(in);
+    if (nbad < 0) return NULL;
+    rv = ranges2list(job.ranges, sz);
+    if (rv != NULL && nbad > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg),
+            "query_polygon: %ld polygons with NaN/Inf vertices returned "
+            "no pixels", nbad);
+        if (PyErr_WarnEx(PyExc_RuntimeWarning, msg, 1) < 0) {
+            Py_DECREF(rv);
+            return NULL;
+        }
+    }
+    return rv;
+}
+
+// A whole map reorder: tmp is a copy of map, permuted back into map
+typedef struct {
+    Healpix_Base2 hpb;
+    char *map, *tmp;
+    int itemsize;
+    bool to_ring;
+} ReorderJob;
+
+template<int S> struct Item { char b[S]; };
+
+static void reorder_copy_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    ReorderJob *job = (ReorderJob *)arg;
+    memcpy(job->tmp + start * job->itemsize, job->map + start * job->itemsize,
+        (end - start) * job->itemsize);
+}
+
+static void reorder_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    ReorderJob *job = (ReorderJob *)arg;
+    int s = job->itemsize;
+    switch (s) {
+#define REORDER(S) \
+        case S: job->hpb.reorder_tiles((const Item<S> *)job->tmp, \
+            (Item<S> *)job->map, job->to_ring, start, end); break;
+        REORDER(1)
+        REORDER(2)
+        REORDER(4)
+        REORDER(8)
+        REORDER(16)
+        REORDER(32)
+#undef REORDER
+        default: {
+            // Other record sizes go a pixel at a time
+            npy_intp tpix = job->hpb.Npix() / job->hpb.reorder_ntiles();
+            for (npy_intp p=start*tpix; p < end*tpix; p++) {
+                npy_intp r = job->hpb.nest2ring(p);
+                if (job->to_ring) memcpy(job->map + r*s, job->tmp + p*s, s);
+                else memcpy(job->map + p*s, job->tmp + r*s, s);
+            }
+        }
+    }
+}
+
+/* Permutes a whole map in place from this object's scheme to 'scheme',
+ * a tile of pixels at a time on several threads (see
+ * Healpix_Base2::reorder_tiles), using one scratch copy of the map. */
+static PyObject * HPBObject_reorder(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    int nthreads=0;
+    long rv;
+    char *scheme;
+    ReorderJob job;
+    PyArrayObject *map;
+    static char *kwlist[] = {"map", "scheme", "nthreads", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!s|i", kwlist, 
+            &PyArray_Type, &map, &scheme, &nthreads))
+        return NULL;
+    if (strcmp(scheme, "NEST") == 0) job.to_ring = false;
+    else if (strcmp(scheme, "RING") == 0) job.to_ring = true;
+    else {
+        PyErr_Format(PyExc_ValueError,"scheme must be 'RING' or 'NEST'.");
+        return NULL;
+    }
+    // Pixels are only moved, so any byte order will do
+    if (RANK(map) != 1 || DIM(map,0) != self->hpb.Npix() ||
+            !PyArray_CHKFLAGS(map, NPY_CARRAY)) {
+        PyErr_Format(PyExc_ValueError,
+            "map must be a writable contiguous array of npix values.");
+        return NULL;
+    }
+    if (self->hpb.Order() < 0) {
+        PyErr_Format(PyExc_ValueError,
+            "nside must be a power of 2 to change scheme.");
+        return NULL;
+    }
+    if ((self->hpb.Scheme() == RING) != job.to_ring) {
+        npy_intp ntiles = self->hpb.reorder_ntiles();
+        npy_intp tpix = self->hpb.Npix() / ntiles;
+        job.hpb = self->hpb;
+        job.itemsize = PyArray_ITEMSIZE(map);
+        job.map = map->data;
+        job.tmp = (char *) PyMem_Malloc(DIM(map,0) * job.itemsize);
+        CHK_NULL(job.tmp);
+        rv = run_batch(reorder_copy_chunk, &job, DIM(map,0), nthreads);
+        if (rv >= 0)
+            rv = run_batch(reorder_chunk, &job, ntiles, nthreads,
+                (MIN_CHUNK + tpix - 1) / tpix);
+        PyMem_Free(job.tmp);
+        if (rv < 0) return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+// A ud_grade between two NEST maps, whose nsides differ by a factor 2^k
+typedef struct {
+    const char *in;
+    char *out;
+    const double *wgt;
+    const npy_bool *mask;
+    int type, shift;        // shift = 2k
+    bool down, sum;
+    double fill;
+} UdGradeJob;
+
+/* Each output pixel is the (weighted) mean or sum of the input over its
+ * area: for a downgrade, of its 4^k unmasked children; for an upgrade,
+ * its parent (split 4^k ways for a sum).  Output pixels with nothing
+ * valid under them get fill.  Upgrades go backwards and downgrades
+ * forwards, so that one chunk can work in place. */
+template<typename T, typename A> static void ud_grade_loop(
+        const UdGradeJob *job, npy_intp start, npy_intp end) {
+    const T *in = (const T *)job->in;
+    T *out = (T *)job->out;
+    double w, wsum;
+    A acc;
+    if (job->down) {
+        npy_intp nc = (npy_intp)1 << job->shift;
+        for (npy_intp i=start; i < end; i++) {
+            acc = 0; wsum = 0;
+            bool any = false;
+            for (npy_intp c=i*nc; c < (i+1)*nc; c++) {
+                if (job->mask != NULL && job->mask[c]) continue;
+                w = (job->wgt == NULL) ? 1 : job->wgt[c];
+                acc += A(in[c]) * w;
+                wsum += w;
+                any = true;
+            }
+            if (job->sum) out[i] = any ? T(acc) : T(job->fill);
+            else out[i] = (wsum != 0) ? T(acc / wsum) : T(job->fill);
         }
-        return Py_BuildValue("(OO)",PyArray_Return(crd1),PyArray_Return(crd2));
     } else {
-        crd3 = (PyArrayObject *) PyArray_SimpleNew(1, dimens, PyArray_DOUBLE);
-        for (int i=0; i < sz; i++) {
-            p = self->hpb.pix2ang(IND1(px,i,int));
-            v = p.to_vec3();
-            IND1(crd1,i,double) = v.x;
-            IND1(crd2,i,double) = v.y;
-            IND1(crd3,i,double) = v.z;
+        double split = job->sum ? 1. / ((npy_intp)1 << job->shift) : 1;
+        for (npy_intp j=end-1; j >= start; j--) {
+            npy_intp p = j >> job->shift;
+            w = (job->wgt == NULL) ? 1 : job->wgt[p];
+            if ((job->mask != NULL && job->mask[p]) || w == 0)
+                out[j] = T(job->fill);
+            else if (job->sum) out[j] = T(A(in[p]) * (w * split));
+            else out[j] = in[p];
         }
-        return Py_BuildValue("(OOO)", PyArray_Return(crd1),
-            PyArray_Return(crd2), PyArray_Return(crd3));
     }
 }
-        
-// Thin wrapper over Healpix_Base::Order
+
+static void ud_grade_chunk(void *arg, npy_intp start, npy_intp end,
+        long *nbad) {
+    UdGradeJob *job = (UdGradeJob *)arg;
+    switch (job->type) {
+        case NPY_FLOAT: ud_grade_loop<float, double>(job, start, end); break;
+        case NPY_DOUBLE: ud_grade_loop<double, double>(job, start, end); break;
+        case NPY_CFLOAT:
+            ud_grade_loop<std::complex<float>, std::complex<double> >(job,
+                start, end);
+            break;
+        case NPY_CDOUBLE:
+            ud_grade_loop<std::complex<double>, std::complex<double> >(job,
+                start, end);
+            break;
+    }
+}
+
+/* Changes the resolution of a NEST map of this object into out (a NEST
+ * map of any power of 2 nside), using the hierarchy of NEST pixel numbers
+ * instead of coordinates.  out may share its data with map. */
+static PyObject * HPBObject_ud_grade(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    int nthreads=0, shift=0;
+    long rv;
+    char *mode="mean";
+    double fill=0;
+    int64 npix = self->hpb.Npix();
+    UdGradeJob job;
+    PyArrayObject *map, *out, *in=NULL, *wgt=NULL, *mask=NULL;
+    PyObject *wgt_obj=Py_None, *mask_obj=Py_None;
+    static char *kwlist[] = {"map", "out", "mode", "wgt", "mask", "fill",
+        "nthreads", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!O!|sOOdi", kwlist,
+            &PyArray_Type, &map, &PyArray_Type, &out, &mode, &wgt_obj,
+            &mask_obj, &fill, &nthreads))
+        return NULL;
+    if (self->hpb.Scheme() != NEST) {
+        PyErr_Format(PyExc_ValueError, "ud_grade needs a NEST HealpixBase.");
+        return NULL;
+    }
+    if (strcmp(mode, "mean") == 0) job.sum = false;
+    else if (strcmp(mode, "sum") == 0) job.sum = true;
+    else {
+        PyErr_Format(PyExc_ValueError, "mode must be 'mean' or 'sum'.");
+        return NULL;
+    }
+    CHK_ARRAY_RANK(map,1);
+    CHK_ARRAY_RANK(out,1);
+    job.type = TYPE(map);
+    if (job.type != NPY_FLOAT && job.type != NPY_DOUBLE &&
+            job.type != NPY_CFLOAT && job.type != NPY_CDOUBLE) {
+        PyErr_Format(PyExc_ValueError,
+            "map must be float, double, complex64 or complex128.");
+        return NULL;
+    }
+    CHK_ARRAY_TYPE(out, job.type);
+    if (DIM(map,0) != npix || !PyArray_ISCARRAY(out)) {
+        PyErr_Format(PyExc_ValueError,
+            "map must have npix values, and out must be writable, contiguous "
+            "and in native byte order.");
+        return NULL;
+    }
+    // out must be a hierarchical map too, 2k orders above or below map
+    int64 npix_out = DIM(out,0);
+    int64 lo = (npix_out < npix) ? npix_out : npix;
+    int64 hi = (npix_out < npix) ? npix : npix_out;
+    while (lo > 0 && (lo << shift) < hi) shift += 2;
+    if (lo == 0 || npix_out % 12 != 0 || (lo << shift) != hi) {
+        PyErr_Format(PyExc_ValueError,
+            "out must have 12*4**k values for some k.");
+        return NULL;
+    }
+    // A contiguous, native byte order copy of map, unless it is one already
+    in = (PyArrayObject *) PyArray_FROM_OTF((PyObject *)map, job.type,
+        NPY_IN_ARRAY);
+    CHK_NULL(in);
+    if (wgt_obj != Py_None) {
+        wgt = (PyArrayObject *) PyArray_ContiguousFromAny(wgt_obj,
+            NPY_DOUBLE, 1, 1);
+        if (wgt == NULL || DIM(wgt,0) != npix) {
+            if (wgt != NULL) PyErr_Format(PyExc_ValueError,
+                "wgt must have npix values.");
+            Py_DECREF(in); Py_XDECREF(wgt);
+            return NULL;
+        }
+    }
+    if (mask_obj != Py_None) {
+        mask = (PyArrayObject *) PyArray_ContiguousFromAny(mask_obj,
+            NPY_BOOL, 1, 1);
+        if (mask == NULL || DIM(mask,0) != npix) {
+            if (mask != NULL) PyErr_Format(PyExc_ValueError,
+                "mask must have npix values.");
+            Py_DECREF(in); Py_XDECREF(wgt); Py_XDECREF(mask);
+            return NULL;
+        }
+    }
+    job.in = in->data;
+    job.out = out->data;
+    job.wgt = (wgt == NULL) ? NULL : (double *)wgt->data;
+    job.mask = (mask == NULL) ? NULL : (npy_bool *)mask->data;
+    job.shift = shift;
+    job.down = npix_out < npix;
+    job.fill = fill;
+    // Working in place has to go in order, on one thread
+    int isize = PyArray_ITEMSIZE(out);
+    if (in->data < out->data + npix_out * isize &&
+            out->data < in->data + npix * isize) {
+        if (in->data != out->data) {
+            PyErr_Format(PyExc_ValueError,
+                "out must either start at map or not overlap it.");
+            rv = -1;
+        } else {
+            rv = run_batch(ud_grade_chunk, &job, npix_out, 1, npix_out);
+        }
+    } else {
+        npy_intp per = (npy_intp)1 << (job.down ? shift : 0);
+        rv = run_batch(ud_grade_chunk, &job, npix_out, nthreads,
+            (MIN_CHUNK + per - 1) / per);
+    }
+    Py_DECREF(in); Py_XDECREF(wgt); Py_XDECREF(mask);
+    if (rv < 0) return NULL;
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Sparse maps keep their cells as a sorted array of NUNIQ numbers
+ * (4*4**order + NEST pixel), with a row of values per layer.  The NUNIQ
+ * numbers of every order up to that of the map fill [4, 16*4**order). */
+struct CellLess {
+    const long *px;
+    CellLess(const long *p) : px(p) {}
+    bool operator()(npy_intp a, npy_intp b) const { return px[a] < px[b]; }
+};
+
+// Merge the sorted cells with px (visited in sorted order through idx),
+// summing the values of equal cells.  Returns the number of cells in the
+// merge, and only counts them if out_cells is NULL.
+static npy_intp sparse_merge(const long *cells, const double *vals,
+        npy_intp nc, const long *px, const double *pvals, npy_intp np,
+        const npy_intp *idx, npy_intp nl, long *out_cells,
+        double *out_vals, npy_intp nout) {
+    npy_intp i=0, j=0, k=0;
+    long key;
+    while (i < nc || j < np) {
+        if (j >= np || (i < nc && cells[i] <= px[idx[j]])) key = cells[i];
+        else key = px[idx[j]];
+        if (out_cells != NULL) {
+            out_cells[k] = key;
+            for (npy_intp l=0; l < nl; l++) out_vals[l*nout + k] = 0;
+            if (i < nc && cells[i] == key) {
+                for (npy_intp l=0; l < nl; l++)
+                    out_vals[l*nout + k] = vals[l*nc + i];
+            }
+            for (npy_intp jj=j; jj < np && px[idx[jj]] == key; jj++) {
+                for (npy_intp l=0; l < nl; l++)
+                    out_vals[l*nout + k] += pvals[l*np + idx[jj]];
+            }
+        }
+        if (i < nc && cells[i] == key) i++;
+        while (j < np && px[idx[j]] == key) j++;
+        k++;
+    }
+    return k;
+}
+
+/* Adds values to a sparse map in bulk: one sort of the new cells and one
+ * merge pass, instead of an insertion per pixel. */
+static PyObject * HPBObject_sparse_add(HPBObject *self, PyObject *args,
+        PyObject *kwds) {
+    PyArrayObject *cells, *vals, *px, *pvals, *in[4], *out_cells, *out_vals;
+    npy_intp nc, np, nl, nout, dims[2];
+    static char *kwlist[] = {"cells", "vals", "px", "pvals", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,"O!O!O!O!", kwlist,
+            &PyArray_Type, &cells, &PyArray_Type, &vals,
+            &PyArray_Type, &px, &PyArray_Type, &pvals))
+        return NULL;
+    int order = self->hpb.Order();
+    if (order < 0) {
+        PyErr_Format(PyExc_ValueError,
+            "sparse maps need an nside that is a power of 2.");
+        return NULL;
+    }
+    CHK_ARRAY_RANK(cells,1);
+    CHK_ARRAY_TYPE(cells,NPY_LONG);
+    CHK_ARRAY_RANK(vals,2);
+    CHK_ARRAY_TYPE(vals,NPY_DOUBLE);
+    CHK_ARRAY_RANK(px,1);
+    CHK_ARRAY_TYPE(px,NPY_LONG);
+    CHK_ARRAY_RANK(pvals,2);
+    CHK_ARRAY_TYPE(pvals,NPY_DOUBLE);
+    nc = DIM(cells,0); np = DIM(px,0); nl = DIM(vals,0);
+    if (DIM(vals,1) != nc || DIM(pvals,0) != nl || DIM(pvals,1) != np) {
+        PyErr_Format(PyExc_ValueError,
+            "vals must be nlayers x len(cells) and pvals nlayers x len(px).");
+        return NULL;
+    }
+    in[0] = (PyArrayObject *) PyArray_GETCONTIGUOUS(cells);
+    in[1] = (PyArrayObject *) PyArray_GETCONTIGUOUS(vals);
+    in[2] = (PyArrayObject *) PyArray_GETCONTIGUOUS(px);
+    in[3] = (PyArrayObject *) PyArray_GETCONTIGUOUS(pvals);
+    for (int i=0; i < 4; i++) {
+        if (in[i] == NULL) {
+            for (int j=0; j < 4; j++) Py_XDECREF(in[j]);
+            PyErr_Format(PyExc_MemoryError, "Failed to allocate in");
+            return NULL;
+        }
+    }
+    const long *c = (const long *)in[0]->data;
+    const double *v = (const double *)in[1]->data;
+    const long *p = (const long *)in[2]->data;
+    const double *pv = (const double *)in[3]->data;
+    long umax = long(16) << (2*order);
+    for (npy_intp i=0; i < nc + np; i++) {
+        long u = (i < nc) ? c[i] : p[i - nc];
+        if (u < 4 || u >= umax)
+            PyErr_Format(PyExc_ValueError, "cell %ld not in [4,%ld).",
+                u, umax);
+        else if (i > 0 && i < nc && u <= c[i-1])
+            PyErr_Format(PyExc_ValueError,
+                "cells must be sorted and unique.");
+        else continue;
+        for (int j=0; j < 4; j++) Py_DECREF(in[j]);
+        return NULL;
+    }
+    std::vector<npy_intp> idx(np);
+    for (npy_intp i=0; i < np; i++) idx[i] = i;
+    const npy_intp *pidx = (np > 0) ? &idx[0] : NULL;
+    // Sort the new cells and count the merge without the GIL...
+    Py_BEGIN_ALLOW_THREADS
+    std::stable_sort(idx.begin(), idx.end(), CellLess(p));
+    nout = sparse_merge(c, v, nc, p, pv, np, pidx, nl, NULL, NULL, 0);
+    Py_END_ALLOW_THREADS
+    // ...then allocate the result and fill it in
+    dims[0] = nl; dims[1] = nout;
+    out_cells = (PyArrayObject *) PyArray_SimpleNew(1, dims+1, NPY_LONG);
+    out_vals = (PyArrayObject *) PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if (out_cells == NULL || out_vals == NULL) {
+        for (int j=0; j < 4; j++) Py_DECREF(in[j]);
+        Py_XDECREF(out_cells); Py_XDECREF(out_vals);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate out");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    sparse_merge(c, v, nc, p, pv, np, pidx, nl, (long *)out_cells->data,
+        (double *)out_vals->data, nout);
+    Py_END_ALLOW_THREADS
+    for (int j=0; j < 4; j++) Py_DECREF(in[j]);
+    return Py_BuildValue("(NN)", PyArray_Return(out_cells),
+        PyArray_Return(out_vals));
+}
+
+// Thin wrapper over Healpix_Base2::Order
 static PyObject * HPBObject_Order(HPBObject *self) {
     return PyInt_FromLong(self->hpb.Order());
 }
 
-// Thin wrapper over Healpix_Base::Nside
+// Thin wrapper over Healpix_Base2::Nside
 static PyObject * HPBObject_Nside(HPBObject *self) {
     return PyInt_FromLong(self->hpb.Nside());
 }
 
-// Thin wrapper over Healpix_Base::Npix
+// Thin wrapper over Healpix_Base2::Npix
 static PyObject * HPBObject_Npix(HPBObject *self) {
     return PyInt_FromLong(self->hpb.Npix());
 }
 
-// Thin wrapper over Healpix_Base::Scheme
+// Thin wrapper over Healpix_Base2::Scheme
 static PyObject * HPBObject_Scheme(HPBObject *self) {
     Healpix_Ordering_Scheme scheme = self->hpb.Scheme();
     if (scheme == RING) return PyString_FromString("RING");
@@ -335,12 +1390,31 @@ static PyMethodDef HPBObject_methods[] = {
     {"nest_ring_conv", (PyCFunction)HPBObject_nest_ring_conv,
         METH_VARARGS,
         "nest_ring_conv(px,scheme)\nTranslate an array of pixel numbers to index data in the scheme specified in 'scheme' ('NEST' or 'RING').  Returns px, which has been modified in place (so beware!)."},
+    {"reorder", (PyCFunction)HPBObject_reorder, METH_VARARGS|METH_KEYWORDS,
+        "reorder(map,scheme,nthreads=0)\nPermute map (a contiguous array of npix values of any type, which must be in the current scheme of this object) in place into 'scheme' ('NEST' or 'RING').  Does not change the scheme of this object.  Work is split over nthreads threads (0 = one per cpu) and run without the GIL."},
+    {"ud_grade", (PyCFunction)HPBObject_ud_grade, METH_VARARGS|METH_KEYWORDS,
+        "ud_grade(map,out,mode='mean',wgt=None,mask=None,fill=0,nthreads=0)\nChange the resolution of map (npix values in NEST order; this object must be NEST) into out (12*4**k values in NEST order, of the same type as map, which is float, double or complex).  Each pixel of out is the mean (or with mode='sum', the sum) of map over its area: downgrading combines the children of each pixel, and upgrading replicates (or splits) each pixel into its children.  wgt holds optional weights for map, and pixels of map where mask is True are ignored.  Pixels of out with nothing valid under them get fill.  out may start at the same memory as map to work in place (on one thread); otherwise work is split over nthreads threads (0 = one per cpu) and run without the GIL."},
     {"set_nside_scheme", (PyCFunction)HPBObject_SetNside, METH_VARARGS,
         "set_nside_scheme(nside,scheme)\nAdjust Nside and Scheme ('RING' or 'NEST')."},
     {"crd2px", (PyCFunction)HPBObject_crd2px, METH_VARARGS|METH_KEYWORDS,
-        "crd2px(c1,c2,c3=None,interpolate=False)\nConvert 1 dimensional arrays of input coordinates to pixel indices. If only c1,c2 provided, then read them as th,phi.  If c1,c2,c3 provided, read them as x,y,z. If interpolate is False, return a single pixel coordinate.  If interpolate is True, return px,wgts where each entry in px contains the 4 pixels adjacent to the specified location, and wgt contains the 4 corresponding weights of those pixels."},
+        "crd2px(c1,c2,c3=None,interpolate=False,nthreads=0)\nConvert 1 dimensional arrays of input coordinates to pixel indices. If only c1,c2 provided, then read them as th,phi.  If c1,c2,c3 provided, read them as x,y,z. If interpolate is False, return a single pixel coordinate.  If interpolate is True, return px,wgts where each entry in px contains the 4 pixels adjacent to the specified location, and wgt contains the 4 corresponding weights of those pixels.  Large batches are split over nthreads threads (0 = one per cpu) and run without the GIL.  NaN/Inf coordinates are mapped to theta=0 and counted in a single RuntimeWarning."},
+    {"interp_get", (PyCFunction)HPBObject_interp_get,
+        METH_VARARGS|METH_KEYWORDS,
+        "interp_get(map,c1,c2,c3=None,nthreads=0)\nReturn map (npix values, or a 2 dimensional array of nmap x npix) interpolated at the coordinates c1,c2(,c3), read as for crd2px.  Equivalent to n.sum(map[...,px]*wgts, axis=-1) for px,wgts=crd2px(c1,c2,c3,interpolate=True), but done in one pass without the intermediate arrays.  Returns a double array of length N (or nmap x N)."},
+    {"scatter_add", (PyCFunction)HPBObject_scatter_add,
+        METH_VARARGS|METH_KEYWORDS,
+        "scatter_add(px,maps,vals,set=False)\nFor each map (a contiguous array of npix values, modified in place) and corresponding vals (len(px) values, or 1), add vals to map at the pixels in px.  Repeated pixels accumulate all of their values.  If set is True, the pixels in px are zeroed first, so they are assigned the sum of their vals.  Only the pixels in px are touched."},
+    {"sparse_add", (PyCFunction)HPBObject_sparse_add,
+        METH_VARARGS|METH_KEYWORDS,
+        "sparse_add(cells,vals,px,pvals)\nMerge new values into a sparse map.  cells is a sorted array of unique NUNIQ cell numbers (4*4**k + NEST pixel at order k, for k up to the order of this object, whose nside must be a power of 2), and vals is the nlayers x len(cells) double array of their values.  px holds NUNIQ cells in any order (repeats accumulate), with pvals their nlayers x len(px) double values.  Returns the new (cells,vals); the inputs are not modified.  The sort and merge run without the GIL."},
+    {"query_disc", (PyCFunction)HPBObject_query_disc,
+        METH_VARARGS|METH_KEYWORDS,
+        "query_disc(radius,c1,c2,c3=None,nthreads=0)\nFind the pixels whose centers lie within radius (scalar, or one per disc) of each disc center c1,c2(,c3), read as for crd2px.  Returns a list with, for each disc, a K x 2 array of (start,stop) ranges of RING pixel numbers (use nest_ring_conv on the expanded pixels for a NEST map).  Discs are searched in parallel on nthreads threads (0 = one per cpu) without the GIL."},
+    {"query_polygon", (PyCFunction)HPBObject_query_polygon,
+        METH_VARARGS|METH_KEYWORDS,
+        "query_polygon(vertices,nthreads=0)\nLike query_disc, for the pixels whose centers lie inside each of a batch of convex polygons.  vertices is npoly x nv x 3, holding the x,y,z of the corners of each polygon in order (either winding)."},
     {"px2crd", (PyCFunction)HPBObject_px2crd,METH_VARARGS|METH_KEYWORDS,
-        "px2crd(px,ncrd=3)\nConvert a 1 dimensional input array of pixel numbers to the type of coordinates specified by ncrd.  If ncrd=3 (default), the returned array will have (x,y,z) for each pixel.  Otherwise if ncrd=2, the returned array will have (theta,phi) for each pixel."},
+        "px2crd(px,ncrd=3,nthreads=0)\nConvert a 1 dimensional input array of pixel numbers to the type of coordinates specified by ncrd.  If ncrd=3 (default), the returned array will have (x,y,z) for each pixel.  Otherwise if ncrd=2, the returned array will have (theta,phi) for each pixel.  Large batches are split over nthreads threads (0 = one per cpu) and run without the GIL."},
     {"order", (PyCFunction)HPBObject_Order,METH_NOARGS,
         "order()\nReturn the order parameter."},
     {"nside", (PyCFunction)HPBObject_Nside,METH_NOARGS,
@@ -374,7 +1448,7 @@ static PyTypeObject HPBType = {
     0,                         /*tp_setattro*/
     0,                         /*tp_as_buffer*/
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,        /*tp_flags*/
-    "Functionality related to the HEALPix pixelisation.  HealpixBase() or HealpixBase(nside, scheme='RING').",       /* tp_doc */
+    "Functionality related to the HEALPix pixelisation.  HealpixBase() or HealpixBase(nside, scheme='RING').  Pixel numbers are 64 bit, so nside may go up to 2**29.",       /* tp_doc */
     0,                     /* tp_traverse */
     0,                     /* tp_clear */
     0,                     /* tp_richcompare */
@@ -22,7 +22,10 @@
 #include <stdarg.h>
 #include "miriad.h"
 
+#define MAXMSG 256
+
 static char *errmsg_c(int n);
+static void bugraise_c(Const char *m);
 
 char *Name = NULL;
 int reentrant=0;
@@ -32,6 +35,11 @@ int reentrant=0;
 typedef void (*proc)(void);  /* helper definition for function pointers */
 static proc bug_cleanup=NULL;
 
+/* The innermost error context pushed by this thread, and the host error
+   number being reported by bugno_c. */
+static THREADLOCAL BUGCTX *bug_context=NULL;
+static THREADLOCAL int bug_errno=0;
+
 /************************************************************************/
 void bugrecover_c(void (*cl)(void))
 /** bugrecover_c -- bypass fatal bug calls for alien clients            */
@@ -57,6 +65,53 @@ void bugrecover_c(void (*cl)(void))
 {
     bug_cleanup = cl;
 }
+/************************************************************************/
+void bugpush_c(BUGCTX *ctx)
+/** bugpush_c -- start recovering from fatal errors in this thread	*/
+/*& arp									*/
+/*: error-handling							*/
+/*+
+    Push an error context for the calling thread. Until the matching
+    bugpop_c, a fatal error in this thread does not exit: the message
+    and host error number are stored in ctx->msg and ctx->status (a
+    warning or error issued just before it prefixes the message), and
+    control returns to the setjmp on ctx->env with a non-zero value.
+    Unlike bugrecover_c, contexts are per-thread and nest, so clients
+    can run MIRIAD on different data sets in parallel threads.
+    Example of usage:
+
+    BUGCTX ctx;
+    bugpush_c(&ctx);
+    if(setjmp(ctx.env) == 0){
+      ....
+    }
+    if(bugpop_c(&ctx)) fprintf(stderr,"%s\n",ctx.msg);
+
+    The frame that calls setjmp must still be active when the error
+    occurs. Data sets involved in the error are not closed.		*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  ctx->status = 0;
+  ctx->msg[0] = 0;
+  ctx->prev = bug_context;
+  bug_context = ctx;
+}
+/************************************************************************/
+int bugpop_c(BUGCTX *ctx)
+/** bugpop_c -- stop recovering from fatal errors with a context	*/
+/*& arp									*/
+/*: error-handling							*/
+/*+
+    Pop an error context pushed by bugpush_c (and any pushed after it
+    but not popped). Returns ctx->status, which is non-zero if a fatal
+    error returned control to ctx->env.				*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  bug_context = ctx->prev;
+  return(ctx->status);
+}
 
 /************************************************************************/
 void buglabel_c(Const char *name)
@@ -110,10 +165,19 @@ void bug_c(char s,Const char *m)
   else if (s == 'e' || s == 'E') p = "Error";
   else {doabort = 1;		 p = "Fatal Error"; }
 
+  if(doabort && bug_context != NULL) bugraise_c(m);
   fprintf(stderr,"### %s:  %s\n",p,m);
+  if(bug_context != NULL && s != 'i' && s != 'I'){
+    strncpy(bug_context->msg,m,sizeof(bug_context->msg)-1);
+    bug_context->msg[sizeof(bug_context->msg)-1] = 0;
+  }
   if(doabort){
-    reentrant = !reentrant;
-    if(reentrant)habort_c();
+    /* Only abort all open data sets if the error is really fatal; a client
+       that recovers may still be using them (possibly in other threads). */
+    if(bug_cleanup == NULL){
+      reentrant = !reentrant;
+      if(reentrant)habort_c();
+    }
 #ifdef vms
 # include ssdef
     lib$stop(SS$_ABORT);
@@ -149,7 +213,7 @@ void bugv_c(char s,Const char *m, ...)
 /*----------------------------------------------------------------------*/
 {
   va_list ap;
-  char *p;
+  char *p,msg[MAXMSG];
   int doabort;
 
   doabort = 0;
@@ -158,6 +222,13 @@ void bugv_c(char s,Const char *m, ...)
   else if (s == 'e' || s == 'E') p = "Error";
   else {doabort = 1;		 p = "Fatal Error"; }
 
+  if(bug_context != NULL){
+    va_start(ap,m);
+    vsnprintf(msg,sizeof(msg),m,ap);
+    va_end(ap);
+    bug_c(s,msg);
+    return;
+  }
   va_start(ap,m);
   fprintf(stderr,"### %s: ",p);
   vfprintf(stderr,m,ap);
@@ -166,8 +237,12 @@ void bugv_c(char s,Const char *m, ...)
   va_end(ap);
 
   if(doabort){
-    reentrant = !reentrant;
-    if(reentrant)habort_c();
+    /* Only abort all open data sets if the error is really fatal; a client
+       that recovers may still be using them (possibly in other threads). */
+    if(bug_cleanup == NULL){
+      reentrant = !reentrant;
+      if(reentrant)habort_c();
+    }
     if (bug_cleanup) {
         (*bug_cleanup)();       /* call it */
         fprintf(stderr,"### bug_cleanup: code should not come here, goodbye\n");
@@ -198,8 +273,31 @@ void bugno_c(char s,int n)
 /*--									*/
 /*----------------------------------------------------------------------*/
 {
+  bug_errno = n;
   if (n == -1)bug_c(s,"End of file detected");
   else bug_c(s,errmsg_c(n));
+  bug_errno = 0;
+}
+/************************************************************************/
+static void bugraise_c(Const char *m)
+/*
+  Return control to the innermost error context of this thread, with
+  a fatal error. The last warning or error issued in the context (which
+  often says what was being done) prefixes the message.
+------------------------------------------------------------------------*/
+{
+  BUGCTX *ctx;
+  char msg[sizeof(ctx->msg)+2+MAXMSG];
+
+  ctx = bug_context;
+  ctx->status = bug_errno > 0 ? bug_errno : -1;
+  bug_errno = 0;
+  if(ctx->msg[0]) snprintf(msg,sizeof(msg),"%s: %s",ctx->msg,m);
+  else snprintf(msg,sizeof(msg),"%s",m);
+  strncpy(ctx->msg,msg,sizeof(ctx->msg)-1);
+  ctx->msg[sizeof(ctx->msg)-1] = 0;
+  bug_context = ctx->prev;
+  longjmp(ctx->env,1);
 }
 /************************************************************************/
 static char *errmsg_c(int n)
@@ -210,7 +308,7 @@ static char *errmsg_c(int n)
 #ifdef vms
 #include <descrip.h>
   $DESCRIPTOR(string_descriptor,string);
-  static char string[128];
+  static THREADLOCAL char string[128];
   short int len0;
   int one;
 
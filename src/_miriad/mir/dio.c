@@ -177,6 +177,10 @@ void dopen_c(int *fd,char *name,char *status,off_t *size,int *iostat)
 #endif
   if((*fd = open(s,flags,0644)) < 0){*iostat = errno; return;}
   *size = Lseek(*fd,0,SEEK_END);
+#ifdef POSIX_FADV_SEQUENTIAL
+  if(!strcmp(status,"read"))
+    (void)posix_fadvise(*fd,0,0,POSIX_FADV_SEQUENTIAL);
+#endif
 
 /* If its a scratch file, unlink it now, so that the file will disappear
    when it is closed (or this program crashes). */
@@ -90,6 +90,7 @@ typedef struct item {
   off_t offset;
   struct tree *tree;
   IOB io[2];
+  void *z;		/* Block compression state (zio.c), or NULL. */
   struct item *fwd;
 } ITEM;
 
@@ -97,9 +98,10 @@ typedef struct tree {
   char *name;
   int handle,flags,rdwr,wriostat;
   ITEM *itemlist; 
+  size_t bsize;		/* size of the i/o buffers of its items */
 } TREE;
 
-static TREE foreign = {"",0,0,0,0,NULL};
+static TREE foreign = {"",0,0,0,0,NULL,BUFSIZE};
 #define MAXITEM 1024
 
 private int nitem,ntree;
@@ -109,9 +111,28 @@ private ITEM *item_addr[MAXITEM];
 #define hget_tree(tno) (tree_addr[tno])
 #define hget_item(tno) (item_addr[tno])
 
-private int header_ok,expansion[MAXTYPES],align_size[MAXTYPES];
-private char align_buf[BUFSIZE];
+private int expansion[MAXTYPES],align_size[MAXTYPES];
+private THREADLOCAL int header_ok;
+private THREADLOCAL char align_buf[BUFSIZE];
 private int first=TRUE;
+private size_t default_bsize = BUFSIZE;
+
+/* The tree and item tables (and their counts) are shared by all data sets,
+   so they are changed under a lock. Everything else hangs off a single
+   tree, and so a tree can be used from any one thread at a time. */
+
+#ifdef HAS_PTHREADS
+#include <pthread.h>
+private pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+private pthread_once_t init_once = PTHREAD_ONCE_INIT;
+#define LOCK_TABLES   pthread_mutex_lock(&table_lock)
+#define UNLOCK_TABLES pthread_mutex_unlock(&table_lock)
+#define HINIT         pthread_once(&init_once,hinit_c)
+#else
+#define LOCK_TABLES
+#define UNLOCK_TABLES
+#define HINIT         if(first)hinit_c()
+#endif
 
 /* Macro to wait for I/O to complete. If its a synchronous i/o system,
    never bother calling the routine to wait for i/o completion.       */
@@ -136,6 +157,14 @@ static void hinit_c(void);
 static int hfind_nl(char *buf, int len);
 static void hcheckbuf_c(ITEM *item, off_t next, int *iostat);
 static void hwrite_fill_c(ITEM *item, IOB *iob, int next, int *iostat);
+static void hflush_iob_c(ITEM *item, IOB *iob, int *iostat);
+static void hdread_c(ITEM *item, char *buf, off_t offset, size_t length,
+		     int *iostat);
+static void hdwrite_c(ITEM *item, char *buf, off_t offset, size_t length,
+		      int *iostat);
+static void hdirect_c(ITEM *item, int dowrite, char *buf, off_t offset,
+		      size_t length, int *iostat);
+static size_t hbuf_round(size_t size);
 static void hcache_create_c(TREE *t, int *iostat);
 static void hcache_read_c(TREE *t, int *iostat);
 static int hname_check(char *name);
@@ -179,7 +208,7 @@ void hopen_c(int *tno,Const char *name,Const char *status,int *iostat)
 
 /* Initialise if its the first time through. */
 
-  if(first)hinit_c();
+  HINIT;
 
 /* Find a spare slot, and set the name etc. */
 
@@ -213,6 +242,8 @@ private void hinit_c()
 ------------------------------------------------------------------------*/
 {
   int i;
+  long size;
+  char *s,*end;
 
   nitem = 0;
   ntree = 1;
@@ -240,6 +271,18 @@ private void hinit_c()
   align_size[H_DBLE] = H_DBLE_SIZE;
   align_size[H_CMPLX] =H_REAL_SIZE;
   align_size[H_TXT]  = 1;
+
+/* The MIRIAD_BUFSIZE environment variable (bytes, or with a k or M
+   suffix) sets the default i/o buffer size of items in large files. */
+
+  s = getenv("MIRIAD_BUFSIZE");
+  if(s != NULL){
+    size = strtol(s,&end,10);
+    if(*end == 'k' || *end == 'K') size *= 1024;
+    else if(*end == 'm' || *end == 'M') size *= 1024*1024;
+    if(size > 0) default_bsize = hbuf_round(size);
+  }
+  foreign.bsize = default_bsize;
   first = FALSE;
   header_ok = FALSE;
 }
@@ -279,12 +322,14 @@ void hflush_c(int tno,int *iostat)
 	if(item->io[i].state == IO_MODIFIED){
 	  WAIT(item,iostat);
 	  if(*iostat)return;
-	  dwrite_c( item->fd, item->io[i].buf, item->io[i].offset,
+	  hdwrite_c( item, item->io[i].buf, item->io[i].offset,
 				     item->io[i].length, iostat);
 	  if(*iostat)return;
 	  item->io[i].state = IO_ACTIVE;
         }
       }
+      if(item->z != NULL)
+	{zflush_c(item->z,iostat);				if(*iostat)return;}
     }
   }
 
@@ -470,10 +515,12 @@ void hclose_c(int tno)
     hrelease_item_c(it1);
     it1 = it2;
   }
+  LOCK_TABLES;
   tree_addr[tno] = NULL;
+  ntree--;
+  UNLOCK_TABLES;
   free(t->name);
   free((char *)t);
-  ntree--;
 }
 /************************************************************************/
 void hdelete_c(int tno,Const char *keyword,int *iostat)
@@ -504,7 +551,7 @@ void hdelete_c(int tno,Const char *keyword,int *iostat)
   TREE *t;
   int ent_del;
 
-  if(first)hinit_c();
+  HINIT;
 
   if(tno != 0) if( (*iostat = hname_check((char *)keyword)) ) return;
 
@@ -569,10 +616,10 @@ void haccess_c(int tno,int *ihandle,Const char *keyword,Const char *status,int *
   char path[MAXPATH];
   ITEM *item;
   TREE *t;
-  int mode=0;
+  int mode=0,stat;
   char string[3];
 
-  if(first)hinit_c();
+  HINIT;
 
   if(!strcmp("read",status))	    mode = ITEM_READ;
   else if(!strcmp("write",status))  mode = ITEM_WRITE;
@@ -630,9 +677,17 @@ void haccess_c(int tno,int *ihandle,Const char *keyword,Const char *status,int *
     Strcat(path,keyword);
     dopen_c(&(item->fd),path,(char *)status,&(item->size),iostat);
 
-    item->bsize = BUFSIZE;
-    item->io[0].buf = Malloc(BUFSIZE);
-    if(BUFDBUFF)item->io[1].buf = Malloc(BUFSIZE);
+/* Items stored as compressed blocks (see zio.c) are recognised by their
+   magic number. */
+
+    if(!*iostat && tno != 0 && (mode & (ITEM_READ|ITEM_APPEND))){
+      item->z = zopen_c(item->fd,status,&(item->size),iostat);
+      if(*iostat) dclose_c(item->fd,&stat);
+    }
+
+    item->bsize = t->bsize;
+    item->io[0].buf = Malloc(item->bsize);
+    if(BUFDBUFF)item->io[1].buf = Malloc(item->bsize);
     if(mode & ITEM_APPEND) item->offset = item->size;
 
 /* If we have opened a file in write mode, remember that this dataset is
@@ -792,7 +847,7 @@ void hdaccess_c(int ihandle,int *iostat)
     for(i=0; i<2 && !stat; i++){
       if(item->io[i].state == IO_MODIFIED && !(item->flags & ITEM_SCRATCH)){
 	WAIT(item,&stat);
-	if(!stat)dwrite_c( item->fd, item->io[i].buf, item->io[i].offset,
+	if(!stat)hdwrite_c( item, item->io[i].buf, item->io[i].offset,
 				     item->io[i].length, &stat);
 	item->io[i].state = IO_ACTIVE;
       }
@@ -800,6 +855,11 @@ void hdaccess_c(int ihandle,int *iostat)
     *iostat = stat;
     WAIT(item,&stat);
     if(stat) *iostat = stat;
+    if(item->z != NULL){
+      zclose_c(item->z,&stat);
+      if(stat) *iostat = stat;
+      item->z = NULL;
+    }
     dclose_c(item->fd,&stat);
     if(stat) *iostat = stat;
     hrelease_item_c(item);
@@ -945,6 +1005,15 @@ void hio_c(int ihandle,int dowrite,int type,char *buf,
   if(item->bsize < BUFSIZE && item->bsize < next)hcheckbuf_c(item,next,iostat);
   if(*iostat)return;
 
+/* Transfers of a buffer or more of bytes go directly between the file and
+   the callers buffer. */
+
+  if(type == H_BYTE && item->fd != 0 && item->bsize > CACHESIZE &&
+     length >= item->bsize){
+    hdirect_c(item,dowrite,buf,offset,length,iostat);
+    return;
+  }
+
 /*----------------------------------------------------------------------*/
 /*									*/
 /*	Loop until we have processed all the data required.		*/
@@ -978,7 +1047,7 @@ void hio_c(int ihandle,int dowrite,int type,char *buf,
         if(iob1->length%BUFALIGN && next < item->size)
 	  {hwrite_fill_c(item,iob1,next,iostat);	if(*iostat) return;}
         WAIT(item,iostat);				if(*iostat) return;
-        dwrite_c(item->fd,iob1->buf,iob1->offset,iob1->length,iostat);
+        hdwrite_c(item,iob1->buf,iob1->offset,iob1->length,iostat);
         iob1->state = IO_ACTIVE;			if(*iostat) return;
       }
       iob1->offset = (offset/BUFALIGN) * BUFALIGN;
@@ -988,7 +1057,7 @@ void hio_c(int ihandle,int dowrite,int type,char *buf,
         iob1->length = min(item->bsize,item->size-iob1->offset);
 	if(iob2->buf != NULL && iob1->offset < iob2->offset)
 	  iob1->length = min(iob1->length, iob2->offset - iob1->offset);
-	dread_c(item->fd,iob1->buf,iob1->offset,iob1->length,iostat);
+	hdread_c(item,iob1->buf,iob1->offset,iob1->length,iostat);
 	iob1->state = IO_ACTIVE;			if(*iostat) return;
       }
     }
@@ -1013,14 +1082,14 @@ void hio_c(int ihandle,int dowrite,int type,char *buf,
 /* Write behind. */
       if(iob2->state == IO_MODIFIED && (!(iob2->length%BUFALIGN) ||
 				   iob2->offset + iob2->length == item->size)){
-        dwrite_c(item->fd,iob2->buf,iob2->offset,iob2->length,iostat);
+        hdwrite_c(item,iob2->buf,iob2->offset,iob2->length,iostat);
         iob2->state = IO_ACTIVE;
 
 /* Read ahead. */
       } else if(!dowrite && next < item->size && next != iob2->offset){
         iob2->offset = next;
-        iob2->length = min( BUFSIZE, item->size - iob2->offset );
-        dread_c (item->fd,iob2->buf,iob2->offset,iob2->length,iostat);
+        iob2->length = min( item->bsize, item->size - iob2->offset );
+        hdread_c (item,iob2->buf,iob2->offset,iob2->length,iostat);
         iob2->state = IO_ACTIVE;
       }
     }
@@ -1051,6 +1120,7 @@ void hio_c(int ihandle,int dowrite,int type,char *buf,
 
     off  = offset - iob1->offset;
     len = min(length, iob1->length - off);
+    if(off % size) len = min(len, BUFSIZE);
     s = ( ( off % size ) ? align_buf : iob1->buf + off );
     if(dowrite){
       switch(type){
@@ -1147,12 +1217,12 @@ private void hcheckbuf_c(ITEM *item,off_t next,int *iostat)
 /* Allocate full sized buffers if needed. */
 
   } else if(item->bsize <= CACHESIZE && next > CACHESIZE){
-    s = Malloc(BUFSIZE);
-    item->bsize = BUFSIZE;
+    s = Malloc(item->tree->bsize);
+    item->bsize = item->tree->bsize;
     if(item->io[0].length > 0)Memcpy(s,item->io[0].buf,item->io[0].length);
     if(item->io[0].buf != NULL) free(item->io[0].buf);
     item->io[0].buf = s;
-    if(BUFDBUFF)item->io[1].buf = Malloc(BUFSIZE);
+    if(BUFDBUFF)item->io[1].buf = Malloc(item->bsize);
   }
 
 /* Open a file if needed. */
@@ -1185,20 +1255,180 @@ private void hwrite_fill_c(ITEM *item,IOB *iob,int next,int *iostat)
     iostat	I/O status.
 ------------------------------------------------------------------------*/
 {
-  char buffer[BUFSIZE];
+  char stack[BUFSIZE],*buffer;
   int offset,length;
 
   offset = BUFALIGN * ((iob->offset + iob->length) / BUFALIGN);
   length = BUFALIGN * ((next-1)/BUFALIGN + 1) - offset;
   length = min(length, item->size - offset);
+  buffer = (length > BUFSIZE ? Malloc(length) : stack);
+
+  WAIT(item,iostat);
+  if(!*iostat) hdread_c(item,buffer,offset,length,iostat);
+  if(!*iostat) dwait_c(item->fd,iostat);
+  if(!*iostat){
+    offset = iob->offset + iob->length - offset;
+    length -= offset;
+    Memcpy(iob->buf+iob->length,buffer+offset,length);
+    iob->length += length;
+  }
+  if(buffer != stack) free(buffer);
+}
+/************************************************************************/
+private void hflush_iob_c(ITEM *item,IOB *iob,int *iostat)
+/*
+  Write out an i/o buffer if it has been modified.
+------------------------------------------------------------------------*/
+{
+  off_t next;
+
+  *iostat = 0;
+  if(iob->state != IO_MODIFIED || (item->flags & ITEM_SCRATCH)) return;
+  next = iob->offset + iob->length;
+  if(iob->length%BUFALIGN && next < item->size)
+    {hwrite_fill_c(item,iob,next,iostat);		if(*iostat) return;}
+  WAIT(item,iostat);					if(*iostat) return;
+  hdwrite_c(item,iob->buf,iob->offset,iob->length,iostat);
+  iob->state = IO_ACTIVE;
+}
+/************************************************************************/
+private void hdirect_c(ITEM *item,int dowrite,char *buf,off_t offset,
+		       size_t length,int *iostat)
+/*
+  Read or write bytes directly between the file and the callers buffer.
+  Buffered data that overlaps is written out first, and buffers are
+  discarded if the write replaces their contents. Compressed items
+  must be written in order, so all their modified buffers are written.
+------------------------------------------------------------------------*/
+{
+  int i,overlap;
+  IOB *iob;
+
+  for(i=0; i < 2; i++){
+    iob = &(item->io[i]);
+    if(iob->buf == NULL || iob->length == 0) continue;
+    overlap = iob->offset < offset + (off_t)length &&
+	      iob->offset + (off_t)iob->length > offset;
+    if(!overlap && item->z == NULL) continue;
+    hflush_iob_c(item,iob,iostat);			if(*iostat) return;
+    if(dowrite && overlap) iob->length = 0;
+  }
+  WAIT(item,iostat);					if(*iostat) return;
+  if(dowrite){
+    hdwrite_c(item,buf,offset,length,iostat);	if(*iostat) return;
+    item->size = max(item->size,offset + (off_t)length);
+  } else {
+    hdread_c(item,buf,offset,length,iostat);		if(*iostat) return;
+  }
+  dwait_c(item->fd,iostat);				if(*iostat) return;
+  item->offset = offset + length;
+}
+/************************************************************************/
+private size_t hbuf_round(size_t size)
+/*
+  Round a buffer size up to a multiple of BUFSIZE.
+------------------------------------------------------------------------*/
+{
+  return( max(1,(size + BUFSIZE - 1) / BUFSIZE) * BUFSIZE );
+}
+/************************************************************************/
+void hbufsize_c(int tno,size_t size,int *iostat)
+/**hbufsize -- Set the i/o buffer size of a data set.			*/
+/*&arp									*/
+/*:low-level-i/o							*/
+/*+ FORTRAN call sequence
+
+	subroutine hbufsize(tno,size,iostat)
+	integer tno,size,iostat
+
+  Set the size of the i/o buffer used by each large item of a data set
+  (it is rounded up to a multiple of the default size). Larger buffers
+  mean fewer, larger system calls when streaming through big items such
+  as visibility data. Items that are already open are flushed and given
+  new buffers.
+
+  Input:
+    tno		The handle of the data set.
+    size	The buffer size, in bytes.
+  Output:
+    iostat	I/O status indicator. 0 indicates success. Other values
+		are standard system error numbers.			*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  TREE *t;
+  ITEM *item;
+  int i;
 
-  WAIT(item,iostat);					if(*iostat)return;
-  dread_c(item->fd,buffer,offset,length,iostat);	if(*iostat)return;
-  dwait_c(item->fd,iostat);				if(*iostat)return;
-  offset = iob->offset + iob->length - offset;
-  length -= offset;
-  Memcpy(iob->buf+iob->length,buffer+offset,length);
-  iob->length += length;
+  *iostat = 0;
+  t = hget_tree(tno);
+  t->bsize = hbuf_round(size);
+  for(item = t->itemlist; item != NULL; item = item->fwd){
+    if(item->bsize <= CACHESIZE || item->bsize == t->bsize) continue;
+    for(i=0; i < 2; i++){
+      if(item->io[i].buf == NULL) continue;
+      hflush_iob_c(item,&(item->io[i]),iostat);	if(*iostat) return;
+      free(item->io[i].buf);
+      item->io[i].buf = Malloc(t->bsize);
+      item->io[i].length = 0;
+    }
+    item->bsize = t->bsize;
+  }
+}
+/************************************************************************/
+void hcompress_c(int ihandle,int *iostat)
+/**hcompress -- Store an item as compressed blocks.			*/
+/*&arp									*/
+/*:low-level-i/o							*/
+/*+ FORTRAN call sequence
+
+	subroutine hcompress(itno,iostat)
+	integer itno,iostat
+
+  Ask that an item be stored as a sequence of independently compressed
+  blocks. This must be called after the item is opened for writing, and
+  before anything is written to it. Compressed items are read (and
+  appended to) like any other, but data that has been written cannot
+  be changed.
+
+  Input:
+    itno	The handle of the item.
+  Output:
+    iostat	I/O status indicator. 0 indicates success. Other values
+		are standard system error numbers.			*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  ITEM *item;
+
+  item = hget_item(ihandle);
+  *iostat = 0;
+  if(item->z != NULL) return;
+  if(!(item->flags & ITEM_WRITE) || (item->flags & ITEM_NOCACHE) ||
+     item->size != 0)
+    bugv_c('f',"hcompress_c: Item %s is not a new item",item->name);
+  hcheckbuf_c(item,CACHESIZE+1,iostat);			if(*iostat) return;
+  item->z = zopen_c(item->fd,"write",&(item->size),iostat);
+}
+/************************************************************************/
+private void hdread_c(ITEM *item,char *buf,off_t offset,size_t length,
+		      int *iostat)
+/*
+  Read from the file of an item, decompressing if needed.
+------------------------------------------------------------------------*/
+{
+  if(item->z != NULL) zread_c(item->z,buf,offset,length,iostat);
+  else dread_c(item->fd,buf,offset,length,iostat);
+}
+/************************************************************************/
+private void hdwrite_c(ITEM *item,char *buf,off_t offset,size_t length,
+		       int *iostat)
+/*
+  Write to the file of an item, compressing if needed.
+------------------------------------------------------------------------*/
+{
+  if(item->z != NULL) zwrite_c(item->z,buf,offset,length,iostat);
+  else dwrite_c(item->fd,buf,offset,length,iostat);
 }
 /************************************************************************/
 void hseek_c(int ihandle,off_t offset)
@@ -1428,10 +1658,12 @@ private void hrelease_item_c(ITEM *item)
   if(item->io[0].buf != NULL) free(item->io[0].buf);
   if(item->io[1].buf != NULL) free(item->io[1].buf);
 
+  LOCK_TABLES;
   item_addr[item->handle] = NULL;
+  nitem--;
+  UNLOCK_TABLES;
   free(item->name);
   free((char *)item);
-  nitem--;
 }
 /************************************************************************/
 private ITEM *hcreate_item_c(TREE *tree,char *name)
@@ -1445,21 +1677,26 @@ private ITEM *hcreate_item_c(TREE *tree,char *name)
 
 /* Hash the name. */
 
+  item = (ITEM *)Malloc(sizeof(ITEM));
+  LOCK_TABLES;
   s = name;
   hash = nitem++;
-  if(nitem > MAXITEM)
-    bugv_c('f',"Item address table overflow, in hio; nitem=%d MAXITEM=%d",nitem,MAXITEM);
+  if(nitem > MAXITEM){
+    nitem--;
+    UNLOCK_TABLES;
+    bugv_c('f',"Item address table overflow, in hio; nitem=%d MAXITEM=%d",nitem+1,MAXITEM);
+  }
   while(*s) hash += *s++;
   hash %= MAXITEM;
 
 /* Find a slot in the list of addresses, and allocate it. */
 
   while(hget_item(hash) != NULL) hash = (hash+1) % MAXITEM;
-  item_addr[hash] = (ITEM *)Malloc(sizeof(ITEM));
+  item_addr[hash] = item;
+  UNLOCK_TABLES;
 
 /* Initialise it now. */
 
-  item = hget_item(hash);
   item->name = Malloc(strlen(name) + 1);
   Strcpy(item->name,name);
   item->handle = hash;
@@ -1469,6 +1706,7 @@ private ITEM *hcreate_item_c(TREE *tree,char *name)
   item->last = 0;
   item->offset = 0;
   item->bsize = 0;
+  item->z = NULL;
   item->tree = tree;
   for(i=0; i<2; i++){
     item->io[i].offset = 0;
@@ -1492,25 +1730,31 @@ private TREE *hcreate_tree_c(char *name)
 
 /* Hash the name. */
 
+  t = (TREE *)Malloc(sizeof(TREE));
+  LOCK_TABLES;
   s = name;
   hash = ntree++;
-  if(ntree > MAXOPEN)
-    bugv_c('f',"Tree address table overflow, in hio, ntree=%d MAXOPEN=%d",ntree,MAXOPEN);
+  if(ntree > MAXOPEN){
+    ntree--;
+    UNLOCK_TABLES;
+    bugv_c('f',"Tree address table overflow, in hio, ntree=%d MAXOPEN=%d",ntree+1,MAXOPEN);
+  }
   while(*s) hash += *s++;
   hash %= MAXOPEN;
 
 /* Find a slot in the list of addresses, and allocate it. */
 
   while(hget_tree(hash) != NULL) hash = (hash+1) % MAXOPEN;
-  tree_addr[hash] = (TREE *)Malloc(sizeof(TREE));
+  tree_addr[hash] = t;
+  UNLOCK_TABLES;
 
 /* Initialise it. */
 
-  t = hget_tree(hash);
   t->name = Malloc(strlen(name) + 1);
   Strcpy(t->name,name);
   t->handle = hash;
   t->flags = 0;
   t->itemlist = NULL;
+  t->bsize = default_bsize;
   return t;
 }
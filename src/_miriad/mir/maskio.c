@@ -26,9 +26,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include "miriad.h"
+#if defined(MIR_SSE2)
+#include <emmintrin.h>
+#endif
 
 
-static char message[128];
+static THREADLOCAL char message[128];
 
 #define BITS_PER_INT 31
 
@@ -66,6 +69,8 @@ typedef struct {
 
 
 private void mkfill(MASK_INFO *mask,int offset);
+private void mkexpand(int bitmask,int boff,int blen,int *flags);
+private int  mkcompress(Const int *flags,int boff,int blen);
 
 /************************************************************************/
 char *mkopen_c(int tno,char *name,char *status)
@@ -198,8 +203,8 @@ int mkread_c(char *handle,int mode,int *flags,int offset,int n,int nsize)
 	if(bitmask == 0x7FFFFFFF) for(i=0; i<blen; i++) *flags++ = FORT_TRUE;
 	else if(bitmask == 0)     for(i=0; i<blen; i++) *flags++ = FORT_FALSE;
 	else{
-	  for(i=boff; i<boff+blen; i++)
-	    *flags++ = ( bits[i] & bitmask ? FORT_TRUE : FORT_FALSE );
+	  mkexpand(bitmask,boff,blen,flags);
+	  flags += blen;
 	}
 	len -= blen;
 	boff = 0;
@@ -235,7 +240,7 @@ void mkwrite_c(char *handle,int mode,int *flags,int offset,int n,int nsize)
 ------------------------------------------------------------------------*/
 {
   MASK_INFO *mask;
-  int i,len,boff,blen,bitmask,*buf,t;
+  int len,boff,blen,bitmask,*buf,t;
   int run,curr,state,iostat;
 
   curr = 0;
@@ -291,13 +296,10 @@ void mkwrite_c(char *handle,int mode,int *flags,int offset,int n,int nsize)
     if(mode == MK_FLAGS){
       while( len > 0){
         blen = min( BITS_PER_INT - boff,len);
-        bitmask = *buf;
-        for(i=boff; i<boff+blen; i++){
-	  if(FORT_LOGICAL(*flags)) bitmask |=  bits[i];
-	  else			       bitmask &= ~bits[i];
-	  flags++;
-        }
-        *buf++ = bitmask;
+        bitmask = masks[boff+blen] ^ masks[boff];
+        *buf = (*buf & ~bitmask) | mkcompress(flags,boff,blen);
+        buf++;
+        flags += blen;
         len -= blen;
         boff = 0;
       }
@@ -396,3 +398,140 @@ private void mkfill(MASK_INFO *mask,int offset)
     mask->length = (off + len)*BITS_PER_INT - mask->offset;
   }
 }
+/************************************************************************/
+private void mkexpand(int bitmask,int boff,int blen,int *flags)
+/*
+  Expand bits boff to boff+blen-1 of a mask word into FORTRAN logicals.
+
+  Inputs:
+    bitmask	The mask word.
+    boff	The first bit to expand.
+    blen	The number of bits to expand.
+  Output:
+    flags	The flags, one per bit.
+------------------------------------------------------------------------*/
+{
+  int i;
+#if defined(MIR_SSE2)
+  __m128i word,b,m,t,f;
+
+/* Test four bits at a time against the bits table. */
+
+  word = _mm_set1_epi32(bitmask);
+  t = _mm_set1_epi32(FORT_TRUE);
+  f = _mm_set1_epi32(FORT_FALSE);
+  for(i=boff; i+4 <= boff+blen; i += 4){
+    b = _mm_loadu_si128((__m128i *)(bits+i));
+    m = _mm_cmpeq_epi32(_mm_and_si128(word,b),b);
+    _mm_storeu_si128((__m128i *)flags,
+	_mm_or_si128(_mm_and_si128(m,t),_mm_andnot_si128(m,f)));
+    flags += 4;
+  }
+#else
+  i = boff;
+#endif
+  for(bitmask >>= i; i < boff+blen; i++, bitmask >>= 1)
+    *flags++ = ( bitmask & 1 ? FORT_TRUE : FORT_FALSE );
+}
+/************************************************************************/
+private int mkcompress(Const int *flags,int boff,int blen)
+/*
+  Pack FORTRAN logicals into bits boff to boff+blen-1 of a mask word.
+  The other bits of the result are zero.
+
+  Inputs:
+    flags	The flags, one per bit.
+    boff	The first bit to set.
+    blen	The number of bits to set.
+  Output:
+    mkcompress	The packed bits.
+------------------------------------------------------------------------*/
+{
+  int i,bitmask;
+#if defined(MIR_SSE2)
+  __m128i f;
+
+/* A sign mask of four "false" comparisons gives four clear bits. */
+
+  f = _mm_set1_epi32(FORT_FALSE);
+  bitmask = 0;
+  for(i=boff; i+4 <= boff+blen; i += 4){
+    bitmask |= (~_mm_movemask_ps(_mm_castsi128_ps(
+	_mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)flags),f))) & 0xF) << i;
+    flags += 4;
+  }
+#else
+  bitmask = 0;
+  i = boff;
+#endif
+  for(; i < boff+blen; i++)
+    if(FORT_LOGICAL(*flags++)) bitmask |= bits[i];
+  return(bitmask);
+}
+/************************************************************************/
+void mkmask_c(Const int *flags,char *mask,int n)
+/*
+  Convert FORTRAN logical flags (true for good data) into a byte mask
+  (1 for bad data), as used by numpy masked arrays.
+
+  Input:
+    flags	The flags.
+    n		The number of flags.
+  Output:
+    mask	The mask, one byte per flag.
+------------------------------------------------------------------------*/
+{
+#if defined(MIR_SSE2)
+  __m128i f,one,a,b,c,d;
+
+/* Compare against "false", then narrow 16 results to 16 bytes. */
+
+  f = _mm_set1_epi32(FORT_FALSE);
+  one = _mm_set1_epi8(1);
+  for(; n >= 16; n -= 16, flags += 16, mask += 16){
+    a = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)flags),f);
+    b = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)(flags+4)),f);
+    c = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)(flags+8)),f);
+    d = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)(flags+12)),f);
+    a = _mm_packs_epi16(_mm_packs_epi32(a,b),_mm_packs_epi32(c,d));
+    _mm_storeu_si128((__m128i *)mask,_mm_and_si128(a,one));
+  }
+#endif
+  for(; n > 0; n--) *mask++ = ( FORT_LOGICAL(*flags++) ? 0 : 1 );
+}
+/************************************************************************/
+void mkunmask_c(Const char *mask,int *flags,int n)
+/*
+  Convert a byte mask (non-zero for bad data) into FORTRAN logical
+  flags (true for good data). This is the inverse of mkmask_c.
+
+  Input:
+    mask	The mask, one byte per flag.
+    n		The number of flags.
+  Output:
+    flags	The flags.
+------------------------------------------------------------------------*/
+{
+#if defined(MIR_SSE2)
+  __m128i zero,t,f,a,lo,hi,m;
+  int k;
+
+/* Widen 16 byte comparisons to four vectors of 32 bit flags. */
+
+  zero = _mm_setzero_si128();
+  t = _mm_set1_epi32(FORT_TRUE);
+  f = _mm_set1_epi32(FORT_FALSE);
+  for(; n >= 16; n -= 16, flags += 16, mask += 16){
+    a = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)mask),zero);
+    lo = _mm_unpacklo_epi8(a,a);
+    hi = _mm_unpackhi_epi8(a,a);
+    for(k=0; k < 4; k++){
+      m = (k & 2 ? hi : lo);
+      m = (k & 1 ? _mm_unpackhi_epi16(m,m) : _mm_unpacklo_epi16(m,m));
+      _mm_storeu_si128((__m128i *)(flags+4*k),
+	_mm_or_si128(_mm_and_si128(m,t),_mm_andnot_si128(m,f)));
+    }
+  }
+#endif
+  for(; n > 0; n--) *flags++ = ( *mask++ ? FORT_FALSE : FORT_TRUE );
+}
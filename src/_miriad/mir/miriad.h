@@ -40,6 +40,7 @@
 #include <sys/types.h>     /* provides off_t */
 #include <unistd.h>
 #include <stdarg.h>
+#include <setjmp.h>
 #include "sysdep.h"        /* since it now contains the "pack.c" prototypes */
 
 /* Define const and void if needed. */
@@ -115,6 +116,8 @@ void hmode_c(int tno, char *mode);
 int  hexists_c(int tno, Const char *keyword);
 void hdaccess_c(int ihandle, int *iostat);
 off_t hsize_c(int ihandle);
+void hbufsize_c(int tno, size_t size, int *iostat);
+void hcompress_c(int ihandle, int *iostat);
 void hio_c(int ihandle, int dowrite, int type, char *buf, off_t offset, size_t length, int *iostat);
 void hseek_c(int ihandle, off_t offset);
 off_t htell_c(int ihandle);
@@ -194,6 +197,14 @@ void dopendir_c  (char **contxt, char *path);
 void dclosedir_c (char *contxt);
 void dreaddir_c  (char *contxt, char *path, int length);
 
+/* zio.c */
+
+void *zopen_c    (int fd, Const char *status, off_t *size, int *iostat);
+void zclose_c    (void *zfile, int *iostat);
+void zflush_c    (void *zfile, int *iostat);
+void zread_c     (void *zfile, char *buffer, off_t offset, size_t length, int *iostat);
+void zwrite_c    (void *zfile, Const char *buffer, off_t offset, size_t length, int *iostat);
+
 /* uvio.c */
 
 void uvopen_c   (int *tno, Const char *name, Const char *status);
@@ -201,6 +212,8 @@ void uvclose_c  (int tno);
 void uvflush_c  (int tno);
 void uvnext_c   (int tno);
 void uvrewind_c (int tno);
+void uvtell_c   (int tno, off_t *offset, off_t *flgoff, off_t *wflgoff);
+void uvseek_c   (int tno, off_t offset, off_t flgoff, off_t wflgoff);
 void uvcopyvr_c (int tin, int tout);
 int  uvupdate_c (int tno);
 void uvvarini_c (int tno, int *vhan);
@@ -211,9 +224,14 @@ void uvrdvr_c   (int tno, int type, Const char *var, char *data, char *def, int
 void uvgetvr_c  (int tno, int type, Const char *var, char *data, int n);
 void uvprobvr_c (int tno, Const char *var, char *type, int *length, int *updated);
 void uvputvr_c  (int tno, int type, Const char *var, Const char *data, int n);
+int  uvsnap_c   (int tno, char *buf, int size);
+void uvunsnap_c (int tno, Const char *buf);
 void uvtrack_c  (int tno, Const char *name, Const char *switches);
 int  uvscan_c   (int tno, Const char *var);
 void uvwrite_c  (int tno, Const double *preamble, Const float *data, Const int *flags, int n);
+void uvwriteblk_c(int tno, Const double *preamble, Const float *data, Const int *flags, int n, int nrec);
+void uvjpack_c  (Const float *in, char *out, int *work, int n, float *tscale);
+void uvjunpack_c(Const char *in, float *out, int *work, int n, float tscale);
 void uvwwrite_c (int tno, Const float *data, Const int *flags, int n);
 void uvsela_c   (int tno, Const char *object, Const char *string, int datasel);
 void uvselect_c (int tno, Const char *object, double p1, double p2, int datasel);
@@ -282,6 +300,8 @@ void mkclose_c (char *handle);
 int  mkread_c  (char *handle, int mode, int *flags, int offset, int n, int nsize);
 void mkwrite_c (char *handle, int mode, int *flags, int offset, int n, int nsize);
 void mkflush_c (char *handle);
+void mkmask_c  (Const int *flags, char *mask, int n);
+void mkunmask_c(Const char *mask, int *flags, int n);
 
 
 /* xyzio.c */
@@ -303,7 +323,18 @@ void xyzplnwr_c (int tno, int planenr, Const float *data, Const int *mask, Const
 
 /* bug.c */
 
+/* A fatal error inside bugpush_c/bugpop_c longjmps to env, on the thread
+   that pushed it, with the error recorded in status and msg. */
+typedef struct bugctx {
+  jmp_buf env;
+  int status;			/* Host error number, -1 if none, 0 if no error. */
+  char msg[256];
+  struct bugctx *prev;
+} BUGCTX;
+
 void bugrecover_c(void (*cl)(void));
+void bugpush_c   (BUGCTX *ctx);
+int  bugpop_c    (BUGCTX *ctx);
 void buglabel_c  (Const char *name);
 void bugno_c     (char s, int n);
 void bug_c       (char s, Const char *m);
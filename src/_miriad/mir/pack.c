@@ -31,6 +31,9 @@
 
 #include "sysdep.h"
 #include "miriad.h"
+#if defined(MIR_SSE2)
+#include <emmintrin.h>
+#endif
 
 #if defined(WORDS_BIGENDIAN)
 
@@ -97,6 +100,22 @@ void pack16_c(int *in,char *out,int n)
 {
   int i;
   char *s;
+#if defined(MIR_SSE2)
+  __m128i a,b;
+
+/* Keep the low 16 bits of each integer (as the byte copy below does),
+   then pack and swap bytes, 8 at a time. */
+
+  for(; n >= 8; n -= 8, in += 8, out += 16){
+    a = _mm_loadu_si128((__m128i *)in);
+    b = _mm_loadu_si128((__m128i *)(in+4));
+    a = _mm_srai_epi32(_mm_slli_epi32(a,16),16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b,16),16);
+    a = _mm_packs_epi32(a,b);
+    a = _mm_or_si128(_mm_slli_epi16(a,8),_mm_srli_epi16(a,8));
+    _mm_storeu_si128((__m128i *)out,a);
+  }
+#endif
 
   s = (char *)in;
   for(i=0; i < n; i++){
@@ -113,6 +132,20 @@ void unpack16_c(char *in,int *out,int n)
 {
   int i;
   char *s;
+#if defined(MIR_SSE2)
+  __m128i a;
+
+/* Swap bytes, then sign extend each half into 32 bits, 8 at a time. */
+
+  for(; n >= 8; n -= 8, in += 16, out += 8){
+    a = _mm_loadu_si128((__m128i *)in);
+    a = _mm_or_si128(_mm_slli_epi16(a,8),_mm_srli_epi16(a,8));
+    _mm_storeu_si128((__m128i *)out,
+		     _mm_srai_epi32(_mm_unpacklo_epi16(a,a),16));
+    _mm_storeu_si128((__m128i *)(out+4),
+		     _mm_srai_epi32(_mm_unpackhi_epi16(a,a),16));
+  }
+#endif
 
   s = (char *)out;
   for(i=0; i < n; i++){
@@ -10,7 +10,6 @@
 		     added some assert to make the code fail if this happens
 
  
-   TODO:   <string.h>::bcopy -> memcpy
  */
 
 /* #dfin SWAP_ENDIAN 1  for cfa0 (big endian lf-o-righ incra
@@ -19,6 +18,7 @@
    lil ndian righ-o-lf Inl 80x86 and Pnium procor */
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include "sma_data.h"
 
@@ -69,14 +69,12 @@ reverse2(char *bytes)
 void
 reverse1(char *bytes)
 {
-   char t;
-   t = *bytes;
-   *bytes = bytes[0];
+   /* a single byte has no order to swap */
 }
 
 struct inh_def *swap_inh(struct inh_def *inh_pnr)
 {     struct inh_def inh_buff;
-      bcopy(inh_pnr, &inh_buff, sizeof(struct inh_def));
+      memcpy(&inh_buff, inh_pnr, sizeof(struct inh_def));
       reverse4((char *)(&inh_buff.conid));
       reverse2((char *)(&inh_buff.icocd));
       reverse4((char *)(&inh_buff.traid));
@@ -109,13 +107,13 @@ struct inh_def *swap_inh(struct inh_def *inh_pnr)
       reverse4((char *)(&inh_buff.epoch));
       reverse4((char *)(&inh_buff.sflux));
       reverse4((char *)(&inh_buff.size));
-      bcopy(&inh_buff,inh_pnr, sizeof(struct inh_def));
+      memcpy(inh_pnr, &inh_buff, sizeof(struct inh_def));
       return(inh_pnr);
 }
 
 struct blh_def *swap_blh(struct blh_def *blh_pnr)
 {     struct blh_def blh_buff;
-      bcopy(blh_pnr, &blh_buff, sizeof(struct blh_def));
+      memcpy(&blh_buff, blh_pnr, sizeof(struct blh_def));
       reverse4((char *)(&blh_buff.blhid));
       reverse4((char *)(&blh_buff.inhid));
       reverse2((char *)(&blh_buff.isb));
@@ -150,13 +148,13 @@ struct blh_def *swap_blh(struct blh_def *blh_pnr)
       reverse4((char *)(&blh_buff.bln));
       reverse4((char *)(&blh_buff.blu));
       reverse4((char *)(&blh_buff.soid));
-      bcopy(&blh_buff,blh_pnr, sizeof(struct blh_def));
+      memcpy(blh_pnr, &blh_buff, sizeof(struct blh_def));
 return(blh_pnr);
 }
 
 struct sph_def *swap_sph(struct sph_def *sph_pnr)
 {    struct sph_def sph_buff;
-     bcopy(sph_pnr, &sph_buff, sizeof(struct sph_def));
+     memcpy(&sph_buff, sph_pnr, sizeof(struct sph_def));
      reverse4((char *)(&sph_buff.sphid));
      reverse4((char *)(&sph_buff.blhid));
      reverse4((char *)(&sph_buff.inhid));
@@ -186,14 +184,14 @@ struct sph_def *swap_sph(struct sph_def *sph_pnr)
      reverse2((char *)(&sph_buff.gaiidpha));
      reverse2((char *)(&sph_buff.flcid));
      reverse2((char *)(&sph_buff.atmid));
-     bcopy(&sph_buff,sph_pnr, sizeof(struct sph_def));
+     memcpy(sph_pnr, &sph_buff, sizeof(struct sph_def));
          return(sph_pnr);
 }
 
 struct codeh_def *swap_cdh(struct codeh_def *cdh_pnr)
 {    struct codeh_def cdh_buff;
      int i;
-     bcopy(cdh_pnr, &cdh_buff, sizeof(struct codeh_def));
+     memcpy(&cdh_buff, cdh_pnr, sizeof(struct codeh_def));
      for (i=0; i< 12; i++) {
        reverse1((char *)(&cdh_buff.v_name[i]));
      }
@@ -205,13 +203,13 @@ struct codeh_def *swap_cdh(struct codeh_def *cdh_pnr)
      }
      reverse2((char *)(&cdh_buff.ncode));
 
-     bcopy(&cdh_buff,cdh_pnr, sizeof(struct codeh_def));
+     memcpy(cdh_pnr, &cdh_buff, sizeof(struct codeh_def));
      return(cdh_pnr);
 }
  
 struct ant_def *swap_enh(struct ant_def *enh_pnr)
 {    struct ant_def enh_buff;
-     bcopy(enh_pnr, &enh_buff, sizeof(struct ant_def));
+     memcpy(&enh_buff, enh_pnr, sizeof(struct ant_def));
      reverse4((char *)(&enh_buff.antennaNumber));
      reverse4((char *)(&enh_buff.padNumber));
      reverse4((char *)(&enh_buff.antennaStatus));
@@ -239,13 +237,13 @@ struct ant_def *swap_enh(struct ant_def *enh_pnr)
      reverse8((char *)(&enh_buff.chopper_angle));
      reverse8((char *)(&enh_buff.tsys));
      reverse8((char *)(&enh_buff.ambient_load_temperature));
-     bcopy(&enh_buff, enh_pnr, sizeof(struct ant_def));
+     memcpy(enh_pnr, &enh_buff, sizeof(struct ant_def));
      return(enh_pnr);
 }
 
 struct sch_def *swap_sch(struct sch_def *sch_pnr)
 {   struct sch_def sch_buff;
-    bcopy(sch_pnr, &sch_buff, sizeof(struct sch_def));
+    memcpy(&sch_buff, sch_pnr, sizeof(struct sch_def));
     reverse4((char *)(&sch_buff.inhid));
     reverse1((char *)(&sch_buff.form[0]));
     reverse1((char *)(&sch_buff.form[1]));
@@ -253,7 +251,7 @@ struct sch_def *swap_sch(struct sch_def *sch_pnr)
     reverse1((char *)(&sch_buff.form[3]));
     reverse4((char *)(&sch_buff.nbyt));
     reverse4((char *)(&sch_buff.nbyt_pack));
-    bcopy(&sch_buff,sch_pnr, sizeof(struct sch_def));
+    memcpy(sch_pnr, &sch_buff, sizeof(struct sch_def));
     return(sch_pnr);
 }
 
@@ -274,16 +272,10 @@ int *swap_int_data(int *int_data_pnr, int datalength)
      int int_data_buff;
      int i;
      assert(check_s4==4);
-     printf("before swap:  i pnr buff :--: before swap: pnr buff\n");
      for (i=0; i<datalength; i++) {
        int_data_buff=int_data_pnr[i];     
-       printf("%d %d %d :--:  ", i,
-	      int_data_pnr[i], int_data_buff);
        reverse4((char *)(&int_data_buff));
        int_data_pnr[i]=int_data_buff;
-       printf("%d %d\n",
-	      int_data_pnr[i], int_data_buff);
-
      }
      return(int_data_pnr);
 }
@@ -295,17 +287,10 @@ long int *swap_long_data(long int *long_data_pnr, int datalength)
      long int long_data_buff;
      int i;
      assert(check_s8==8);
-     printf("long before swap:  i pnr buff :--: before swap: pnr buff %d\n",
-            datalength);
      for (i=0; i<datalength; i++) {
        long_data_buff = long_data_pnr[i];
-       printf("%d %d %d :--:  ", i,
-	      long_data_pnr[i], long_data_buff);
        reverse8((char *)(&long_data_buff));
        long_data_pnr[i] = long_data_buff;
-       printf("%d %d\n",
-	      long_data_pnr[i], long_data_buff);
-       
      }
      return(long_data_pnr);
 }
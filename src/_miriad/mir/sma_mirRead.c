@@ -177,10 +177,10 @@
 //                  for if-else around line 2534.
 //***********************************************************
 #include <math.h>
-#include <rpc/rpc.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <time.h>
@@ -194,7 +194,7 @@
 
 
 /* extern variable while read mir data */
-char pathname[36];
+char pathname[512];
 static FILE* fpin[6];
 int nsets[6];
 double jday; /* julian day */
@@ -236,7 +236,7 @@ int *noskip1, int *spskip1, int *dsb1, int*mcconfig1, int*nohighspr);
 void rspokeflshsma_c(char *kst[]);
 
 
-int rsgetdata(float smavis[2*7681], int smaflags[7681], int *smanchan, int p, int bl, int sb, int rx);
+int rsgetdata(float smavis[2*MAXCHAN], int smaflags[MAXCHAN], int *smanchan, int p, int bl, int sb, int rx);
 struct pols *rscntstokes(int npol, int bl, int sb, int rx);
 int rsmir_Read(char *datapath, int jstat);
 struct inh_def *inh_read(FILE *fpinh);
@@ -265,15 +265,36 @@ struct lmn *sph2lmn(double ra, double dec);
 struct vel *vsite(double phi, double st);
 void vsun(double *VEL);
 short ipolmap(short input_ipol);
+static void sma_close(void);
+static void sma_abort(void);
+
+/* close whichever mir files are open */
+static void sma_close(void)
+{
+  int file;
+  for (file=0;file<6;file++){
+    if (fpin[file] != NULL) fclose(fpin[file]);
+    fpin[file] = NULL;
+  }
+}
+
+/* give up on the mir data; the reason has already been printed */
+static void sma_abort(void)
+{
+  sma_close();
+  bug_c('f',"Unable to continue reading the mir data, in rsmir_Read");
+}
 
 /* interface between fortran and c */
 void rsmirread_c(char *datapath, char *jst[])
 { 
   int jstat;
+  if (strlen(datapath) >= sizeof(pathname))
+    bug_c('f',"Path to the mir data is too long, in rsmirread_c");
   strcpy(pathname,datapath);
-  jstat= (int)*jst;
+  jstat= (int)(intptr_t)*jst;
   jstat = rsmir_Read(pathname,jstat);
-  *jst = (char *)jstat; 
+  *jst = (char *)(intptr_t)jstat; 
 }
 
 void rsmiriadwrite_c(char *datapath, char *jst[])
@@ -282,13 +303,13 @@ void rsmiriadwrite_c(char *datapath, char *jst[])
   jstat=-1;
   /* open mir files */
   jstat = rsmir_Read(pathname,jstat);
-  *jst = (char *)jstat;
+  *jst = (char *)(intptr_t)jstat;
   /* then start to read and write data if the files are ok. */
   if (jstat==0) {
     jstat=0;
     jstat = rsmir_Read(pathname,jstat);
   } else {
-    printf("file problem\n");
+    fprintf(stderr,"file problem\n");
   }
 }
 
@@ -337,7 +358,7 @@ void rspokeinisma_c(char *kst[], int tno1, int *dosam1, int *doxyp1,
 	            int *dsb1, int *mcconfig1, int *nohighspr1)
 { 
   /* rspokeflshsma_c == pokeflsh */
-  int buffer, i;
+  int i;
   /* initialize the external buffers */   
   strcpy(sname, " ");
   smabuffer.tno    = tno1;
@@ -368,13 +389,13 @@ void rspokeinisma_c(char *kst[], int tno1, int *dosam1, int *doxyp1,
   smabuffer.spskip[1] = spskip1[1];
   smabuffer.mcconfig  = *mcconfig1;
   smabuffer.highrspectra = *nohighspr1;
-      printf("User's input vSource = %f km/s\n", smabuffer.vsource);
+      fprintf(stderr,"User's input vSource = %f km/s\n", smabuffer.vsource);
       if(rfreq1 > 0.00001 || rfreq1 < -0.00001) {
              for (i=0; i<SMIF+1; i++) {
              smabuffer.restfreq[i] = rfreq1;
                                       }
             smabuffer.dorfreq = -1;
-      printf("User's input RestFrequency = %f GHz\n", rfreq1);
+      fprintf(stderr,"User's input RestFrequency = %f GHz\n", rfreq1);
                     } else {
              smabuffer.dorfreq =  1;
                                       }
@@ -393,7 +414,6 @@ void rspokeinisma_c(char *kst[], int tno1, int *dosam1, int *doxyp1,
   smabuffer.nifs = 0;
   smabuffer.nused = 0;
   smabuffer.tcorr = 0;
-  buffer=(int)*kst;
   *kst= OK;
 }
 
@@ -402,7 +422,7 @@ void rspokeflshsma_c(char *kst[])
   int tno;
   int i1, i2, ifs, p, bl, sb, rx, nchan, nspect;
   int npol,ipnt,ischan[SMIF];
-  int tbinhi,ibuff;
+  int ibuff;
   double preamble[5], tdash;
   long int dummy;
   float jyperk, eta, eta_c, eta_a, r_ant=3, pi;
@@ -418,6 +438,8 @@ void rspokeflshsma_c(char *kst[])
   tno = smabuffer.tno;
   sb = smabuffer.sb; /* sb=0 for lsb; sb=1 for usb; sb=2 for both */
   rx = smabuffer.rxif;
+// rxif=-1 loads all receivers; the data are filed under the first
+  if(rx==-1) rx = smabuffer.rx1;
   if(smabuffer.nused==0) 
     return;
   /* put ants to uvdata */
@@ -454,7 +476,6 @@ void rspokeflshsma_c(char *kst[])
       }
   } 
   tdash  = smabuffer.time;
-  tbinhi = 1;
 // convert julian date to ut and store ut 
 // ut and julian date on 2000 julian2000=2451544.5
 // julain date = 2451544.5 + day of the yr + fraction of day from 0h UT 
@@ -501,9 +522,9 @@ void rspokeflshsma_c(char *kst[])
   if(smabuffer.doif!=1&&smabuffer.nifs>1) {
     nspect =ischan[0]= 1;
     for(ifs=0; ifs < smabuffer.nifs; ifs++) {
-      printf(" writing headers\n");
+      fprintf(stderr," writing headers\n");
       uvputvri_c(tno,"nspect",&nspect,1);
-      printf(" search\n");
+      fprintf(stderr," search\n");
       uvputvri_c(tno,"npol",  &(smabuffer.nstoke[ifs]),1);
       uvputvri_c(tno,"nschan",&(smabuffer.nfreq[ifs]),1);
       uvputvri_c(tno,"ischan",&ischan[0],1);
@@ -512,7 +533,7 @@ void rspokeflshsma_c(char *kst[])
       uvputvrd_c(tno,"restfreq",&(smabuffer.restfreq[ifs]),1);
       bl=0;
       for(i2=1; i2<smabuffer.nants+1; i2++){
-	for(i1=1; i1<i2+1; i2++){
+	for(i1=1; i1<i2+1; i1++){
 	  preamble[0] = smabuffer.u[bl];
 	  preamble[1] = smabuffer.v[bl];
 	  preamble[2] = smabuffer.w[bl];
@@ -520,7 +541,7 @@ void rspokeflshsma_c(char *kst[])
 	  preamble[4] = 256*i1 + i2;
 	  for(p=0; p<smabuffer.nstoke[ifs]; p++){
           ipnt = smabuffer.pnt[ifs][p][bl][0][0];
-          printf("ipnt=%d\n", ipnt);
+          fprintf(stderr,"ipnt=%d\n", ipnt);
 	  if(ipnt>0) 
 	  uvputvrr_c(tno,"inttime",&smabuffer.inttime[bl],1);
 	  if(smabuffer.opcorr==0) {
@@ -542,7 +563,7 @@ void rspokeflshsma_c(char *kst[])
 // counting total number of spectral channels
       for (ifs = 1; ifs < smabuffer.nifs; ifs++) {
 	ischan[ifs] = ischan[ifs-1] + smabuffer.nfreq[ifs];
-//        printf("MMMMM %d", smabuffer.nfreq[ifs]);
+//        fprintf(stderr,"MMMMM %d", smabuffer.nfreq[ifs]);
       }
       uvputvri_c(tno,"nspect",&(smabuffer.nifs),1);
       uvputvri_c(tno,"ischan",&(ischan),smabuffer.nifs);
@@ -608,7 +629,7 @@ int rsgetdata(float smavis[2*MAXCHAN], int smaflags[MAXCHAN], int *smanchan, int
   nchand = 0;
   for (n=0; n<nifs; n++) {
     ipnt = smabuffer.pnt[n][p][bl][sb][rx]; 
-//      printf("n ipnt %d %d\n", n, ipnt);
+//      fprintf(stderr,"n ipnt %d %d\n", n, ipnt);
       if(ipnt>0) {
       if(nchan<nchand) {
 	for (i=nchan; i<nchand; i++) {
@@ -629,7 +650,7 @@ int rsgetdata(float smavis[2*MAXCHAN], int smaflags[MAXCHAN], int *smanchan, int
       }
       if(smabuffer.bchan[n]>=1&&smabuffer.bchan[n]<=smabuffer.nfreq[n])
 	smaflags[nchan+smabuffer.bchan[n]] = smabuffer.flag[n][p][bl][sb][rx]; 
-        nchan = nchan + smabuffer.nfreq[n];
+      nchan = nchan + smabuffer.nfreq[n];
     }
     nchand = nchand + smabuffer.nfreq[n];
   }
@@ -674,22 +695,21 @@ struct pols *rscntstokes(int npol, int bl, int sb, int rx)
 
 int rsmir_Read(char *datapath, int jstat)
 {
-  char location[6][81];
-  char pathname[64];
+  char location[6][528];
+  char pathname[512];
   char filename[6][36];
   char sours[9], smasours[33];
   int set, readSet;
   int file,nfiles = 6;
   int headerbytes[6];
   smEng **smaEngdata;
-  int i,j,k,l,m,i0;
+  int i,j,k,l,m;
   int kk,iinset,lastinset,ireset,reset_id[10];
-  long imax,bytepos,nbytes,datalength;
+  long imax,bytepos,datalength;
   long *data_start_pos;
-  int firstbsl;
   int numberBaselines=0;
   int numberSpectra,numberSidebands,numberRxif;
-  int blhid,firstsp,lastsp;
+  int blhid;
   int inhset,blhset,sphset,inhset1st;
   int spcode[25], frcode[25];
   short int scale;
@@ -699,16 +719,15 @@ int rsmir_Read(char *datapath, int jstat)
   int tno, ipnt, max_sourid;
   int kstat;
   char *kst[4];
-  char target[6];
-  char unknown[7];
-  char skipped[8];
+  char target[7];
+  char unknown[8];
+  char skipped[9];
   int ntarget;
   time_t  startTime, endTime;
   float trueTime;
   blvector blarray[MAXANT][MAXANT];
   station  antenna[MAXANT];
   source   multisour[MAXSOURCE];
-  struct xyz   antxyz[MAXANT];
   int sourceID, phaseSign;
   short oka,okb,okc,okd;
   correlator smaCorr;
@@ -735,7 +754,7 @@ int rsmir_Read(char *datapath, int jstat)
   extern struct sch_def   **sch;
   struct bltsys    **tsys;
   struct anttsys   **atsys;
-  struct wtt    **wts;
+  static struct wtt **wts; /* kept for the second sideband */
 // initialize
   startTime = time(NULL);
   phaseSign = 1;
@@ -745,7 +764,10 @@ int rsmir_Read(char *datapath, int jstat)
   rxlod     = 0;
   lastinset = 0;
   ireset    = 0;
+  memset(&visSMAscan, 0, sizeof(visSMAscan));
 //  
+  if (strlen(datapath) >= sizeof(pathname))
+    bug_c('f',"Path to the mir data is too long, in rsmir_Read");
   strcpy(pathname,datapath);
   strcpy(filename[0],"in_read");
   strcpy(filename[1],"bl_read");
@@ -776,11 +798,11 @@ int rsmir_Read(char *datapath, int jstat)
       // open the mir files
       fpin[file] = fopen(location[file],"r");
       if (fpin[file] == NULL) {
-	printf("Problem opening the file %s\n",location[file]);
+	fprintf(stderr,"Problem opening the file %s\n",location[file]);
 	perror("file open problem");
-	exit(-1);
+	sma_abort();
       } else {
-	printf("Found file %s\n",location[file]);
+	fprintf(stderr,"Found file %s\n",location[file]);
       }
     }
     // Get the size of each file and compute the number of headers 
@@ -798,19 +820,19 @@ int rsmir_Read(char *datapath, int jstat)
     for (set=0;set<nsets[0];set++) {
       inh[set] = (struct inh_def *)malloc(sizeof(struct inh_def ));
       if (inh[set] == NULL ){
-	printf("ERROR: Memory allocation for inh failed trying to allocate %d bytes\n", nsets[0]*sizeof(struct inh_def));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for inh failed trying to allocate %lu bytes\n", (unsigned long)(nsets[0]*sizeof(struct inh_def)));
+	sma_abort();
       }
     }
     if (smabuffer.scanproc==0||smabuffer.scanproc<0)
-      smabuffer.scanproc = nsets[0] - smabuffer.scanskip-2;
+      smabuffer.scanproc = nsets[0] - smabuffer.scanskip;
     
     blh = (struct blh_def **) malloc(nsets[1]*sizeof( struct blh_def *));
     for (set=0;set<nsets[1];set++) {
       blh[set] = (struct blh_def *)malloc(sizeof(struct blh_def ));
       if (blh[set] == NULL ){
-	printf("ERROR: Memory allocation for blh failed trying to allocate %d bytes\n", nsets[1]*sizeof(struct blh_def));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for blh failed trying to allocate %lu bytes\n", (unsigned long)(nsets[1]*sizeof(struct blh_def)));
+	sma_abort();
       }
     }
     // new baseline buffer used for configuring spectra.
@@ -820,17 +842,17 @@ int rsmir_Read(char *datapath, int jstat)
     for (set=0;set<nsets[0];set++) {
       bln[set] = (struct blh_config *)malloc(sizeof(struct blh_config ));
       if (bln[set] == NULL ){
-	printf("ERROR: Memory allocation for blh failed trying to allocate %d bytes\n", nsets[0]*sizeof(struct blh_def));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for blh failed trying to allocate %lu bytes\n", (unsigned long)(nsets[0]*sizeof(struct blh_def)));
+	sma_abort();
       }
     }
     // baseline coordinate buffer.
     uvwbsln = (struct uvwPack **) malloc(nsets[0]*sizeof( struct uvwPack));
     for (set=0;set<nsets[0];set++) {
-      uvwbsln[set] = (struct uvwPack *)malloc(sizeof(struct uvwPack));
+      uvwbsln[set] = (struct uvwPack *)calloc(1, sizeof(struct uvwPack));
       if (uvwbsln[set] == NULL ){
-	printf("ERROR: Memory allocation for uvwbsln failed for %d bytes\n",nsets[0]*sizeof(struct uvwPack));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for uvwbsln failed for %lu bytes\n",(unsigned long)(nsets[0]*sizeof(struct uvwPack)));
+	sma_abort();
       }
     }
     
@@ -844,9 +866,9 @@ int rsmir_Read(char *datapath, int jstat)
       }
     }
     if (SWAP_ENDIAN) {
-      printf("FINISHED READING  IN HEADERS (endian-swapped)\n");
+      fprintf(stderr,"FINISHED READING  IN HEADERS (endian-swapped)\n");
     } else {
-      printf("FINISHED READING  IN HEADERS\n");
+      fprintf(stderr,"FINISHED READING  IN HEADERS\n");
     }
     for (set=0;set<nsets[1];set++) {
       *blh[set] = *(blh_read(fpin[1]));
@@ -859,41 +881,43 @@ int rsmir_Read(char *datapath, int jstat)
     // count sidebands
     numberSidebands = 1;
     for (set=0; set<nsets[1]; set++) {
-      if( blh[set]->inhid == inh[smabuffer.scanskip]->inhid
+      if( set+1 < nsets[1]
+	  &&  blh[set]->inhid == inh[smabuffer.scanskip]->inhid
 	  &&  blh[set]->isb != blh[set+1]->isb) {
 	numberSidebands = 2;
 	break; 
       }
     }
-    printf("NUMBER OF SIDEBANDS =%d\n",numberSidebands);
+    fprintf(stderr,"NUMBER OF SIDEBANDS =%d\n",numberSidebands);
     // count receivers
     smaCorr.no_rxif = 1;
     for (set=0; set<nsets[1]; set++) {
       smabuffer.rx1=smabuffer.rx2=blh[set]->irec;
-      if( blh[set]->inhid == inh[smabuffer.scanskip]->inhid
+      if( set+1 < nsets[1]
+	  &&  blh[set]->inhid == inh[smabuffer.scanskip]->inhid
 	  &&  blh[set]->irec != blh[set+1]->irec) {
         smabuffer.rx2=blh[set+1]->irec;
 	smaCorr.no_rxif = 2;
 	break;
       }
     }
-    printf("NUMBER OF RECEIVERS =%d \n",smaCorr.no_rxif);
+    fprintf(stderr,"NUMBER OF RECEIVERS =%d \n",smaCorr.no_rxif);
 
    switch(smabuffer.rx1) {
-   case 0: printf("rx1->230\n"); break;
-   case 1: printf("rx1->340\n"); break;
-   case 2: printf("rx1->690\n"); break;
+   case 0: fprintf(stderr,"rx1->230\n"); break;
+   case 1: fprintf(stderr,"rx1->340\n"); break;
+   case 2: fprintf(stderr,"rx1->690\n"); break;
                          }
        
    if(smaCorr.no_rxif == 2)
    switch(smabuffer.rx2) {
-   case 0: printf("rx2->230\n"); break;
-   case 1: printf("rx2->340\n"); break;
-   case 2: printf("rx2->690\n"); break;
+   case 0: fprintf(stderr,"rx2->230\n"); break;
+   case 1: fprintf(stderr,"rx2->340\n"); break;
+   case 2: fprintf(stderr,"rx2->690\n"); break;
                          }    
 
-           if(smabuffer.sb==0) printf("Processing LSB\n");
-           if(smabuffer.sb==1) printf("Processing USB\n");
+           if(smabuffer.sb==0) fprintf(stderr,"Processing LSB\n");
+           if(smabuffer.sb==1) fprintf(stderr,"Processing USB\n");
  
     numberRxif = smaCorr.no_rxif;
     // check if the receiver  smabuffer.rxif==0 for all receivers
@@ -902,14 +926,14 @@ int rsmir_Read(char *datapath, int jstat)
       if( blh[set]->inhid == inh[smabuffer.scanskip]->inhid
 	  &&  blh[set]->irec == smabuffer.rxif) 
 	goto foundTheRx;       } 
-    printf("ERROR: there is no receiver %d in this data set.\n",
+    fprintf(stderr,"ERROR: there is no receiver %d in this data set.\n",
 	   smabuffer.rxif);
     if(smaCorr.no_rxif == 1)
-    printf("       please try it again with rxif=%d\n", smabuffer.rx1);
+    fprintf(stderr,"       please try it again with rxif=%d\n", smabuffer.rx1);
      if(smaCorr.no_rxif == 2)
-     printf("       please try it again with rxif=%d or rxif=%d\n", 
+     fprintf(stderr,"       please try it again with rxif=%d or rxif=%d\n", 
      smabuffer.rx1,  smabuffer.rx2);
-    exit(-1);
+    sma_abort();
   foundTheRx:
 // assign the rx id to load in the case of dual rx
       if(smabuffer.rxif==-1||smaCorr.no_rxif==1) {rxlod=0;
@@ -922,18 +946,18 @@ int rsmir_Read(char *datapath, int jstat)
     for (set=0;set<nsets[1];set++) {
       tsys[set] = (struct bltsys *)malloc(sizeof(struct bltsys ));
       if (tsys[set] == NULL ){
-	printf("ERROR: Memory allocation for tsys failed trying to allocate %d bytes\n",
-	       nsets[1]*sizeof(struct bltsys));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for tsys failed trying to allocate %lu bytes\n",
+	       (unsigned long)(nsets[1]*sizeof(struct bltsys)));
+	sma_abort();
       }
     }
     atsys = (struct anttsys **) malloc(nsets[0]*sizeof( struct anttsys *));
     for (set=0;set<nsets[0];set++) {
       atsys[set] = (struct anttsys *)malloc(sizeof(struct anttsys ));
       if (atsys[set] == NULL ){
-	printf("ERROR: Memory allocation for atsys failed trying to allocate %d bytes\n",
-	       nsets[0]*sizeof(struct anttsys));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for atsys failed trying to allocate %lu bytes\n",
+	       (unsigned long)(nsets[0]*sizeof(struct anttsys)));
+	sma_abort();
       }
     }
 // allocate memory for wts once in the case of do both sb
@@ -942,9 +966,9 @@ int rsmir_Read(char *datapath, int jstat)
     for (set=0;set<nsets[0];set++) {
       wts[set] = (struct wtt *)malloc(sizeof(struct wtt ));
       if (wts[set] == NULL ){
-        printf("ERROR: Memory allocation for wts failed trying to allocate %d bytes\n",
-               nsets[0]*sizeof(struct wtt));
-        exit(-1);
+        fprintf(stderr,"ERROR: Memory allocation for wts failed trying to allocate %lu bytes\n",
+               (unsigned long)(nsets[0]*sizeof(struct wtt)));
+        sma_abort();
       }
     } }
 
@@ -952,23 +976,21 @@ int rsmir_Read(char *datapath, int jstat)
     /* loading baselines */
     blhset =0;
     { 
-      int blnset;
       int blset;
       int inhid_hdr;
       int blhid_hdr;
       blhid_hdr = 0;
       inhid_hdr = inh[0]->inhid;
-      blnset = 0;
       if (smabuffer.rxif!=-1) {
 
 
    switch(smabuffer.rxif) {
-   case 0: printf("to load rx->230 visdata\n"); break;
-   case 1: printf("to load rx->340 visdata\n"); break;
-   case 2: printf("to load rx->690 visdata\n"); break;
+   case 0: fprintf(stderr,"to load rx->230 visdata\n"); break;
+   case 1: fprintf(stderr,"to load rx->340 visdata\n"); break;
+   case 2: fprintf(stderr,"to load rx->690 visdata\n"); break;
                          }
       } else {
-	printf("to load data for all receivers.\n");
+	fprintf(stderr,"to load data for all receivers.\n");
       }
       //
       // bln will be used in configuring spectra
@@ -1000,11 +1022,11 @@ int rsmir_Read(char *datapath, int jstat)
         if(smaCorr.no_rxif==2&&blh[blset-1]->irec==smabuffer.rx1
        &&blh[blset]->irec==smabuffer.rx2) {
         blid_intchng[set] = blh[blset]->blhid;
-/*        printf("blid_intchng blh rx sb blh->inhid %d %d %d %d %d\n", 
+/*        fprintf(stderr,"blid_intchng blh rx sb blh->inhid %d %d %d %d %d\n", 
         blid_intchng[set],
         blh[blset]->blhid, blh[blset]->irec, blh[blset]->isb,
         blh[blset]->inhid);
-        printf("blid_intchng blh rx sb blh->inhid %d %d %d %d %d\n",
+        fprintf(stderr,"blid_intchng blh rx sb blh->inhid %d %d %d %d %d\n",
         blid_intchng[set],
         blh[blset-1]->blhid, blh[blset-1]->irec, blh[blset-1]->isb,
         blh[blset-1]->inhid);
@@ -1019,7 +1041,7 @@ int rsmir_Read(char *datapath, int jstat)
 	      bln[set]->isb   = blh[blset]->isb;
 	      bln[set]->irec  = blh[blset]->irec; 
 	      inhid_hdr       = blh[blset]->inhid;
-/* printf("bln[set]->blhid  bln[set]->irec bln[set]->isb %d %d %d \n",
+/* fprintf(stderr,"bln[set]->blhid  bln[set]->irec bln[set]->isb %d %d %d \n",
  bln[set]->blhid,
                  bln[set]->irec, bln[set]->isb); 
 */
@@ -1056,7 +1078,7 @@ int rsmir_Read(char *datapath, int jstat)
 	  // counting baseline for each integration set
 	  uvwbsln[set]->n_bls++;
 	}
-	//     printf("set numberBaselines %d %d\n", set, numberBaselines);     
+	//     fprintf(stderr,"set numberBaselines %d %d\n", set, numberBaselines);     
 	numberBaselines=uvwbsln[set]->n_bls;
       } /* blset */
     }
@@ -1088,12 +1110,12 @@ handling_blarray:
 	  blarray[blh[set]->itel1][blh[set]->itel2].itel1 = blh[set]->itel1;
 	  blarray[blh[set]->itel1][blh[set]->itel2].itel2 = blh[set]->itel2;
 	  blarray[blh[set]->itel1][blh[set]->itel2].blid  = blh[set]->blsid;
-//          printf(" ant1 ant2 e n u %d %d %f %f %f\n", blh[set]->itel1,
+//          fprintf(stderr," ant1 ant2 e n u %d %d %f %f %f\n", blh[set]->itel1,
 //          blh[set]->itel2,blh[set]->ble, blh[set]->bln, blh[set]->blu);
 	  smabuffer.nants++;       }
 	else
 	  {smabuffer.nants = (int)((1+sqrt(1.+8.*smabuffer.nants))/2);
-	  printf("mirRead: number of antenna =%d are found.\n", smabuffer.nants);
+	  fprintf(stderr,"mirRead: number of antenna =%d are found.\n", smabuffer.nants);
 	  goto blload_done;}
       } /* set */
     }
@@ -1101,18 +1123,18 @@ handling_blarray:
     free(blh);
     
     if (SWAP_ENDIAN) {
-      printf("FINISHED READING  BL HEADERS (endian-swapped)\n");
+      fprintf(stderr,"FINISHED READING  BL HEADERS (endian-swapped)\n");
     } else {
-      printf("FINISHED READING  BL HEADERS\n");
+      fprintf(stderr,"FINISHED READING  BL HEADERS\n");
     }
     // assign memory to enh
     enh = (struct ant_def **) malloc(nsets[4]*sizeof( struct ant_def *));
     for (set=0;set<nsets[4];set++) {
       enh[set] = (struct ant_def *)malloc(sizeof(struct ant_def ));
       if (enh[set] == NULL ){
-	printf("ERROR: Memory allocation for enh failed for %d bytes\n",
-	       nsets[4]*sizeof(struct ant_def));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for enh failed for %lu bytes\n",
+	       (unsigned long)(nsets[4]*sizeof(struct ant_def)));
+	sma_abort();
       }
     }
     // make sma engineer data buffer
@@ -1120,14 +1142,14 @@ handling_blarray:
     for (set=0;set<nsets[0];set++) {
       smaEngdata[set] = (struct smEng *)malloc(sizeof(struct smEng ));
       if (smaEngdata[set] == NULL ){
-	printf("ERROR: Memory allocation for smaEngdata failed for %d bytes\n",
-	       nsets[0]*sizeof(struct smEng));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for smaEngdata failed for %lu bytes\n",
+	       (unsigned long)(nsets[0]*sizeof(struct smEng)));
+	sma_abort();
       }
     }
     // skip engineer data reading because the engineer
     // file was problem for the two receivers case. 05-2-25
-    //printf("doeng = %d\n", smabuffer.doeng);
+    //fprintf(stderr,"doeng = %d\n", smabuffer.doeng);
     if (smabuffer.doeng!=1) {
       goto engskip;
     } else {
@@ -1163,9 +1185,9 @@ handling_blarray:
       }
     }
     if (SWAP_ENDIAN) {
-      printf("FINISHED READING EN HEADERS (endian-swapped)\n");
+      fprintf(stderr,"FINISHED READING EN HEADERS (endian-swapped)\n");
     } else {
-      printf("FINISHED READING EN HEADERS\n");
+      fprintf(stderr,"FINISHED READING EN HEADERS\n");
     }
   engskip:
     //free(smaEngdata);
@@ -1199,7 +1221,7 @@ handling_blarray:
 	  - antenna[smabuffer.refant].y;
 	antenna[i].z = (double)blarray[i][smabuffer.refant].uu 
 	  - antenna[smabuffer.refant].z;
-//        printf(" ant ee nn uu %d %f %f %f\n",i,
+//        fprintf(stderr," ant ee nn uu %d %f %f %f\n",i,
 //            blarray[i][smabuffer.refant].ee,
 //            blarray[i][smabuffer.refant].nn,
 //            blarray[i][smabuffer.refant].uu);
@@ -1209,7 +1231,7 @@ handling_blarray:
          antenna[smabuffer.refant].x = 0.;
          antenna[smabuffer.refant].y = 0.;
          antenna[smabuffer.refant].z = 0.;
-//            printf(" ant ee nn uu %d %f %f %f\n",i,
+//            fprintf(stderr," ant ee nn uu %d %f %f %f\n",i,
 //            blarray[smabuffer.refant][i].ee,
 //            blarray[smabuffer.refant][i].nn,
 //           blarray[smabuffer.refant][i].uu);
@@ -1225,7 +1247,7 @@ handling_blarray:
 	antenna[i].z = (double)blarray[smabuffer.refant][i].uu
 	  - antenna[smabuffer.refant].z;
 	antenna[i].z = - antenna[i].z;
-//            printf(" ant ee nn uu %d %f %f %f\n",i,
+//            fprintf(stderr," ant ee nn uu %d %f %f %f\n",i,
 //            blarray[smabuffer.refant][i].ee,
 //            blarray[smabuffer.refant][i].nn,
 //            blarray[smabuffer.refant][i].uu);
@@ -1244,9 +1266,9 @@ handling_blarray:
 	geocxyz[i].y = (antenna[i].x);
 	geocxyz[i].z = (antenna[i].z)*sin(smabuffer.lat)
 	  + (antenna[i].y)*cos(smabuffer.lat);
-// printf("ant x y z %d %f %f %f\n", i, antenna[i].x,antenna[i].y,antenna[i].z);
+// fprintf(stderr,"ant x y z %d %f %f %f\n", i, antenna[i].x,antenna[i].y,antenna[i].z);
       }
-      printf("NUMBER OF ANTENNAS =%d\n", smabuffer.nants);
+      fprintf(stderr,"NUMBER OF ANTENNAS =%d\n", smabuffer.nants);
       //
       // maximum antenna number for the array is 8 
       //
@@ -1254,34 +1276,6 @@ handling_blarray:
       for (i=1; i < smabuffer.nants+1; i++) {
 	sprintf(antenna[i].name, "AN%d", i);
       }     
-      // the positions of antennas need to check  
-      // antpos on 2005 feb 16
-      antxyz[1].x = 4.4394950000000000e+00;
-      antxyz[2].x = -5.7018977000000000e+00;
-      antxyz[3].x = -5.0781509999999996e-01;
-      antxyz[4].x = 5.2273398999999996e+00;
-      antxyz[5].x = -1.7918341999999999e+01;
-      antxyz[6].x = 0.0000000000000000e+00;
-      antxyz[7].x = -1.6564844999999998e+01;
-      antxyz[8].x = -6.4019909999999998e+00;
-      
-      antxyz[1].y = -6.3875615000000003e+01; 
-      antxyz[2].y = -1.8985175000000002e+01;
-      antxyz[3].y = -2.5154143000000001e+01;
-      antxyz[4].y = -2.0077679000000000e+01;
-      antxyz[5].y = -5.9557980000000001e+01;
-      antxyz[6].y =  0.0000000000000000e+00;
-      antxyz[7].y = -2.7025637000000000e+01;
-      antxyz[8].y = -6.8001356999999999e+01;
-      
-      antxyz[1].z = -2.1837547000000001e+01; 
-      antxyz[2].z = 1.5609299999999999e+01;
-      antxyz[3].z =  1.2797959999999999e+00; 
-      antxyz[4].z = -1.4844139000000000e+01;
-      antxyz[5].z = 3.0068384999999999e+01;
-      antxyz[6].z = 0.0000000000000000e+00;
-      antxyz[7].z = 3.0769280999999999e+01;
-      antxyz[8].z = 3.6370589999999998e+00;
 
 // reading antenna position from ASCII file
       if(smabuffer.readant > 0) {
@@ -1297,11 +1291,11 @@ double xyzpos;
 
 
 
-    printf("Geocentrical coordinates of antennas (m), reference antenna=%d\n",
+    fprintf(stderr,"Geocentrical coordinates of antennas (m), reference antenna=%d\n",
 	     smabuffer.refant); 
       for (i=1; i < smabuffer.nants+1; i++) {
        
-	printf("ANT x y z %s %11.4f %11.4f %11.4f\n",
+	fprintf(stderr,"ANT x y z %s %11.4f %11.4f %11.4f\n",
 	       antenna[i].name,
 	       geocxyz[i].x,
 	       geocxyz[i].y,
@@ -1313,7 +1307,7 @@ double xyzpos;
       // Units are nanosecs. 
       // write antenna dat to uv file 
       //
-      printf("Miriad coordinates of antennas (nanosecs), reference antenna=%d\n",
+      fprintf(stderr,"Miriad coordinates of antennas (nanosecs), reference antenna=%d\n",
 	     smabuffer.refant);
       r = sqrt(pow(geocxyz[smabuffer.refant].x,2) + 
 	       pow(geocxyz[smabuffer.refant].y,2));
@@ -1331,14 +1325,14 @@ double xyzpos;
 	tmp  = ( geocxyz[i].x) * cost + (geocxyz[i].y)*sint - r;
 	antpos[i-1] 
 	  = (1e9/DCMKS) * tmp;
-	printf("ANT x y x %s %11.4f ", antenna[i].name, antpos[i-1]);
+	fprintf(stderr,"ANT x y x %s %11.4f ", antenna[i].name, antpos[i-1]);
 	tmp  = (-geocxyz[i].x) * sint + (geocxyz[i].y) * cost;
 	antpos[i-1+smabuffer.nants] 
 	  = (1e9/DCMKS) * tmp;
-	printf("%11.4f ", antpos[i-1 + smabuffer.nants]);
+	fprintf(stderr,"%11.4f ", antpos[i-1 + smabuffer.nants]);
 	antpos[i-1+2*smabuffer.nants] 
 	  = (1e9/DCMKS) * (geocxyz[i].z-z0);
-	printf("%11.4f\n", antpos[i-1+2*smabuffer.nants]);
+	fprintf(stderr,"%11.4f\n", antpos[i-1+2*smabuffer.nants]);
       }
       
     }
@@ -1351,9 +1345,9 @@ double xyzpos;
     for (set=0;set<nsets[3];set++) {
       cdh[set] = (struct codeh_def *)malloc(sizeof(struct codeh_def ));
       if (cdh[set] == NULL ){
-	printf("ERROR: Memory allocation for cdh failed for %d bytes.\n",
-	       nsets[3]*sizeof(struct codeh_def));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for cdh failed for %lu bytes.\n",
+	       (unsigned long)(nsets[3]*sizeof(struct codeh_def)));
+	sma_abort();
       }
     }
     for (set=0;set<nsets[3];set++){
@@ -1363,9 +1357,9 @@ double xyzpos;
       }
     }
     if (SWAP_ENDIAN) {
-      printf("FINISHED READING  CD HEADERS (endian-swapped)\n");
+      fprintf(stderr,"FINISHED READING  CD HEADERS (endian-swapped)\n");
     }else {
-      printf("FINISHED READING  CD HEADERS\n");
+      fprintf(stderr,"FINISHED READING  CD HEADERS\n");
     }
     sourceID = 0;
     for (set=0;set<nsets[3];set++){
@@ -1399,9 +1393,9 @@ double xyzpos;
     if(inh[1]->ivctype==2)
       strcpy(multisour[sourceID].veltyp, "VELO-HEL");
     if(inh[1]->ivctype!=0 && inh[1]->ivctype!=2) {
-      printf("ERROR: veltype ivctype=%d is not supported.\n",
+      fprintf(stderr,"ERROR: veltype ivctype=%d is not supported.\n",
 	     inh[1]->ivctype);
-      exit(-1); 
+      sma_abort(); 
     }
     
     uvputvra_c(tno,"veltype", multisour[sourceID].veltyp);
@@ -1420,11 +1414,12 @@ double xyzpos;
           for(i=2; i< sourceID; i++) {
           if(strcmp(multisour[i].name, sours)==0) {
 // copy the original source name to smasours
-          for(i=0; i<33; i++) {
+          for(i=0; i<(int)sizeof(cdh[set]->code); i++) {
           smasours[i]=cdh[set]->code[i];
-          if(cdh[set]->code[i]==32||cdh[set]->code[i]==0||i==32)
+          if(cdh[set]->code[i]==32||cdh[set]->code[i]==0)
             smasours[i]='\0';
                                }
+          smasours[i]='\0';
          
           oka=okb=okc=okd=0;
           for(i=2; i< sourceID; i++) {
@@ -1449,16 +1444,16 @@ double xyzpos;
                             }
                            }
 
-    printf("Warning: The original name: '%s' is renamed to '%s'\n", 
+    fprintf(stderr,"Warning: The original name: '%s' is renamed to '%s'\n", 
     smasours, multisour[sourceID].name);
                                                        }
                                                  }
     multisour[sourceID].sour_id = cdh[set]->icode;
-	//         printf("cdh[set]->code=%s\n", cdh[set]->code);
+	//         fprintf(stderr,"cdh[set]->code=%s\n", cdh[set]->code);
     inhset=0;
 	while (inh[inhset]->souid!=multisour[sourceID].sour_id)
 	  inhset++;
-	//         printf("inh[inhset]->rar to c %s inhid=%d\n",
+	//         fprintf(stderr,"inh[inhset]->rar to c %s inhid=%d\n",
 	//         (char *)rar2c(inh[inhset]->rar),inh[inhset]->inhid);
 	multisour[sourceID].ra = inh[inhset]->rar;
 	multisour[sourceID].dec = inh[inhset]->decr;
@@ -1495,9 +1490,9 @@ double xyzpos;
     for (set=0; set<nsets[0]; set++) {
       spn[set] = (struct sph_config *)malloc(sizeof(struct sph_config ));
       if (spn[set] == NULL ){
-	printf("ERROR: Memory allocation for sph_config failed for %d bytes\n",
-	       nsets[0]*sizeof(struct sph_config));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for sph_config failed for %lu bytes\n",
+	       (unsigned long)(nsets[0]*sizeof(struct sph_config)));
+	sma_abort();
       }
     }
 //
@@ -1512,8 +1507,6 @@ double xyzpos;
       } else { smabuffer.highrspectra =-1; }
     
     { 
-      int inhid_hdr;
-      int blhid_hdr;
       int sphid_hdr;
       int blset;
       int inset;
@@ -1521,17 +1514,13 @@ double xyzpos;
       nspectra=0;
       blset     =  0;
       sphid_hdr =  0;
-      blhid_hdr = -10;
-      inhid_hdr = -10;
-      firstsp   = -1;
-      lastsp    = -1;
       numberSpectra = 0;
       // define baseline id used in pursing the spectral
       // configuration. 
       // integration set = smabuffer.scanskip
       // blhset=1 , the second baseline of the integration
       blhset=1;
-      //      printf("smabuffer.scanskip=%d\n", smabuffer.scanskip);
+      //      fprintf(stderr,"smabuffer.scanskip=%d\n", smabuffer.scanskip);
       blhid = uvwbsln[smabuffer.scanskip]->uvwID[blhset].blhid;
       rewind(fpin[2]);
       // spn starts from 0
@@ -1551,18 +1540,19 @@ double xyzpos;
 	}
 // load baseline based tsys structure
 	if(sph1->blhid==tsys[0]->blhid) nspectra++;
-//      printf("nspectra = %d\n", nspectra);
-//      printf("sph1->inhid tsys[blset]->inhid sph1->blhid tsys[blset]->blhid blset %d %d %d %d %d\n",
+//      fprintf(stderr,"nspectra = %d\n", nspectra);
+//      fprintf(stderr,"sph1->inhid tsys[blset]->inhid sph1->blhid tsys[blset]->blhid blset %d %d %d %d %d\n",
 //        sph1->inhid,tsys[blset]->inhid,sph1->blhid,tsys[blset]->blhid,blset);
 	if(sph1->blhid==tsys[blset]->blhid&&sph1->inhid==tsys[blset]->inhid) {
-// printf("sphset blid iband tsys %d  %d  %d %f \n",set,sph1->blhid, sph1->iband,sph1->tssb);
+// fprintf(stderr,"sphset blid iband tsys %d  %d  %d %f \n",set,sph1->blhid, sph1->iband,sph1->tssb);
  tsys[blset]->tssb[sph1->iband] = sph1->tssb;
 // loading online flagging information
-        if(tsys[blset]->ipol < -4||sph1->iband!=0) {
+// the continuum (iband 0) carries no weight
+        if(tsys[blset]->ipol < -4&&sph1->iband!=0) {
        wts[inset]->wt[sph1->iband-1][-4-tsys[blset]->ipol][tsys[blset]->blsid][tsys[blset]->isb][tsys[blset]->irec] = sph1->wt; 
                                      }
           else {
-         if(sph1->iband!=0)
+         if(tsys[blset]->ipol < 0&&sph1->iband!=0)
  wts[inset]->wt[sph1->iband-1][-tsys[blset]->ipol][tsys[blset]->blsid][tsys[blset]->isb][tsys[blset]->irec] = sph1->wt;
            }   
 	if(smabuffer.highrspectra !=1){  
@@ -1574,7 +1564,11 @@ double xyzpos;
 	}
 	// purse the spectral configuration
 	// check up inhid to work on the same set of integration 
-	if(sph1->inhid>inh[inset]->inhid) inset++ ;
+	// stop at the first spectrum past the integrations to be processed
+	if(sph1->inhid>inh[inset]->inhid) {
+	  inset++;
+	  if(inset==smabuffer.scanskip+smabuffer.scanproc) goto sphend;
+	}
 	// check up inhid and blhid to work on the same integration set
 	//       and the baseline set with the sidebband and rx as
 	//       is desired.
@@ -1610,7 +1604,7 @@ double xyzpos;
       if(sph1->blhid==(blid_intchng[inset]-1))
         spn[inset]->nch[sph1->iband][0] = sph1->nch; 
 /*       if(sph1->blhid==blid_intchng[inset])     
-       printf("inset blhid nch[%d][0] nch[i][1]  %d %d %d %d \n",
+       fprintf(stderr,"inset blhid nch[%d][0] nch[i][1]  %d %d %d %d \n",
         sph1->iband,
         inset,
         sph1->blhid,
@@ -1618,22 +1612,18 @@ double xyzpos;
         spn[inset]->nch[sph1->iband][1]); 
 */                             }
           lastinset=inset;
-	if(inset==smabuffer.scanskip+smabuffer.scanproc) { 
-	  goto sphend; 
-	}
       }
     }
 sphend:
      if (smabuffer.scanskip+smabuffer.scanproc>nsets[0]) {
-printf("Hits the end of integration %d\n", nsets[0]);
-printf("Reset 'nscans=%d, ' and run it again.\n",smabuffer.scanskip);
-         exit(-1);
+fprintf(stderr,"Hits the end of integration %d\n", nsets[0]);
+fprintf(stderr,"Reset 'nscans=%d, ' and run it again.\n",smabuffer.scanskip);
+         sma_abort();
                   }
 
 // handling 2003 incompleted correlator data
 if (smabuffer.spskip[0]==-2003) {
 double spfreq[25];
-double spfreqo[25];
 int nchunk=0;
 int minspID=25;
          for (i=1;i<SMIF+1;i++) {
@@ -1646,7 +1636,6 @@ int minspID=25;
          if(spfreq[i]<100.0) {
          spfreq[i]=0.0;
          spcode[i]=0;        }
-         spfreqo[i] =  spfreq[i];
          if (spcode[i]!=0&&spcode[i]<minspID) minspID=spcode[i];
                            }
          for (i=1;i<SMIF+1;i++) {
@@ -1662,13 +1651,13 @@ goto dat2003; }
               for (i=0;i<SMIF+1;i++) {
               if (spn[iinset]->nch[i][0]
                !=spn[iinset+1]->nch[i][0]) {
-         printf("Warning: The correlator was reconfigured at integrations=%d\n",
+         fprintf(stderr,"Warning: The correlator was reconfigured at integrations=%d\n",
                    iinset+1);
                           ireset++;
                     reset_id[ireset] = iinset+1;
-         printf("From    -> To\n");
+         fprintf(stderr,"From    -> To\n");
                     for (i=1;i<SMIF+1;i++) {
-         printf("s%2d:%3d -> :%3d\n", i, spn[iinset]->nch[i][0],
+         fprintf(stderr,"s%2d:%3d -> :%3d\n", i, spn[iinset]->nch[i][0],
                  spn[iinset+1]->nch[i][0]);
                                        }
                                            }
@@ -1677,38 +1666,34 @@ goto dat2003; }
            if(smabuffer.mcconfig==0) {
            for (i=1;i<ireset+1;i++) {
            if(smabuffer.scanskip< reset_id[i]) {
-    printf("Suggesttion:\n");
-    printf("For a single correlator configuration per loading (recommended),\n");
-    printf("reset nscans=%d,%d for the set of the first configuration data;\n", smabuffer.scanskip, reset_id[i]-1);
-    printf("reset nscans=%d, for the set of the second configuration data.\n",  reset_id[i]);
-    printf("Or choose options=mcconfig for multiple correlator configurations per loading (not recommended).\n");
-    printf("Try it again.\n");
-         exit(-1);
+    fprintf(stderr,"Suggesttion:\n");
+    fprintf(stderr,"For a single correlator configuration per loading (recommended),\n");
+    fprintf(stderr,"reset nscans=%d,%d for the set of the first configuration data;\n", smabuffer.scanskip, reset_id[i]-1);
+    fprintf(stderr,"reset nscans=%d, for the set of the second configuration data.\n",  reset_id[i]);
+    fprintf(stderr,"Or choose options=mcconfig for multiple correlator configurations per loading (not recommended).\n");
+    fprintf(stderr,"Try it again.\n");
+         sma_abort();
         }
                                     }
                                      }
 dat2003:                                                                           
-    printf("\n");
-    printf("number of non-empty Spectra = %d\n", numberSpectra);
+    fprintf(stderr,"\n");
+    fprintf(stderr,"number of non-empty Spectra = %d\n", numberSpectra);
 // reset number of spectra
     if(smabuffer.highrspectra==1) numberSpectra=25;
     if (SWAP_ENDIAN) {
-      printf("FINISHED READING SP HEADERS (endian-swapped)\n");
+      fprintf(stderr,"FINISHED READING SP HEADERS (endian-swapped)\n");
     } else {
-      printf("FINISHED READING SP HEADERS\n");
+      fprintf(stderr,"FINISHED READING SP HEADERS\n");
     }
 // solve for tsys
     {
       int refant;
       int done;
-      int pair1;
-      int pair2;
       int blset;
 // solve for tsys of a reference ante
       set=0;
       refant=0;
-      pair1=0;
-      pair2=0;
       blset=1;
       for(blset=0; blset<nsets[1]; blset++) {
 	if(set==nsets[0]-1) goto next;
@@ -1781,24 +1766,24 @@ dat2003:
       }
     nnextnextnext:
       //     for (set=0; set < nsets[0]; set++) {
-      //        printf("%d tsys %f  %f \n", set, atsys[set]->tssb[3],
+      //        fprintf(stderr,"%d tsys %f  %f \n", set, atsys[set]->tssb[3],
       //        atsys[set]->tssb[7]);
-      //     printf("%d entsys %f %f --- %f %f\n", set, atsys[set]->tssb[3], 
+      //     fprintf(stderr,"%d entsys %f %f --- %f %f\n", set, atsys[set]->tssb[3], 
       //          smaEngdata[set]->tsys[3], atsys[set]->tssb[7],
       //          smaEngdata[set]->tsys[7]); 
-      //   printf("%d tsys %f %f \n", atsys[set]->tssb[3],atsys[set]->tssb[7]);
+      //   fprintf(stderr,"%d tsys %f %f \n", atsys[set]->tssb[3],atsys[set]->tssb[7]);
       //}
-    printf("Decoded baseline-based Tsys\n");
+    fprintf(stderr,"Decoded baseline-based Tsys\n");
     }
     // decode the doppler velocity
 
  if (jday <2453531.5 && smabuffer.circular == 1) {
-      printf("Skip decoding the Doppler velocity\n");
+      fprintf(stderr,"Skip decoding the Doppler velocity\n");
      } else {
       double vabsolute;
       double fratio;
       for(set= smabuffer.scanskip; 
-	  set < smabuffer.scanskip+smabuffer.scanproc+1; set++){
+	  set < smabuffer.scanskip+smabuffer.scanproc; set++){
 	// calculate doppler velocity from chunk 1; 
 	// the rest chunk give the same value.
         // absolute velocity is based on form (2-229)
@@ -1863,16 +1848,16 @@ dat2003:
         spn[set]->veldop = spn[set]->veldop + smabuffer.vsource;
         spn[set]->smaveldop = vabsolute - spn[set]->vel[12]+ 
                  smabuffer.vsource;
-// printf("%d veldop=%f %f\n", set, spn[set]->veldop,spn[set]->vel[12]);
+// fprintf(stderr,"%d veldop=%f %f\n", set, spn[set]->veldop,spn[set]->vel[12]);
       }
-    printf("Decoded the Doppler velocity\n");
+    fprintf(stderr,"Decoded the Doppler velocity\n");
     }                   
 // rewind the data file
     rewind(fpin[5]);
 // start from the inhset = smabuffer.scanskip 
     inhset = smabuffer.scanskip;
     numberBaselines=  uvwbsln[inhset]->n_bls,
-    printf("here we are!\n");
+    fprintf(stderr,"here we are!\n");
 //
 // parsing to handle spectral chunk data assuming
 // 24 spectral chunks handled online regardless
@@ -1899,11 +1884,11 @@ dat2003:
     for (i=1; i< sourceID+1; i++) {
       if(multisour[i].sour_id==0) 
         strcpy(multisour[i].name, "skipped!");
-      printf("source: %-21s id=%2d RA=%13s ", 
+      fprintf(stderr,"source: %-21s id=%2d RA=%13s ", 
 	     multisour[i].name,
 	     multisour[i].sour_id, 
 	     (char *)rar2c(multisour[i].ra));
-      printf("DEC=%13s\n", (char *)decr2c(multisour[i].dec));
+      fprintf(stderr,"DEC=%13s\n", (char *)decr2c(multisour[i].dec));
     if(multisour[i].sour_id>max_sourid) max_sourid=multisour[i].sour_id;
     }
 
@@ -1997,15 +1982,16 @@ dat2003:
 // print the side band to be processed
     switch(smabuffer.sb) {
     case 0:
-      printf("LSB only\n");
+      fprintf(stderr,"LSB only\n");
       break;
     case 1:
-      printf("USB only\n");
+      fprintf(stderr,"USB only\n");
     }
 // initializing the number vis points to be read    
     smabuffer.nused=0;
     free(cdh);
     free(sph);
+    sph = NULL; /* freed again before the first integration is read */
     rewind(fpin[3]);
     rewind(fpin[2]);
     rewind(fpin[5]);
@@ -2013,9 +1999,9 @@ dat2003:
     for (set=0; set<nsets[0];set++) {
       sch[set] = (struct sch_def *)malloc(sizeof(struct sch_def ));
       if (sch[set] == NULL ){
-	printf("ERROR: Memory allocation for sch failed for %d bytes\n",
-	       nsets[0]*sizeof(struct sch_def));
-	exit(-1);
+	fprintf(stderr,"ERROR: Memory allocation for sch failed for %lu bytes\n",
+	       (unsigned long)(nsets[0]*sizeof(struct sch_def)));
+	sma_abort();
       }
     }
     
@@ -2045,22 +2031,20 @@ dat2003:
 //                          # of spectral windows,
 //                          # of sidebands,
 //                          # of receivers to be processed 
- printf("#Baselines=%d #Spectra=%d  #Sidebands=%d #Receivers=%d\n",
+ fprintf(stderr,"#Baselines=%d #Spectra=%d  #Sidebands=%d #Receivers=%d\n",
 	   numberBaselines/2, numberSpectra-1, numberSidebands, 
 	   numberRxif);
     
-    if(smabuffer.dobary==1) printf("Compute radial velocity wrt barycenter\n");
-    if(smabuffer.dolsr==1) printf("Compute radial velocity wrt LSR\n");
+    if(smabuffer.dobary==1) fprintf(stderr,"Compute radial velocity wrt barycenter\n");
+    if(smabuffer.dolsr==1) fprintf(stderr,"Compute radial velocity wrt LSR\n");
     sphSizeBuffer = numberSpectra*numberBaselines; 
 //sphSizeBuffer: a number of total spectral sets for usb and lsb together 
 //               in each of the integration sets
-    firstsp = sphset;
-    firstbsl= blhset;
-    printf("start to read vis data!!!\n");
+    fprintf(stderr,"start to read vis data!!!\n");
 // initialize the vis point handle
     ipnt=1;
 // assign the start integration set to be processed
-  if(smabuffer.scanskip!=0) inhset=smabuffer.scanskip-1;
+  inhset=smabuffer.scanskip-1;
   if(smabuffer.scanproc!=0&&(nsets[0]>(smabuffer.scanskip+smabuffer.scanproc)))
      nsets[0]=smabuffer.scanskip+smabuffer.scanproc;
 // start the processing loop
@@ -2095,13 +2079,13 @@ dat2003:
 // LST= (double) inh[inhset]->ha*DPI/12.0 + smabuffer.obsra;
 //  delLST=(smabuffer.lst-LST)*12.0/DPI*3600;
 // in unit of hr in mir format; in unit of radian in miriad format 
-// printf("%d lst engLst %f %f delLST=%f obsra=%f %f\n", 
+// fprintf(stderr,"%d lst engLst %f %f delLST=%f obsra=%f %f\n", 
 // inhset, smabuffer.lst, LST, delLST, smabuffer.obsra, smabuffer.ra);
 //  for (i=0; i<smabuffer.nants; i++) {
 //       smabuffer.el[i] = smaEngdata[inhset]->el[i+1];
 //       smabuffer.az[i] = smaEngdata[inhset]->az[i+1];
 //       smabuffer.tsys[i] = smaEngdata[inhset]->tsys[i+1];
-// printf("%d %f %f --- %f %f\n",i, smabuffer.el[i], inh[inhset]->el,
+// fprintf(stderr,"%d %f %f --- %f %f\n",i, smabuffer.el[i], inh[inhset]->el,
 //                              smabuffer.az[i], inh[inhset]->az);     
 //                                    }
 //}
@@ -2131,7 +2115,8 @@ dat2003:
         (strncmp(multisour[sourceID].name,unknown,7)!=0))||
           smabuffer.noskip==1) {
 	char sour[9];
-	strncpy(sour, multisour[sourceID].name, 9);
+	strncpy(sour, multisour[sourceID].name, 8);
+	sour[8]='\0';
 // uvputvra_c(tno,"source",multisour[sourceID].name);
         uvputvra_c(tno,"source", sour);
 	uvputvrd_c(tno,"ra",&(smabuffer.ra),1);
@@ -2183,7 +2168,6 @@ smabuffer.veldop = (float)velrad(dolsr,time, raapp,decapp,raepo,decepo,lst,lat);
     for(i=1;i<SMIF+1;i++) {
         miriadsp[i]=0;
                       }
-        i0=0;
         for(i=1;i<SMIF+1;i++) {
         if (spn[inhset]->nch[i][rxlod]!=0) {
 // miriadsp: an integer array; if the chunk i
@@ -2286,15 +2270,15 @@ smabuffer.veldop = (float)velrad(dolsr,time, raapp,decapp,raepo,decepo,lst,lat);
 // when only one skipping gap occured
 //
    if(spcode[i]!=spn[inhset]->iband[i]) {
- printf("\n");
+ fprintf(stderr,"\n");
    if(smabuffer.spskip[0]==0) {
- printf("Spotted skipping in spectral chunks starting at spcode=%d iband=%d\n", spcode[i], spn[inhset]->iband[i]);
- printf("Try smalod with keyword spskip=%d,%d again.\n",
+ fprintf(stderr,"Spotted skipping in spectral chunks starting at spcode=%d iband=%d\n", spcode[i], spn[inhset]->iband[i]);
+ fprintf(stderr,"Try smalod with keyword spskip=%d,%d again.\n",
     spn[inhset]->iband[i], spcode[i]-spn[inhset]->iband[i]);
        } else {
- printf("The skipping parameter spskip =%d,%d is inconsistent with\n",
+ fprintf(stderr,"The skipping parameter spskip =%d,%d is inconsistent with\n",
            spcode[i], spn[inhset]->iband[i]);
- printf("the spectral chunks skipped in the MIR data!\n");
+ fprintf(stderr,"the spectral chunks skipped in the MIR data!\n");
         }
    bug_c( 'f', "spcode must match with iband!\n");
       }
@@ -2373,9 +2357,9 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
     for (set=0; set < sphSizeBuffer; set++) {
     sph[set] = (struct sph_def *)malloc(sizeof(struct sph_def ));
     if (sph[set] == NULL ){
-      printf("ERROR: Memory allocation for sph failed for %d bytes\n",
-      sphSizeBuffer*sizeof(struct sph_def));
-      exit(-1);
+      fprintf(stderr,"ERROR: Memory allocation for sph failed for %lu bytes\n",
+      (unsigned long)(sphSizeBuffer*sizeof(struct sph_def)));
+      sma_abort();
 	      }
 	    }
     for (set=0; set< sphSizeBuffer; set++) {
@@ -2420,7 +2404,7 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
 // Move to this position in the file and read the data by
 // skipping the first a few integration 
 	  if(j<1) fseek(fpin[5],bytepos,SEEK_SET);
-	  nbytes = sch_data_read(fpin[5],datalength,shortdata);
+	  sch_data_read(fpin[5],datalength,shortdata);
 	  if (SWAP_ENDIAN) {
 	    shortdata=swap_sch_data(shortdata, datalength);
 	  }
@@ -2482,7 +2466,7 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
                    }
 	    /* smabuffer.pnt[ifpnt][polpnt][blpnt][0] = ipnt;*/
 	    smabuffer.pnt[ifpnt][polpnt][blpnt][sbpnt][rxpnt] = ipnt;
-//         printf("kk spcode ifpnt smabuffer.pnt %d %d %d %d\n",kk,spcode[kk],
+//         fprintf(stderr,"kk spcode ifpnt smabuffer.pnt %d %d %d %d\n",kk,spcode[kk],
 //            ifpnt,smabuffer.pnt[ifpnt][polpnt][blpnt][sbpnt][rxpnt]);
             if(wts[inhset]->wt[ifpnt][polpnt][blpnt][sbpnt][rxpnt] < 0.)
             smabuffer.flag[ifpnt][polpnt][blpnt][sbpnt][rxpnt] = 0;
@@ -2491,7 +2475,7 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
 
     if(smabuffer.highrspectra==1&&miriadsp[kk]==0) goto chunkskip;
     shortdata = (short int* )malloc(datalength*sizeof(short int));
-          nbytes = sch_data_read(fpin[5],datalength,shortdata);
+          sch_data_read(fpin[5],datalength,shortdata);
           if (SWAP_ENDIAN) {
             shortdata=swap_sch_data(shortdata, datalength);
           }
@@ -2507,10 +2491,10 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
 	    for(i=0;i<sph[kk]->nch;i++){
 	      if (smabuffer.rsnchan> 0) {
               if(sph[kk]->nch < smabuffer.rsnchan) {
- printf("Error: rsnchan=%d is greater than %d, the number of channels in a chunk,\n",
+ fprintf(stderr,"Error: rsnchan=%d is greater than %d, the number of channels in a chunk,\n",
             smabuffer.rsnchan, sph[kk]->nch);
-            printf("       redo it with a smaller rsnchan.\n");
-            exit(-1);
+            fprintf(stderr,"       redo it with a smaller rsnchan.\n");
+            sma_abort();
                                                     }
 // average the channel to the desired resolution 
   avereal = avereal+(float)pow(2.,(double)scale)*shortdata[5+2*i];
@@ -2544,7 +2528,6 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
                                                    }
 	    sphset++;  /* count for each spectral chunk */
 	  }
-	    firstsp = sphset;
         }
       }
       readSet++;
@@ -2553,7 +2536,7 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
       ipnt=1;
       if(flush==1) {
       if (fmod((readSet-1), 100.)<0.5||(readSet-1)==1)
-  printf("set=%4d ints=%4d inhid=%4d time(JulianDay)=%9.5f int=% 4.1f \n",
+  fprintf(stderr,"set=%4d ints=%4d inhid=%4d time(JulianDay)=%9.5f int=% 4.1f \n",
 		 readSet-1,
 		 visSMAscan.blockID.ints,
 		 visSMAscan.blockID.inhid,
@@ -2564,7 +2547,7 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
 	*kst = (char *)&kstat;
         if(smabuffer.noskip!=1) {
         if(strncmp(multisour[sourceID].name,skipped,8)==0)
- printf("Warnning: one scan is skipped at %9.5f due to insufficient source information.\n",visSMAscan.time.UTCtime);
+ fprintf(stderr,"Warnning: one scan is skipped at %9.5f due to insufficient source information.\n",visSMAscan.time.UTCtime);
         if(strncmp(multisour[sourceID].name,skipped,8)!=0) {
         if((strncmp(multisour[sourceID].name,target,6)!=0)&&
            (strncmp(multisour[sourceID].name,unknown,7)!=0)) {
@@ -2578,42 +2561,42 @@ smabuffer.w[blpnt] = uvwbsln[inhset]->uvwID[j].w/smabuffer.basefreq*1000.;
                       }
       }
     }
-    printf("set=%4d ints=%4d inhid=%4d time(JulianDay)=%9.5f int=% 4.1f \n",
+    fprintf(stderr,"set=%4d ints=%4d inhid=%4d time(JulianDay)=%9.5f int=% 4.1f \n",
 	   readSet-1, 
 	   visSMAscan.blockID.ints,
 	   visSMAscan.blockID.inhid,
 	   visSMAscan.time.UTCtime,
 	   visSMAscan.time.intTime);
-    printf("skipped %d integration scans on `target&unknown'\n",ntarget);
+    fprintf(stderr,"skipped %d integration scans on `target&unknown'\n",ntarget);
 
     avenchan=smabuffer.rsnchan;
          for (i=0; i<ireset+1; i++) {
              if(i>0) smabuffer.scanskip = reset_id[i];
     if (smabuffer.rsnchan>0) {
 int nnpadding;
-      printf("converted vis spectra from the original correlator configuration\n");
-      printf("to low and uniform resolution spectra:\n");
-      printf("(starting at integrations=%d)\n", smabuffer.scanskip);
-      printf("         input     output\n");
+      fprintf(stderr,"converted vis spectra from the original correlator configuration\n");
+      fprintf(stderr,"to low and uniform resolution spectra:\n");
+      fprintf(stderr,"(starting at integrations=%d)\n", smabuffer.scanskip);
+      fprintf(stderr,"         input     output\n");
       for (kk=1; kk<numberSpectra; kk++) {
  if(smabuffer.highrspectra==1&&spn[smabuffer.scanskip]->nch[kk][rxlod]==0)
 {
        nnpadding = 1-avenchan;
-printf("warning: each of the empty chunks is padded with one flagged channel.\n");
+fprintf(stderr,"warning: each of the empty chunks is padded with one flagged channel.\n");
 
 } else {
        nnpadding = 0;
 }
 
         if(smabuffer.spskip[0]==0) {
-	printf("  s%02d     %4d  =>  s%02d %4d\n",kk, 
+	fprintf(stderr,"  s%02d     %4d  =>  s%02d %4d\n",kk, 
         spn[smabuffer.scanskip]->nch[kk][rxlod], kk, avenchan+nnpadding);
           } else {
         if(kk < smabuffer.spskip[0]) {
-        printf("  s%02d     %4d  =>  s%02d %4d\n",kk,
+        fprintf(stderr,"  s%02d     %4d  =>  s%02d %4d\n",kk,
         spn[smabuffer.scanskip]->nch[kk][rxlod], kk, avenchan+nnpadding);
           } else {
-        printf("  s%02d     %4d  =>  s%02d %4d\n",kk+smabuffer.spskip[1],
+        fprintf(stderr,"  s%02d     %4d  =>  s%02d %4d\n",kk+smabuffer.spskip[1],
         spn[smabuffer.scanskip]->nch[kk][rxlod], kk, avenchan+nnpadding);
            }
            }
@@ -2621,30 +2604,30 @@ printf("warning: each of the empty chunks is padded with one flagged channel.\n"
       }
     } else {
 int npadding=0;
-      printf("vis spectra from the original correlator configuration: \n");
-      printf("(starting at integrations=%d)\n", smabuffer.scanskip);
-      printf("         input     output\n");
+      fprintf(stderr,"vis spectra from the original correlator configuration: \n");
+      fprintf(stderr,"(starting at integrations=%d)\n", smabuffer.scanskip);
+      fprintf(stderr,"         input     output\n");
       for (kk=1; kk<numberSpectra; kk++) {
  if(smabuffer.highrspectra==1&&spn[smabuffer.scanskip]->nch[kk][rxlod]==0)
 { 
        npadding = 1; 
-printf("warning: each of the empty chunks is padded with one flagged channel.\n")
+fprintf(stderr,"warning: each of the empty chunks is padded with one flagged channel.\n")
 ;
 
 } else { 
        npadding = 0;
 }   
        if(smabuffer.spskip[0]==0) {
-        printf("  s%02d     %4d  =>  s%02d %4d\n",kk, 
+        fprintf(stderr,"  s%02d     %4d  =>  s%02d %4d\n",kk, 
         spn[smabuffer.scanskip]->nch[kk][rxlod], kk, 
         spn[smabuffer.scanskip]->nch[kk][rxlod]+npadding);
          } else {
         if(kk < smabuffer.spskip[0]) {
-        printf("  s%02d     %4d  =>  s%02d %4d\n",kk,
+        fprintf(stderr,"  s%02d     %4d  =>  s%02d %4d\n",kk,
         spn[smabuffer.scanskip]->nch[kk][rxlod], kk,
         spn[smabuffer.scanskip]->nch[kk][rxlod]+npadding); 
         } else {
-        printf("  s%02d     %4d  =>  s%02d %4d\n",
+        fprintf(stderr,"  s%02d     %4d  =>  s%02d %4d\n",
         kk+smabuffer.spskip[1],
         spn[smabuffer.scanskip]->nch[kk][rxlod], kk,
         spn[smabuffer.scanskip]->nch[kk][rxlod]+npadding);
@@ -2655,14 +2638,15 @@ printf("warning: each of the empty chunks is padded with one flagged channel.\n"
      }
     if(smabuffer.spskip[0]!=-2003) {
     if(smabuffer.spskip[0]!=0&&smabuffer.spskip[0]!=-1)
-     printf("The MIR s%02d - s%02d contain no data and are skipped!\n",
+     fprintf(stderr,"The MIR s%02d - s%02d contain no data and are skipped!\n",
         smabuffer.spskip[0],
         smabuffer.spskip[0]+smabuffer.spskip[1]-1);}
      else {
-     printf("The MIR s%d contains incompleted-correlator data!\n",
+     fprintf(stderr,"The MIR s%d contains incompleted-correlator data!\n",
        -smabuffer.spskip[0]);
           } 
-    printf("Done with data conversion from mir to miriad!\n");
+    fprintf(stderr,"Done with data conversion from mir to miriad!\n");
+    sma_close();
   }
   /* ---------------------------------------------------------------------- */
   endTime = time(NULL);
@@ -2682,7 +2666,7 @@ struct inh_def *inh_read(FILE * fpinh)
   int nbytes;   /* counts number of bytes written */
   int nobj;     /* the number of objects written by each write */
   
-  struct inh_def inh;
+  static struct inh_def inh; /* returned, so it must outlive the call */
   struct inh_def *inhptr;
  
   nbytes = 0;
@@ -2692,8 +2676,8 @@ struct inh_def *inh_read(FILE * fpinh)
   
   nobj += fread(&inh.conid,sizeof(inh.conid),1,fpinh);
   if (nobj == 0) {
-    printf("Unexpected end of file in_read\n");
-    exit(-1);
+    fprintf(stderr,"Unexpected end of file in_read\n");
+    sma_abort();
   }
   nbytes += sizeof(inh.conid);
   nobj += fread(&inh.icocd,sizeof(inh.icocd),1,fpinh);
@@ -2769,7 +2753,7 @@ struct blh_def *blh_read(FILE * fpblh)
 {
   int nbytes;   /* counts number of bytes written */
   int nobj;     /* the number of objects written by each write */
-  struct blh_def blh;
+  static struct blh_def blh;
   struct blh_def *blhptr;
  
   nbytes = 0;
@@ -2778,8 +2762,8 @@ struct blh_def *blh_read(FILE * fpblh)
  
   nobj += fread(&blh.blhid,sizeof(blh.blhid),1,fpblh);
   if (nobj == 0) {
-    printf("Unexpected end of file bl_read\n");
-    exit(-1);
+    fprintf(stderr,"Unexpected end of file bl_read\n");
+    sma_abort();
   }
   nbytes += sizeof(blh.blhid);
   nobj += fread(&blh.inhid,sizeof(blh.inhid),1,fpblh);
@@ -2865,8 +2849,8 @@ unsigned long mfsize(FILE *fp)
   fsize = 0;
   
   if (fp==NULL) {
-    printf("null pointer\n");
-    return (unsigned)NULL;
+    fprintf(stderr,"null pointer\n");
+    return 0;
   }
 
   /* fseek() doesn't signal EOF so i use fread() to detect the end of file */
@@ -2908,15 +2892,15 @@ struct sph_def *sph_read(FILE * fpsph)
   int nbytes;   /* counts number of bytes written */
   int nobj;     /* the number of objects written by each write */
  
-  struct sph_def sph;
+  static struct sph_def sph;
   struct sph_def *sphptr; 
   nbytes = 0;
   nobj = 0;
  
   nobj += fread(&sph.sphid,sizeof(sph.sphid),1,fpsph);
   if (nobj == 0) {
-    printf("Unexpected end of file sp_read\n");
-    exit(-1);
+    fprintf(stderr,"Unexpected end of file sp_read\n");
+    sma_abort();
   }
   nbytes += sizeof(sph.sphid);
   nobj += fread(&sph.blhid,sizeof(sph.blhid),1,fpsph);
@@ -2986,15 +2970,15 @@ struct codeh_def * cdh_read (FILE * fpcodeh)
   int nbytes;   /* counts number of bytes written */
   int nobj;     /* the number of objects written by each write */
  
-  struct codeh_def codeh;
+  static struct codeh_def codeh;
   struct codeh_def *codehptr;
   nbytes = 0;
   nobj = 0;
 
   nobj += fread(codeh.v_name,sizeof(codeh.v_name),1,fpcodeh);
   if (nobj == 0) {
-    printf("Unexpected end of file cdh_read\n");
-    exit(-1);
+    fprintf(stderr,"Unexpected end of file cdh_read\n");
+    sma_abort();
   }
   nbytes += sizeof(codeh.v_name);
   nobj += fread(&codeh.icode,sizeof(codeh.icode),1,fpcodeh);
@@ -3014,15 +2998,15 @@ struct ant_def * enh_read(FILE * fpeng)
   int nbytes;   /* counts number of bytes written */
   int nobj;     /* the number of objects written by each write */
 
-  struct ant_def ant;
+  static struct ant_def ant;
   struct ant_def *antptr; 
   nbytes = 0;
   nobj = 0;
  
   nobj += fread(&ant.antennaNumber,sizeof(ant.antennaNumber),1,fpeng);
   if (nobj == 0) {
-    printf("Unexpected end of file enh_read\n");
-    exit(-1);
+    fprintf(stderr,"Unexpected end of file enh_read\n");
+    sma_abort();
   }
   nbytes += sizeof(ant.antennaNumber);
   nobj += fread(&ant.padNumber,sizeof(ant.padNumber),1,fpeng);
@@ -3086,15 +3070,15 @@ struct sch_def * sch_head_read(FILE * fpsch)
   int nbytes;   /* counts number of bytes written */
   int nobj;     /* the number of objects written by each write */
 
-  struct sch_def sch;
+  static struct sch_def sch;
   struct sch_def *schptr; 
   nbytes = 0;
   nobj = 0;
  
   nobj += fread(&sch.inhid,sizeof(sch.inhid),1,fpsch);
   if (nobj == 0) {
-    printf("Unexpected end of file sch_head_read\n");
-    exit(-1);
+    fprintf(stderr,"Unexpected end of file sch_head_read\n");
+    sma_abort();
   }
   nbytes += sizeof(sch.inhid);
   nobj += fread(sch.form,sizeof(sch.form),1,fpsch);
@@ -3118,10 +3102,10 @@ int sch_data_read(FILE * fpsch, long int datalength, short int * data)
   nobj = 0;
   nobj += fread(data,datalength*sizeof(short int),1,fpsch);
   if (nobj == 0) {
-    printf("The current scan (set=% 4d) is being read.\n",
+    fprintf(stderr,"The current scan (set=% 4d) is being read.\n",
 	   smabuffer.currentscan); 
     bug_c('f',"Unexpected end of file shc_data_read. Using nscans\n to select a scan range and run smalod again.\n"); 
-    exit(-1);
+    sma_abort();
   }
   return nbytes;
   
@@ -3129,22 +3113,21 @@ int sch_data_read(FILE * fpsch, long int datalength, short int * data)
 
 char *rar2c(double ra)
 { 
-  static char rac[13];
+  static char rac[32];
   int hh, mm;
   float ss;
   hh = (int) (12.0/DPI*ra);
   mm = (int) ((12.0/DPI*ra-hh)*60.0);
   ss = (float) (((12.0/DPI*ra-hh)*60.0-mm)*60.0);
-  sprintf(rac,"%02d:%02d:%07.4f", hh,mm,ss);
-  rac[13]='\0';
-  /*    printf("ra=%s\n", rac);
+  snprintf(rac,sizeof(rac),"%02d:%02d:%07.4f", hh,mm,ss);
+  /*    fprintf(stderr,"ra=%s\n", rac);
    */
   return &rac[0];      
 }
 
 char *decr2c(double dec)
 {
-  static char decc[15];
+  static char decc[32];
   int dd, am;
   float as;
   dd = (int)(180./DPI*dec);
@@ -3152,8 +3135,7 @@ char *decr2c(double dec)
   as = (float)(((180./DPI*dec-dd)*60.0-am))*60.0;
   am = (int)fabs(am);
   as = (float)fabs(as);
-  sprintf(decc,"% 3d:%02d:%07.4f", dd,am,as);
-  decc[15]='\0';
+  snprintf(decc,sizeof(decc),"% 3d:%02d:%07.4f", dd,am,as);
   return &decc[0];
 }
  
@@ -3161,9 +3143,9 @@ int spdecode (struct codeh_def *specCode[])
 { 
   int spid;
   char  cspid[13];
-  char  prefix[1];
-  cspid[13]='\0';
+  char  prefix[2];
   memcpy(cspid, specCode[0]->code, 12);
+  cspid[12]='\0';
   sscanf(cspid, "%1s%d", prefix, &spid);
   return spid;
 }
@@ -3176,32 +3158,32 @@ float juliandate (struct codeh_def *refdate[])
   char  ccaldate[13];
   static char *months[] = {"ill", "Jan","Feb","Mar","Apr","May","Jun","Jul", 
           "Aug","Sep","Oct","Nov","Dec"};
-  char yc[4];
-  char mc[3];
+  char yc[13];
+  char mc[13];
   int yi,mi,di;
 
-  ccaldate[13]='\0';
   memcpy(ccaldate,refdate[0]->code, 12);
-  sscanf(ccaldate, "%s%d%s%d", mc, &di,yc,&yi);
-//  printf("Observing Date: %d %s %d\n", yi, mc, di);
+  ccaldate[12]='\0';
+  sscanf(ccaldate, "%12s%d%12s%d", mc, &di,yc,&yi);
+//  fprintf(stderr,"Observing Date: %d %s %d\n", yi, mc, di);
   mi=0;
   for (i=1; i<13; i++){
     if (memcmp(mc,months[i], 3)==0) mi=i;
   }
   jdate = slaCldj (yi, mi, di, stat)+2400000.5;
   if(stat==1) {
-     printf("bad year   (MJD not computed).");
-     exit(-1);
+     fprintf(stderr,"bad year   (MJD not computed).");
+     sma_abort();
               }
   if(stat==2) {
-     printf("bad month   (MJD not computed).");
-     exit(-1);
+     fprintf(stderr,"bad month   (MJD not computed).");
+     sma_abort();
               }
   if(stat==3) {
-     printf("bad day   (MJD not computed).");
-     exit(-1);
+     fprintf(stderr,"bad day   (MJD not computed).");
+     sma_abort();
               }
- printf("Observing Date: %d %s %d    Julian Date: %f\n", yi, mc, di, jdate);
+ fprintf(stderr,"Observing Date: %d %s %d    Julian Date: %f\n", yi, mc, di, jdate);
 
   return jdate;
 }
@@ -3340,7 +3322,7 @@ void nutate(double jday,double rmean,double dmean,double *rtrueptr,double *dtrue
   dtrue = dmean + sineps*cosra*dpsi + sinra*deps;
   *rtrueptr = rtrue;
   *dtrueptr = dtrue;
-  /*   printf("nutate: r1 d1 %f %f\n", rtrue, dtrue);
+  /*   fprintf(stderr,"nutate: r1 d1 %f %f\n", rtrue, dtrue);
    */
 }
 
@@ -3574,15 +3556,15 @@ double velrad( short dolsr,
   double  vel;
   
   // computer barycentric velocity
-  //      printf("velrad:\n");
-  //      printf("dolsri %d \n", dolsr);
-  //      printf("time %f \n", time);
-  //      printf("raapp %f \n", raapp);
-  //      printf("decapp %f \n", decapp);
-  //      printf("raapp %f \n", raepo);
-  //      printf("decapp %f \n", decepo);
-  //      printf("lst %f \n", lst);
-  //      printf("lat %f \n", lat);
+  //      fprintf(stderr,"velrad:\n");
+  //      fprintf(stderr,"dolsri %d \n", dolsr);
+  //      fprintf(stderr,"time %f \n", time);
+  //      fprintf(stderr,"raapp %f \n", raapp);
+  //      fprintf(stderr,"decapp %f \n", decapp);
+  //      fprintf(stderr,"raapp %f \n", raepo);
+  //      fprintf(stderr,"decapp %f \n", decepo);
+  //      fprintf(stderr,"lst %f \n", lst);
+  //      fprintf(stderr,"lat %f \n", lat);
   
   inlmn = sph2lmn(raapp,decapp);
   lmnapp[0] = inlmn->lmn1;
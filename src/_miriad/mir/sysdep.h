@@ -122,6 +122,27 @@ typedef long long int int8;
 #  define HAS_STRERROR
 #endif
 
+/* Different data sets may be used from different threads. Tables shared
+   by all data sets are locked (see hio.c), and static scratch space that
+   is only used within one call is made THREADLOCAL. */
+
+#define HAS_PTHREADS
+#if defined(__GNUC__)
+#  define THREADLOCAL __thread
+#endif
+
+
+#ifndef THREADLOCAL
+#  define THREADLOCAL
+#endif
+
+/* SSE2 versions of the packing, flag and scaling loops are used where the
+   compiler targets SSE2, unless MIR_NOSIMD is defined (to build and time
+   the plain C loops). */
+
+#if defined(__SSE2__) && !defined(MIR_NOSIMD)
+#  define MIR_SSE2
+#endif
 
 /*  Short cut routines when no conversion is necessary. These are
     used for any IEEE floating point machine with FITS ordered bytes.	
@@ -267,6 +267,9 @@
 #include <ctype.h>
 #include "io.h"
 #include "miriad.h"
+#if defined(MIR_SSE2)
+#include <emmintrin.h>
+#endif
 
 #define UVF_COPY	0x01	/* Set if this variable is to be copied by
 				   the uvcopy routine. */
@@ -306,6 +309,8 @@
 #define MK_FLAGS	1
 #define MK_RUNS		2
 
+#define UV_WBLOCK	(1<<20)	/* Bytes uvwriteblk stages per hwriteb. */
+
 /*----------------------------------------------------------------------*/
 /*									*/
 /*	A few definitions to coax lint to like my code.			*/
@@ -352,19 +357,21 @@
 
 #define MYABS(x) ( (x) > 0 ? (x) : -(x) )
 
+/* uvsnap saves only the length of the correlation data, not its values. */
+#define UVSNAP_LENONLY(var) (!strcmp((var)->name,"corr") ||		\
+			     !strcmp((var)->name,"wcorr"))
+
 /*----------------------------------------------------------------------*/
 /*									*/
 /*	Types and static variables.					*/
 /*									*/
 /*----------------------------------------------------------------------*/
 
-static char message[MAXLINE];
+static THREADLOCAL char message[MAXLINE];
 static int internal_size[10];
 static int external_size[10];
 static char type_flag[10];
 
-static char var_data_hdr[UV_HDR_SIZE]={0,0,VAR_DATA,0};
-static char var_size_hdr[UV_HDR_SIZE]={0,0,VAR_SIZE,0};
 static char var_eor_hdr[UV_HDR_SIZE]={0,0,VAR_EOR,0};
 
 
@@ -490,6 +497,9 @@ typedef struct {
 	SIGMA2 sigma2;
 	UVW *uvw;
 	WINDOW *win;
+	char *wbuf;
+	off_t woffset;
+	int wlength,wsize,wstage;
 } UV;
 
 #define MAXVHANDS 128
@@ -499,6 +509,13 @@ static VARHAND *varhands[MAXVHANDS];
 static WINDOW truewin;
 static AMP noamp;
 static int first=TRUE;
+#ifdef HAS_PTHREADS
+#include <pthread.h>
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+#define UV_INIT pthread_once(&init_once,uv_init)
+#else
+#define UV_INIT if(first)uv_init()
+#endif
 
 /* void uvputvr_c(); */
 private void uvinfo_chan(),uvinfo_variance(),uvbasant_c();
@@ -515,6 +532,12 @@ private UV *uv_getuv();
 private VARIABLE *uv_mkvar(),*uv_locvar(),*uv_checkvar();
 private int uv_scan(),uvread_line(),uvread_select(),uvread_maxvis();
 private int uvread_shadowed(),uvread_match();
+private void uv_int2float(Const int *in,float *out,int n,float scale);
+private void uv_float2int(Const float *in,int *out,int n,float scale);
+private float uv_maxabs(Const float *in,int n);
+private void uv_hwrite(UV *uv,int type,Const char *buf,off_t offset,int length,
+		       int *iostat);
+private void uv_wflush(UV *uv);
 private double uv_getskyfreq();
 
 /************************************************************************/
@@ -708,7 +731,7 @@ void uvopen_c(int *tno,Const char *name,Const char *status)
   int iostat;
   char line[MAXLINE];
 
-  if(first)uv_init();
+  UV_INIT;
 
 /*----------------------------------------------------------------------*/
 /*									*/
@@ -866,6 +889,11 @@ void uvflush_c(int tno)
 
   if(!(uv->flags & (UVF_NEW|UVF_APPEND)))return;
 
+/* Write out anything left staged by an interrupted uvwriteblk. */
+
+  uv_wflush(uv);
+  uv->wstage = FALSE;
+
 /* Flush the masks out. */
 
   if(uv->corr_flags.handle != NULL) mkflush_c(uv->corr_flags.handle);
@@ -979,6 +1007,7 @@ private void uv_freeuv(UV *uv)
   if(uv->sigma2.table != NULL)free((char *)uv->sigma2.table);
   uv_free_select(uv->select);
   if(uv->uvw != NULL) free((char *)(uv->uvw));
+  if(uv->wbuf != NULL) free(uv->wbuf);
   free((char *)uv);
 }
 /************************************************************************/
@@ -1068,6 +1097,11 @@ private UV *uv_getuv(int tno)
   uv->time = NULL;
   uv->bl = NULL;
 
+  uv->wbuf = NULL;
+  uv->woffset = 0;
+  uv->wlength = uv->wsize = 0;
+  uv->wstage = FALSE;
+
   for(i=0, v = uv->variable; i < MAXVAR; i++, v++){
     v->length = v->flength = 0;
     v->buf = NULL;
@@ -1265,7 +1299,7 @@ void uvnext_c(int tno)
 
   uv = uvs[tno];
   if(uv->flags & (UVF_NEW|UVF_APPEND)){
-    hwriteb_c(uv->item,var_eor_hdr,uv->offset,UV_HDR_SIZE,&iostat);
+    uv_hwrite(uv,H_BYTE,var_eor_hdr,uv->offset,UV_HDR_SIZE,&iostat);
     CHECK(iostat,(message,"Error writing end-of-record, in UVNEXT"));
     uv->offset += UV_ALIGN;
   } else {
@@ -1307,6 +1341,62 @@ void uvrewind_c(int tno)
   uv->wcorr_flags.offset = 0;
 }
 /************************************************************************/
+void uvtell_c(int tno,off_t *offset,off_t *flgoff,off_t *wflgoff)
+/**uvtell -- Return the current position in a uv data file.		*/
+/*&arp                                                                  */
+/*:uv-i/o								*/
+/*+
+  Return the offsets that describe where the next call to uvread or
+  uvscan will start. These can be handed back to uvseek to return to
+  this record later.
+
+  Input:
+    tno		The uv data file handle.
+  Output:
+    offset	Byte offset of the next record in the visdata item.
+    flgoff	Offset (in channels) of the next record's corr flags.
+    wflgoff	Offset (in channels) of the next record's wcorr flags.	*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  UV *uv;
+
+  uv = uvs[tno];
+  *offset  = uv->offset;
+  *flgoff  = uv->corr_flags.offset;
+  *wflgoff = uv->wcorr_flags.offset;
+}
+/************************************************************************/
+void uvseek_c(int tno,off_t offset,off_t flgoff,off_t wflgoff)
+/**uvseek -- Reposition a uv data file at a record boundary.		*/
+/*&arp                                                                  */
+/*:uv-i/o								*/
+/*+
+  Move the read position of a uv data file to a record previously
+  returned by uvtell. Variables which are not updated in the records
+  that follow keep whatever value they last had, so the caller should
+  use uvunsnap to restore them.
+
+  Input:
+    tno		The uv data file handle.
+    offset	Byte offset of a record in the visdata item.
+    flgoff	Offset (in channels) of that record's corr flags.
+    wflgoff	Offset (in channels) of that record's wcorr flags.	*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  UV *uv;
+
+  uv = uvs[tno];
+  if(uv->flags & (UVF_NEW|UVF_APPEND))
+    BUG('f',"Cannot seek in a uv file opened for writing, in UVSEEK");
+  if(offset < 0 || offset > uv->max_offset || offset % UV_ALIGN)
+    ERROR('f',(message,"Invalid record offset %ld, in UVSEEK",(long)offset));
+  uv->offset = offset;
+  uv->corr_flags.offset = flgoff;
+  uv->wcorr_flags.offset = wflgoff;
+}
+/************************************************************************/
 void uvcopyvr_c(int tin,int tout)
 /**uvcopyvr -- Copy variables from one uv file to another.		*/
 /*&rjs                                                                  */
@@ -1680,6 +1770,7 @@ void uvputvr_c(int tno,int type,Const char *var,Const char *data,int n)
   VARIABLE *v;
   int size,iostat,changed,length,i;
   char *in1,*in2;
+  char hdr[UV_HDR_SIZE];	/* Not static: files may be written in parallel */
 
   if(n <= 0){
     ERROR('w',(message,"Variable %s has zero or negative size, in UVPUTVR",var));
@@ -1697,10 +1788,10 @@ void uvputvr_c(int tno,int type,Const char *var,Const char *data,int n)
   if(v->length != size*n){
     changed = TRUE;
     v->length = size * n;
-    var_size_hdr[0] = v->index;
-    hwriteb_c(uv->item,var_size_hdr,uv->offset,UV_HDR_SIZE,&iostat);
+    hdr[0] = v->index; hdr[1] = 0; hdr[2] = VAR_SIZE; hdr[3] = 0;
+    uv_hwrite(uv,H_BYTE,hdr,uv->offset,UV_HDR_SIZE,&iostat);
     CHECK(iostat,(message,"Error writing variable-length header for %s, in UVPUTVR",var));
-    hwritei_c(uv->item,&v->length,uv->offset+UV_HDR_SIZE,H_INT_SIZE,&iostat);
+    uv_hwrite(uv,H_INT,(char *)&v->length,uv->offset+UV_HDR_SIZE,H_INT_SIZE,&iostat);
     CHECK(iostat,(message,"Error writing variable-length for %s, in UVPUTVR",var));
     uv->offset += UV_ALIGN;
     if( !(v->flags & UVF_NOCHECK) )
@@ -1724,11 +1815,11 @@ void uvputvr_c(int tno,int type,Const char *var,Const char *data,int n)
 /* Write out the data itself. */
 
   if( changed ) {
-    var_data_hdr[0] = v->index;
-    hwriteb_c(uv->item,var_data_hdr,uv->offset,UV_HDR_SIZE,&iostat);
+    hdr[0] = v->index; hdr[1] = 0; hdr[2] = VAR_DATA; hdr[3] = 0;
+    uv_hwrite(uv,H_BYTE,hdr,uv->offset,UV_HDR_SIZE,&iostat);
     CHECK(iostat,(message,"Error writing variable-value header for %s, in UVPUTVR",var));
     uv->offset += mroundup(UV_HDR_SIZE,size);
-    hwrite_c(uv->item,type,data,uv->offset,v->length,&iostat);
+    uv_hwrite(uv,type,data,uv->offset,v->length,&iostat);
     CHECK(iostat,(message,"Error writing variable-value for %s, in UVPUTVR",var));
     uv->offset = mroundup( uv->offset+v->length, UV_ALIGN);
     if(v->callno++ > CHECK_THRESH) {
@@ -1742,6 +1833,95 @@ void uvputvr_c(int tno,int type,Const char *var,Const char *data,int n)
   }
 }
 /************************************************************************/
+int uvsnap_c(int tno,char *buf,int size)
+/**uvsnap -- Save the current values of all uv variables.		*/
+/*&arp                                                                  */
+/*:uv-i/o								*/
+/*+
+  Copy the current values of the variables of a uv file being read into
+  a buffer, so that uvunsnap can later restore them (for example after
+  uvseek). Only the lengths of the correlation data ("corr" and "wcorr")
+  are saved, and variables overridden by an item are not saved at all.
+  Call with size=0 to find how big the buffer needs to be.
+
+  Input:
+    tno		The handle of the uv data file.
+    size	The size of buf, in bytes.
+  Output:
+    buf		The saved variable values (if size is big enough).
+    uvsnap_c	The number of bytes needed.				*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  UV *uv;
+  VARIABLE *v;
+  int i,n,length,nbytes;
+
+  uv = uvs[tno];
+  nbytes = sizeof(int);
+  if(size >= nbytes) memcpy(buf,&uv->nvar,sizeof(int));
+  for(i=0, v = uv->variable; i < uv->nvar; i++, v++){
+    length = v->length;
+    if(v->buf == NULL || (v->flags & UVF_OVERRIDE)) length = -1;
+    n = (length > 0 && !UVSNAP_LENONLY(v) ?
+	mroundup(length/external_size[v->type] * internal_size[v->type],
+		 sizeof(int)) : 0);
+    if(size >= nbytes + (int)sizeof(int) + n){
+      memcpy(buf+nbytes,&length,sizeof(int));
+      if(n > 0) memcpy(buf+nbytes+sizeof(int),v->buf,
+		   length/external_size[v->type]*internal_size[v->type]);
+    }
+    nbytes += sizeof(int) + n;
+  }
+  return(nbytes);
+}
+/************************************************************************/
+void uvunsnap_c(int tno,Const char *buf)
+/**uvunsnap -- Restore the values of uv variables saved by uvsnap.	*/
+/*&arp                                                                  */
+/*:uv-i/o								*/
+/*+
+  Restore the variable values saved by uvsnap on the same uv file. This
+  is used together with uvseek, so that a file can be read starting
+  from a record in the middle with the same variable values as if it
+  had been read from the beginning. Variables that did not yet exist when
+  the snapshot was made are given zero length.
+
+  Input:
+    tno		The handle of the uv data file.
+    buf		The buffer filled by uvsnap.				*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  UV *uv;
+  VARIABLE *v;
+  int i,n,nvar,length,nbytes;
+
+  uv = uvs[tno];
+  memcpy(&nvar,buf,sizeof(int));
+  if(nvar > uv->nvar)
+    BUG('f',"Snapshot does not match this file, in UVUNSNAP");
+  nbytes = sizeof(int);
+  for(i=0, v = uv->variable; i < uv->nvar; i++, v++){
+    if(i >= nvar){
+      if(!(v->flags & UVF_OVERRIDE)) v->length = v->flength = 0;
+      continue;
+    }
+    memcpy(&length,buf+nbytes,sizeof(int));
+    nbytes += sizeof(int);
+    if(length < 0) continue;
+    n = length/external_size[v->type]*internal_size[v->type];
+    v->length = v->flength = length;
+    if(n > 0) v->buf = Realloc(v->buf,n);
+    if(n > 0 && !UVSNAP_LENONLY(v)){
+      memcpy(v->buf,buf+nbytes,n);
+      nbytes += mroundup(n,sizeof(int));
+    }
+    uv->flags |= v->flags & (UVF_UPDATED_PLANET | UVF_UPDATED_SKYFREQ |
+			     UVF_UPDATED_UVW);
+  }
+}
+/************************************************************************/
 void uvtrack_c(int tno,Const char *name,Const char *switches)
 /**uvtrack -- Set flags and switches associated with a uv variable.	*/
 /*&rjs                                                                  */
@@ -1919,6 +2099,89 @@ private int uv_scan(UV *uv, VARIABLE *vt)
   return 0;
 }
 /************************************************************************/
+private void uv_int2float(Const int *in,float *out,int n,float scale)
+/*
+  Convert scaled integer correlation data (as unpacked from 'j' corr) to
+  floats: out = scale * in.
+------------------------------------------------------------------------*/
+{
+#if defined(MIR_SSE2)
+  __m128 s4 = _mm_set1_ps(scale);
+  for(; n >= 4; n -= 4, in += 4, out += 4)
+    _mm_storeu_ps(out,_mm_mul_ps(s4,
+	_mm_cvtepi32_ps(_mm_loadu_si128((__m128i *)in))));
+#endif
+  while(n-- > 0) *out++ = scale * *in++;
+}
+/************************************************************************/
+private void uv_float2int(Const float *in,int *out,int n,float scale)
+/*
+  Scale floats to integers (truncating) for 'j' corr: out = scale * in.
+------------------------------------------------------------------------*/
+{
+#if defined(MIR_SSE2)
+  __m128 s4 = _mm_set1_ps(scale);
+  for(; n >= 4; n -= 4, in += 4, out += 4)
+    _mm_storeu_si128((__m128i *)out,
+	_mm_cvttps_epi32(_mm_mul_ps(s4,_mm_loadu_ps(in))));
+#endif
+  while(n-- > 0) *out++ = scale * *in++;
+}
+/************************************************************************/
+private float uv_maxabs(Const float *in,int n)
+/*
+  Return the largest absolute value in an array (NaNs are ignored).
+------------------------------------------------------------------------*/
+{
+  float maxval,temp;
+  maxval = 0;
+#if defined(MIR_SSE2)
+  if(n >= 4){
+    float m[4];
+    __m128 m4 = _mm_setzero_ps();
+    __m128 sign = _mm_set1_ps(-0.0f);
+    for(; n >= 4; n -= 4, in += 4)
+      m4 = _mm_max_ps(_mm_andnot_ps(sign,_mm_loadu_ps(in)),m4);
+    _mm_storeu_ps(m,m4);
+    maxval = max(max(m[0],m[1]),max(m[2],m[3]));
+  }
+#endif
+  while(n-- > 0){
+    temp = *in++;
+    if(temp < 0)temp = -temp;
+    if(temp > maxval) maxval = temp;
+  }
+  return(maxval);
+}
+/************************************************************************/
+void uvjpack_c(Const float *in,char *out,int *work,int n,float *tscale)
+/*
+  Encode n floats as 'j' corr data, as uvwrite does: scale them to 16 bit
+  integers, packed in file (big-endian) order into the 2*n bytes of out,
+  and return the tscale that undoes the scaling. work is scratch space
+  for n integers. This is the per-record work of 'j' corr beyond the i/o,
+  exposed so that it can be timed on its own.
+------------------------------------------------------------------------*/
+{
+  float maxval,scale;
+
+  maxval = uv_maxabs(in,n);
+  if(maxval == 0) maxval = 1;
+  *tscale = maxval / 32767;
+  scale = 32767 / maxval;
+  uv_float2int(in,work,n,scale);
+  pack16_c(work,out,n);
+}
+/************************************************************************/
+void uvjunpack_c(Const char *in,float *out,int *work,int n,float tscale)
+/*
+  Decode n values of 'j' corr data packed by uvjpack, as uvread does.
+------------------------------------------------------------------------*/
+{
+  unpack16_c((char *)in,work,n);
+  uv_int2float(work,out,n,tscale);
+}
+/************************************************************************/
 void uvwrite_c(int tno,Const double *preamble,Const float *data,
 	       Const int *flags,int n)
 /**uvwrite -- Write correlation data to a uv file.			*/
@@ -1948,10 +2211,9 @@ void uvwrite_c(int tno,Const double *preamble,Const float *data,
 /*----------------------------------------------------------------------*/
 {
   UV *uv;
-  int i,nchan,i1,i2,nuvw,itemp;
-  float maxval,scale,*p,temp;
+  int nchan,i1,i2,nuvw,itemp;
+  float maxval,scale,temp;
   double *d,dtemp;
-  int *q;
   char *counter,*status;
   FLAGS *flags_info;
   VARIABLE *v;
@@ -2052,21 +2314,12 @@ void uvwrite_c(int tno,Const double *preamble,Const float *data,
   } else {
     if(v->length != 2*n*H_INT2_SIZE)
       v->buf = Realloc(v->buf,2*n*sizeof(int));
-    maxval = 0;
-    p = (float *)data;
-    for(i=0; i < 2*n; i++){
-      temp = *p++;
-      if(temp < 0)temp = -temp;
-      maxval = max(maxval,temp);
-    }
+    maxval = uv_maxabs(data,2*n);
     if(maxval == 0) maxval = 1;
     scale = maxval / 32767;
     uvputvrr_c(tno,"tscale",&scale,1);
     scale = 32767 / maxval;
-    p = (float *)data;
-    q = (int *)v->buf;
-    for(i=0; i < 2*n; i++) *q++ = scale * *p++;
-    q = (int *)v->buf;
+    uv_float2int(data,(int *)v->buf,2*n,scale);
     uvputvrj_c(tno,v->name,(int *)v->buf,2*n);
   }
 
@@ -2103,6 +2356,109 @@ void uvwrite_c(int tno,Const double *preamble,Const float *data,
   uvnext_c(tno);
 }
 /************************************************************************/
+void uvwriteblk_c(int tno,Const double *preamble,Const float *data,
+		  Const int *flags,int n,int nrec)
+/**uvwriteblk -- Write a block of correlation data records to a uv file.*/
+/*&arp                                                                  */
+/*:uv-i/o								*/
+/*+
+  Write nrec visibility records, each as uvwrite would. The encoded
+  records are staged in memory and written to the visibility stream in
+  a few large pieces, rather than a few bytes at a time. As in uvwrite,
+  the preamble variables are only written when they change. Flags must
+  be given one per channel (not as runs).
+  Input:
+    tno		Handle of the uv data set.
+    n		Number of channels in each record.
+    nrec	Number of records.
+    preamble	A double array of nrec preambles, each the size that
+		uvwrite expects (u,v,[w,]time,baseline).
+    data	A complex array of nrec*n elements.
+    flags	Logical array of nrec*n elements. A true value for
+		a channel indicates good data.				*/
+/*--									*/
+/*----------------------------------------------------------------------*/
+{
+  UV *uv;
+  int k,npre;
+
+  uv = uvs[tno];
+  if(uv->flags & UVF_RUNS)
+    BUG('f',"Flags given as runs are not supported, in UVWRITEBLK");
+  npre = (uv->flags & UVF_DOW ? 3 : 2) + 2;
+
+/* Stage the records, writing out whenever enough has built up. */
+
+  uv_wflush(uv);
+  uv->wstage = TRUE;
+  for(k=0; k < nrec; k++){
+    uvwrite_c(tno,preamble,data,flags,n);
+    preamble += npre;
+    data += 2*n;
+    flags += n;
+    if(uv->wlength >= UV_WBLOCK) uv_wflush(uv);
+  }
+  uv_wflush(uv);
+  uv->wstage = FALSE;
+}
+/************************************************************************/
+private void uv_hwrite(UV *uv,int type,Const char *buf,off_t offset,int length,
+		       int *iostat)
+/*
+  Write to the visibility stream, or to the uvwriteblk staging buffer
+  when a block is being staged. Staged data is kept in disk format, so
+  that uv_wflush can write it with a single hwriteb.
+------------------------------------------------------------------------*/
+{
+  int off,size;
+  char *s;
+
+  if(!uv->wstage){
+    hwrite_c(uv->item,type,buf,offset,length,iostat);
+    return;
+  }
+  *iostat = 0;
+  if(uv->wlength == 0) uv->woffset = offset;
+  off = offset - uv->woffset;
+  if(off + length > uv->wsize){
+    size = max(2*uv->wsize,max(off + length,UV_WBLOCK + 4096));
+    uv->wbuf = Realloc(uv->wbuf,size);
+    uv->wsize = size;
+  }
+
+/* Zero any alignment padding skipped since the last write. */
+
+  if(off > uv->wlength) memset(uv->wbuf+uv->wlength,0,off - uv->wlength);
+  s = uv->wbuf + off;
+  switch(type){
+    case H_BYTE:  memcpy(s,buf,length);				break;
+    case H_INT:   pack32_c((int *)buf,s,length/H_INT_SIZE);	break;
+    case H_INT2:  pack16_c((int2 *)buf,s,length/H_INT2_SIZE);	break;
+    case H_INT8:  pack64_c((int8 *)buf,s,length/H_INT8_SIZE);	break;
+    case H_REAL:  packr_c((float *)buf,s,length/H_REAL_SIZE);	break;
+    case H_DBLE:  packd_c((double *)buf,s,length/H_DBLE_SIZE);	break;
+    case H_CMPLX: packr_c((float *)buf,s,(2*length)/H_CMPLX_SIZE); break;
+    case H_TXT:   memcpy(s,buf,length);
+		  if(length > 0 && buf[length-1] == 0) s[length-1] = '\n';
+		  break;
+    default:	  ERROR('f',(message,"Unrecognised write type %d, in UVWRITEBLK",type));
+  }
+  uv->wlength = max(uv->wlength,off + length);
+}
+/************************************************************************/
+private void uv_wflush(UV *uv)
+/*
+  Write out whatever uvwriteblk has staged.
+------------------------------------------------------------------------*/
+{
+  int iostat;
+
+  if(uv->wlength == 0) return;
+  hwriteb_c(uv->item,uv->wbuf,uv->woffset,uv->wlength,&iostat);
+  CHECK(iostat,(message,"Error writing visibility data, in UVWRITEBLK"));
+  uv->wlength = 0;
+}
+/************************************************************************/
 void uvwwrite_c(int tno,Const float *data,Const int *flags,int n)
 /**uvwwrite -- Write wide-band correlation data to a uv file.		*/
 /*&rjs                                                                  */
@@ -2558,6 +2914,7 @@ void uvset_c(int tno,Const char *object,Const char *type,
 /*----------------------------------------------------------------------*/
 {
   UV *uv;
+  int iostat;
 
   uv = uvs[tno];
   uv->flags &= ~UVF_INIT;
@@ -2595,6 +2952,15 @@ void uvset_c(int tno,Const char *object,Const char *type,
       uv->corr = uv_mkvar(tno,"corr", H_INT2 );
     else
       ERROR('f',(message,"Unsupported correlation type %s, in UVSET",type));
+  } else if(!strcmp(object,"compress")) {
+    if(!(uv->flags & UVF_NEW) || uv->offset != 0)
+      BUG('f',"Compression must be set before writing a new file, in UVSET");
+    if(!strcmp(type,"lz")){
+      hcompress_c(uv->item,&iostat);
+      CHECK(iostat,(message,"Error compressing visdata, in UVSET"));
+    } else if(strcmp(type,"none")){
+      ERROR('f',(message,"Unsupported compression %s, in UVSET",type));
+    }
   } else {
     ERROR('w',(message,"Unrecognised object \"%s\" ignored, in UVSET.",object));
   }
@@ -4051,8 +4417,7 @@ private int uvread_line(UV *uv,LINE_INFO *line,float *data,
   if(width == 1 && ( step == 0 || n == 1)){
     if(v->type == H_INT2){
       scale *= *(float *)uv->tscale->buf;
-      di   = (int *)v->buf + 2*start;
-      for(i=0; i < 2*n; i++) *d++ = scale * *di++;
+      uv_int2float((int *)v->buf + 2*start,d,2*n,scale);
     } else {
       df   = (float *)v->buf + 2*start;
       if(scale != 1)for(i=0; i < 2*n; i++) *d++ = scale * *df++;
@@ -4060,6 +4425,26 @@ private int uvread_line(UV *uv,LINE_INFO *line,float *data,
     }
     memcpy((char *)flags,(char *)flagin,sizeof(int)*n);
 
+/* Handle every step'th channel without averaging. Like the straight copy
+   (and unlike a width of one in the averaging below), flagged data are
+   returned as they are. */
+
+  } else if(width == 1){
+    step += width;
+    if(v->type == H_INT2){
+      scale *= *(float *)uv->tscale->buf;
+      di = (int *)(v->buf) + 2*start;
+      for(i=0; i<n; i++, di += 2*step){
+	*d++ = scale * di[0]; *d++ = scale * di[1];
+      }
+    } else {
+      df = (float *)(v->buf) + 2*start;
+      for(i=0; i<n; i++, df += 2*step){
+	*d++ = scale * df[0]; *d++ = scale * df[1];
+      }
+    }
+    for(i=0; i<n; i++, flagin += step) *flags++ = *flagin;
+
 /* Handle the case of averaged, scaled integers. */
 
   } else if(v->type == H_INT2){
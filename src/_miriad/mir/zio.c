@@ -0,0 +1,720 @@
+/************************************************************************/
+/*									*/
+/*	A package of routines to store a data item as a sequence of	*/
+/*	independently compressed blocks. These sit underneath the	*/
+/*	hio buffering, in place of the dio read and write routines,	*/
+/*	so that compressed items look like ordinary items to the	*/
+/*	rest of MIRIAD.							*/
+/*									*/
+/*	The file starts with an 8 byte magic number, followed by the	*/
+/*	blocks. Each block has a 16 byte header (its uncompressed	*/
+/*	length, its stored length, the codec that packed it and the	*/
+/*	Adler-32 checksum of the stored bytes, as big-endian		*/
+/*	integers) and then its data. Every block but the		*/
+/*	last holds exactly ZBLOCK bytes of the item, so the block that	*/
+/*	holds a given offset is known without searching.		*/
+/*									*/
+/*	When the item is flushed or closed, a trailer follows the	*/
+/*	blocks: the block table (for each block, its file offset as	*/
+/*	two integers, and then the four header values), followed by	*/
+/*	the offset of the table (two integers), the number of blocks,	*/
+/*	the Adler-32 checksum of the table, and an 8 byte magic		*/
+/*	number. Opening a file reads its tail, and usually the whole	*/
+/*	table, in a single read. Files without a good trailer (e.g. a	*/
+/*	writer that died before closing) fall back to walking the	*/
+/*	block headers. Sealing a block cuts the trailer off, so a	*/
+/*	stale table is never left at the end of the file.		*/
+/*									*/
+/*	Codecs:								*/
+/*	  ZIO_STORE	The data are stored as they are.		*/
+/*	  ZIO_LZ	The bytes of each 4 byte word are regrouped	*/
+/*			(all the first bytes, then all the second,	*/
+/*			...), and the result is compressed with a	*/
+/*			small LZ77 coder in the style of LZ4.		*/
+/*	A block is stored if compressing it does not save space.	*/
+/*									*/
+/*	Data in sealed (full) blocks cannot be changed. Rewriting them	*/
+/*	with the same bytes is allowed, as hio does this when a		*/
+/*	buffer that straddles a block boundary is flushed twice.	*/
+/*									*/
+/************************************************************************/
+
+#define private static
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "hio.h"
+#include "miriad.h"
+
+#define Memcpy (void)memcpy
+
+#define ZBLOCK		(1<<18)		/* Uncompressed size of a block. */
+#define ZHDR		16		/* Size of a block header. */
+#define ZMAGIC_SIZE	8
+#define ZENTRY		24		/* Size of a block table entry. */
+#define ZTAIL		24		/* Size of the end of the trailer. */
+#define ZTAILREAD	8192		/* Bytes read from the end on open. */
+
+/* File offsets are stored as two 32 bit integers. */
+
+#define ZHI(x)		((int)(((x) >> 16) >> 16))
+#define ZLO(x)		((int)((x) & 0xffffffff))
+#define ZOFF(hi,lo)	((((off_t)(hi) << 16) << 16) + (unsigned int)(lo))
+#define ZIO_STORE	0
+#define ZIO_LZ		1
+
+#define LZ_HASHBITS	14
+#define LZ_MINMATCH	4
+#define LZ_MAXOFF	65535
+#define LZ_TAIL		5		/* Bytes at the end left as literals. */
+
+static char zmagic[ZMAGIC_SIZE] = {'\211','M','I','R','Z','\r','\n','\032'};
+static char ztmagic[ZMAGIC_SIZE] = {'\211','M','I','R','Z','I','D','X'};
+
+typedef struct {
+  off_t disk;			/* Offset of the block header in the file. */
+  int rawlen,disklen,codec,sum;
+} ZBLK;
+
+typedef struct {
+  int fd,nblk,maxblk,cur;
+  ZBLK *blk;			/* The sealed blocks, then the open one. */
+  off_t size;			/* Uncompressed size of the item. */
+  char *rbuf;			/* Uncompressed copy of sealed block "cur". */
+  char *wbuf;			/* The open (last) block. */
+  int wlen,wdirty;
+  int tdirty;			/* The trailer needs to be rewritten. */
+  off_t woff,wdisk;		/* Where the open block starts. */
+  char *zbuf,*sbuf;		/* Scratch for packing and unpacking. */
+} ZFILE;
+
+private void zfree(ZFILE *z);
+private void zblk_read(ZFILE *z,int k,int *iostat);
+private void zblk_write(ZFILE *z,Const char *buf,int len,off_t disk,
+			ZBLK *b,int *iostat);
+private int  zsum(Const char *buf,int n);
+private void zseal(ZFILE *z,int *iostat);
+private int  ztrail_read(ZFILE *z,off_t fsize,off_t *end,int *iostat);
+private void ztrail_write(ZFILE *z,off_t end,int *iostat);
+private void zgrow(ZFILE *z,int n);
+private int  zbad(int *h);
+private void zshuffle(Const char *in,char *out,int n);
+private void zunshuffle(Const char *in,char *out,int n);
+private int  lz_compress(Const unsigned char *in,int n,
+			 unsigned char *out,int nout);
+private int  lz_decompress(Const unsigned char *in,int n,
+			   unsigned char *out,int nout);
+
+/************************************************************************/
+void *zopen_c(int fd,Const char *status,off_t *size,int *iostat)
+/*
+  Attach to an item file. For "write", the file is empty and the magic
+  number is written. For "read" or "append", the file is checked for
+  the magic number, and NULL is returned (with iostat = 0) if it is an
+  ordinary file. Otherwise the block table is read from the trailer (or
+  built from the block headers if there is no good trailer), and size is
+  set to the uncompressed size of the item.
+
+  Input:
+    fd		File descriptor (from dopen_c).
+    status	Either "read", "write" or "append".
+  Input/Output:
+    size	The size of the file, changed to the size of the item.
+  Output:
+    iostat	I/O status.
+------------------------------------------------------------------------*/
+{
+  ZFILE *z;
+  ZBLK *b;
+  char magic[ZMAGIC_SIZE],hdr[ZHDR];
+  int h[4];
+  off_t disk,end,fsize;
+
+  *iostat = 0;
+  fsize = *size;
+  if(strcmp(status,"write")){
+    if(fsize < ZMAGIC_SIZE) return NULL;
+    dread_c(fd,magic,0,ZMAGIC_SIZE,iostat);		if(*iostat) return NULL;
+    if(memcmp(magic,zmagic,ZMAGIC_SIZE)) return NULL;
+  }
+
+  z = (ZFILE *)malloc(sizeof(ZFILE));
+  z->fd = fd;
+  z->nblk = z->maxblk = 0;
+  z->cur = -1;
+  z->blk = NULL;
+  zgrow(z,1);
+  z->rbuf = (char *)malloc(ZBLOCK);
+  z->wbuf = (char *)malloc(ZBLOCK);
+  z->sbuf = (char *)malloc(ZBLOCK);
+  z->zbuf = (char *)malloc(ZBLOCK);
+  z->wlen = z->wdirty = z->tdirty = 0;
+  z->woff = 0;
+  z->wdisk = ZMAGIC_SIZE;
+
+  if(!strcmp(status,"write")){
+    dwrite_c(fd,zmagic,0,ZMAGIC_SIZE,iostat);
+    z->size = *size = 0;
+    z->tdirty = 1;
+    if(*iostat){ zfree(z); return NULL; }
+    return z;
+  }
+
+/* Take the table of blocks from the trailer if it is good. Otherwise
+   walk the block headers (up to the trailer, if there is one) to build
+   it. Every block but the last must be full. */
+
+  if(ztrail_read(z,fsize,&end,iostat)){
+    if(z->nblk > 0) z->wlen = z->blk[z->nblk-1].rawlen;
+  } else {
+    disk = ZMAGIC_SIZE;
+    while(!*iostat && disk + ZHDR <= end){
+      dread_c(fd,hdr,disk,ZHDR,iostat);			if(*iostat) break;
+      unpack32_c(hdr,h,4);
+      if(zbad(h) || disk + ZHDR + h[1] > end ||
+	 (z->nblk && z->wlen != ZBLOCK)){
+	*iostat = EIO;
+	break;
+      }
+      zgrow(z,z->nblk+2);
+      b = z->blk + z->nblk++;
+      b->disk = disk;
+      b->rawlen = h[0];
+      b->disklen = h[1];
+      b->codec = h[2];
+      b->sum = h[3];
+      z->wlen = h[0];
+      disk += ZHDR + h[1];
+    }
+    if(!*iostat && disk != end) *iostat = EIO;
+  }
+  z->size = *size = (off_t)ZBLOCK * max(z->nblk-1,0) + z->wlen;
+
+/* A partial last block becomes the open block, so that appending
+   extends it. */
+
+  if(!*iostat && z->nblk > 0 && z->wlen < ZBLOCK){
+    zblk_read(z,z->nblk-1,iostat);
+    Memcpy(z->wbuf,z->rbuf,z->wlen);
+    z->nblk--;
+    z->cur = -1;
+    z->wdisk = z->blk[z->nblk].disk;
+  } else {
+    z->wlen = 0;
+    z->wdisk = end;
+  }
+  if(*iostat){
+    zfree(z);
+    return NULL;
+  }
+  z->woff = (off_t)ZBLOCK * z->nblk;
+  return z;
+}
+/************************************************************************/
+void zclose_c(void *zfile,int *iostat)
+/*
+  Write out the open block, and release a compressed item.
+------------------------------------------------------------------------*/
+{
+  zflush_c(zfile,iostat);
+  zfree((ZFILE *)zfile);
+}
+/************************************************************************/
+private void zfree(ZFILE *z)
+/*
+  Release the memory of a compressed item.
+------------------------------------------------------------------------*/
+{
+  if(z->blk != NULL) free(z->blk);
+  free(z->rbuf);
+  free(z->wbuf);
+  free(z->sbuf);
+  free(z->zbuf);
+  free(z);
+}
+/************************************************************************/
+void zflush_c(void *zfile,int *iostat)
+/*
+  Write the open block to the file, if it has changed, followed by the
+  trailer. The open block remains open, and is rewritten in place if
+  more data is added to it.
+------------------------------------------------------------------------*/
+{
+  ZFILE *z;
+  off_t end;
+
+  z = (ZFILE *)zfile;
+  *iostat = 0;
+  if(!z->wdirty && !z->tdirty) return;
+  if(z->wdirty){
+    zblk_write(z,z->wbuf,z->wlen,z->wdisk,z->blk + z->nblk,iostat);
+    if(*iostat) return;
+  }
+  end = z->wdisk;
+  if(z->wlen > 0) end += ZHDR + z->blk[z->nblk].disklen;
+  ztrail_write(z,end,iostat);				if(*iostat) return;
+  z->wdirty = z->tdirty = 0;
+}
+/************************************************************************/
+void zread_c(void *zfile,char *buffer,off_t offset,size_t length,int *iostat)
+/*
+  Read uncompressed data from a compressed item.
+------------------------------------------------------------------------*/
+{
+  ZFILE *z;
+  int k,off,n;
+
+  z = (ZFILE *)zfile;
+  *iostat = 0;
+  if(offset + (off_t)length > z->size){ *iostat = EIO; return; }
+  while(length > 0){
+    if(offset >= z->woff){
+      Memcpy(buffer,z->wbuf + (offset - z->woff),length);
+      return;
+    }
+    k = offset / ZBLOCK;
+    off = offset - (off_t)k * ZBLOCK;
+    n = min(length, ZBLOCK - off);
+    zblk_read(z,k,iostat);				if(*iostat) return;
+    Memcpy(buffer,z->rbuf + off,n);
+    buffer += n;
+    offset += n;
+    length -= n;
+  }
+}
+/************************************************************************/
+void zwrite_c(void *zfile,Const char *buffer,off_t offset,size_t length,
+	      int *iostat)
+/*
+  Write uncompressed data to a compressed item. Data go into the open
+  block, which is compressed and written out when a write starts beyond
+  its end. Gaps are filled with zeros.
+------------------------------------------------------------------------*/
+{
+  ZFILE *z;
+  int k,off,n;
+
+  z = (ZFILE *)zfile;
+  *iostat = 0;
+  while(length > 0){
+
+/* Sealed blocks can only be "rewritten" with the data they hold. */
+
+    if(offset < z->woff){
+      k = offset / ZBLOCK;
+      off = offset - (off_t)k * ZBLOCK;
+      n = min(length, ZBLOCK - off);
+      zblk_read(z,k,iostat);				if(*iostat) return;
+      if(memcmp(z->rbuf + off,buffer,n)){ *iostat = EINVAL; return; }
+
+/* Seal a full open block when writing past it. */
+
+    } else if(offset - z->woff >= ZBLOCK){
+      if(z->wlen < ZBLOCK){
+	memset(z->wbuf + z->wlen,0,ZBLOCK - z->wlen);
+	z->wlen = ZBLOCK;
+      }
+      zseal(z,iostat);					if(*iostat) return;
+      continue;
+
+/* Otherwise copy into the open block. */
+
+    } else {
+      off = offset - z->woff;
+      n = min(length, ZBLOCK - off);
+      if(off > z->wlen) memset(z->wbuf + z->wlen,0,off - z->wlen);
+      Memcpy(z->wbuf + off,buffer,n);
+      z->wlen = max(z->wlen,off + n);
+      z->wdirty = 1;
+      z->size = max(z->size,z->woff + z->wlen);
+    }
+    buffer += n;
+    offset += n;
+    length -= n;
+  }
+}
+/************************************************************************/
+private void zseal(ZFILE *z,int *iostat)
+/*
+  Compress and write out the (full) open block, and start a new one.
+  Any trailer is cut off first, as it no longer describes the file.
+------------------------------------------------------------------------*/
+{
+  ZBLK *b;
+
+  if(!z->tdirty){
+    if(ftruncate(z->fd,z->wdisk) < 0){ *iostat = errno; return; }
+    z->tdirty = 1;
+  }
+  b = z->blk + z->nblk;
+  zblk_write(z,z->wbuf,z->wlen,z->wdisk,b,iostat);
+  if(*iostat) return;
+  z->nblk++;
+  zgrow(z,z->nblk+1);
+  z->woff += ZBLOCK;
+  z->wdisk += ZHDR + b->disklen;
+  z->wlen = z->wdirty = 0;
+}
+/************************************************************************/
+private void zgrow(ZFILE *z,int n)
+/*
+  Make room for at least n entries in the block table.
+------------------------------------------------------------------------*/
+{
+  if(n <= z->maxblk) return;
+  z->maxblk = max(2*z->maxblk + 16,n);
+  z->blk = (ZBLK *)realloc(z->blk,sizeof(ZBLK)*z->maxblk);
+}
+/************************************************************************/
+private int zbad(int *h)
+/*
+  Check the lengths in a block header (or a block table entry).
+------------------------------------------------------------------------*/
+{
+  return h[0] < 0 || h[0] > ZBLOCK || h[1] < 0 || h[1] > ZBLOCK;
+}
+/************************************************************************/
+private int ztrail_read(ZFILE *z,off_t fsize,off_t *end,int *iostat)
+/*
+  Read the block table from the trailer. The last ZTAILREAD bytes of the
+  file are read in one go, which holds the whole table unless the item
+  is large.
+
+  Input:
+    fsize	The size of the file.
+  Output:
+    end		Where the blocks end: the start of the table if the tail
+		of the trailer is good, or else the end of the file.
+    iostat	I/O status.
+    ztrail_read	TRUE if the block table was filled in.
+------------------------------------------------------------------------*/
+{
+  ZBLK *b;
+  char *buf,*tbuf;
+  int t[4],*h,*e,n,k,ntab,ok;
+  off_t toff,disk;
+
+  *end = fsize;
+  if(fsize < ZMAGIC_SIZE + ZTAIL) return FALSE;
+  n = min(fsize - ZMAGIC_SIZE,(off_t)ZTAILREAD);
+  dread_c(z->fd,z->sbuf,fsize - n,n,iostat);		if(*iostat) return FALSE;
+  buf = z->sbuf + n - ZTAIL;
+  if(memcmp(buf + ZTAIL - ZMAGIC_SIZE,ztmagic,ZMAGIC_SIZE)) return FALSE;
+  unpack32_c(buf,t,4);
+  toff = ZOFF(t[0],t[1]);
+  if(t[2] < 0 || t[2] > (fsize - ZMAGIC_SIZE)/(ZENTRY+ZHDR) ||
+     toff < ZMAGIC_SIZE || toff + (off_t)ZENTRY*t[2] + ZTAIL != fsize)
+    return FALSE;
+  *end = toff;
+
+/* Get the table, with a second read only if it did not all fit. */
+
+  ntab = ZENTRY*t[2];
+  tbuf = NULL;
+  if(ntab + ZTAIL <= n){
+    buf -= ntab;
+  } else {
+    buf = tbuf = (char *)malloc(ntab);
+    dread_c(z->fd,buf,toff,ntab,iostat);
+    if(*iostat){ free(tbuf); return FALSE; }
+  }
+
+/* Check the table hangs together before using it. */
+
+  ok = zsum(buf,ntab) == t[3];
+  h = (int *)malloc(sizeof(int)*(6*t[2]+1));
+  if(ok) unpack32_c(buf,h,6*t[2]);
+  zgrow(z,t[2]+1);
+  disk = ZMAGIC_SIZE;
+  for(k=0; ok && k < t[2]; k++){
+    e = h + 6*k;
+    ok = ZOFF(e[0],e[1]) == disk && !zbad(e+2) &&
+	 (k == t[2]-1 || e[2] == ZBLOCK);
+    b = z->blk + k;
+    b->disk = disk;
+    b->rawlen = e[2];
+    b->disklen = e[3];
+    b->codec = e[4];
+    b->sum = e[5];
+    disk += ZHDR + e[3];
+  }
+  ok = ok && disk == toff;
+  if(ok) z->nblk = t[2];
+  free(h);
+  if(tbuf != NULL) free(tbuf);
+  return ok;
+}
+/************************************************************************/
+private void ztrail_write(ZFILE *z,off_t end,int *iostat)
+/*
+  Write the trailer (the block table, including the open block if it
+  holds anything) at the end of the blocks, and cut the file there.
+------------------------------------------------------------------------*/
+{
+  ZBLK *b;
+  char *buf;
+  int t[4],*h,*e,n,k,len;
+
+  n = z->nblk + (z->wlen > 0 ? 1 : 0);
+  len = ZENTRY*n + ZTAIL;
+  h = (int *)malloc(sizeof(int)*(6*n+1));
+  buf = (char *)malloc(len);
+  for(k=0; k < n; k++){
+    b = z->blk + k;
+    e = h + 6*k;
+    e[0] = ZHI(b->disk);
+    e[1] = ZLO(b->disk);
+    e[2] = b->rawlen;
+    e[3] = b->disklen;
+    e[4] = b->codec;
+    e[5] = b->sum;
+  }
+  pack32_c(h,buf,6*n);
+  t[0] = ZHI(end);
+  t[1] = ZLO(end);
+  t[2] = n;
+  t[3] = zsum(buf,ZENTRY*n);
+  pack32_c(t,buf + ZENTRY*n,4);
+  Memcpy(buf + len - ZMAGIC_SIZE,ztmagic,ZMAGIC_SIZE);
+  dwrite_c(z->fd,buf,end,len,iostat);
+  if(!*iostat && ftruncate(z->fd,end + len) < 0) *iostat = errno;
+  free(h);
+  free(buf);
+}
+/************************************************************************/
+private void zblk_write(ZFILE *z,Const char *buf,int len,off_t disk,
+			ZBLK *b,int *iostat)
+/*
+  Pack a block and write it (with its header) at a given file offset.
+  The block table entry b is filled in.
+------------------------------------------------------------------------*/
+{
+  int h[4],n;
+  char *data;
+
+  zshuffle(buf,z->sbuf,len);
+  n = lz_compress((unsigned char *)z->sbuf,len,
+		  (unsigned char *)z->zbuf,ZBLOCK);
+  b->disk = disk;
+  b->rawlen = len;
+  if(n > 0 && n < len){
+    b->codec = ZIO_LZ;
+    b->disklen = n;
+    data = z->zbuf;
+  } else {
+    b->codec = ZIO_STORE;
+    b->disklen = len;
+    data = (char *)buf;
+  }
+  b->sum = zsum(data,b->disklen);
+  h[0] = b->rawlen; h[1] = b->disklen; h[2] = b->codec; h[3] = b->sum;
+  pack32_c(h,z->sbuf,4);
+  dwrite_c(z->fd,z->sbuf,disk,ZHDR,iostat);		if(*iostat) return;
+  dwrite_c(z->fd,data,disk + ZHDR,b->disklen,iostat);
+}
+/************************************************************************/
+private void zblk_read(ZFILE *z,int k,int *iostat)
+/*
+  Read and unpack sealed block k into the decoded block buffer.
+------------------------------------------------------------------------*/
+{
+  ZBLK *b;
+  int n;
+
+  *iostat = 0;
+  if(z->cur == k) return;
+  b = z->blk + k;
+  z->cur = -1;
+  if(b->codec == ZIO_STORE && b->disklen == b->rawlen){
+    dread_c(z->fd,z->rbuf,b->disk + ZHDR,b->disklen,iostat);
+    if(!*iostat && zsum(z->rbuf,b->disklen) != b->sum) *iostat = EIO;
+  } else if(b->codec == ZIO_LZ){
+    dread_c(z->fd,z->zbuf,b->disk + ZHDR,b->disklen,iostat);
+    if(*iostat) return;
+    if(zsum(z->zbuf,b->disklen) != b->sum){ *iostat = EIO; return; }
+    n = lz_decompress((unsigned char *)z->zbuf,b->disklen,
+		      (unsigned char *)z->sbuf,ZBLOCK);
+    if(n != b->rawlen){ *iostat = EIO; return; }
+    zunshuffle(z->sbuf,z->rbuf,n);
+  } else *iostat = EIO;
+  if(!*iostat) z->cur = k;
+}
+/************************************************************************/
+private int zsum(Const char *buf,int n)
+/*
+  The Adler-32 checksum of a buffer.
+------------------------------------------------------------------------*/
+{
+  unsigned int a,b;
+  int i,m;
+  Const unsigned char *p;
+
+  p = (Const unsigned char *)buf;
+  a = 1;
+  b = 0;
+  while(n > 0){
+    m = min(n,5552);
+    for(i=0; i < m; i++){
+      a += p[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    p += m;
+    n -= m;
+  }
+  return (int)((b << 16) | a);
+}
+/************************************************************************/
+private void zshuffle(Const char *in,char *out,int n)
+/*
+  Regroup the bytes of 4 byte words: all first bytes, then all second
+  bytes, and so on. Floating point and integer data compress much
+  better this way, as the high bytes vary slowly. A partial trailing
+  word is copied as is.
+------------------------------------------------------------------------*/
+{
+  int i,nw;
+  char *o0,*o1,*o2,*o3;
+
+  nw = n/4;
+  o0 = out; o1 = o0 + nw; o2 = o1 + nw; o3 = o2 + nw;
+  for(i=0; i < nw; i++, in += 4){
+    o0[i] = in[0]; o1[i] = in[1]; o2[i] = in[2]; o3[i] = in[3];
+  }
+  for(i=4*nw; i < n; i++) out[i] = *in++;
+}
+/************************************************************************/
+private void zunshuffle(Const char *in,char *out,int n)
+/*
+  Undo zshuffle.
+------------------------------------------------------------------------*/
+{
+  int i,nw;
+  Const char *i0,*i1,*i2,*i3;
+
+  nw = n/4;
+  i0 = in; i1 = i0 + nw; i2 = i1 + nw; i3 = i2 + nw;
+  for(i=0; i < nw; i++, out += 4){
+    out[0] = i0[i]; out[1] = i1[i]; out[2] = i2[i]; out[3] = i3[i];
+  }
+  for(i=4*nw; i < n; i++) *out++ = in[i];
+}
+/************************************************************************/
+private int lz_emit(unsigned char *out,int op,int nout,
+		    Const unsigned char *lit,int nlit,int moff,int mlen)
+/*
+  Append a sequence (a token, literals, and optionally a match) to the
+  compressed output. Returns the new output length, or -1 if it would
+  not fit. A sequence without a match (mlen = 0) ends the block.
+------------------------------------------------------------------------*/
+{
+  int n;
+
+  if(op + 1 + nlit + nlit/255 + 1 + (mlen ? 3 + mlen/255 : 0) > nout)
+    return -1;
+  out[op++] = (min(nlit,15) << 4) | (mlen ? min(mlen - LZ_MINMATCH,15) : 0);
+  if(nlit >= 15){
+    for(n = nlit - 15; n >= 255; n -= 255) out[op++] = 255;
+    out[op++] = n;
+  }
+  Memcpy(out + op,lit,nlit);
+  op += nlit;
+  if(mlen){
+    out[op++] = moff & 0xff;
+    out[op++] = moff >> 8;
+    if(mlen - LZ_MINMATCH >= 15){
+      for(n = mlen - LZ_MINMATCH - 15; n >= 255; n -= 255) out[op++] = 255;
+      out[op++] = n;
+    }
+  }
+  return op;
+}
+/************************************************************************/
+#define LZ_READ32(p) ((unsigned int)(p)[0] | ((unsigned int)(p)[1] << 8) | \
+		((unsigned int)(p)[2] << 16) | ((unsigned int)(p)[3] << 24))
+#define LZ_HASH(x) (((x) * 2654435761U) >> (32 - LZ_HASHBITS))
+
+private int lz_compress(Const unsigned char *in,int n,
+			unsigned char *out,int nout)
+/*
+  Greedy LZ77 compression, using a hash of the next 4 bytes to find the
+  last place they occurred. Returns the compressed length, or 0 if the
+  output would not fit in nout bytes.
+------------------------------------------------------------------------*/
+{
+  int table[1<<LZ_HASHBITS];
+  int ip,anchor,op,ref,len,h,limit;
+  unsigned int seq;
+
+  for(h=0; h < (1<<LZ_HASHBITS); h++) table[h] = -1;
+  ip = anchor = op = 0;
+  limit = n - LZ_TAIL;
+  while(ip + LZ_MINMATCH <= limit){
+    seq = LZ_READ32(in + ip);
+    h = LZ_HASH(seq);
+    ref = table[h];
+    table[h] = ip;
+    if(ref < 0 || ip - ref > LZ_MAXOFF || LZ_READ32(in + ref) != seq){
+
+/* Step faster through data that is not compressing. */
+
+      ip += 1 + ((ip - anchor) >> 6);
+      continue;
+    }
+    len = LZ_MINMATCH;
+    while(ip + len < limit && in[ref+len] == in[ip+len]) len++;
+    op = lz_emit(out,op,nout,in+anchor,ip-anchor,ip-ref,len);
+    if(op < 0) return 0;
+    ip += len;
+    anchor = ip;
+  }
+  op = lz_emit(out,op,nout,in+anchor,n-anchor,0,0);
+  return (op < 0 ? 0 : op);
+}
+/************************************************************************/
+private int lz_decompress(Const unsigned char *in,int n,
+			  unsigned char *out,int nout)
+/*
+  Undo lz_compress. Returns the uncompressed length, or -1 if the input
+  is corrupt.
+------------------------------------------------------------------------*/
+{
+  int ip,op,tok,len,moff,c;
+  unsigned char *s;
+
+  ip = op = 0;
+  while(ip < n){
+    tok = in[ip++];
+    len = tok >> 4;
+    if(len == 15) do{
+      if(ip >= n) return -1;
+      c = in[ip++];
+      len += c;
+    }while(c == 255);
+    if(len > n - ip || len > nout - op) return -1;
+    Memcpy(out + op,in + ip,len);
+    ip += len;
+    op += len;
+    if(ip == n) break;
+
+    if(ip + 2 > n) return -1;
+    moff = in[ip] | (in[ip+1] << 8);
+    ip += 2;
+    len = (tok & 15) + LZ_MINMATCH;
+    if((tok & 15) == 15) do{
+      if(ip >= n) return -1;
+      c = in[ip++];
+      len += c;
+    }while(c == 255);
+    if(moff == 0 || moff > op || len > nout - op) return -1;
+    s = out + op - moff;
+    if(moff >= len) Memcpy(out + op,s,len);
+    else for(c=0; c < len; c++) out[op+c] = s[c];
+    op += len;
+  }
+  return op;
+}
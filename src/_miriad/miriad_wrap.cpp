@@ -1,4 +1,6 @@
 #include "miriad_wrap.h"
+#include <sys/stat.h>
+#include <climits>
 
 /*____                           _                    _    
  / ___|_ __ ___  _   _ _ __   __| |_      _____  _ __| | __
@@ -15,11 +17,27 @@ typedef struct {
     long decphase;
     long intcnt;
     double curtime;
+    char name[MAXPATH];
+    char status;
+    UVIndex *index;
+    int *flagbuf;
+    int nflagbuf;
+    char *snap0;
+    int chstart, chn, chstep;
 } UVObject;
 
 // Deallocate memory when Python object is deleted
 static void UVObject_dealloc(UVObject* self) {
-    if (self->tno != -1) uvclose_c(self->tno);
+    BUGCTX ctx;
+    if (self->tno != -1) {
+        // There is no one to report a failed close to
+        bugpush_c(&ctx);
+        if (setjmp(ctx.env) == 0) uvclose_c(self->tno);
+        bugpop_c(&ctx);
+    }
+    delete self->index;
+    free(self->flagbuf);
+    free(self->snap0);
     self->ob_type->tp_free((PyObject*)self);
 }
 
@@ -31,39 +49,359 @@ static PyObject *UVObject_new(PyTypeObject *type,
     return (PyObject *) self;
 }
 
-// A simple error handler that we can use in bug.c
-void error_handler(void) {
-    throw MiriadError("Runtime error in MIRIAD");
+/* Load the variables of the first record, so they can be inspected before
+ * anything is read, and keep a snapshot of them (see uvsnap_c) that
+ * uv_rewind restores.  Only the variables are scanned; no correlation data
+ * are decoded. */
+static void uv_prime(UVObject *self) {
+    char type;
+    int length, updated, n;
+    uvprobvr_c(self->tno, "corr", &type, &length, &updated);
+    uvscan_c(self->tno, type == ' ' ? "" : "corr");
+    n = uvsnap_c(self->tno, NULL, 0);
+    self->snap0 = (char *) malloc(n);
+    if (self->snap0 != NULL) uvsnap_c(self->tno, self->snap0, n);
+    uvrewind_c(self->tno);
+}
+
+/* Rewind to the first record, with the variables as they were when the
+ * file was opened rather than wherever the last read left them. */
+static void uv_rewind(UVObject *self) {
+    uvrewind_c(self->tno);
+    if (self->snap0 != NULL) uvunsnap_c(self->tno, self->snap0);
 }
 
 // Initialize object (__init__)
 static int UVObject_init(UVObject *self, PyObject *args, PyObject *kwds) {
     char *name=NULL, *status=NULL, *corrmode=NULL;
+    int bufsize=0, compress=0, iostat=0;
     self->tno = -1;
     self->decimate = 1;
     self->decphase = 0;
     self->intcnt = -1;
     self->curtime = -1;
+    self->index = NULL;
     // Parse arguments and typecheck
-    if (!PyArg_ParseTuple(args, "sss", &name, &status, &corrmode)) return -1;
+    if (!PyArg_ParseTuple(args, "sss|ii", &name, &status, &corrmode, &bufsize,
+            &compress)) return -1;
+    if (strlen(name) >= MAXPATH) {
+        PyErr_Format(PyExc_ValueError, "UV filename too long");
+        return -1;
+    }
+    strcpy(self->name, name);
+    self->status = status[0];
     switch (corrmode[0]) {
         case 'r': case 'j': break;
         default:
             PyErr_Format(PyExc_ValueError, "UV corrmode must be 'r' or 'j' (got '%c')", corrmode[0]);
             return -1;
     }
-    // Setup an error handler so MIRIAD doesn't just exit
-    bugrecover_c(error_handler);
     try {
+        AllowThreads nogil;
+        MIRIAD_GUARD;
         uvopen_c(&self->tno, name, status);
         // Statically set the preamble format
         uvset_c(self->tno,"preamble","uvw/time/baseline",0,0.,0.,0.);
         uvset_c(self->tno,"corr",corrmode,0,0.,0.,0.);
+        if (bufsize > 0) hbufsize_c(self->tno, bufsize, &iostat);
+        if (compress && self->status == 'n')
+            uvset_c(self->tno,"compress","lz",0,0.,0.,0.);
+        if (self->status == 'o') uv_prime(self);
     } catch (MiriadError &e) {
         self->tno = -1;
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return -1;
+    }
+    if (iostat) {
+        PyErr_Format(PyExc_IOError, "Failed to set i/o buffer size (%s)",
+            strerror(iostat));
+        return -1;
+    }
+    return 0;
+}
+
+/* The record index maps each record in visdata to its offset (and flag
+ * offsets), along with the time/baseline/pol that key it.  Every INDEX_SNAP
+ * records it also keeps a snapshot of the variable table, so a seek can
+ * restore the variables and rescan at most INDEX_SNAP-1 records instead of
+ * reading from the start.  It is built by one pass of uvscan_c the first
+ * time it is needed, and saved in the INDEX_ITEM item so later opens of the
+ * same file just load it. */
+
+bool UVIndex::matches(const UVIndexEntry &e) const {
+    if (tlo.size() > 0) {
+        // Same test as uvread_select, including fractional-day times
+        int i1 = (int) (e.time - 0.5);
+        double t0 = e.time - i1 - 0.5;
+        bool ok = false;
+        for (size_t k=0; k < tlo.size() && !ok; k++)
+            ok = (tlo[k] <= e.time && e.time <= thi[k]) ||
+                 (tlo[k] <= t0 && t0 <= thi[k]);
+        if (!ok) return false;
+    }
+    if (ai.size() > 0 && !anyant) {
+        int i = GETI(e.bl), j = GETJ(e.bl);
+        bool ok = false;
+        for (size_t k=0; k < ai.size() && !ok; k++)
+            ok = (ai[k] == i && aj[k] == j) || (ai[k] == j && aj[k] == i) ||
+                 (aj[k] == -1 && (ai[k] == i || ai[k] == j));
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Size and mtime of visdata, which invalidate a saved index when they change
+static int uvindex_stamp(UVObject *self, int8 *size, int8 *mtime) {
+    struct stat st;
+    std::string path = std::string(self->name) + "/visdata";
+    if (stat(path.c_str(), &st) != 0) return -1;
+    *size = (int8) st.st_size;
+    *mtime = (int8) st.st_mtime;
+    return 0;
+}
+
+/* INDEX_ITEM layout: after the item header come 3 ints (version, snapshot
+ * interval, unused) and 5 int8s (visdata size and mtime, number of entries
+ * and snapshots, bytes of snapshot data), then the entry columns, snapshot
+ * offsets and snapshot data. */
+#define IDX_HDR_SIZE 56
+
+/* Load a saved index, if there is one and it is still current.  Returns 0
+ * on success. */
+static int uvindex_load(UVObject *self) {
+    UVIndex *idx = self->index;
+    int item, iostat, stat, hdr[3];
+    int8 stamp[5], size, mtime;
+    if (!hexists_c(self->tno, INDEX_ITEM)) return -1;
+    if (uvindex_stamp(self, &size, &mtime) != 0) return -1;
+    haccess_c(self->tno, &item, INDEX_ITEM, "read", &iostat);
+    if (iostat) return -1;
+    hreadi_c(item, hdr, ITEM_HDR_SIZE, 3*H_INT_SIZE, &iostat);
+    if (!iostat) hreadl_c(item, stamp, 16, 5*H_INT8_SIZE, &iostat);
+    if (iostat || hdr[0] != INDEX_VERSION || hdr[1] != INDEX_SNAP ||
+            stamp[0] != size || stamp[1] != mtime || stamp[2] < 0 ||
+            stamp[3] != (stamp[2] + INDEX_SNAP - 1) / INDEX_SNAP) {
+        hdaccess_c(item, &iostat);
         return -1;
     }
+    size_t n = (size_t) stamp[2], ns = (size_t) stamp[3];
+    std::vector<int8> l(3*n);
+    std::vector<double> d(n);
+    std::vector<float> r(n);
+    std::vector<int> in(n);
+    MIRIAD_GUARD;
+    idx->snapoff.resize(ns);
+    idx->snaps.resize((size_t) stamp[4]);
+    off_t off = IDX_HDR_SIZE;
+    if (n > 0) {
+        hreadl_c(item, &l[0], off, 3*n*H_INT8_SIZE, &iostat);
+        off += 3*n*H_INT8_SIZE;
+        if (!iostat) hreadd_c(item, &d[0], off, n*H_DBLE_SIZE, &iostat);
+        off += n*H_DBLE_SIZE;
+        if (!iostat) hreadr_c(item, &r[0], off, n*H_REAL_SIZE, &iostat);
+        off += n*H_REAL_SIZE;
+        if (!iostat) hreadi_c(item, &in[0], off, n*H_INT_SIZE, &iostat);
+        off += n*H_INT_SIZE;
+        if (!iostat) hreadl_c(item, &idx->snapoff[0], off,
+            ns*H_INT8_SIZE, &iostat);
+        off += ns*H_INT8_SIZE;
+        if (!iostat) hreadb_c(item, &idx->snaps[0], off, stamp[4], &iostat);
+    }
+    stat = iostat;
+    hdaccess_c(item, &iostat);
+    if (stat || iostat) return -1;
+    idx->ent.resize(n);
+    for (size_t k=0; k < n; k++) {
+        UVIndexEntry &e = idx->ent[k];
+        e.offset = l[3*k]; e.flgoff = l[3*k+1]; e.wflgoff = l[3*k+2];
+        e.time = d[k]; e.bl = r[k]; e.pol = in[k];
+    }
+    return 0;
+}
+
+/* Save the index into the data set.  Failure (e.g. a read-only file) is not
+ * an error; the index will just be rebuilt next time. */
+static void uvindex_save(UVObject *self) {
+    UVIndex *idx = self->index;
+    int item, iostat, stat, hdr[3];
+    int8 stamp[5];
+    size_t n = idx->ent.size(), ns = idx->snapoff.size();
+    if (uvindex_stamp(self, &stamp[0], &stamp[1]) != 0) return;
+    stamp[2] = n; stamp[3] = ns; stamp[4] = idx->snaps.size();
+    haccess_c(self->tno, &item, INDEX_ITEM, "write", &iostat);
+    if (iostat) return;
+    std::vector<int8> l(3*n);
+    std::vector<double> d(n);
+    std::vector<float> r(n);
+    std::vector<int> in(n);
+    MIRIAD_GUARD;
+    for (size_t k=0; k < n; k++) {
+        const UVIndexEntry &e = idx->ent[k];
+        l[3*k] = e.offset; l[3*k+1] = e.flgoff; l[3*k+2] = e.wflgoff;
+        d[k] = e.time; r[k] = e.bl; in[k] = e.pol;
+    }
+    hdr[0] = INDEX_VERSION; hdr[1] = INDEX_SNAP; hdr[2] = 0;
+    off_t off = IDX_HDR_SIZE;
+    hwriteb_c(item, binary_item, 0, ITEM_HDR_SIZE, &iostat);
+    if (!iostat) hwritei_c(item, hdr, ITEM_HDR_SIZE, 3*H_INT_SIZE, &iostat);
+    if (!iostat) hwritel_c(item, stamp, 16, 5*H_INT8_SIZE, &iostat);
+    if (n > 0) {
+        if (!iostat) hwritel_c(item, &l[0], off, 3*n*H_INT8_SIZE, &iostat);
+        off += 3*n*H_INT8_SIZE;
+        if (!iostat) hwrited_c(item, &d[0], off, n*H_DBLE_SIZE, &iostat);
+        off += n*H_DBLE_SIZE;
+        if (!iostat) hwriter_c(item, &r[0], off, n*H_REAL_SIZE, &iostat);
+        off += n*H_REAL_SIZE;
+        if (!iostat) hwritei_c(item, &in[0], off, n*H_INT_SIZE, &iostat);
+        off += n*H_INT_SIZE;
+        if (!iostat) hwritel_c(item, &idx->snapoff[0], off,
+            ns*H_INT8_SIZE, &iostat);
+        off += ns*H_INT8_SIZE;
+        if (!iostat) hwriteb_c(item, &idx->snaps[0], off,
+            idx->snaps.size(), &iostat);
+    }
+    stat = iostat;
+    hdaccess_c(item, &iostat);
+    if (stat || iostat) hdelete_c(self->tno, INDEX_ITEM, &iostat);
+}
+
+/* Position the file to read entry k next, with every variable as it would
+ * be after reading sequentially up to it: restore the nearest snapshot at
+ * or before k and rescan forward from there. */
+static void uvindex_seek(UVObject *self, size_t k) {
+    UVIndex *idx = self->index;
+    size_t s = k / INDEX_SNAP;
+    off_t offset, flgoff, wflgoff;
+    const UVIndexEntry &e0 = idx->ent[s*INDEX_SNAP], &e = idx->ent[k];
+    // Skipping ahead within a block can just scan from where we are
+    uvtell_c(self->tno, &offset, &flgoff, &wflgoff);
+    if (offset < e0.offset || offset > e.offset) {
+        uvunsnap_c(self->tno, &idx->snaps[idx->snapoff[s]]);
+        uvseek_c(self->tno, e0.offset, e0.flgoff, e0.wflgoff);
+        offset = e0.offset;
+    }
+    while (offset < e.offset) {
+        if (uvscan_c(self->tno, "") != 0) break;
+        uvtell_c(self->tno, &offset, &flgoff, &wflgoff);
+    }
+    uvseek_c(self->tno, e.offset, e.flgoff, e.wflgoff);
+}
+
+// First entry at or after offset (entries are in file order)
+static size_t uvindex_lower(UVIndex *idx, off_t offset) {
+    size_t lo=0, hi=idx->ent.size(), mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (idx->ent[mid].offset < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Build the index with a single pass of uvscan_c over the whole file.  This
+ * does not depend on (or disturb) any uvselect_c selection. */
+static void uvindex_build(UVObject *self) {
+    UVIndex *idx = self->index;
+    UVIndexEntry e;
+    off_t offset, flgoff, wflgoff, fo=0, wfo=0;
+    int length, updated, has_pol, tno=self->tno;
+    bool start = true;
+    char type;
+    memset(&e, 0, sizeof(e));
+    idx->ent.clear();
+    idx->snapoff.clear();
+    idx->snaps.clear();
+    uvprobvr_c(tno, "pol", &type, &length, &updated);
+    has_pol = (type == 'i');
+    uvrewind_c(tno);
+    while (1) {
+        /* An entry starts right after the previous one, so any records
+         * without correlation data are rescanned along with it. */
+        if (start) {
+            uvtell_c(tno, &offset, &flgoff, &wflgoff);
+            e.offset = offset; e.flgoff = fo; e.wflgoff = wfo;
+            if (idx->ent.size() % INDEX_SNAP == 0) {
+                size_t off = idx->snaps.size();
+                idx->snapoff.push_back(off);
+                idx->snaps.resize(off + uvsnap_c(tno, NULL, 0));
+                uvsnap_c(tno, &idx->snaps[off], idx->snaps.size() - off);
+            }
+            start = false;
+        }
+        if (uvscan_c(tno, "") != 0) break;
+        // Flag offsets advance the same way uvread_c advances them
+        uvprobvr_c(tno, "wcorr", &type, &length, &updated);
+        if (updated) wfo += length;
+        uvprobvr_c(tno, "corr", &type, &length, &updated);
+        if (!updated || length <= 0) continue;
+        fo += (type == 'c') ? length : length / 2;
+        start = true;
+        uvgetvr_c(tno, H_DBLE, "time", (char *)&e.time, 1);
+        uvgetvr_c(tno, H_REAL, "baseline", (char *)&e.bl, 1);
+        if (has_pol) uvgetvr_c(tno, H_INT, "pol", (char *)&e.pol, 1);
+        idx->ent.push_back(e);
+    }
+    // Drop a trailing snapshot that has no record after it
+    if (idx->snapoff.size() > (idx->ent.size() + INDEX_SNAP - 1) / INDEX_SNAP) {
+        idx->snaps.resize(idx->snapoff.back());
+        idx->snapoff.pop_back();
+    }
+    uv_rewind(self);
+}
+
+/* Make sure self->index is current, loading or building it as needed.
+ * Only files opened 'old' can be indexed. */
+static int uvindex_get(UVObject *self) {
+    if (self->status != 'o') return -1;
+    if (self->index == NULL) self->index = new UVIndex();
+    if (!self->index->loaded) {
+        if (uvindex_load(self) != 0) {
+            uvindex_build(self);
+            uvindex_save(self);
+        }
+        self->index->loaded = true;
+    }
+    return 0;
+}
+
+/* Mirror a uvselect_c call in the index filter.  The filter only has to
+ * pass a superset of what uvread_c selects (uvread_c still applies the full
+ * selection), so included time ranges and baselines narrow it, other
+ * clauses are ignored, and anything it cannot follow turns it off. */
+static void uvindex_select(UVIndex *idx, const char *name,
+        double n1, double n2, int include) {
+    if (strcmp(name, "clear") == 0) {
+        idx->clear_select();
+    } else if (strcmp(name, "time") == 0 && include) {
+        idx->tlo.push_back(n1);
+        idx->thi.push_back(n2);
+    } else if (strcmp(name, "antennae") == 0 && include) {
+        // uvselect_c antennae are 1-based with 0 meaning "all"
+        int a = (int) (max(n1, n2) + 0.5) - 1;
+        int b = (int) (min(n1, n2) + 0.5) - 1;
+        if (a < 0) idx->anyant = true;
+        idx->ai.push_back(a);
+        idx->aj.push_back(b);
+    } else if (strcmp(name, "time") == 0 || strcmp(name, "antennae") == 0 ||
+            strcmp(name, "or") == 0 || strcmp(name, "visibility") == 0 ||
+            strcmp(name, "increment") == 0) {
+        // Excludes, 'or' clauses, and selections that count records
+        idx->selok = false;
+    }
+}
+
+/* Before a read, move forward to the next record that passes the index
+ * filter.  Returns -1 if there is none. */
+static int uvindex_next(UVObject *self) {
+    UVIndex *idx = self->index;
+    off_t offset, flgoff, wflgoff;
+    uvtell_c(self->tno, &offset, &flgoff, &wflgoff);
+    // Building the index rewinds the file, so only do it from the start
+    if (!idx->loaded && (offset != 0 || uvindex_get(self) != 0)) return 0;
+    size_t k = uvindex_lower(idx, offset), n = idx->ent.size();
+    while (k < n && !idx->matches(idx->ent[k])) k++;
+    if (k == n) return -1;
+    if (idx->ent[k].offset != offset) uvindex_seek(self, k);
     return 0;
 }
 
@@ -75,37 +413,91 @@ static int UVObject_init(UVObject *self, PyObject *args, PyObject *kwds) {
            |__/                                                       
 */
 
-// Thin wrapper over uvrewind_c
+// Rewind, restoring the variables of the first record (see uv_prime)
 PyObject * UVObject_rewind(UVObject *self) {
-    uvrewind_c(self->tno);
+    try {
+        MIRIAD_GUARD;
+        uv_rewind(self);
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
     self->intcnt = -1;
     self->curtime = -1;
     Py_INCREF(Py_None);
     return Py_None;
 }
 
+// Scratch space for MIRIAD's int flags, which raw_read/raw_write convert
+static int *uv_flagbuf(UVObject *self, int n) {
+    if (n > self->nflagbuf) {
+        int *buf = (int *) realloc(self->flagbuf, n * sizeof(int));
+        if (buf == NULL) return NULL;
+        self->flagbuf = buf;
+        self->nflagbuf = n;
+    }
+    return self->flagbuf;
+}
+
+/* Have uvread_c return n2read channels starting at start, every step'th
+ * channel, or (for start < 0) as many channels as there are.  Only
+ * changes the MIRIAD line type (which reinitializes uvread_c) when the
+ * request differs from the last one.  chstep == 0 means all channels. */
+static void uv_setchans(UVObject *self, int n2read, int start, int step) {
+    if (start < 0) {
+        if (self->chstep == 0) return;
+        uvset_c(self->tno, "data", "channel", 0, 1., 1., 1.);
+        self->chstep = 0;
+    } else {
+        if (self->chstart == start && self->chn == n2read &&
+            self->chstep == step) return;
+        uvset_c(self->tno, "data", "channel", n2read, start+1., 1., step);
+        self->chstart = start; self->chn = n2read; self->chstep = step;
+    }
+}
+
 /* Wrapper over uvread_c to deal with numpy arrays, conversion of baseline
- * and polarization codes, and returning a tuple of all results.
+ * and polarization codes, and returning a tuple of all results.  Flags are
+ * returned as a bool mask (True where flagged), ready for numpy.ma.  Given
+ * start and step, exactly n2read channels start, start+step, ... are read,
+ * and only those are decoded.
  */
 PyObject * UVObject_read(UVObject *self, PyObject *args) {
     PyArrayObject *data, *flags, *uvw;
     PyObject *rv;
-    int nread, n2read, i, j;
+    int nread, n2read, i, j, *flagbuf, start=-1, step=1;
     double preamble[PREAMBLE_SIZE];
-    if (!PyArg_ParseTuple(args, "i", &n2read)) return NULL;
+    if (!PyArg_ParseTuple(args, "i|ii", &n2read, &start, &step)) return NULL;
+    if (n2read < 0 || (PyTuple_Size(args) > 1 && start < 0) || step < 1) {
+        PyErr_Format(PyExc_ValueError,
+            "raw_read needs num >= 0, start >= 0 and step >= 1");
+        return NULL;
+    }
     // Make numpy arrays to hold the results
     npy_intp data_dims[1] = {n2read};
     data = (PyArrayObject *) PyArray_SimpleNew(1, data_dims, PyArray_CFLOAT);
     CHK_NULL(data);
-    flags = (PyArrayObject *) PyArray_SimpleNew(1, data_dims, PyArray_INT);
+    flags = (PyArrayObject *) PyArray_SimpleNew(1, data_dims, PyArray_BOOL);
     CHK_NULL(flags);
+    flagbuf = uv_flagbuf(self, n2read);
+    if (flagbuf == NULL) return PyErr_NoMemory();
     while (1) {
         // Here is the MIRIAD call
         try {
+            AllowThreads nogil;
+            MIRIAD_GUARD;
+            uv_setchans(self, n2read, start, step);
+            // Jump past records the index says uvselect would reject
+            if (self->index != NULL && self->index->filtering() &&
+                    uvindex_next(self) != 0) {
+                memset(preamble, 0, sizeof(preamble));
+                nread = 0;
+                break;
+            }
             uvread_c(self->tno, preamble,
-                (float *)data->data, (int *)flags->data, n2read, &nread);
+                (float *)data->data, flagbuf, n2read, &nread);
         } catch (MiriadError &e) {
-            PyErr_Format(PyExc_RuntimeError, e.get_message());
+            PyErr_SetString(PyExc_RuntimeError, e.get_message());
             return NULL;
         }
         if (preamble[3] != self->curtime) {
@@ -116,6 +508,9 @@ PyObject * UVObject_read(UVObject *self, PyObject *args) {
             break;
         }
     }
+    // Invert into numpy's mask convention; channels not read are masked
+    mkmask_c(flagbuf, (char *)flags->data, nread);
+    memset(flags->data + nread, 1, n2read - nread);
     // Now we build a return value of ((uvw,t,(i,j)), data, flags, nread)
     npy_intp uvw_dims[1] = {3};
     uvw = (PyArrayObject *) PyArray_SimpleNew(1, uvw_dims, PyArray_DOUBLE);
@@ -133,17 +528,23 @@ PyObject * UVObject_read(UVObject *self, PyObject *args) {
     return rv;
 }
 
+// Check for both int,long, b/c label of 32b number is platform dependent
+static bool is_int32(PyArrayObject *a) {
+    return TYPE(a) == NPY_INT || (sizeof(int) == sizeof(long) && TYPE(a) == NPY_LONG);
+}
+
 /* Wrapper over uvwrite_c to deal with numpy arrays, conversion of baseline
- * codes, and accepts preamble as a tuple.
+ * codes, and accepts preamble as a tuple.  flags is a bool mask (True where
+ * flagged), or with valid set, MIRIAD's integer32 flags (valid where == 1).
  */
 PyObject * UVObject_write(UVObject *self, PyObject *args) {
     PyArrayObject *data=NULL, *flags=NULL, *uvw=NULL;
-    int i, j;
+    int i, j, valid=0, *flagbuf;
     double preamble[PREAMBLE_SIZE], t;
     // Parse arguments and typecheck
-    if (!PyArg_ParseTuple(args, "(O!d(ii))O!O!", 
+    if (!PyArg_ParseTuple(args, "(O!d(ii))O!O!|i", 
         &PyArray_Type, &uvw, &t, &i, &j,
-        &PyArray_Type, &data, &PyArray_Type, &flags)) return NULL;
+        &PyArray_Type, &data, &PyArray_Type, &flags, &valid)) return NULL;
     if (RANK(uvw) != 1 || DIM(uvw,0) != 3) {
         PyErr_Format(PyExc_ValueError,
             "uvw must have shape (3,) %d", RANK(uvw));
@@ -155,11 +556,23 @@ PyObject * UVObject_write(UVObject *self, PyObject *args) {
     }
     CHK_ARRAY_TYPE(uvw, NPY_DOUBLE);
     CHK_ARRAY_TYPE(data, NPY_CFLOAT);
-    // Check for both int,long, b/c label of 32b number is platform dependent
-    if (TYPE(flags) != NPY_INT && \
-            (sizeof(int) == sizeof(long) && TYPE(flags) != NPY_LONG)) {
-        PyErr_Format(PyExc_ValueError, "type(flags) != NPY_LONG or NPY_INT");
-        return NULL;
+    // The two conventions are opposite, so never guess one from the type
+    if (valid) {
+        if (!is_int32(flags)) {
+            PyErr_Format(PyExc_ValueError,
+                "valid flags must be NPY_LONG or NPY_INT");
+            return NULL;
+        }
+        flagbuf = (int *)flags->data;
+    } else {
+        if (TYPE(flags) != NPY_BOOL) {
+            PyErr_Format(PyExc_ValueError,
+                "flags must be a NPY_BOOL mask (pass valid=1 for int flags)");
+            return NULL;
+        }
+        flagbuf = uv_flagbuf(self, DIM(flags,0));
+        if (flagbuf == NULL) return PyErr_NoMemory();
+        mkunmask_c(flags->data, flagbuf, DIM(flags,0));
     }
     // Fill up the preamble
     preamble[0] = IND1(uvw,0,double);
@@ -169,10 +582,76 @@ PyObject * UVObject_write(UVObject *self, PyObject *args) {
     preamble[4] = MKBL(i,j);
     // Here is the MIRIAD call
     try {
+        AllowThreads nogil;
+        MIRIAD_GUARD;
         uvwrite_c(self->tno, preamble,
-            (float *)data->data, (int *)flags->data, DIM(data,0));
+            (float *)data->data, flagbuf, DIM(data,0));
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Wrapper over uvwriteblk_c, which writes N records at once: uvw (N,3),
+ * t (N), i and j (N), data (N,nchan), and flags (N,nchan) as a bool mask
+ * (True where flagged).  data and flags must be C-contiguous.
+ */
+PyObject * UVObject_write_block(UVObject *self, PyObject *args) {
+    PyArrayObject *uvw, *t, *i, *j, *data, *flags;
+    int nrec, nchan, *flagbuf;
+    if (!PyArg_ParseTuple(args, "O!O!O!O!O!O!", &PyArray_Type, &uvw,
+        &PyArray_Type, &t, &PyArray_Type, &i, &PyArray_Type, &j,
+        &PyArray_Type, &data, &PyArray_Type, &flags)) return NULL;
+    CHK_ARRAY_TYPE(uvw, NPY_DOUBLE);
+    CHK_ARRAY_TYPE(t, NPY_DOUBLE);
+    CHK_ARRAY_TYPE(data, NPY_CFLOAT);
+    if (!is_int32(i) || !is_int32(j)) {
+        PyErr_Format(PyExc_ValueError, "type(i), type(j) must be NPY_INT");
+        return NULL;
+    }
+    if (RANK(data) != 2 || RANK(flags) != 2 || RANK(uvw) != 2 ||
+            RANK(t) != 1 || RANK(i) != 1 || RANK(j) != 1) {
+        PyErr_Format(PyExc_ValueError,
+            "uvw, data and flags must be 2 dimensional; t, i, j 1 dimensional");
+        return NULL;
+    }
+    nrec = DIM(data,0); nchan = DIM(data,1);
+    if (DIM(uvw,0) != nrec || DIM(uvw,1) != 3 || DIM(t,0) != nrec ||
+            DIM(i,0) != nrec || DIM(j,0) != nrec ||
+            DIM(flags,0) != nrec || DIM(flags,1) != nchan) {
+        PyErr_Format(PyExc_ValueError,
+            "uvw must be (N,3), t, i, j (N,), and data, flags (N,nchan)");
+        return NULL;
+    }
+    if (!PyArray_ISCONTIGUOUS(data) || !PyArray_ISCONTIGUOUS(flags)) {
+        PyErr_Format(PyExc_ValueError, "data and flags must be C-contiguous");
+        return NULL;
+    }
+    CHK_ARRAY_TYPE(flags, NPY_BOOL);
+    flagbuf = uv_flagbuf(self, nrec * nchan);
+    if (flagbuf == NULL) return PyErr_NoMemory();
+    mkunmask_c(flags->data, flagbuf, nrec * nchan);
+    // Fill up the preambles
+    std::vector<double> preamble(PREAMBLE_SIZE * nrec);
+    for (int k=0; k < nrec; k++) {
+        double *p = &preamble[PREAMBLE_SIZE * k];
+        p[0] = IND2(uvw,k,0,double);
+        p[1] = IND2(uvw,k,1,double);
+        p[2] = IND2(uvw,k,2,double);
+        p[3] = IND1(t,k,double);
+        int ii = IND1(i,k,int), jj = IND1(j,k,int);
+        p[4] = MKBL(ii,jj);
+    }
+    // Here is the MIRIAD call
+    try {
+        AllowThreads nogil;
+        MIRIAD_GUARD;
+        uvwriteblk_c(self->tno, &preamble[0],
+            (float *)data->data, flagbuf, nchan, nrec);
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
     Py_INCREF(Py_None);
@@ -184,9 +663,10 @@ PyObject * UVObject_copyvr(UVObject *self, PyObject *args) {
     UVObject *uv;
     if (!PyArg_ParseTuple(args, "O!", &UVType, &uv)) return NULL;
     try {
+        MIRIAD_GUARD;
         uvcopyvr_c(uv->tno, self->tno);
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
     Py_INCREF(Py_None);
@@ -198,9 +678,10 @@ PyObject * UVObject_trackvr(UVObject *self, PyObject *args) {
     char *name, *sw;
     if (!PyArg_ParseTuple(args, "ss", &name, &sw)) return NULL;
     try {
+        MIRIAD_GUARD;
         uvtrack_c(self->tno, name, sw);
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
     Py_INCREF(Py_None);
@@ -225,9 +706,10 @@ PyObject * UVObject_rdvr(UVObject *self, PyObject *args) {
     npy_intp dims[1];
     PyArrayObject *rv;
     if (!PyArg_ParseTuple(args, "ss", &name, &type)) return NULL;
-    uvprobvr_c(self->tno, name, value, &length, &updated);
-    dims[0] = length;
     try {
+        MIRIAD_GUARD;
+        uvprobvr_c(self->tno, name, value, &length, &updated);
+        dims[0] = length;
         switch (type[0]) {
             case 'a':
                 uvgetvr_c(self->tno,H_BYTE,name,value,length+1);
@@ -262,7 +744,7 @@ PyObject * UVObject_rdvr(UVObject *self, PyObject *args) {
                 return NULL;
         }
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
 }
@@ -289,6 +771,7 @@ PyObject * UVObject_wrvr(UVObject *self, PyObject *args) {
         CHK_ARRAY_RANK(wr_arr,1);
     }
     try {
+        MIRIAD_GUARD;
         switch (type[0]) {
             case 'a':
                 CHK_STRING(wr_val);
@@ -326,7 +809,7 @@ PyObject * UVObject_wrvr(UVObject *self, PyObject *args) {
         Py_INCREF(Py_None);
         return Py_None;
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
 }
@@ -342,9 +825,14 @@ PyObject * UVObject_select(UVObject *self, PyObject *args) {
         self->decphase = (long) n2;
     } else {
         try {
+            MIRIAD_GUARD;
             uvselect_c(self->tno, name, n1, n2, include);
+            if (self->status == 'o') {
+                if (self->index == NULL) self->index = new UVIndex();
+                uvindex_select(self->index, name, n1, n2, include);
+            }
         } catch (MiriadError &e) {
-            PyErr_Format(PyExc_RuntimeError, e.get_message());
+            PyErr_SetString(PyExc_RuntimeError, e.get_message());
             return NULL;
         }
     }
@@ -352,17 +840,175 @@ PyObject * UVObject_select(UVObject *self, PyObject *args) {
     return Py_None;
 }
 
+/* Position the file at the first record (in file order) at or after time t
+ * that matches baseline (i,j) and pol, using the record index.  i,j < 0
+ * match any baseline and pol == 0 matches any polarization.
+ */
+PyObject * UVObject_seek(UVObject *self, PyObject *args) {
+    double t;
+    int i, j, pol;
+    size_t k, n;
+    if (!PyArg_ParseTuple(args, "diii", &t, &i, &j, &pol)) return NULL;
+    try {
+        MIRIAD_GUARD;
+        if (uvindex_get(self) != 0) {
+            PyErr_Format(PyExc_ValueError, "seek requires a UV file opened 'old'");
+            return NULL;
+        }
+        UVIndex *idx = self->index;
+        n = idx->ent.size();
+        for (k=0; k < n; k++) {
+            const UVIndexEntry &e = idx->ent[k];
+            if (e.time < t) continue;
+            if (i >= 0 && !((GETI(e.bl) == i && GETJ(e.bl) == j) ||
+                    (GETI(e.bl) == j && GETJ(e.bl) == i))) continue;
+            if (pol != 0 && e.pol != pol) continue;
+            break;
+        }
+        if (k == n) {
+            PyErr_Format(PyExc_IOError, "No matching record");
+            return NULL;
+        }
+        uvindex_seek(self, k);
+        self->intcnt = -1;
+        self->curtime = -1;
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Return the time, baseline (i,j), and polarization of every record, in
+ * file order, from the record index (building it if needed, which rewinds
+ * the file).  No correlation data are decoded.
+ */
+PyObject * UVObject_records(UVObject *self) {
+    PyArrayObject *t=NULL, *i=NULL, *j=NULL, *pol=NULL;
+    npy_intp dims[1];
+    try {
+        MIRIAD_GUARD;
+        if (uvindex_get(self) != 0) {
+            PyErr_Format(PyExc_ValueError, "_records requires a UV file opened 'old'");
+            return NULL;
+        }
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    UVIndex *idx = self->index;
+    dims[0] = idx->ent.size();
+    t = (PyArrayObject *) PyArray_SimpleNew(1, dims, PyArray_DOUBLE);
+    i = (PyArrayObject *) PyArray_SimpleNew(1, dims, PyArray_INT);
+    j = (PyArrayObject *) PyArray_SimpleNew(1, dims, PyArray_INT);
+    pol = (PyArrayObject *) PyArray_SimpleNew(1, dims, PyArray_INT);
+    if (t == NULL || i == NULL || j == NULL || pol == NULL) {
+        Py_XDECREF(t); Py_XDECREF(i); Py_XDECREF(j); Py_XDECREF(pol);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate record arrays");
+        return NULL;
+    }
+    for (npy_intp k=0; k < dims[0]; k++) {
+        const UVIndexEntry &e = idx->ent[k];
+        IND1(t,k,double) = e.time;
+        IND1(i,k,int) = GETI(e.bl);
+        IND1(j,k,int) = GETJ(e.bl);
+        IND1(pol,k,int) = e.pol;
+    }
+    return Py_BuildValue("(NNNN)", PyArray_Return(t), PyArray_Return(i),
+        PyArray_Return(j), PyArray_Return(pol));
+}
+
+// The SMA MIR reader (mir/sma_mirRead.c), which writes as it reads
+extern "C" {
+void rspokeinisma_c(char *kst[], int tno1, int *dosam1, int *doxyp1,
+    int *doop1, int *dohann1, int *birdie1, int *dowt1, int *dopmps1,
+    int *dobary1, int *doif1, int *hires1, int *nopol1, int *circular1,
+    int *linear1, int *oldpol1, double lat1, double long1, int rsnchan1,
+    int refant1, int *dolsr1, double rfreq1, float *vsour1,
+    double *antpos1, int readant1, int *noskip1, int *spskip1,
+    int *dsb1, int *mcconfig1, int *nohighspr1);
+void rssmaflush_c(int scanskip, int scanproc, int sb, int rxif,
+    int dosporder, int doeng, int doflppha);
+int rsmir_Read(char *datapath, int jstat);
+}
+
+// The MIR reader keeps its state in globals, so one conversion at a time
+static pthread_mutex_t sma_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Convert the SMA MIR data set in directory mirdir into this (new) UV file,
+ * one integration at a time, as MIRIAD's smalod does.  sb selects the
+ * sideband (0=lsb,1=usb), rxif the receiver (-1 for any), rsnchan resamples
+ * every chunk to that many channels (-1 to keep them), scanskip/scanproc
+ * skip and then process that many integrations (scanproc=0 for the rest),
+ * and polmode labels the data unpolarized (0), linear (1), or circular (2).
+ * lat and lon (radians) locate the array.  The GIL is released, but the
+ * reader itself is not reentrant, so conversions are serialized.
+ */
+PyObject * UVObject_sma_read(UVObject *self, PyObject *args) {
+    char *mirdir;
+    int sb=0, rxif=-1, rsnchan=-1, scanskip=0, scanproc=0, polmode=0;
+    double lat=0.34599, lon=-2.71359;
+    if (!PyArg_ParseTuple(args, "s|iiiiiidd", &mirdir, &sb, &rxif, &rsnchan,
+            &scanskip, &scanproc, &polmode, &lat, &lon))
+        return NULL;
+    if (self->status != 'n') {
+        PyErr_Format(PyExc_ValueError, "_sma_read requires a UV file opened 'new'");
+        return NULL;
+    }
+    if (sb != 0 && sb != 1) {
+        PyErr_Format(PyExc_ValueError, "sb must be 0 (lsb) or 1 (usb)");
+        return NULL;
+    }
+    if (polmode < 0 || polmode > 2) {
+        PyErr_Format(PyExc_ValueError, "polmode must be 0, 1, or 2");
+        return NULL;
+    }
+    if (scanskip < 0 || scanproc < 0) {
+        PyErr_Format(PyExc_ValueError, "scanskip and scanproc must be >= 0");
+        return NULL;
+    }
+    // The reader appends its file names straight onto the directory
+    std::string path(mirdir);
+    if (path.empty() || path[path.size()-1] != '/') path += '/';
+    try {
+        AllowThreads nogil;
+        MutexLock lock(&sma_lock);
+        MIRIAD_GUARD;
+        char *kst[4];
+        // doif=1 writes all chunks of a baseline as one record, as smalod
+        int no=0, doif=1, nopol=(polmode==0), linear=(polmode==1),
+            circular=(polmode==2), readant=0, spskip[2]={0,0};
+        float vsource=0;
+        double antpos[1]={0};
+        kst[0] = NULL;
+        rspokeinisma_c(kst, self->tno, &no, &no, &no, &no, &no, &no, &no,
+            &no, &doif, &no, &nopol, &circular, &linear, &no, lat, lon, rsnchan,
+            0, &no, 0., &vsource, antpos, readant, &no, spskip, &no, &no,
+            &no);
+        rsmir_Read((char *)path.c_str(), -3);
+        rssmaflush_c(scanskip, scanproc, sb, rxif, 0, 0, 0);
+        rsmir_Read((char *)path.c_str(), 0);
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 // A thin wrapper over haccess_c
 PyObject * UVObject_haccess(UVObject *self, PyObject *args) {
     char *name, *mode;
     int item_hdl, iostat;
     if (!PyArg_ParseTuple(args, "ss", &name, &mode)) return NULL;
     try {
+        MIRIAD_GUARD;
         haccess_c(self->tno, &item_hdl, name, mode, &iostat);
         CHK_IO(iostat);
         return PyInt_FromLong(item_hdl);
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
 }
@@ -372,11 +1018,12 @@ PyObject * WRAP_hdaccess(UVObject *self, PyObject *args) {
     int item_hdl, iostat;
     if (!PyArg_ParseTuple(args, "i", &item_hdl)) return NULL;
     try {
+        MIRIAD_GUARD;
         hdaccess_c(item_hdl, &iostat);
         Py_INCREF(Py_None);
         return Py_None;
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
 }
@@ -392,6 +1039,7 @@ PyObject * WRAP_hwrite_init(PyObject *self, PyObject *args) {
     char *type;
     if (!PyArg_ParseTuple(args, "is", &item_hdl, &type)) return NULL;
     try {
+        MIRIAD_GUARD;
         switch(type[0]) {
             case 'a': INIT(char_item,H_BYTE_SIZE); break;
             case 'b': INIT(binary_item,ITEM_HDR_SIZE); break;
@@ -407,7 +1055,7 @@ PyObject * WRAP_hwrite_init(PyObject *self, PyObject *args) {
         }
         return PyInt_FromLong(offset);
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
 }
@@ -419,6 +1067,7 @@ PyObject * WRAP_hread_init(PyObject *self, PyObject *args) {
     char s[ITEM_HDR_SIZE];
     if (!PyArg_ParseTuple(args, "i", &item_hdl)) return NULL;
     try {
+        MIRIAD_GUARD;
         hreadb_c(item_hdl,s,0,ITEM_HDR_SIZE,&iostat);
         CHK_IO(iostat);
         code = FIRSTINT(s);
@@ -449,7 +1098,7 @@ PyObject * WRAP_hread_init(PyObject *self, PyObject *args) {
         PyErr_Format(PyExc_RuntimeError, "unknown item type");
         return NULL;
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
 }
@@ -464,6 +1113,7 @@ PyObject * WRAP_hwrite(PyObject *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "iiOs", &item_hdl, &offset, &val, &type))
         return NULL;
     try {
+        MIRIAD_GUARD;
         switch (type[0]) {
             case 'a':
                 CHK_STRING(val);
@@ -522,7 +1172,7 @@ PyObject * WRAP_hwrite(PyObject *self, PyObject *args) {
         }
         return PyInt_FromLong(offset);
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
 }
@@ -537,6 +1187,7 @@ PyObject * WRAP_hread(PyObject *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "iis", &item_hdl, &offset, &type))
         return NULL;
     try {
+        MIRIAD_GUARD;
         switch (type[0]) {
             case 'a':
                 hreadb_c(item_hdl, st, offset, H_BYTE_SIZE, &iostat);
@@ -574,9 +1225,483 @@ PyObject * WRAP_hread(PyObject *self, PyObject *args) {
                 return NULL;
         }
     } catch (MiriadError &e) {
-        PyErr_Format(PyExc_RuntimeError, e.get_message());
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+}
+
+// The hio type, size on disk, and numpy type of each Miriad item type
+static bool htype_info(char type, int *htype, int *size, int *npytype) {
+    switch (type) {
+        case 'a': *htype=H_BYTE; *size=H_BYTE_SIZE; *npytype=NPY_BYTE; break;
+        case 'i': *htype=H_INT; *size=H_INT_SIZE; *npytype=NPY_INT; break;
+        case 'j': *htype=H_INT2; *size=H_INT2_SIZE; *npytype=NPY_INT; break;
+        case 'l': *htype=H_INT8; *size=H_INT8_SIZE; *npytype=NPY_LONGLONG; break;
+        case 'r': *htype=H_REAL; *size=H_REAL_SIZE; *npytype=NPY_FLOAT; break;
+        case 'd': *htype=H_DBLE; *size=H_DBLE_SIZE; *npytype=NPY_DOUBLE; break;
+        case 'c': *htype=H_CMPLX; *size=H_CMPLX_SIZE; *npytype=NPY_CFLOAT; break;
+        default: return false;
+    }
+    return true;
+}
+
+/* hread_array reads count values of the given type with one hread_c call,
+ * returning a numpy array (or a string for type 'a').  count=-1 reads to
+ * the end of the item. */
+PyObject * WRAP_hread_array(PyObject *self, PyObject *args) {
+    int item_hdl, offset, count=-1, iostat, htype, size, npytype;
+    char *type, *buf;
+    PyObject *rv=NULL;
+    if (!PyArg_ParseTuple(args, "iis|i", &item_hdl, &offset, &type, &count))
+        return NULL;
+    if (!htype_info(type[0], &htype, &size, &npytype)) {
+        PyErr_Format(PyExc_ValueError, "unknown item type: %c",type[0]);
+        return NULL;
+    }
+    try {
+        MIRIAD_GUARD;
+        if (count < 0) count = max(0, (int)(hsize_c(item_hdl) - offset) / size);
+        if (type[0] == 'a') {
+            rv = PyString_FromStringAndSize(NULL, count);
+            CHK_NULL(rv);
+            buf = PyString_AS_STRING(rv);
+        } else {
+            npy_intp dims[1] = {count};
+            rv = PyArray_SimpleNew(1, dims, npytype);
+            CHK_NULL(rv);
+            buf = ((PyArrayObject *)rv)->data;
+        }
+        iostat = 0;
+        if (count > 0) {
+            AllowThreads nogil;
+            MIRIAD_GUARD;
+            hio_c(item_hdl, FALSE, htype, buf, offset, count*size, &iostat);
+        }
+        if (iostat != 0) Py_DECREF(rv);
+        CHK_IO(iostat);
+        return rv;
+    } catch (MiriadError &e) {
+        Py_XDECREF(rv);
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+}
+
+/* hwrite_array writes an array (or a string for type 'a') of values of the
+ * given type with one hwrite_c call.  Returns the number of bytes written. */
+PyObject * WRAP_hwrite_array(PyObject *self, PyObject *args) {
+    int item_hdl, offset, iostat, htype, size, npytype, count;
+    char *type, *buf;
+    PyObject *val;
+    PyArrayObject *arr=NULL;
+    if (!PyArg_ParseTuple(args, "iiOs", &item_hdl, &offset, &val, &type))
+        return NULL;
+    if (!htype_info(type[0], &htype, &size, &npytype)) {
+        PyErr_Format(PyExc_ValueError, "unknown item type: %c",type[0]);
+        return NULL;
+    }
+    if (type[0] == 'a') {
+        CHK_STRING(val);
+        buf = PyString_AsString(val);
+        count = PyString_Size(val);
+    } else {
+        if (htype == H_INT || htype == H_INT2) {
+            // Range-check through a wide copy; the cast to int would wrap
+            long long lo = (htype == H_INT) ? INT_MIN : SHRT_MIN;
+            long long hi = (htype == H_INT) ? INT_MAX : SHRT_MAX;
+            PyArrayObject *wide = (PyArrayObject *) PyArray_FROM_OTF(val,
+                NPY_LONGLONG, NPY_IN_ARRAY | NPY_FORCECAST);
+            if (wide == NULL) return NULL;
+            npy_longlong *w = (npy_longlong *) wide->data;
+            for (npy_intp i=0; i < PyArray_SIZE(wide); i++) {
+                if (w[i] < lo || w[i] > hi) {
+                    PyErr_Format(PyExc_ValueError,
+                        "value %lld out of range for item type %c",
+                        (long long) w[i], type[0]);
+                    Py_DECREF(wide);
+                    return NULL;
+                }
+            }
+            arr = (PyArrayObject *) PyArray_FROM_OTF((PyObject *) wide,
+                npytype, NPY_IN_ARRAY | NPY_FORCECAST);
+            Py_DECREF(wide);
+        } else {
+            arr = (PyArrayObject *) PyArray_FROM_OTF(val, npytype,
+                NPY_IN_ARRAY | NPY_FORCECAST);
+        }
+        if (arr == NULL) return NULL;
+        buf = arr->data;
+        count = PyArray_SIZE(arr);
+    }
+    try {
+        AllowThreads nogil;
+        MIRIAD_GUARD;
+        hio_c(item_hdl, TRUE, htype, buf, offset, count*size, &iostat);
+    } catch (MiriadError &e) {
+        Py_XDECREF(arr);
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    Py_XDECREF(arr);
+    CHK_IO(iostat);
+    return PyInt_FromLong(count*size);
+}
+
+/* Image cubes go through xyzio, which buffers whole subcubes (planes,
+ * profiles, ...) between the file and the caller.  xyzio keeps its buffers
+ * and state in globals, so every call holds xyz_lock.  The wrapper also
+ * remembers the current xyzsetup of each open image, so that reads and
+ * writes can be checked against it before xyzio sees them. */
+typedef struct {
+    bool open;
+    int naxis;
+    int subsize;    // pixels per subcube (vircubesize[dimsub-1])
+    int nsub;       // number of subcubes
+    int *maskbuf;   // MIRIAD-style mask for one subcube
+} XYZState;
+
+static pthread_mutex_t xyz_lock = PTHREAD_MUTEX_INITIALIZER;
+static XYZState xyz_state[MAXOPEN];
+
+// Return the state of an open image, or set an exception and return NULL
+static XYZState *xyz_get(int tno) {
+    if (tno < 0 || tno >= MAXOPEN || !xyz_state[tno].open) {
+        PyErr_Format(PyExc_ValueError, "%d is not an open image handle", tno);
+        return NULL;
+    }
+    return &xyz_state[tno];
+}
+
+/* Open an image cube ('old' or 'new').  For a new cube, axlen gives the
+ * length of each axis (x first).  Returns (handle, axlen). */
+PyObject * WRAP_xyzopen(PyObject *self, PyObject *args) {
+    char *name, *status;
+    PyObject *axobj=NULL;
+    int tno, naxis=MAXNAX, axlen[MAXNAX];
+    if (!PyArg_ParseTuple(args, "ss|O", &name, &status, &axobj)) return NULL;
+    if (strcmp(status, "old") != 0 && strcmp(status, "new") != 0) {
+        PyErr_Format(PyExc_ValueError, "status must be 'old' or 'new'");
+        return NULL;
+    }
+    if (status[0] == 'n') {
+        if (axobj == NULL || !PySequence_Check(axobj)) {
+            PyErr_Format(PyExc_ValueError, "a new image needs axlen");
+            return NULL;
+        }
+        naxis = PySequence_Size(axobj);
+        if (naxis < 1 || naxis > MAXNAX) {
+            PyErr_Format(PyExc_ValueError, "images have 1 to %d axes", MAXNAX);
+            return NULL;
+        }
+        for (int d=0; d < naxis; d++) {
+            PyObject *o = PySequence_GetItem(axobj, d);
+            if (o == NULL) return NULL;
+            axlen[d] = PyInt_AsLong(o);
+            Py_DECREF(o);
+            if (axlen[d] <= 0) {
+                if (!PyErr_Occurred())
+                    PyErr_Format(PyExc_ValueError, "axis lengths must be > 0");
+                return NULL;
+            }
+        }
+    }
+    try {
+        AllowThreads nogil;
+        MutexLock lock(&xyz_lock);
+        MIRIAD_GUARD;
+        xyzopen_c(&tno, name, status, &naxis, axlen);
+        XYZState *st = &xyz_state[tno];
+        st->open = true;
+        st->naxis = naxis;
+        st->subsize = st->nsub = 0;
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    PyObject *rv = PyTuple_New(naxis);
+    CHK_NULL(rv);
+    for (int d=0; d < naxis; d++)
+        PyTuple_SET_ITEM(rv, d, PyInt_FromLong(axlen[d]));
+    return Py_BuildValue("(iN)", tno, rv);
+}
+
+// Flush and close an image cube
+PyObject * WRAP_xyzclose(PyObject *self, PyObject *args) {
+    int tno;
+    if (!PyArg_ParseTuple(args, "i", &tno)) return NULL;
+    XYZState *st = xyz_get(tno);
+    if (st == NULL) return NULL;
+    try {
+        AllowThreads nogil;
+        MutexLock lock(&xyz_lock);
+        MIRIAD_GUARD;
+        st->open = false;
+        free(st->maskbuf);
+        st->maskbuf = NULL;
+        xyzclose_c(tno);
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Select the subcubes to read or write (see xyzsetup): subcube names their
+ * axes ('xy' for planes, 'z' for spectra, ...) and blc, trc (1-based,
+ * inclusive, one per axis) bound the region.  Returns (subsize, nsub), the
+ * number of pixels in each subcube and the number of subcubes. */
+PyObject * WRAP_xyzsetup(PyObject *self, PyObject *args) {
+    int tno, blc[MAXNAX], trc[MAXNAX], viraxlen[MAXNAX], vircubesize[MAXNAX];
+    int dimsub=0;
+    char *subcube;
+    PyObject *blcobj, *trcobj;
+    if (!PyArg_ParseTuple(args, "isOO", &tno, &subcube, &blcobj, &trcobj))
+        return NULL;
+    XYZState *st = xyz_get(tno);
+    if (st == NULL) return NULL;
+    if (!PySequence_Check(blcobj) || !PySequence_Check(trcobj) ||
+            PySequence_Size(blcobj) != st->naxis ||
+            PySequence_Size(trcobj) != st->naxis) {
+        PyErr_Format(PyExc_ValueError, "blc and trc need %d values", st->naxis);
+        return NULL;
+    }
+    for (int d=0; d < st->naxis; d++) {
+        PyObject *b = PySequence_GetItem(blcobj, d);
+        PyObject *t = PySequence_GetItem(trcobj, d);
+        if (b != NULL) blc[d] = PyInt_AsLong(b);
+        if (t != NULL) trc[d] = PyInt_AsLong(t);
+        Py_XDECREF(b); Py_XDECREF(t);
+        if (PyErr_Occurred()) return NULL;
+    }
+    for (char *c=subcube; *c != '\0'; c++) if (isalpha(*c)) dimsub++;
+    if (dimsub > st->naxis) {
+        PyErr_Format(PyExc_ValueError, "subcube '%s' has too many axes", subcube);
+        return NULL;
+    }
+    try {
+        AllowThreads nogil;
+        MutexLock lock(&xyz_lock);
+        MIRIAD_GUARD;
+        xyzsetup_c(tno, subcube, blc, trc, viraxlen, vircubesize);
+        st->subsize = (dimsub == 0) ? 1 : vircubesize[dimsub-1];
+        st->nsub = vircubesize[st->naxis-1] / st->subsize;
+        free(st->maskbuf);
+        st->maskbuf = (int *) malloc(st->subsize * sizeof(int));
+        if (st->maskbuf == NULL) bug_c('f', "Out of memory, in xyzsetup");
+    } catch (MiriadError &e) {
+        st->subsize = st->nsub = 0;
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    return Py_BuildValue("ii", st->subsize, st->nsub);
+}
+
+/* Read subcube number k (from 0, in the order set up by xyzsetup),
+ * returning (data, flags) as float32 and bool arrays of the subcube's
+ * pixels, the first subcube axis varying fastest.  flags are True where
+ * pixels are blanked (numpy's mask convention). */
+PyObject * WRAP_xyzread(PyObject *self, PyObject *args) {
+    int tno, k, ndata, coords[MAXNAX];
+    PyArrayObject *data=NULL, *flags=NULL;
+    npy_intp dims[1];
+    if (!PyArg_ParseTuple(args, "ii", &tno, &k)) return NULL;
+    XYZState *st = xyz_get(tno);
+    if (st == NULL) return NULL;
+    if (k < 0 || k >= st->nsub) {
+        PyErr_Format(PyExc_IndexError, "subcube %d not in [0,%d)", k, st->nsub);
+        return NULL;
+    }
+    dims[0] = st->subsize;
+    data = (PyArrayObject *) PyArray_SimpleNew(1, dims, PyArray_FLOAT);
+    flags = (PyArrayObject *) PyArray_SimpleNew(1, dims, NPY_BOOL);
+    if (data == NULL || flags == NULL) {
+        Py_XDECREF(data); Py_XDECREF(flags);
+        PyErr_Format(PyExc_MemoryError, "Failed to allocate subcube arrays");
+        return NULL;
+    }
+    try {
+        AllowThreads nogil;
+        MutexLock lock(&xyz_lock);
+        MIRIAD_GUARD;
+        xyzs2c_c(tno, k, coords);
+        xyzread_c(tno, coords, (float *)data->data, st->maskbuf, &ndata);
+        mkmask_c(st->maskbuf, (char *)flags->data, st->subsize);
+    } catch (MiriadError &e) {
+        Py_DECREF(data); Py_DECREF(flags);
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    return Py_BuildValue("(NN)", PyArray_Return(data), PyArray_Return(flags));
+}
+
+/* Write subcube number k (from 0, as for xyzread) from C-contiguous data
+ * (float32) and flags (bool, True where blanked), each holding the pixels
+ * of one subcube. */
+PyObject * WRAP_xyzwrite(PyObject *self, PyObject *args) {
+    int tno, k, coords[MAXNAX];
+    PyArrayObject *data, *flags;
+    if (!PyArg_ParseTuple(args, "iiO!O!", &tno, &k, &PyArray_Type, &data,
+            &PyArray_Type, &flags)) return NULL;
+    XYZState *st = xyz_get(tno);
+    if (st == NULL) return NULL;
+    if (k < 0 || k >= st->nsub) {
+        PyErr_Format(PyExc_IndexError, "subcube %d not in [0,%d)", k, st->nsub);
+        return NULL;
+    }
+    CHK_ARRAY_TYPE(data, NPY_FLOAT);
+    CHK_ARRAY_TYPE(flags, NPY_BOOL);
+    if (PyArray_SIZE(data) != st->subsize || PyArray_SIZE(flags) != st->subsize ||
+            !PyArray_ISCONTIGUOUS(data) || !PyArray_ISCONTIGUOUS(flags)) {
+        PyErr_Format(PyExc_ValueError,
+            "data and flags must be C-contiguous with %d pixels", st->subsize);
+        return NULL;
+    }
+    try {
+        AllowThreads nogil;
+        MutexLock lock(&xyz_lock);
+        MIRIAD_GUARD;
+        mkunmask_c(flags->data, st->maskbuf, st->subsize);
+        xyzs2c_c(tno, k, coords);
+        xyzwrite_c(tno, coords, (float *)data->data, st->maskbuf, &st->subsize);
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
         return NULL;
     }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Read a header keyword of any data set handle as an int, float, or str,
+ * depending on how it was stored.  Raises KeyError if it is not present. */
+PyObject * WRAP_rdhd(PyObject *self, PyObject *args) {
+    int tno, n, ival;
+    float rval;
+    double dval;
+    char *name, descr[MAXPATH], type[MAXPATH];
+    if (!PyArg_ParseTuple(args, "is", &tno, &name)) return NULL;
+    try {
+        AllowThreads nogil;
+        MIRIAD_GUARD;
+        hdprobe_c(tno, name, descr, MAXPATH, type, &n);
+        if (strcmp(type, "integer") == 0 && n == 1)
+            rdhdi_c(tno, name, &ival, 0);
+        else if (strcmp(type, "real") == 0 && n == 1)
+            rdhdr_c(tno, name, &rval, 0.);
+        else if (strcmp(type, "double") == 0 && n == 1)
+            rdhdd_c(tno, name, &dval, 0.);
+        else if (strcmp(type, "character") == 0)
+            rdhda_c(tno, name, descr, "", MAXPATH);
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    if (strcmp(type, "nonexistent") == 0) {
+        PyErr_SetString(PyExc_KeyError, name);
+        return NULL;
+    } else if (strcmp(type, "integer") == 0 && n == 1) {
+        return PyInt_FromLong(ival);
+    } else if (strcmp(type, "real") == 0 && n == 1) {
+        return PyFloat_FromDouble(rval);
+    } else if (strcmp(type, "double") == 0 && n == 1) {
+        return PyFloat_FromDouble(dval);
+    } else if (strcmp(type, "character") == 0) {
+        return PyString_FromString(descr);
+    }
+    PyErr_Format(PyExc_ValueError, "%s is a %s item; use hread_array", name, type);
+    return NULL;
+}
+
+/* Write a header keyword of any data set handle: ints are written as
+ * integers, floats as doubles, and strings as characters. */
+PyObject * WRAP_wrhd(PyObject *self, PyObject *args) {
+    int tno;
+    char *name, *sval=NULL;
+    long ival=0;
+    double dval=0;
+    PyObject *val;
+    if (!PyArg_ParseTuple(args, "isO", &tno, &name, &val)) return NULL;
+    if (PyString_Check(val)) sval = PyString_AsString(val);
+    else if (PyInt_Check(val)) ival = PyInt_AsLong(val);
+    else if (PyFloat_Check(val)) dval = PyFloat_AsDouble(val);
+    else {
+        PyErr_Format(PyExc_ValueError, "expected an int, float, or string");
+        return NULL;
+    }
+    bool isint = PyInt_Check(val);
+    try {
+        AllowThreads nogil;
+        MIRIAD_GUARD;
+        if (sval != NULL) wrhda_c(tno, name, sval);
+        else if (isint) wrhdi_c(tno, name, ival);
+        else wrhdd_c(tno, name, dval);
+    } catch (MiriadError &e) {
+        PyErr_SetString(PyExc_RuntimeError, e.get_message());
+        return NULL;
+    }
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/* Encode each row of a C-contiguous (nrec,nchan) complex64 array as 'j'
+ * corr data, as uvwrite_c would, returning the packed int16 values (in file
+ * byte order) and the tscale of each row.  This is only the scaling and
+ * packing (no i/o), so that it can be timed on its own. */
+PyObject * WRAP_corrj_pack(PyObject *self, PyObject *args) {
+    PyArrayObject *data, *packed, *tscale;
+    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &data)) return NULL;
+    CHK_ARRAY_TYPE(data, NPY_CFLOAT);
+    if (RANK(data) != 2 || !PyArray_ISCONTIGUOUS(data) ||
+            !PyArray_ISNOTSWAPPED(data)) {
+        PyErr_Format(PyExc_ValueError,
+            "data must be a 2 dimensional, C-contiguous, native array");
+        return NULL;
+    }
+    int nrec = DIM(data,0), n = 2 * DIM(data,1);
+    npy_intp dims[2] = {nrec, n};
+    packed = (PyArrayObject *) PyArray_SimpleNew(2, dims, NPY_SHORT);
+    tscale = (PyArrayObject *) PyArray_SimpleNew(1, dims, NPY_FLOAT);
+    if (packed == NULL || tscale == NULL) {
+        Py_XDECREF(packed); Py_XDECREF(tscale);
+        return PyErr_NoMemory();
+    }
+    {
+        AllowThreads nogil;
+        std::vector<int> work(n > 0 ? n : 1);
+        for (int k=0; k < nrec; k++)
+            uvjpack_c((float *)data->data + k*n, packed->data + 2*k*n,
+                &work[0], n, (float *)tscale->data + k);
+    }
+    return Py_BuildValue("(NN)", (PyObject *)packed, (PyObject *)tscale);
+}
+
+/* Decode the output of corrj_pack back to a (nrec,nchan) complex64 array,
+ * as uvread_c would. */
+PyObject * WRAP_corrj_unpack(PyObject *self, PyObject *args) {
+    PyArrayObject *packed, *tscale, *data;
+    if (!PyArg_ParseTuple(args, "O!O!", &PyArray_Type, &packed,
+        &PyArray_Type, &tscale)) return NULL;
+    CHK_ARRAY_TYPE(packed, NPY_SHORT);
+    CHK_ARRAY_TYPE(tscale, NPY_FLOAT);
+    if (RANK(packed) != 2 || RANK(tscale) != 1 || DIM(packed,1) % 2 != 0 ||
+            DIM(tscale,0) != DIM(packed,0) || !PyArray_ISCONTIGUOUS(packed)
+            || !PyArray_ISCONTIGUOUS(tscale)) {
+        PyErr_Format(PyExc_ValueError,
+            "packed must be C-contiguous (nrec,2*nchan), tscale (nrec,)");
+        return NULL;
+    }
+    int nrec = DIM(packed,0), n = DIM(packed,1);
+    npy_intp dims[2] = {nrec, n / 2};
+    data = (PyArrayObject *) PyArray_SimpleNew(2, dims, NPY_CFLOAT);
+    CHK_NULL(data);
+    {
+        AllowThreads nogil;
+        std::vector<int> work(n > 0 ? n : 1);
+        for (int k=0; k < nrec; k++)
+            uvjunpack_c(packed->data + 2*k*n, (float *)data->data + k*n,
+                &work[0], n, ((float *)tscale->data)[k]);
+    }
+    return PyArray_Return(data);
 }
 
 /*_        __                     _               _   _       
@@ -590,10 +1715,16 @@ PyObject * WRAP_hread(PyObject *self, PyObject *args) {
 static PyMethodDef UVObject_methods[] = {
     {"rewind", (PyCFunction)UVObject_rewind, METH_NOARGS,
         "rewind()\nSeek to the beginning of a UV file."},
+    {"_seek", (PyCFunction)UVObject_seek, METH_VARARGS,
+        "_seek(t,i,j,pol)\nUse the record index to seek to the first record at or after time t with baseline (i,j) and polarization pol.  i,j = -1 matches any baseline and pol = 0 matches any polarization.  Raises IOError if no record matches."},
+    {"_records", (PyCFunction)UVObject_records, METH_NOARGS,
+        "_records()\nReturn arrays (t,i,j,pol) giving the time, baseline, and polarization (0 if there is no pol variable) of every record, in file order, from the record index.  Rewinds the file if the index has to be built."},
     {"raw_read", (PyCFunction)UVObject_read, METH_VARARGS,
-        "_read(num)\nRead up to the specified number of channels from a spectrum.  Returns (preamble, data, flags) where preamble = (uvw,time,(ant_i,ant_j)), data = complex64 numpy array of data, flags = integer32 array of data valid where == 1.  Note that this definition of flags is the inverse of numpy's definition."},
+        "raw_read(num[,start,step])\nRead up to the specified number of channels from a spectrum, or exactly num channels start, start+step, ... if start or step are given (only those are decoded).  Returns (preamble, data, flags, nread) where preamble = (uvw,time,(ant_i,ant_j)), data = complex64 numpy array of data, flags = bool array that is True where data are flagged (numpy's mask convention)."},
     {"raw_write", (PyCFunction)UVObject_write, METH_VARARGS,
-        "_write(preamble,data,flags)\nWrite the provided preamble, data, flags to file.  See _read() for definitions of preamble, data, flags."},
+        "_write(preamble,data,flags,valid=0)\nWrite the provided preamble, data, flags to file.  See _read() for definitions of preamble, data.  flags is a bool mask (True where flagged), or if valid is set, an integer32 array of data valid where == 1."},
+    {"write_block", (PyCFunction)UVObject_write_block, METH_VARARGS,
+        "write_block(uvw,t,i,j,data,flags)\nWrite N records at once, where uvw is (N,3), t, i, j have length N, and data (complex64) and flags are (N,nchan) and C-contiguous.  flags is a bool mask (True where flagged).  The records are encoded without the GIL and written in large blocks."},
     {"copyvr", (PyCFunction)UVObject_copyvr, METH_VARARGS,
         "copyvr(uv)\nCopy any variables which changed during the last read into the provided uv interface."},
     {"trackvr", (PyCFunction)UVObject_trackvr, METH_VARARGS,
@@ -604,6 +1735,8 @@ static PyMethodDef UVObject_methods[] = {
         "_wrvr(name,type,val)\nWrite a value to a variable of the provided Miriad type (see _rdvr()).  If val is an array, multiple values will be written."},
     {"_select", (PyCFunction)UVObject_select, METH_VARARGS,
         "_select(name,n1,n2,include)\nSelect which data is returned by _read().  See select() for more information."},
+    {"_sma_read", (PyCFunction)UVObject_sma_read, METH_VARARGS,
+        "_sma_read(mirdir,sb=0,rxif=-1,rsnchan=-1,scanskip=0,scanproc=0,polmode=0,lat,lon)\nConvert the SMA MIR data set in directory mirdir into this UV file (opened 'new'), one integration at a time.  sb is the sideband (0=lsb,1=usb), rxif the receiver (-1=any), rsnchan resamples chunks to that many channels (-1=no), scanskip/scanproc skip and then process that many integrations (0=all), polmode labels data unpolarized (0), linear (1), or circular (2), and lat/lon (radians) default to the SMA."},
     {"haccess", (PyCFunction)UVObject_haccess, METH_VARARGS,
         "haccess(name,mode)\nOpen a header item in the given mode ('read','write').  Returns an integer handle."},
     {NULL}  /* Sentinel */
@@ -663,6 +1796,28 @@ static PyMethodDef _miriad_methods[] = {
         "hwrite(handle,offset,value,type)\nWrite a value at the provided offset to an open header item of the given type."},
     {"hread", (PyCFunction)WRAP_hread, METH_VARARGS,
         "hread(handle,offset,type)\nRead a value of the given type from an open header item at the provided offset."},
+    {"hwrite_array", (PyCFunction)WRAP_hwrite_array, METH_VARARGS,
+        "hwrite_array(handle,offset,values,type)\nWrite an array (or a string for type 'a') of values at the provided offset to an open header item of the given type (a,i,j,l,r,d,c).  Returns the number of bytes written."},
+    {"hread_array", (PyCFunction)WRAP_hread_array, METH_VARARGS,
+        "hread_array(handle,offset,type,count=-1)\nRead count values of the given type (a,i,j,l,r,d,c) from an open header item at the provided offset, returning a numpy array (or a string for type 'a').  count=-1 reads to the end of the item."},
+    {"xyzopen", (PyCFunction)WRAP_xyzopen, METH_VARARGS,
+        "xyzopen(name,status,axlen=None)\nOpen an image cube ('old' or 'new'; a new cube needs axlen, the length of each axis, x first).  Returns (handle, axlen)."},
+    {"xyzclose", (PyCFunction)WRAP_xyzclose, METH_VARARGS,
+        "xyzclose(handle)\nFlush and close an image cube."},
+    {"xyzsetup", (PyCFunction)WRAP_xyzsetup, METH_VARARGS,
+        "xyzsetup(handle,subcube,blc,trc)\nSelect the subcubes read or written: subcube names their axes ('xy' for planes, 'z' for spectra, '-' reverses an axis) and blc, trc (1-based, inclusive, one per axis) bound the region.  Returns (subsize, nsub), the pixels per subcube and the number of subcubes."},
+    {"xyzread", (PyCFunction)WRAP_xyzread, METH_VARARGS,
+        "xyzread(handle,k)\nRead subcube k (from 0) as (data, flags): float32 and bool arrays (True where blanked) with the first subcube axis varying fastest."},
+    {"xyzwrite", (PyCFunction)WRAP_xyzwrite, METH_VARARGS,
+        "xyzwrite(handle,k,data,flags)\nWrite subcube k (from 0) from C-contiguous float32 data and bool flags (True where blanked) ordered as for xyzread."},
+    {"rdhd", (PyCFunction)WRAP_rdhd, METH_VARARGS,
+        "rdhd(handle,name)\nRead a scalar or string header keyword of a data set.  Raises KeyError if it is not present."},
+    {"wrhd", (PyCFunction)WRAP_wrhd, METH_VARARGS,
+        "wrhd(handle,name,value)\nWrite a header keyword of a data set: an int, a float (as a double), or a string."},
+    {"corrj_pack", (PyCFunction)WRAP_corrj_pack, METH_VARARGS,
+        "corrj_pack(data)\nScale and pack each row of a C-contiguous (nrec,nchan) complex64 array to 16 bit integers, as 'j' corr data are written.  Returns (packed, tscale): an int16 (nrec,2*nchan) array in file (big-endian) byte order, and the float32 scale of each row.  Does no i/o; for timing the encoding."},
+    {"corrj_unpack", (PyCFunction)WRAP_corrj_unpack, METH_VARARGS,
+        "corrj_unpack(packed,tscale)\nDecode the output of corrj_pack back to a (nrec,nchan) complex64 array, as 'j' corr data are read."},
     {NULL}  /* Sentinel */
 };
 
@@ -680,5 +1835,10 @@ PyMODINIT_FUNC init_miriad(void) {
     import_array();
     Py_INCREF(&UVType);
     PyModule_AddObject(m, "UV", (PyObject *)&UVType);
+#if defined(MIR_SSE2)
+    PyModule_AddIntConstant(m, "SIMD", 1);
+#else
+    PyModule_AddIntConstant(m, "SIMD", 0);
+#endif
 }
 
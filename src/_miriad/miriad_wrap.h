@@ -8,8 +8,11 @@
 #include <Python.h>
 #include "numpy/arrayobject.h"
 #include <string>
+#include <vector>
+#include <pthread.h>
 #include "hio.h"
 #include "io.h"
+#include "maxdimc.h"
 
 // Some miriad macros...
 #define PREAMBLE_SIZE 5
@@ -71,7 +74,7 @@
         PyErr_Format(PyExc_ValueError, "expected a complex"); \
         return NULL; }
 
-// Define an error that we can have miriad throw to avoid exiting.
+// The error thrown by MIRIAD_GUARD when MIRIAD reports a fatal error
 class MiriadError {
   private:
     std::string msg;
@@ -80,6 +83,86 @@ class MiriadError {
     const char* get_message() const { return msg.c_str(); }
 };
 
+// A bug.c error context for the calling thread, popped when it goes away
+class BugContext {
+  public:
+    BUGCTX ctx;
+    BugContext() { bugpush_c(&ctx); }
+    ~BugContext() { bugpop_c(&ctx); }
+};
+
+/* Turns fatal MIRIAD errors in the rest of the enclosing block into a
+ * MiriadError carrying MIRIAD's message.  bug.c longjmps back here, past
+ * only C frames, and the exception is thrown from this frame, so it never
+ * unwinds through MIRIAD.  Contexts are per-thread, so MIRIAD calls on
+ * different files may run in parallel threads.  Nothing with a destructor
+ * may be constructed after the guard in its block while MIRIAD calls can
+ * fail, nor live in any C++ frame between it and those calls. */
+#define MIRIAD_GUARD \
+    BugContext bug_guard; \
+    if (setjmp(bug_guard.ctx.env) != 0) throw MiriadError(bug_guard.ctx.msg)
+
+/* Releases the GIL for as long as it exists, so MIRIAD calls on different
+ * files can run in parallel threads.  No Python calls may be made while it
+ * exists; scope it inside the try block, before MIRIAD_GUARD, so a
+ * MiriadError handler runs with the GIL held again. */
+class AllowThreads {
+  private:
+    PyThreadState *save;
+  public:
+    AllowThreads() { save = PyEval_SaveThread(); }
+    ~AllowThreads() { PyEval_RestoreThread(save); }
+};
+
+/* Holds a mutex for as long as it exists, for MIRIAD code that keeps its
+ * state in globals.  Take it after AllowThreads and before MIRIAD_GUARD. */
+class MutexLock {
+  private:
+    pthread_mutex_t *mutex;
+  public:
+    MutexLock(pthread_mutex_t *m) : mutex (m) { pthread_mutex_lock(mutex); }
+    ~MutexLock() { pthread_mutex_unlock(mutex); }
+};
+
+// The record index lives in its own item in the data set, and is rebuilt
+// whenever the size or mtime of visdata no longer match what it recorded.
+#define INDEX_ITEM "aipy_idx"
+#define INDEX_VERSION 1
+// Records between snapshots of the variable table
+#define INDEX_SNAP 128
+
+// One visibility record: where it starts and what it is
+typedef struct {
+    off_t offset, flgoff, wflgoff;
+    double time;
+    float bl;
+    int pol;
+} UVIndexEntry;
+
+/* Record index for a UV file, plus a mirror of the time/antennae selections
+ * that have been made, so reads can jump straight to candidate records
+ * (uvselect_c still has the final say on each record read). */
+class UVIndex {
+  public:
+    UVIndex() : loaded(false), selok(true), anyant(false) {}
+    bool loaded;
+    std::vector<UVIndexEntry> ent;
+    // uvsnap_c snapshot taken before entry k*INDEX_SNAP, at snaps[snapoff[k]]
+    std::vector<int8> snapoff;
+    std::vector<char> snaps;
+    bool selok, anyant;
+    std::vector<double> tlo, thi;
+    std::vector<int> ai, aj;
+    void clear_select() {
+        selok = true; anyant = false;
+        tlo.clear(); thi.clear(); ai.clear(); aj.clear();
+    }
+    bool filtering() const {
+        return selok && (tlo.size() > 0 || (ai.size() > 0 && !anyant));
+    }
+    bool matches(const UVIndexEntry &e) const;
+};
+
 extern PyTypeObject UVType;
 
 #endif
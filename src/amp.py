@@ -191,6 +191,7 @@ class BeamAlm(phs.Beam):
         self._update_hmap()
     def _update_hmap(self):
         for c,alm in enumerate(self.alm): self.hmap[c].from_alm(self.alm[c])
+        self._maps = n.array([h.map for h in self.hmap])
     def update(self):
         """Update beam model using new set of coefficients.
         coeffs = dictionary of polynomial term (integer) and corresponding Alm 
@@ -202,8 +203,7 @@ class BeamAlm(phs.Beam):
         coordinates (x=E,y=N,z=UP). x,y,z may be multiple coordinates.  
         Returns 'x' pol (rotate pi/2 for 'y')."""
         top = [healpix.mk_arr(c, dtype=n.double) for c in top]
-        px,wgts = self.hmap[0].crd2px(*top, **{'interpolate':1})
-        poly = n.array([n.sum(h.map[px] * wgts, axis=-1) for h in self.hmap])
+        poly = self.hmap[0].interp_get(self._maps, *top)
         rv = n.polyval(poly, n.reshape(self.afreqs, (self.afreqs.size, 1)))
         return rv
 
@@ -6,7 +6,7 @@ Adds data to the HealpixBase class using numpy arrays, and interfaces to
 FITS files using pyfits.
 """
 
-import numpy as n, utils, pyfits
+import numpy as n, utils, pyfits, os
 from _healpix import HealpixBase
 from _alm import Alm
 
@@ -15,10 +15,205 @@ default_fits_format_codes = {
     n.float32:'E', n.float64:'D', n.complex64:'C', n.complex128:'M'
 }
 
+# Big-endian numpy types of the fits binary table format codes.  'L' is
+# stored as the characters 'T' and 'F'.
+fits_format_dtypes = {
+    'L':'i1', 'B':'u1', 'I':'>i2', 'J':'>i4', 'K':'>i8',
+    'E':'>f4', 'D':'>f8', 'C':'>c8', 'M':'>c16'
+}
+FITS_BLOCK = 2880
+
+def _fits_card(key, value=None, comment=''):
+    """Format an 80 character fits header card."""
+    if key in ('HISTORY', 'COMMENT'): card = '%-8s%s' % (key, value)
+    else:
+        if type(value) is str:
+            card = '%-8s= %-20s' % (key, "'%-8s'" % value.replace("'", "''"))
+        elif type(value) is bool:
+            card = '%-8s= %20s' % (key, value and 'T' or 'F')
+        elif type(value) is float:
+            card = '%-8s= %20s' % (key, repr(value).upper())
+        else: card = '%-8s= %20s' % (key, str(value))
+        if comment: card += ' / ' + comment
+    return ('%-80s' % card)[:80]
+
+def _fits_header(cards):
+    """Return the fits header blocks holding cards, a list of
+    (key, value, comment) tuples."""
+    h = ''.join([_fits_card(*c) for c in cards]) + '%-80s' % 'END'
+    return h + ' ' * (-len(h) % FITS_BLOCK)
+
+def _fits_value(s):
+    """Parse the value field (columns 11-80) of a fits header card."""
+    s = s.strip()
+    if s.startswith("'"):
+        v, i = '', 1
+        while i < len(s):
+            if s[i] == "'":
+                if s[i+1:i+2] != "'": break
+                i += 1
+            v += s[i]
+            i += 1
+        return v.rstrip()
+    s = s.split('/')[0].strip()
+    if s == 'T': return True
+    if s == 'F': return False
+    try: return int(s)
+    except(ValueError): pass
+    try: return float(s.replace('D', 'E'))
+    except(ValueError): return s
+
+def _read_fits_header(f):
+    """Read the header of the HDU at the current position of the open
+    file f into a dictionary of keywords."""
+    hdr = {}
+    while True:
+        block = f.read(FITS_BLOCK)
+        if len(block) < FITS_BLOCK:
+            raise IOError('Unexpected end of fits file %s' % f.name)
+        for i in range(0, FITS_BLOCK, 80):
+            card = block[i:i+80]
+            key = card[:8].strip()
+            if key == 'END': return hdr
+            if card[8:10] == '= ' and not key in hdr:
+                hdr[key] = _fits_value(card[10:])
+
+def _fits_data_size(hdr):
+    """Return the size in bytes (with padding) of the data of an HDU."""
+    naxis = hdr.get('NAXIS', 0)
+    if naxis == 0: return 0
+    sz = 1
+    for i in range(1, naxis+1): sz *= hdr['NAXIS%d' % i]
+    sz = abs(hdr['BITPIX']) / 8 * hdr.get('GCOUNT', 1) * \
+        (hdr.get('PCOUNT', 0) + sz)
+    return sz + (-sz % FITS_BLOCK)
+
+def write_fits_table(filename, cols, names, formats, cards=[], history=[],
+        clobber=True, chunk=2**18):
+    """Write 1 dimensional arrays cols as the columns named names (with fits
+    format codes formats) of a binary table in HDU 1 of a fits file.  cards
+    are (key, value, comment) tuples for the table header, and history
+    lines go in the primary header.  Rows are converted and written chunk
+    at a time, so only chunk rows are ever held beyond cols."""
+    if os.path.exists(filename) and not clobber:
+        raise IOError('File %s already exists' % filename)
+    nrows = len(cols[0])
+    dtype = n.dtype([(nm, fits_format_dtypes[fm])
+        for nm,fm in zip(names, formats)])
+    phdr = [('SIMPLE', True, 'conforms to FITS standard'),
+        ('BITPIX', 8, 'array data type'),
+        ('NAXIS', 0, 'number of array dimensions'),
+        ('EXTEND', True, '')] + [('HISTORY', h, '') for h in history]
+    thdr = [('XTENSION', 'BINTABLE', 'binary table extension'),
+        ('BITPIX', 8, 'array data type'),
+        ('NAXIS', 2, 'number of array dimensions'),
+        ('NAXIS1', dtype.itemsize, 'length of dimension 1'),
+        ('NAXIS2', nrows, 'length of dimension 2'),
+        ('PCOUNT', 0, 'number of group parameters'),
+        ('GCOUNT', 1, 'number of groups'),
+        ('TFIELDS', len(cols), 'number of table fields')]
+    for i,(nm,fm) in enumerate(zip(names, formats)):
+        thdr += [('TTYPE%d' % (i+1), nm, ''), ('TFORM%d' % (i+1), fm, '')]
+    f = open(filename, 'wb')
+    try:
+        f.write(_fits_header(phdr))
+        f.write(_fits_header(thdr + list(cards)))
+        buf = n.empty(min(chunk, nrows), dtype=dtype)
+        for i in range(0, nrows, chunk):
+            b = buf[:min(chunk, nrows - i)]
+            for nm,fm,c in zip(names, formats, cols):
+                c = c[i:i+len(b)]
+                if fm == 'L': b[nm] = n.where(c, ord('T'), ord('F'))
+                else: b[nm] = c
+            b.tofile(f)
+        f.write('\0' * (-nrows * dtype.itemsize % FITS_BLOCK))
+    finally: f.close()
+
+def _read_fits_table_pyfits(filename, hdunum, colnums):
+    hdu = pyfits.open(filename)[hdunum]
+    if colnums is None: colnums = range(len(hdu.columns))
+    cols = []
+    for c in colnums:
+        data = hdu.data.field(c)
+        if not data.dtype.isnative:
+            data.dtype = data.dtype.newbyteorder()
+            data.byteswap(True)
+        cols.append(data)
+    return cols, hdu.header
+
+def read_fits_table(filename, hdunum=1, colnums=None, chunk=2**18):
+    """Read the columns colnums (default all) of the binary table in HDU
+    hdunum of a fits file.  The table is memory-mapped, and each column is
+    streamed into a native array chunk rows at a time, so the other columns
+    are never copied.  Returns (cols, hdr), where hdr holds the keywords of
+    the table header.  Tables this can't map (scaled, string or variable
+    length columns) are read with pyfits.  Raises IndexError for a column
+    that is not in the table."""
+    f = open(filename, 'rb')
+    try:
+        for i in range(hdunum):
+            f.seek(_fits_data_size(_read_fits_header(f)), 1)
+        hdr = _read_fits_header(f)
+        offset = f.tell()
+    finally: f.close()
+    fields = []
+    for i in range(1, hdr.get('TFIELDS', 0) + 1):
+        fm = str(hdr['TFORM%d' % i]).strip()
+        rpt, code = fm[:-1], fm[-1:]
+        if not code in fits_format_dtypes or not (rpt == '' or rpt.isdigit()) \
+                or 'TSCAL%d' % i in hdr or 'TZERO%d' % i in hdr:
+            fields = None
+            break
+        fields.append(('f%d' % i, fits_format_dtypes[code], int(rpt or 1)))
+    if hdr.get('XTENSION') != 'BINTABLE' or fields is None:
+        return _read_fits_table_pyfits(filename, hdunum, colnums)
+    dtype = n.dtype([(nm, dt, (r,)) for nm,dt,r in fields])
+    if dtype.itemsize != hdr['NAXIS1']:
+        return _read_fits_table_pyfits(filename, hdunum, colnums)
+    if colnums is None: colnums = range(len(fields))
+    for c in colnums:
+        if c >= len(fields): raise IndexError('No column %d in table' % c)
+    nrows = hdr['NAXIS2']
+    data = n.memmap(filename, dtype=dtype, mode='r', offset=offset,
+        shape=(nrows,))
+    cols = []
+    for c in colnums:
+        nm,dt,r = fields[c]
+        col = n.empty(nrows * r, dtype=n.dtype(dt).newbyteorder('='))
+        for i in range(0, nrows, chunk):
+            col[i*r:(i+chunk)*r] = data[nm][i:i+chunk].ravel()
+        if dt == fits_format_dtypes['L']: col = (col == ord('T'))
+        cols.append(col)
+    del(data)
+    return cols, hdr
+
 def mk_arr(val, dtype=n.double):
     if type(val) is n.ndarray: return val.astype(dtype)
     return n.array(val, dtype=dtype).flatten()
 
+def ranges2px(ranges):
+    """Expand a K x 2 array of (start,stop) pixel ranges, as returned by
+    HealpixBase.query_disc and query_polygon, into an array of pixels."""
+    ranges = n.array(ranges, dtype=n.long).reshape(-1,2)
+    lens = ranges[:,1] - ranges[:,0]
+    offsets = n.repeat(ranges[:,0] - (n.cumsum(lens) - lens), lens)
+    return n.arange(lens.sum(), dtype=n.long) + offsets
+
+# NUNIQ number of the first cell of each order k: 4*4**k
+_nuniq_base = n.left_shift(4, 2 * n.arange(30)).astype(n.long)
+
+def nuniq(px, order):
+    """Return the NUNIQ cell numbers (4*4**order + px) of the NEST pixels px
+    at order (scalar, or one per pixel)."""
+    order = n.array(order, dtype=n.long)
+    return mk_arr(px, dtype=n.long) + n.left_shift(4, 2 * order)
+
+def nuniq2px(cells):
+    """Split NUNIQ cell numbers into arrays of (order, NEST pixel)."""
+    cells = mk_arr(cells, dtype=n.long)
+    order = n.searchsorted(_nuniq_base, cells, side='right') - 1
+    return order, cells - _nuniq_base[order]
+
 class HealpixMap(HealpixBase):
     """Collection of utilities for mapping data on a sphere.  Adds a data map 
     to the infrastructure in _healpix.HealpixBase."""
@@ -50,12 +245,21 @@ class HealpixMap(HealpixBase):
     def get_map(self):
         """Return Healpix data as a 1 dimensional numpy array."""
         return self.map
+    def _native_map(self):
+        """Return self.map as the writable, contiguous, native byte order
+        array that the in-place native routines need, first replacing it
+        with such a copy if it is not one."""
+        m = self.map
+        if not (m.flags.c_contiguous and m.flags.writeable and
+                m.dtype.isnative):
+            self.map = n.array(m, dtype=m.dtype.newbyteorder('='), order='C')
+        return self.map
     def change_scheme(self, scheme):
         """Reorder the pixels in map to be "RING" or "NEST" ordering."""
         assert(scheme in ["RING", "NEST"])
         if scheme == self.scheme(): return
-        i = self.nest_ring_conv(n.arange(self.npix()), scheme)
-        self[i] = self.map
+        self.map = n.ascontiguousarray(self.map)
+        self.reorder(self.map, scheme)
         self.set_nside_scheme(self.nside(), scheme)
     def __getitem__(self, crd):
         """Access data on a sphere via hpm[crd].
@@ -64,54 +268,81 @@ class HealpixMap(HealpixBase):
         if type(crd) is tuple:
             crd = [mk_arr(c, dtype=n.double) for c in crd]
             if self._use_interpol:
-                px,wgts = self.crd2px(*crd, **{'interpolate':1})
-                return n.sum(self.map[px] * wgts, axis=-1)
+                if self.map.dtype.kind == 'c':
+                    px,wgts = self.crd2px(*crd, **{'interpolate':1})
+                    return n.sum(self.map[px] * wgts, axis=-1)
+                return self.interp_get(self.map, *crd)
             else: px = self.crd2px(*crd)
         else: px = mk_arr(crd, dtype=n.long)
         return self.map[px]
+    def crd2px_any(self, crd):
+        """Return the pixel indices for crd = either 1d array of pixel
+        indices, (th,phi), or (x,y,z), where th,phi,x,y,z are numpy arrays
+        of coordinates."""
+        if type(crd) is tuple:
+            crd = [mk_arr(c, dtype=n.double) for c in crd]
+            return self.crd2px(*crd)
+        if type(crd) is n.ndarray: assert(len(crd.shape) == 1)
+        return mk_arr(crd, dtype=n.long)
     def __setitem__(self, crd, val):
         """Assign data to a sphere via hpm[crd] = val.  Functionality slightly
         complicated to make repeat coordinates assign sum of values (i.e.
         crd = ([1,1], [2,2]), val = [3,3] will assign 6 to location (1,2).
         crd = either 1d array of pixel indices, (th,phi), or (x,y,z), where
         th,phi,x,y,z are numpy arrays of coordinates."""
-        if type(crd) is tuple:
-            crd = [mk_arr(c, dtype=n.double) for c in crd]
-            px = self.crd2px(*crd)
-        else:
-            if type(crd) is n.ndarray: assert(len(crd.shape) == 1)
-            px = mk_arr(crd, dtype=n.int)
+        px = self.crd2px_any(crd)
         if px.size == 1:
             if type(val) is n.ndarray: val = mk_arr(val, dtype=self.map.dtype)
             self.map[px] = val
         else:
-            m = n.zeros_like(self.map)
-            px = px.reshape(px.size,1)
-            cnt = n.zeros(self.map.shape, dtype=n.bool)
-            val = mk_arr(val, dtype=m.dtype)
-            utils.add2array(m, px, val)
-            utils.add2array(cnt, px, n.ones(val.shape, dtype=n.bool))
-            self.map = n.where(cnt, m, self.map)
-    def from_hpm(self, hpm):
+            m = self._native_map()
+            self.scatter_add(px, [m], [mk_arr(val, dtype=m.dtype)], set=True)
+    def add(self, crd, val):
+        """Accumulate data onto a sphere: the equivalent of hpm[crd] += val,
+        but repeat coordinates add all of their values.  Only the pixels
+        in crd are touched."""
+        px = self.crd2px_any(crd)
+        m = self._native_map()
+        self.scatter_add(px, [m], [mk_arr(val, dtype=m.dtype)])
+    def from_hpm(self, hpm, mode='mean'):
         """Initialize this HealpixMap with data from another.  Takes care
         of upgrading or downgrading the resolution, and swaps ordering
-        scheme if necessary."""
-        if hpm.nside() < self.nside():
+        scheme if necessary.  When both nsides are powers of 2, downgrading
+        averages the children of each pixel (or sums them, if mode='sum'),
+        and upgrading replicates each pixel into its children (or splits it
+        among them, if mode='sum')."""
+        if hpm.nside() == self.nside():
+            if hpm.scheme() == self.scheme():
+                self.map = hpm.map.astype(self.get_dtype())
+            else:
+                m = hpm.map.astype(self.get_dtype())
+                hpm.reorder(m, self.scheme())
+                self.map = m
+        elif hpm.order() >= 0 and self.order() >= 0:
+            dtype = hpm.get_dtype()
+            if not dtype in (n.float32, n.double, n.complex64, n.complex128):
+                dtype = n.double
+            m = hpm.map
+            if hpm.scheme() == 'RING' or dtype != hpm.get_dtype():
+                m = m.astype(dtype)
+                if hpm.scheme() == 'RING': hpm.reorder(m, 'NEST')
+            out = n.empty(self.npix(), dtype=dtype)
+            HealpixBase(hpm.nside(), 'NEST').ud_grade(m, out, mode=mode)
+            if self.scheme() == 'RING':
+                HealpixBase(self.nside(), 'NEST').reorder(out, 'RING')
+            if out.dtype != self.get_dtype(): out = out.astype(self.get_dtype())
+            self.map = out
+        elif hpm.nside() < self.nside():
             interpol = hpm._use_interpol
             hpm.set_interpol(True)
             px = n.arange(self.npix())
             th,phi = self.px2crd(px, ncrd=2)
             self[px] = hpm[th,phi].astype(self.get_dtype())
-        elif hpm.nside() > self.nside():
+            hpm.set_interpol(interpol)
+        else:
             px = n.arange(hpm.npix())
             th,phi = hpm.px2crd(px, ncrd=2)
             self[th,phi] = hpm[px].astype(self.get_dtype())
-        else:
-            if hpm.scheme() == self.scheme():
-                self.map = hpm.map.astype(self.get_dtype())
-            else:
-                i = self.nest_ring_conv(n.arange(self.npix()), hpm.scheme())
-                self.map = hpm.map[i].astype(self.get_dtype())
     def from_alm(self, alm):
         """Set data to the map generated by the spherical harmonic
         coefficients contained in alm."""
@@ -126,23 +357,19 @@ class HealpixMap(HealpixBase):
         return alm
     def from_fits(self, filename, hdunum=1, colnum=0):
         """Read a HealpixMap from the specified location in a fits file."""
-        hdu = pyfits.open(filename)[hdunum]
-        data = hdu.data.field(colnum)
-        if not data.dtype.isnative:
-            data.dtype = data.dtype.newbyteorder()
-            data.byteswap(True)
-        scheme= hdu.header['ORDERING'][:4]
-        self.set_map(data, scheme=scheme)
-    def _set_fits_header(self, hdr):
-        hdr.update('PIXTYPE', 'HEALPIX', 'HEALPIX pixelisation')
+        cols,hdr = read_fits_table(filename, hdunum=hdunum, colnums=[colnum])
+        self.set_map(cols[0], scheme=hdr['ORDERING'][:4])
+    def _fits_cards(self):
+        """Return the fits header cards describing this HealpixMap."""
         scheme = self.scheme()
-        if scheme == 'NEST': scheme == 'NESTED'
-        hdr.update('ORDERING', scheme,
-            'Pixel ordering scheme, either RING or NESTED')
-        hdr.update('NSIDE', self.nside(), 'Resolution parameter for HEALPIX')
-        hdr.update('FIRSTPIX', 0, "First pixel # (0 based)")
-        hdr.update('LASTPIX', self.npix()-1, "Last pixel # (0 based)")
-        hdr.update('INDXSCHM', 'IMPLICIT', "Indexing: IMPLICIT or EXPLICIT")
+        if scheme == 'NEST': scheme = 'NESTED'
+        return [('PIXTYPE', 'HEALPIX', 'HEALPIX pixelisation'),
+            ('ORDERING', scheme,
+                'Pixel ordering scheme, either RING or NESTED'),
+            ('NSIDE', self.nside(), 'Resolution parameter for HEALPIX'),
+            ('FIRSTPIX', 0, "First pixel # (0 based)"),
+            ('LASTPIX', self.npix()-1, "Last pixel # (0 based)"),
+            ('INDXSCHM', 'IMPLICIT', "Indexing: IMPLICIT or EXPLICIT")]
     def get_dtype(self):
         return self.map.dtype
     def to_fits(self, filename, format=None, clobber=True):
@@ -151,11 +378,167 @@ class HealpixMap(HealpixBase):
         stored in default_fits_format_codes."""
         if format is None:
             format = default_fits_format_codes[self.get_dtype().type]
-        hdu0 = pyfits.PrimaryHDU()
-        col0 = pyfits.Column(name='signal', format=format, array=self.map)
-        cols = pyfits.ColDefs([col0])
-        tbhdu = pyfits.new_table(cols)
-        self._set_fits_header(tbhdu.header)
-        hdulist = pyfits.HDUList([hdu0, tbhdu])
-        hdulist.writeto(filename,clobber=clobber)
+        write_fits_table(filename, [self.map], ['signal'], [format],
+            self._fits_cards(), clobber=clobber)
 
+class SparseHealpixMap(HealpixBase):
+    """A HealpixMap that only stores the cells it has been given values
+    for, so a map of a fraction f of the sky takes about f of the memory of
+    a dense one.  Cells are kept in cells, a sorted array of NUNIQ numbers
+    (4*4**k + NEST pixel at order k), so besides the pixels of the map
+    (k = order()), a cell may be a coarser pixel standing for every pixel
+    under it.  The value of the map at a pixel is the sum of the cells
+    containing it.  Several layers of values share the cells: vals is
+    nlayers x len(cells).  Nside must be a power of 2."""
+    def __init__(self, nside=None, nlayers=1, fromfits=None):
+        if fromfits is None:
+            HealpixBase.__init__(self, nside, 'NEST')
+            if self.order() < 0: raise ValueError('Nside must be a power of 2.')
+            self.reset(nlayers)
+        else:
+            HealpixBase.__init__(self)
+            self.from_fits(fromfits)
+    def reset(self, nlayers=None):
+        """Remove every cell, keeping the number of layers (or changing it
+        to nlayers)."""
+        if nlayers is None: nlayers = self.nlayers()
+        self.cells = n.zeros((0,), dtype=n.long)
+        self.vals = n.zeros((nlayers, 0), dtype=n.double)
+    def nlayers(self):
+        return self.vals.shape[0]
+    def cell_orders(self):
+        """Return the order of each cell."""
+        return nuniq2px(self.cells)[0]
+    def _px(self, crd):
+        if type(crd) is tuple:
+            return self.crd2px(*[mk_arr(c, dtype=n.double) for c in crd])
+        px = mk_arr(crd, dtype=n.long)
+        if n.any(px < 0) or n.any(px >= self.npix()):
+            raise ValueError('Pixels must be in [0,%d).' % self.npix())
+        return px
+    def cells_at(self, crd, order=None):
+        """Return the NUNIQ numbers of the cells at order (default order())
+        containing crd = either 1d array of NEST pixel indices of this map,
+        (th,phi), or (x,y,z), where th,phi,x,y,z are numpy arrays of
+        coordinates."""
+        if order is None: order = self.order()
+        assert(0 <= order <= self.order())
+        return nuniq(self._px(crd) >> 2 * (self.order() - order), order)
+    def _rows(self, vals, ncells):
+        if self.nlayers() == 1 and n.ndim(vals) < 2: vals = [vals]
+        if len(vals) != self.nlayers():
+            raise ValueError('vals must have a row for each of the %d layers.'
+                % self.nlayers())
+        rows = n.empty((self.nlayers(), ncells), dtype=n.double)
+        for i,v in enumerate(vals): rows[i] = mk_arr(v)
+        return rows
+    def add(self, crd, vals, order=None):
+        """Accumulate vals into the cells at order (default order()) that
+        contain crd (as for cells_at).  vals has a row (of len(crd) values,
+        or 1) per layer, or is just the row for a single layer.  Repeated
+        cells accumulate all of their values, and new cells are merged in
+        with one native sort, so add in large batches."""
+        cells = self.cells_at(crd, order)
+        self.cells, self.vals = self.sparse_add(self.cells, self.vals,
+            cells, self._rows(vals, len(cells)))
+    def get(self, crd):
+        """Return the values at crd (as for cells_at): the sum of the cells
+        of every order that contain it, or 0 where there are none.  Returns
+        nlayers x len(crd) values, or len(crd) for a single layer."""
+        px = self._px(crd)
+        rv = n.zeros((self.nlayers(), len(px)), dtype=n.double)
+        for k in n.unique(self.cell_orders()):
+            c = nuniq(px >> 2 * (self.order() - k), k)
+            i = n.searchsorted(self.cells, c).clip(0, len(self.cells) - 1)
+            hit = n.nonzero(self.cells[i] == c)[0]
+            rv[:,hit] += self.vals[:,i[hit]]
+        if self.nlayers() == 1: return rv[0]
+        return rv
+    def __getitem__(self, crd):
+        return self.get(crd)
+    def to_dense(self, layer=0):
+        """Return a layer as a dense array of npix values in NEST order,
+        with each coarse cell added to all of the pixels under it."""
+        m = n.zeros((self.npix(),), dtype=n.double)
+        order, px = nuniq2px(self.cells)
+        for k in n.unique(order):
+            sel = n.nonzero(order == k)[0]
+            m.shape = (-1, 4**(self.order() - k))
+            m[px[sel]] += self.vals[layer,sel].reshape(-1,1)
+        m.shape = (self.npix(),)
+        return m
+    def to_hpm(self, layer=0, scheme='RING'):
+        """Return a layer as a (dense) HealpixMap in scheme."""
+        h = HealpixMap(self.nside(), 'NEST')
+        h.map = self.to_dense(layer)
+        h.change_scheme(scheme)
+        return h
+    def from_hpm(self, hpm, layer=0):
+        """Add the nonzero pixels of a (dense) HealpixMap into a layer of
+        this one, as cells at order().  Resolution and ordering are
+        converted as for HealpixMap.from_hpm."""
+        h = HealpixMap(self.nside(), 'NEST')
+        h.from_hpm(hpm)
+        px = n.nonzero(h.map)[0]
+        vals = n.zeros((self.nlayers(), len(px)), dtype=n.double)
+        vals[layer] = h.map[px]
+        self.add(px, vals)
+    def from_fits(self, filename, hdunum=1):
+        """Read a map from the specified location in a fits file.  Tables
+        in the explicit-index (partial sky) format have a column of RING or
+        NESTED pixels (or NUNIQ cells, if ORDERING is NUNIQ) followed by a
+        column per layer; a full sky table makes a layer of each column."""
+        cols,hdr = read_fits_table(filename, hdunum=hdunum)
+        ordering = str(hdr.get('ORDERING', 'NESTED')).strip()[:4]
+        if str(hdr.get('INDXSCHM', 'IMPLICIT')).strip() != 'EXPLICIT':
+            self.set_nside_scheme(self.npix2nside(len(cols[0])), 'NEST')
+            if self.order() < 0: raise ValueError('Nside must be a power of 2.')
+            self.reset(len(cols))
+            for i,c in enumerate(cols):
+                h = HealpixBase(self.nside(), ordering)
+                px = n.nonzero(c)[0]
+                vals = n.zeros((self.nlayers(), len(px)), dtype=n.double)
+                vals[i] = c[px]
+                if ordering == 'RING': h.nest_ring_conv(px, 'NEST')
+                self.add(px, vals)
+            return
+        pix = mk_arr(cols[0], dtype=n.long)
+        vals = n.array(cols[1:], dtype=n.double).reshape(len(cols)-1, -1)
+        if ordering == 'NUNI':
+            order = nuniq2px(pix)[0]
+            if len(order) > 0: nside = 2**order.max()
+            else: nside = 1
+            nside = max(hdr.get('NSIDE', nside), nside)
+            cells = pix
+        else:
+            nside = hdr['NSIDE']
+            if ordering == 'RING':
+                pix = HealpixBase(nside, 'RING').nest_ring_conv(pix, 'NEST')
+            cells = nuniq(pix, HealpixBase(nside).order())
+        self.set_nside_scheme(nside, 'NEST')
+        if self.order() < 0: raise ValueError('Nside must be a power of 2.')
+        self.reset(len(vals))
+        self.cells, self.vals = self.sparse_add(self.cells, self.vals,
+            cells, vals)
+    def to_fits(self, filename, names=None, format='D', clobber=True,
+            history=[]):
+        """Write the map to a fits file in the explicit-index (partial sky)
+        format: a PIXEL column of NEST pixels and a column per layer
+        (named names, in fits format format), with a row per cell.  A map
+        with cells coarser than order() is written with ORDERING NUNIQ,
+        and its NUNIQ cell numbers in a UNIQ column instead."""
+        if names is None:
+            names = ['signal'] + ['layer%d' % i for i in
+                range(1, self.nlayers())]
+        order, px = nuniq2px(self.cells)
+        if n.all(order == self.order()): name,pix,ordering = 'PIXEL',px,'NESTED'
+        else: name,pix,ordering = 'UNIQ',self.cells,'NUNIQ'
+        cards = [('PIXTYPE', 'HEALPIX', 'HEALPIX pixelisation'),
+            ('ORDERING', ordering,
+                'Pixel ordering scheme, either RING, NESTED or NUNIQ'),
+            ('NSIDE', self.nside(), 'Resolution parameter for HEALPIX'),
+            ('OBJECT', 'PARTIAL', 'Sky coverage, either FULLSKY or PARTIAL'),
+            ('INDXSCHM', 'EXPLICIT', "Indexing: IMPLICIT or EXPLICIT")]
+        write_fits_table(filename, [pix] + list(self.vals), [name] + names,
+            ['K'] + [format] * self.nlayers(), cards, history=history,
+            clobber=clobber)
@@ -59,6 +59,18 @@ def facet_centers(N, ncrd=2):
     if ncrd == 3: return pnts
     else: return coord.eq2radec(pnts)
 
+def _fits_history(history):
+    """Split history (newline separated) into lines for a fits header,
+    wrapping long ones and marking continuations with '#'."""
+    hist = []
+    for line in [h.strip() for h in history.split("\n")]:
+        if len(line)>1:
+            if line.startswith('#'):
+                hist += img.word_wrap(line,72,0,0,'').split("\n")
+            else:
+                hist += img.word_wrap(line,70,5,10,'#').split("\n")
+    return hist
+
 class Map(object):
     def __init__(self, *args, **kwargs):
         fromfits = kwargs.pop('fromfits', None)
@@ -91,14 +103,20 @@ class Map(object):
         ind = [i[crds] / w for i in self.ind]
         if len(ind) == 0: return fluxes
         return (fluxes, ind)
+    def _scatter(self, crds, wgts, fluxes, inds, set):
+        """Accumulate (or with set, assign) weights, weighted fluxes and
+        weighted indices at crds, in one native call over all layers."""
+        px = self.map.crd2px_any(crds)
+        layers = [self.wgt._native_map(), self.map._native_map()] + \
+            [self.ind[i]._native_map() for i in range(len(inds))]
+        vals = [wgts, fluxes * wgts] + [ind * wgts for ind in inds]
+        dtypes = [h.dtype for h in layers]
+        vals = [healpix.mk_arr(v, dtype=d) for v,d in zip(vals, dtypes)]
+        self.map.scatter_add(px, layers, vals, set=set)
     def add(self, crds, wgts, fluxes, inds=[]):
-        self.wgt[crds] += wgts
-        self.map[crds] += fluxes * wgts
-        for n,i in enumerate(inds): self.ind[n][crds] += i * wgts
+        self._scatter(crds, wgts, fluxes, inds, False)
     def put(self, crds, wgts, fluxes, inds=[]):
-        self.wgt[crds] = wgts
-        self.map[crds] = fluxes * wgts
-        for n,i in enumerate(inds): self.ind[n][crds] = i * wgts
+        self._scatter(crds, wgts, fluxes, inds, True)
     def reset_wgt(self, wgt=1):
         w = n.where(self.wgt.map > 0, self.wgt.map, 1)
         self.map.map /= w
@@ -114,47 +132,74 @@ class Map(object):
         try: object.__getatr__(self, attr)
         except(AttributeError): return self.map.__getattribute__(attr)
     def from_fits(self, filename, hdunum=1):
-        self.map.from_fits(filename, hdunum=hdunum, colnum=0)
+        # Read every column in one pass over the file
+        cols,hdr = healpix.read_fits_table(filename, hdunum=hdunum)
+        scheme = hdr['ORDERING'][:4]
+        self.map.set_map(cols[0], scheme=scheme)
         self.args = ()
         self.kwargs = {'nside':self.nside(), 'scheme':self.scheme()}
-        try:
-            self.wgt.from_fits(filename, hdunum=hdunum, colnum=1)
-        except(IndexError):
-            self.wgt = healpix.HealpixMap(*self.args, **self.kwargs)
-            self.wgt.set_map(n.ones_like(self.wgt.map))
-        # Figure out how many cols there are (is there a better way?)
-        hdu = pyfits.open(filename)[hdunum]
-        nind = 0
-        while True:
-            try: i = hdu.data.field(2 + nind)
-            except(IndexError): break
-            nind += 1
-        del(hdu)
+        self.wgt = healpix.HealpixMap(*self.args, **self.kwargs)
+        if len(cols) > 1: self.wgt.set_map(cols[1], scheme=scheme)
+        else: self.wgt.set_map(n.ones_like(self.wgt.map), scheme=scheme)
         # Make a spectral index HPM for each additional col in fits file
-        for i in range(nind):
+        for c in cols[2:]:
             h = healpix.HealpixMap(*self.args, **self.kwargs)
-            h.from_fits(filename, hdunum=hdunum, colnum=2+i)
+            h.set_map(c, scheme=scheme)
             self.ind.append(h)
     def to_fits(self, filename, format=None, clobber=False,history=''):
         if format is None:
             format = healpix.default_fits_format_codes[self.get_dtype().type]
-        hdu0 = pyfits.PrimaryHDU()
-        col0 = pyfits.Column(name='signal', format=format, array=self.map.map)
-        col1 = pyfits.Column(name='weights', format=format, array=self.wgt.map)
-        col_inds = [pyfits.Column(name='sp_index%d'%n,format=format,array=i.map)
-            for n,i in enumerate(self.ind)]
-        cols = pyfits.ColDefs([col0, col1] + col_inds)
-        tbhdu = pyfits.new_table(cols)
-        self.map._set_fits_header(tbhdu.header)
-        hdulist = pyfits.HDUList([hdu0, tbhdu])
-        if history!='':
-            history = [h.strip() for h in history.split("\n")]
-            for line in history:
-                if len(line)>1:
-                    if line.startswith('#'):
-                        for subline in img.word_wrap(line,80,0,0,'').split("\n"):
-                            hdulist[0].header.add_history(subline)
-                    else:
-                        for subline in img.word_wrap(line,70,5,10,'#').split("\n"):
-                            hdulist[0].header.add_history(subline)       
-        hdulist.writeto(filename, clobber=clobber)
+        cols = [self.map.map, self.wgt.map] + [i.map for i in self.ind]
+        names = ['signal', 'weights'] + \
+            ['sp_index%d' % i for i in range(len(self.ind))]
+        healpix.write_fits_table(filename, cols, names, [format] * len(cols),
+            self.map._fits_cards(), history=_fits_history(history),
+            clobber=clobber)
+
+class SparseMap(object):
+    """A Map that only stores the pixels it has been given data for, for
+    surveys of a small part of the sky.  The fluxes, weights and indices
+    are the layers of one healpix.SparseHealpixMap (in the column order of
+    Map fits files), so they share a single sorted array of cells."""
+    def __init__(self, nside=None, nindices=0, fromfits=None):
+        self.smap = healpix.SparseHealpixMap(nside, nlayers=2+nindices,
+            fromfits=fromfits)
+    def nindices(self):
+        return self.smap.nlayers() - 2
+    def add(self, crds, wgts, fluxes, inds=[], order=None):
+        """Accumulate weights, weighted fluxes and weighted indices at crds,
+        as for Map.add.  With order, they go into the cells of that
+        (coarser) order containing crds."""
+        wgts = healpix.mk_arr(wgts)
+        vals = [healpix.mk_arr(fluxes) * wgts, wgts] + \
+            [healpix.mk_arr(i) * wgts for i in inds] + \
+            [0] * (self.nindices() - len(inds))
+        self.smap.add(crds, vals, order=order)
+    def get(self, crds):
+        v = self.smap.get(crds)
+        return (v[1], v[0], list(v[2:]))
+    def __getitem__(self, crds):
+        """Return the average map/index values at the specified coordinates."""
+        v = self.smap.get(crds)
+        w = n.where(v[1] > 0, v[1], 1)
+        if self.nindices() == 0: return v[0] / w
+        return (v[0] / w, [i / w for i in v[2:]])
+    def to_map(self, scheme='RING'):
+        """Return the data as a (dense) Map."""
+        m = Map(nside=self.smap.nside(), scheme=scheme,
+            nindices=self.nindices())
+        for i,h in enumerate([m.map, m.wgt] + m.ind):
+            h.map = self.smap.to_hpm(i, scheme=scheme).map
+        return m
+    def from_map(self, map):
+        """Add the data of a (dense) Map into this one.  Resolution and
+        ordering are converted as for HealpixMap.from_hpm."""
+        hpms = [map.map, map.wgt] + map.ind[:self.nindices()]
+        for i,h in enumerate(hpms): self.smap.from_hpm(h, layer=i)
+    def from_fits(self, filename, hdunum=1):
+        self.smap.from_fits(filename, hdunum=hdunum)
+    def to_fits(self, filename, clobber=False, history=''):
+        names = ['signal', 'weights'] + \
+            ['sp_index%d' % i for i in range(self.nindices())]
+        self.smap.to_fits(filename, names=names, clobber=clobber,
+            history=_fits_history(history))
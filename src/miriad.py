@@ -64,18 +64,28 @@ data_types = {
 #  \___/   \_/   
 
 class UV(_miriad.UV):
-    """Top-level interface to a Miriad UV data set."""
-    def __init__(self, filename, status='old', corrmode='r'):
+    """Top-level interface to a Miriad UV data set.  Different UV objects 
+    may be used from different threads, but each should only be used by one
+    thread at a time."""
+    def __init__(self, filename, status='old', corrmode='r', bufsize=0,
+            compress=False):
         """Open a miriad file.  status can be ('old','new','append').  
-        corrmode can be 'r' (float32 data storage) or 'j' (int16 with shared exponent).  Default is 'r'."""
+        corrmode can be 'r' (float32 data storage) or 'j' (int16 with shared exponent).  Default is 'r'.
+        bufsize is the i/o buffer size (in bytes) used for the visibility
+        data and flags.  If 0, the MIRIAD_BUFSIZE environment variable
+        (e.g. '4M') or a 16 kB default is used.
+        If compress is True, a new file stores its visibility data as
+        compressed blocks.  These are read (and appended to) transparently."""
         assert(status in ['old', 'new', 'append'])
         assert(corrmode in ['r', 'j'])
-        _miriad.UV.__init__(self, filename, status, corrmode)
+        _miriad.UV.__init__(self, filename, status, corrmode, bufsize,
+            int(compress))
         self.status = status
         self.nchan = 4096
         if status == 'old':
+            # Variables of the first record are already loaded, and rewind()
+            # restores them
             self.vartable = self._gen_vartable()
-            self.read(); self.rewind() # Update variables for the user
             try: self.nchan = self['nchan']
             except(KeyError): pass
         else: self.vartable = {'corr':corrmode}
@@ -111,13 +121,8 @@ class UV(_miriad.UV):
             else:
                 t, offset = _miriad.hread_init(h)
                 assert(itype == t)
-            while True:
-                try: c, o = _miriad.hread(h, offset, itype)
-                except(IOError): break
-                if itype == 'a': c = c[:o]
-                rv.append(c)
-                offset += o
-            if itype == 'a': rv = ''.join(rv)
+            rv = _miriad.hread_array(h, offset, itype)
+            if itype != 'a' and len(rv) == 1: rv = rv.tolist()
         else:
             t, offset = _miriad.hread_init(h); assert(t == 'b')
             for t in itype:
@@ -133,11 +138,9 @@ class UV(_miriad.UV):
         if type == '?': return self._wrhd_special(name, val)
         h = self.haccess(name, 'write')
         if len(type) == 1:
-            try: len(val)
-            except(TypeError): val = [val]
             if type == 'a': offset = 0
             else: offset = _miriad.hwrite_init(h, type)
-            for v in val: offset += _miriad.hwrite(h, offset, v, type)
+            _miriad.hwrite_array(h, offset, val, type)
         else:
             offset = _miriad.hwrite_init(h, 'b')
             for v, t in zip(val,type): offset += _miriad.hwrite(h,offset,v,t)
@@ -203,40 +206,77 @@ class UV(_miriad.UV):
                     p1 is used.
                     For 'and','or','clear','auto' p1 and p2 are ignored.
             include If true, the data is selected. If false, the data is
-                    discarded. Ignored for 'and','or','clear'."""
+                    discarded. Ignored for 'and','or','clear'.
+        Included 'time' and 'antennae' selections also let read() use the 
+        record index to skip straight to matching records."""
         if name == 'antennae':
             n1 += 1; n2 += 1
         self._select(name, float(n1), float(n2), int(include))
-    def read(self, raw=False):
+    def seek(self, t, bl=None, pol=None):
+        """Jump to the first record at or after Julian date t (in file 
+        order), optionally also matching baseline bl=(i,j) and polarization 
+        pol (a code or a string like 'xx').  The next read() returns that 
+        record, with variables as if the file had been read up to it.  Uses 
+        a record index that is built on first use and saved in the file.
+        Raises IOError if no record matches."""
+        if bl is None: i, j = -1, -1
+        else: i, j = bl
+        if pol is None: pol = 0
+        elif type(pol) == str: pol = str2pol[pol]
+        self._seek(float(t), int(i), int(j), int(pol))
+    def read(self, raw=False, chans=None):
         """Return the next data record.  Calling this function causes 
         vars to change to reflect the record which this function returns.
-        'raw' causes data and flags to be returned seperately."""
-        preamble, data, flags, nread = self.raw_read(self.nchan)
+        'raw' causes data and flags to be returned seperately.  chans
+        (a slice, or channel numbers as from scripting.parse_chans)
+        returns only those channels, and only those are decoded."""
+        if chans is None:
+            preamble, data, flags, nread = self.raw_read(self.nchan)
+            pick = None
+        else:
+            start, count, step, pick = _chan_range(chans, self.nchan)
+            preamble, data, flags, nread = self.raw_read(count, start, step)
         if nread == 0: raise IOError("No data read")
-        flags = n.logical_not(flags)
+        if pick is not None: data, flags = data.take(pick), flags.take(pick)
         if raw: return preamble, data, flags
         return preamble, n.ma.array(data, mask=flags)
-    def all(self, raw=False):
+    def all(self, raw=False, chans=None):
         """Provide an iterator over preamble, data.  Allows constructs like: 
         for preamble, data in uv.all(): ..."""
         curtime = None
         while True:
-            try: yield self.read(raw=raw)
+            try: yield self.read(raw=raw, chans=chans)
             except(IOError): return
     def write(self, preamble, data, flags=None):
         """Write the next data record.  data must be a complex, masked
         array.  preamble must be (uvw, t, (i,j)), where uvw is an array of 
         u,v,w, t is the Julian date, and (i,j) is an antenna pair."""
         if data is None: return
-        if not flags is None: flags = n.logical_not(flags)
+        if not flags is None: mask = flags
         elif len(data.mask.shape) == 0:
-            flags = n.ones(data.shape)
+            mask = n.zeros(data.shape, dtype=n.bool)
             data = data.unmask()
         else:
-            flags = n.logical_not(data.mask)
+            mask = data.mask
             #data = data.filled(0)
             data = data.data
-        self.raw_write(preamble,data.astype(n.complex64),flags.astype(n.int32))
+        self.raw_write(preamble,data.astype(n.complex64),
+            n.ascontiguousarray(mask, dtype=n.bool))
+    def write_block(self, uvw, t, i, j, data, flags=None):
+        """Write N records at once.  uvw is (N,3), t, i, and j have length
+        N, and data is an (N,nchan) complex (masked) array.  flags, if
+        provided, overrides the mask of data (True where flagged).  Other
+        variables (e.g. pol) are the same for every record in the block;
+        time and baseline are only written when they change."""
+        if flags is None: flags = n.ma.getmaskarray(data)
+        data = n.ascontiguousarray(n.ma.getdata(data), dtype=n.complex64)
+        data = data.reshape((-1, data.shape[-1]))
+        flags = n.ascontiguousarray(flags, dtype=n.bool).reshape(data.shape)
+        uvw = n.asarray(uvw, dtype=n.double).reshape((-1,3))
+        t = n.asarray(t, dtype=n.double).reshape(-1)
+        i = n.asarray(i, dtype=n.int32).reshape(-1)
+        j = n.asarray(j, dtype=n.int32).reshape(-1)
+        _miriad.UV.write_block(self, uvw, t, i, j, data, flags)
     def init_from_uv(self, uv, override={}, exclude=[]):
         """Initialize header items and variables from another UV.  Those in 
         override will be overwritten by override[k], and tracking will be 
@@ -281,6 +321,413 @@ class UV(_miriad.UV):
         """Add a variable of the specified type to a UV file."""
         self.vartable[name] = type
 
+def _chan_range(chans, nchan):
+    """Return (start, count, step, pick) for reading channels chans (a slice
+    or channel numbers) of nchan: raw_read(count, start, step) reads evenly
+    spaced channels directly, and otherwise reads the range spanning chans,
+    from which pick (None if not needed) takes the channels wanted."""
+    if isinstance(chans, slice): chans = n.arange(*chans.indices(nchan))
+    chans = n.array(chans, dtype=n.int).flatten()
+    if len(chans) == 0: raise ValueError('No channels selected')
+    if chans.min() < 0 or chans.max() >= nchan:
+        raise IndexError('Channels must be in [0,%d)' % nchan)
+    if len(chans) == 1: return int(chans[0]), 1, 1, None
+    d = n.diff(chans)
+    if d[0] > 0 and n.all(d == d[0]):
+        return int(chans[0]), len(chans), int(d[0]), None
+    lo, hi = chans.min(), chans.max()
+    return int(lo), int(hi - lo + 1), 1, chans - lo
+
+def _read_all(filename, chans=None):
+    """Read every record of a UV file, returning arrays of uvw, t, i, j, 
+    data, and flags (True where flagged).  chans is as for UV.read."""
+    uv = UV(filename)
+    uvw, t, ij, data, flags = [], [], [], [], []
+    if chans is None: args, pick = (uv.nchan,), None
+    else:
+        start, count, step, pick = _chan_range(chans, uv.nchan)
+        args = (count, start, step)
+    while True:
+        (p_uvw,p_t,p_ij), d, f, nread = uv.raw_read(*args)
+        if nread == 0: break
+        d, f = d[:nread], f[:nread]
+        if pick is not None: d, f = d.take(pick), f.take(pick)
+        uvw.append(p_uvw); t.append(p_t); ij.append(p_ij)
+        data.append(d); flags.append(f)
+    del(uv)
+    ij = n.array(ij, dtype=n.int).reshape((-1,2))
+    return (n.array(uvw).reshape((-1,3)), n.array(t), ij[:,0], ij[:,1],
+        n.array(data), n.array(flags))
+
+def read_many(files, nthreads=4, raw=False, chans=None):
+    """Read every record from a list of UV files using up to nthreads 
+    threads (one file per thread at a time; records are decoded without 
+    holding the GIL).  Returns (uvw, t, (i, j)), data, where uvw is (N,3), 
+    t, i, and j have length N, and data is an (N,nchan) masked array, with 
+    records in the order of files.  'raw' returns data and flags 
+    seperately.  chans selects channels as for UV.read.  All files must 
+    have the same number of channels."""
+    import threading, sys
+    results = [None] * len(files)
+    errors, todo = [], range(len(files))
+    lock = threading.Lock()
+    def worker():
+        while True:
+            lock.acquire()
+            try:
+                if len(todo) == 0 or len(errors) > 0: return
+                k = todo.pop(0)
+            finally: lock.release()
+            try: results[k] = _read_all(files[k], chans=chans)
+            except:
+                errors.append(sys.exc_info())
+                return
+    threads = [threading.Thread(target=worker) 
+        for i in range(max(1, min(nthreads, len(files))))]
+    for t in threads: t.start()
+    for t in threads: t.join()
+    if len(errors) > 0: raise errors[0][0], errors[0][1], errors[0][2]
+    uvw, t, i, j, data, mask = [n.concatenate(x) for x in zip(*results)]
+    if raw: return (uvw, t, (i, j)), data, mask
+    return (uvw, t, (i, j)), n.ma.array(data, mask=mask)
+
+SMA_POLMODES = {None:0, 'linear':1, 'circular':2}
+
+def sma_to_uv(mirdir, outfile, sb=0, rxif=-1, rsnchan=-1, scans=(0,0),
+        pol=None):
+    """Convert the SMA MIR data set in directory mirdir straight into a new
+    UV file outfile, one integration at a time, so memory use does not grow
+    with the number of integrations.  sb selects the sideband (0=lsb,
+    1=usb), rxif the receiver (-1 for any), rsnchan resamples every chunk
+    to that many channels (-1 keeps them), scans=(skip,nproc) skips and
+    then converts that many integrations (nproc=0 for the rest), and pol
+    labels the data as unpolarized (None), 'linear', or 'circular'.
+    Returns outfile, to be read with UV.  Conversions run one at a time."""
+    if not pol in SMA_POLMODES: raise ValueError('Unknown pol: %s' % pol)
+    uv = UV(outfile, status='new')
+    uv._sma_read(mirdir, sb, rxif, rsnchan, scans[0], scans[1],
+        SMA_POLMODES[pol])
+    del(uv)
+    return outfile
+
+COLUMNS = [('uvw', n.double, (3,)), ('time', n.double, ()),
+    ('i', n.int32, ()), ('j', n.int32, ()), ('pol', n.int32, ()),
+    ('data', n.complex64, ('nchan',)), ('flags', n.bool, ('nchan',))]
+
+def uv_to_columnar(uv, outdir, chunk=4096):
+    """Write the records of a UV file (a filename or an open UV) to outdir
+    as one raw binary file per column (uvw, time, i, j, pol, data, flags;
+    flags are True where flagged), described by meta.json.  Records are
+    streamed to disk in chunks of 'chunk' records, so memory use is bounded.
+    Scalar variables (and small arrays) as of the first record are saved 
+    in meta.json as well.  Open the result with ColumnarUV."""
+    import json, os
+    if type(uv) == str: uv = UV(uv)
+    else: uv.rewind()
+    if not os.path.exists(outdir): os.mkdir(outdir)
+    files = dict([(name, open(os.path.join(outdir, name + '.dat'), 'wb'))
+        for name, dtype, shape in COLUMNS])
+    haspol = 'pol' in uv.vartable
+    nchan, nrec, vars = uv.nchan, 0, None
+    while True:
+        cols = dict([(name, []) for name, dtype, shape in COLUMNS])
+        for k in xrange(chunk):
+            (uvw,t,(i,j)), d, f, nread = uv.raw_read(nchan)
+            if nread == 0: break
+            if nread != nchan:
+                raise ValueError('Record %d has %d channels, not %d' % 
+                    (nrec + k, nread, nchan))
+            if vars is None: vars = _columnar_vars(uv)
+            cols['uvw'].append(uvw); cols['time'].append(t)
+            cols['i'].append(i); cols['j'].append(j)
+            if haspol: cols['pol'].append(uv['pol'])
+            else: cols['pol'].append(0)
+            cols['data'].append(d); cols['flags'].append(f)
+        for name, dtype, shape in COLUMNS:
+            n.array(cols[name], dtype=dtype).tofile(files[name])
+        nrec += len(cols['time'])
+        if len(cols['time']) < chunk: break
+    for f in files.values(): f.close()
+    vars = vars or {}
+    meta = {'nrec':nrec, 'nchan':nchan, 'vars':vars,
+        'vartable':dict([(k, uv.vartable[k]) for k in vars]),
+        'columns':dict([(name, [n.dtype(dtype).str, 
+            [nchan if s == 'nchan' else s for s in shape]])
+            for name, dtype, shape in COLUMNS])}
+    json.dump(meta, open(os.path.join(outdir, 'meta.json'), 'w'))
+
+def _columnar_vars(uv):
+    """Return the JSON-friendly variables of uv (as of its last record)."""
+    import json
+    vars = {}
+    for name in uv.vars():
+        if name == 'corr': continue
+        try: val = uv[name]
+        except(KeyError, RuntimeError, ValueError): continue
+        if isinstance(val, n.ndarray):
+            if val.size > 1024 or val.dtype.kind == 'c': continue
+            val = val.tolist()
+        elif isinstance(val, n.generic): val = val.item()
+        try: json.dumps(val)
+        except(TypeError, ValueError): continue
+        vars[name] = val
+    return vars
+
+class ColumnarUV:
+    """Read-only access to the output of uv_to_columnar.  Columns are 
+    memory-mapped numpy arrays (uvw, time, i, j, pol, data, flags), and
+    select(), read(), and all() behave like those of UV.  Variables other
+    than the per-record pol are the values saved from the first record."""
+    def __init__(self, dirname):
+        import json, os
+        self.dirname = dirname
+        meta = json.load(open(os.path.join(dirname, 'meta.json')))
+        self.nrec, self.nchan = meta['nrec'], meta['nchan']
+        self.vartable = dict([(str(k), str(v)) 
+            for k,v in meta['vartable'].items()])
+        self.vartable['pol'] = 'i'
+        self._vars = meta['vars']
+        for name, (dtype, shape) in meta['columns'].items():
+            dtype, shape = str(dtype), (self.nrec,) + tuple(shape)
+            if self.nrec == 0: col = n.zeros(shape, dtype=dtype)
+            else: col = n.memmap(os.path.join(dirname, name + '.dat'),
+                dtype=dtype, mode='r', shape=shape)
+            setattr(self, str(name), col)
+        self.select('clear', 0, 0)
+    def vars(self):
+        """Return a list of available variables."""
+        return self.vartable.keys()
+    def __getitem__(self, name):
+        if name == 'pol' and self._cur >= 0: return int(self.pol[self._cur])
+        try: return self._vars[name]
+        except(KeyError): raise KeyError(name)
+    def select(self, name, n1, n2, include=1):
+        """Choose which records are returned by read() and all().  name can
+        be 'clear', 'antennae' (antennae n1 and n2, indexed from 0, with -1
+        meaning any), 'time' (n1 <= t <= n2), 'polarization' (code n1),
+        'auto' (i == j), or 'decimate' (every n1-th integration, starting
+        at the n2-th).  As in UV, included selections of one kind are OR'ed,
+        different kinds are AND'ed, and excluded records are dropped."""
+        if name == 'clear':
+            self._sel = {}
+        elif name in ('antennae', 'time', 'polarization', 'auto', 'decimate'):
+            self._sel.setdefault(name, []).append((n1, n2, include))
+        else: raise ValueError('Unsupported selection: %s' % name)
+        self._recs = None
+        self.rewind()
+    def _match(self, name, n1, n2):
+        if name == 'antennae':
+            if n1 >= 0 and n2 >= 0:
+                return n.logical_or(n.logical_and(self.i == n1, self.j == n2),
+                    n.logical_and(self.i == n2, self.j == n1))
+            if n1 >= 0 or n2 >= 0:
+                a = max(n1, n2)
+                return n.logical_or(self.i == a, self.j == a)
+            return n.ones(self.nrec, dtype=n.bool)
+        elif name == 'time':
+            return n.logical_and(self.time >= n1, self.time <= n2)
+        elif name == 'polarization': return self.pol == n1
+        elif name == 'auto': return self.i == self.j
+        elif name == 'decimate':
+            times, cnt = n.unique(self.time, return_inverse=True)
+            return cnt % int(n1) == int(n2)
+    def selected(self):
+        """Return the indices of the selected records."""
+        if self._recs is None:
+            keep = n.ones(self.nrec, dtype=n.bool)
+            for name, sels in self._sel.items():
+                inc = [self._match(name, n1, n2) for n1,n2,i in sels if i]
+                for m in inc[1:]: inc[0] = n.logical_or(inc[0], m)
+                if len(inc) > 0: keep = n.logical_and(keep, inc[0])
+                for n1,n2,i in sels:
+                    if not i: keep = n.logical_and(keep, 
+                        n.logical_not(self._match(name, n1, n2)))
+            self._recs = n.where(keep)[0]
+        return self._recs
+    def rewind(self):
+        self._next, self._cur = 0, -1
+    def read(self, raw=False):
+        """Return the next selected record, as UV.read() does."""
+        recs = self.selected()
+        if self._next >= len(recs): raise IOError("No data read")
+        k = self._cur = recs[self._next]
+        self._next += 1
+        p = (self.uvw[k], self.time[k], (int(self.i[k]), int(self.j[k])))
+        if raw: return p, self.data[k], self.flags[k]
+        return p, n.ma.array(self.data[k], mask=self.flags[k])
+    def all(self, raw=False):
+        """Provide an iterator over preamble, data, as UV.all() does."""
+        while True:
+            try: yield self.read(raw=raw)
+            except(IOError): return
+
+def uv_to_waterfalls(uv, outdir, maxmem=2**28):
+    """Transpose a time-ordered UV file (a filename or a UV opened 'old')
+    into per-baseline waterfalls in outdir: the records of each (i,j,pol)
+    are stored contiguously, in file order, as rows of data.dat and 
+    flags.dat (time x chan; flags are True where flagged), with matching 
+    rows of time.dat and uvw.dat, and an index in meta.json.  Records are 
+    placed using the record index, then read in chunks of at most maxmem
+    bytes, so memory use is bounded however large the file.  Any select()
+    on uv is cleared, since every record in the index must be read back.
+    Open the result with WaterfallUV."""
+    import json, os
+    if type(uv) == str: uv = UV(uv)
+    t, i, j, pol = uv._records()
+    uv.rewind()
+    uv.select('clear', 0, 0)
+    nrec, nchan = len(t), uv.nchan
+    if nrec == 0: raise ValueError('No records to transpose')
+    # Sort records by (pol,i,j), keeping file order within each baseline
+    order = n.lexsort((n.arange(nrec), j, i, pol))
+    dest = n.empty(nrec, dtype=n.int64)
+    dest[order] = n.arange(nrec)
+    key = n.array([i[order], j[order], pol[order]])
+    starts = n.concatenate([[0], 
+        n.where(n.any(key[:,1:] != key[:,:-1], axis=0))[0] + 1])
+    counts = n.diff(n.concatenate([starts, [nrec]]))
+    if not os.path.exists(outdir): os.mkdir(outdir)
+    cols = {}
+    for name, dtype, shape in COLUMNS:
+        if not name in ('uvw', 'time', 'data', 'flags'): continue
+        shape = tuple([nchan if s == 'nchan' else s for s in shape])
+        cols[name] = n.memmap(os.path.join(outdir, name + '.dat'), 
+            dtype=dtype, mode='w+', shape=(nrec,) + shape)
+    cols['time'][dest] = t
+    chunk = max(1, maxmem / (9*nchan + 24))
+    vars = None
+    for k in xrange(0, nrec, chunk):
+        m = min(chunk, nrec - k)
+        buf = dict([(name, n.empty((m,) + cols[name].shape[1:], 
+            dtype=cols[name].dtype)) for name in ('uvw', 'data', 'flags')])
+        for r in xrange(m):
+            p, d, f, nread = uv.raw_read(nchan)
+            if nread != nchan:
+                raise ValueError('Record %d has %d channels, not %d' % 
+                    (k + r, nread, nchan))
+            if vars is None: vars = _columnar_vars(uv)
+            buf['uvw'][r], buf['data'][r], buf['flags'][r] = p[0], d, f
+        # Rows of a baseline within a chunk are adjacent in the output
+        rows = dest[k:k+m]
+        o = n.argsort(rows)
+        for name in buf: cols[name][rows[o]] = buf[name][o]
+        for name in buf: cols[name].flush()
+    for name in cols: cols[name].flush()
+    del(cols)
+    meta = {'nrec':nrec, 'nchan':nchan, 'vars':vars or {},
+        'keys':[[int(key[0,s]), int(key[1,s]), int(key[2,s]), int(s), int(c)]
+            for s,c in zip(starts, counts)]}
+    json.dump(meta, open(os.path.join(outdir, 'meta.json'), 'w'))
+
+class WaterfallUV:
+    """Read-only access to the output of uv_to_waterfalls.  The columns
+    time, uvw, data, and flags are memory-mapped numpy arrays whose rows are
+    grouped by baseline and polarization, and waterfall() returns the 
+    [time,chan] block of one of them without copying."""
+    def __init__(self, dirname):
+        import json, os
+        self.dirname = dirname
+        meta = json.load(open(os.path.join(dirname, 'meta.json')))
+        self.nrec, self.nchan = meta['nrec'], meta['nchan']
+        self._vars = meta['vars']
+        self._rows = dict([((i,j,pol), slice(s, s+c)) 
+            for i,j,pol,s,c in meta['keys']])
+        for name, dtype, shape in COLUMNS:
+            if not name in ('uvw', 'time', 'data', 'flags'): continue
+            shape = tuple([self.nchan if s == 'nchan' else s for s in shape])
+            setattr(self, name, n.memmap(os.path.join(dirname, name + '.dat'),
+                dtype=dtype, mode='r', shape=(self.nrec,) + shape))
+    def __getitem__(self, name):
+        """Return a variable, as saved from the first record."""
+        return self._vars[name]
+    def keys(self):
+        """Return a list of the (i,j,pol) of each waterfall."""
+        return self._rows.keys()
+    def rows(self, bl, pol=0):
+        """Return the slice of rows holding baseline bl=(i,j) and 
+        polarization pol (a code or a string like 'xx')."""
+        if type(pol) == str: pol = str2pol[pol]
+        return self._rows[(bl[0], bl[1], pol)]
+    def waterfall(self, bl, pol=0, raw=False):
+        """Return (times, data) for baseline bl=(i,j) and polarization pol,
+        where data is a [time,chan] masked array backed by the files.
+        'raw' returns (times, data, flags) instead."""
+        r = self.rows(bl, pol)
+        if raw: return self.time[r], self.data[r], self.flags[r]
+        return self.time[r], n.ma.array(self.data[r], mask=self.flags[r])
+
+#  ___
+# |_ _|_ __ ___   __ _  __ _  ___
+#  | || '_ ` _ \ / _` |/ _` |/ _ \
+#  | || | | | | | (_| | (_| |  __/
+# |___|_| |_| |_|\__,_|\__, |\___|
+#                      |___/
+
+class Image:
+    """Interface to a Miriad image cube that streams it a subcube (a plane,
+    a spectrum, ...) at a time through Miriad's buffered xyzio, so cubes
+    need never be held in memory.  Axes are in Miriad order (x first), so
+    shape is (nx, ny, nz, ...), while the arrays read and written are
+    numpy-ordered, e.g. planes are (ny,nx).  Header keywords are available
+    as img[name].  Only one thread should use an Image at a time."""
+    def __init__(self, filename, status='old', shape=None):
+        """Open an image ('old' or 'new').  A new image needs shape, the
+        length of each axis, x first."""
+        self.tno = None
+        if status == 'new' and shape is None:
+            raise ValueError('A new image needs a shape')
+        self.tno, self.shape = _miriad.xyzopen(filename, status, shape)
+        self.setup('xy'[:len(self.shape)])
+    def close(self):
+        """Flush and close the image."""
+        if self.tno is not None: _miriad.xyzclose(self.tno)
+        self.tno = None
+    def __del__(self): self.close()
+    def __getitem__(self, name): return _miriad.rdhd(self.tno, name)
+    def __setitem__(self, name, val): _miriad.wrhd(self.tno, name, val)
+    def setup(self, subcube, blc=None, trc=None):
+        """Choose the subcubes read() and write() work on: subcube names
+        their axes ('xy' for planes, 'z' for spectra along the third axis,
+        '-x' reverses x, ...), in the order they vary within a subcube.
+        blc and trc (from 0, inclusive, x first) bound the region; they
+        default to the whole cube.  Returns the number of subcubes."""
+        if blc is None: blc = [0] * len(self.shape)
+        if trc is None: trc = [s - 1 for s in self.shape]
+        blc, trc = [int(b)+1 for b in blc], [int(t)+1 for t in trc]
+        axes = [c for c in subcube if c.isalpha()]
+        subshape = [trc['xyzabcd'.index(c)] - blc['xyzabcd'.index(c)] + 1
+            for c in axes]
+        subsize, self.nsub = _miriad.xyzsetup(self.tno, subcube, blc, trc)
+        self._subshape = tuple(reversed(subshape))
+        return self.nsub
+    def read(self, k, raw=False):
+        """Return subcube k (from 0) as a masked array (masked where
+        blanked).  'raw' returns data and flags seperately."""
+        d, f = _miriad.xyzread(self.tno, k)
+        d, f = d.reshape(self._subshape), f.reshape(self._subshape)
+        if raw: return d, f
+        return n.ma.array(d, mask=f)
+    def write(self, k, data, flags=None):
+        """Write subcube k (from 0) from data, a (masked) array shaped as
+        read() returns.  flags, if provided, overrides the mask of data
+        (True where blanked)."""
+        if flags is None: flags = n.ma.getmaskarray(data)
+        data = n.ascontiguousarray(n.ma.getdata(data), dtype=n.float32)
+        flags = n.ascontiguousarray(flags, dtype=n.bool)
+        _miriad.xyzwrite(self.tno, k, data, flags)
+    def all(self, raw=False):
+        """Provide an iterator over the subcubes set up by setup()."""
+        for k in xrange(self.nsub): yield self.read(k, raw=raw)
+    def planes(self, raw=False):
+        """Provide an iterator over the (ny,nx) planes of the cube."""
+        self.setup('xy')
+        return self.all(raw=raw)
+    def spectra(self, raw=False):
+        """Provide an iterator over the spectra (along the third axis) of
+        the cube, x varying fastest, then y."""
+        self.setup('z')
+        return self.all(raw=raw)
+
 def bl2ij(bl):
     bl = int(bl)
     if (bl > 65536):
@@ -20,6 +20,230 @@ class TestHealpix(unittest.TestCase):
         """Test HEALpix npix2nside funtional attribute"""
         self.assertEqual(self.hpb.npix2nside(12*2**12), 2**6)
 
+class TestBatch(unittest.TestCase):
+    def setUp(self):
+        self.hpb = h.HealpixBase(nside=64, scheme='RING')
+    def test_roundtrip(self):
+        """Test crd2px/px2crd round trip over a multi-threaded batch"""
+        px = n.arange(self.hpb.npix())
+        x,y,z = self.hpb.px2crd(px, ncrd=3, nthreads=4)
+        self.assertTrue(n.all(self.hpb.crd2px(x,y,z, nthreads=4) == px))
+        th,phi = self.hpb.px2crd(px, ncrd=2)
+        self.assertTrue(n.all(self.hpb.crd2px(th,phi, nthreads=1) == px))
+        th,phi = self.hpb.px2crd(px[::3], ncrd=2)
+        self.assertTrue(n.all(self.hpb.crd2px(th,phi) == px[::3]))
+    def test_interpolate(self):
+        """Test that interpolation weights sum to 1"""
+        th,phi = self.hpb.px2crd(n.arange(self.hpb.npix()), ncrd=2)
+        px,wgt = self.hpb.crd2px(th, phi, interpolate=1)
+        self.assertEqual(px.shape, (self.hpb.npix(), 4))
+        self.assertTrue(n.allclose(wgt.sum(axis=1), 1))
+    def test_bad_crds(self):
+        """Test that NaN coordinates raise one warning with their count"""
+        import warnings
+        x,y,z = self.hpb.px2crd(n.arange(20000))
+        z[:5] = n.NaN
+        warnings.simplefilter('error', RuntimeWarning)
+        try: self.assertRaises(RuntimeWarning, self.hpb.crd2px, x, y, z)
+        finally: warnings.resetwarnings()
+        self.assertRaises(ValueError, self.hpb.px2crd, n.array([-1]))
+
+class TestInterp(unittest.TestCase):
+    def setUp(self):
+        self.hpb = h.HealpixBase(nside=32, scheme='NEST')
+        self.map = n.random.uniform(size=(3,self.hpb.npix()))
+        self.th = n.random.uniform(0, n.pi, size=1000)
+        self.phi = n.random.uniform(0, 2*n.pi, size=1000)
+    def test_interp_get(self):
+        """Test interp_get matches the sum over crd2px interpolation"""
+        px,wgt = self.hpb.crd2px(self.th, self.phi, interpolate=1)
+        ans = n.sum(self.map[0][px] * wgt, axis=-1)
+        rv = self.hpb.interp_get(self.map[0], self.th, self.phi)
+        self.assertTrue(n.allclose(rv, ans))
+        rv = self.hpb.interp_get(self.map[0].astype(n.float32), 
+            self.th, self.phi)
+        self.assertTrue(n.allclose(rv, ans, rtol=1e-6))
+        x = n.sin(self.th) * n.cos(self.phi)
+        y = n.sin(self.th) * n.sin(self.phi)
+        z = n.cos(self.th)
+        rv = self.hpb.interp_get(self.map[0], x, y, z)
+        self.assertTrue(n.allclose(rv, ans))
+    def test_multi_map(self):
+        """Test interp_get over a stack of maps"""
+        rv = self.hpb.interp_get(self.map, self.th, self.phi, nthreads=2)
+        self.assertEqual(rv.shape, (3,1000))
+        for i in range(3):
+            ans = self.hpb.interp_get(self.map[i], self.th, self.phi)
+            self.assertTrue(n.all(rv[i] == ans))
+        self.assertRaises(ValueError, self.hpb.interp_get, self.map[:,:-1],
+            self.th, self.phi)
+
+class TestBase2(unittest.TestCase):
+    def test_big_nside(self):
+        """Test 64 bit pixel numbers for nside > 8192"""
+        for scheme in ('RING', 'NEST'):
+            hpb = h.HealpixBase(nside=2**16, scheme=scheme)
+            self.assertEqual(hpb.npix(), 12*2**32)
+            self.assertEqual(hpb.npix2nside(hpb.npix()), 2**16)
+            px = n.array([0, 2**31+7, 2**32+1, hpb.npix()-1])
+            th,phi = hpb.px2crd(px, ncrd=2)
+            self.assertTrue(n.all(hpb.crd2px(th,phi) == px))
+            px2,wgt = hpb.crd2px(th, phi, interpolate=1)
+            self.assertTrue(n.all(px2.max(axis=1) < hpb.npix()))
+    def test_nest_ring(self):
+        """Test nest/ring conversion round trip for nside > 8192"""
+        hpb = h.HealpixBase(nside=2**20, scheme='RING')
+        px = n.array([0, 12345678901, 2**40, hpb.npix()-1])
+        px2 = hpb.nest_ring_conv(px.copy(), 'NEST')
+        self.assertTrue(n.all(hpb.nest_ring_conv(px2, 'RING') == px))
+        px3 = n.zeros((len(px), 2), dtype=n.long)
+        px3[:,0] = px2
+        hpb.nest_ring_conv(px3[:,0], 'RING')
+        self.assertTrue(n.all(px3[:,0] == px))
+        self.assertTrue(n.all(px3[:,1] == 0))
+        bad = n.array([0, hpb.npix()])
+        self.assertRaises(ValueError, hpb.nest_ring_conv, bad, 'NEST')
+        self.assertEqual(bad[1], hpb.npix())
+
+class TestScatter(unittest.TestCase):
+    def setUp(self):
+        self.hp = h.HealpixBase(16, 'RING')
+    def test_accumulate(self):
+        """Test that repeated pixels accumulate and others are untouched"""
+        m = n.ones(self.hp.npix(), dtype=n.double)
+        w = n.zeros(self.hp.npix(), dtype=n.float32)
+        px = n.array([3, 3, 7, -1], dtype=n.long)
+        self.hp.scatter_add(px, [m, w], [n.array([1.,2.,3.,4.]), n.array([1.], dtype=n.float32)])
+        self.assertEqual(m[3], 4.); self.assertEqual(m[7], 4.)
+        self.assertEqual(m[-1], 5.); self.assertEqual(m[0], 1.)
+        self.assertEqual(w[3], 2.); self.assertEqual(w[7], 1.)
+    def test_set(self):
+        """Test that set mode assigns the sum of repeated values"""
+        m = n.ones(self.hp.npix(), dtype=n.complex64)
+        px = n.array([5, 5, 6], dtype=n.long)
+        self.hp.scatter_add(px, [m], [n.array([1j, 2., 3.], dtype=n.complex64)], set=True)
+        self.assertEqual(m[5], 2+1j); self.assertEqual(m[6], 3.)
+        self.assertEqual(m[4], 1.)
+    def test_bad(self):
+        """Test that bad pixels and shapes are rejected"""
+        m = n.zeros(self.hp.npix(), dtype=n.double)
+        px = n.array([self.hp.npix()], dtype=n.long)
+        self.assertRaises(ValueError, self.hp.scatter_add, px, [m], [n.ones(1)])
+        px = n.array([0, 1], dtype=n.long)
+        self.assertRaises(ValueError, self.hp.scatter_add, px, [m[:-1]], [n.ones(2)])
+        self.assertRaises(ValueError, self.hp.scatter_add, px, [m], [n.ones(3)])
+
+class TestQuery(unittest.TestCase):
+    def setUp(self):
+        self.hp = h.HealpixBase(32, 'RING')
+        self.xyz = n.array(self.hp.px2crd(n.arange(self.hp.npix()), ncrd=3))
+    def expand(self, ranges):
+        self.assertTrue(n.all(ranges[:,0] < ranges[:,1]))
+        self.assertTrue(n.all(ranges[1:,0] > ranges[:-1,1]))
+        px = [n.arange(a,b) for a,b in ranges]
+        return n.concatenate(px + [n.zeros(0, dtype=n.long)])
+    def test_disc(self):
+        """Test that query_disc finds the pixels with centers in each disc"""
+        th = n.array([0., .7, 1.5, 2.9])
+        phi = n.array([0., 6.1, 2., 4.])
+        rad = n.array([.1, .3, .05, 1.])
+        rngs = self.hp.query_disc(rad, th, phi)
+        self.assertEqual(len(rngs), 4)
+        for i,r in enumerate(rngs):
+            c = n.array([n.sin(th[i])*n.cos(phi[i]),
+                n.sin(th[i])*n.sin(phi[i]), n.cos(th[i])])
+            d = n.dot(c, self.xyz)
+            px = self.expand(r)
+            self.assertTrue(n.all(d[px] >= n.cos(rad[i]) - 1e-12))
+            self.assertEqual(len(px), n.sum(d > n.cos(rad[i]) + 1e-12))
+        x,y,z = self.hp.px2crd(n.array([100]), ncrd=3)
+        r = self.hp.query_disc(n.pi, x, y, z)[0]
+        self.assertEqual(r.tolist(), [[0, self.hp.npix()]])
+    def test_polygon(self):
+        """Test that query_polygon finds the pixels inside each polygon"""
+        v = n.array([[1,.1,.05],[.05,1,.1],[.1,.05,1]])
+        v /= n.sqrt(n.sum(v**2, axis=1)).reshape(3,1)
+        r1,r2 = self.hp.query_polygon([v, v[::-1]])
+        px = self.expand(r1)
+        self.assertTrue(n.all(px == self.expand(r2)))
+        d = n.array([n.dot(n.cross(v[i], v[(i+1)%3]), self.xyz)
+            for i in range(3)]).min(axis=0)
+        self.assertTrue(n.all(d[px] >= -1e-12))
+        self.assertEqual(len(px), n.sum(d > 1e-12))
+        self.assertRaises(ValueError, self.hp.query_polygon, [v[:2]])
+
+class TestReorder(unittest.TestCase):
+    def test_reorder(self):
+        """Test that reorder permutes maps like indexing with nest_ring_conv"""
+        for nside in (1, 4, 256):
+            hp = h.HealpixBase(nside, 'NEST')
+            px = hp.nest_ring_conv(n.arange(hp.npix()), 'NEST')
+            for dtype in (n.int16, n.float32, n.double, n.complex128, 'S3'):
+                m = n.arange(hp.npix()).astype(dtype)
+                m2 = m.copy()
+                hp.reorder(m2, 'RING')
+                self.assertTrue(n.all(m2 == m[px]))
+                hp.reorder(m2, 'NEST')
+                self.assertTrue(n.all(m2 == m[px]))
+                hp.set_nside_scheme(nside, 'RING')
+                hp.reorder(m2, 'NEST')
+                self.assertTrue(n.all(m2 == m))
+                hp.set_nside_scheme(nside, 'NEST')
+    def test_bad(self):
+        """Test that reorder rejects maps it can't permute in place"""
+        hp = h.HealpixBase(4, 'NEST')
+        m = n.zeros(2*hp.npix())
+        self.assertRaises(ValueError, hp.reorder, m[:hp.npix()+1], 'RING')
+        self.assertRaises(ValueError, hp.reorder, m[::2], 'RING')
+        self.assertRaises(ValueError, hp.reorder, m[:hp.npix()], 'XYZ')
+
+class TestUdGrade(unittest.TestCase):
+    def setUp(self):
+        self.hp = h.HealpixBase(8, 'NEST')
+        self.m = n.arange(self.hp.npix(), dtype=n.double)
+    def test_down_up(self):
+        """Test that ud_grade averages children and replicates parents"""
+        out = n.empty(12*4, dtype=n.double)
+        self.hp.ud_grade(self.m, out)
+        self.assertTrue(n.all(out == self.m.reshape(48,16).mean(axis=1)))
+        self.hp.ud_grade(self.m, out, mode='sum')
+        self.assertTrue(n.all(out == self.m.reshape(48,16).sum(axis=1)))
+        up = n.empty(12*16*16, dtype=n.double)
+        self.hp.ud_grade(self.m, up)
+        self.assertTrue(n.all(up == n.repeat(self.m, 4)))
+        self.hp.ud_grade(self.m, up, mode='sum')
+        self.assertTrue(n.all(up == n.repeat(self.m, 4) / 4))
+    def test_wgt_mask(self):
+        """Test that ud_grade weights children and skips masked pixels"""
+        out = n.empty(12, dtype=n.double)
+        wgt = n.ones_like(self.m); wgt[:32] = 0
+        mask = n.zeros(self.m.shape, dtype=n.bool); mask[64:] = True
+        self.hp.ud_grade(self.m, out, wgt=wgt, mask=mask, fill=-1)
+        self.assertEqual(out[0], self.m[32:64].mean())
+        self.assertTrue(n.all(out[1:] == -1))
+    def test_in_place(self):
+        """Test that ud_grade works in place"""
+        m = self.m.copy()
+        self.hp.ud_grade(m, m[:12*4])
+        self.assertTrue(n.all(m[:48] == self.m.reshape(48,16).mean(axis=1)))
+    def test_swapped(self):
+        """Test that ud_grade reads byte-swapped maps by value"""
+        out = n.empty(12*4, dtype=n.double)
+        self.hp.ud_grade(self.m.astype('>f8'), out)
+        self.assertTrue(n.all(out == self.m.reshape(48,16).mean(axis=1)))
+        self.assertRaises(ValueError, self.hp.ud_grade, self.m,
+            n.empty(48, dtype='>f8'))
+    def test_bad(self):
+        """Test that ud_grade rejects maps it can't regrade"""
+        self.assertRaises(ValueError, self.hp.ud_grade, self.m, n.empty(24))
+        self.assertRaises(ValueError, self.hp.ud_grade, self.m, n.empty(3))
+        self.assertRaises(ValueError, self.hp.ud_grade, self.m,
+            n.empty(48, dtype=n.float32))
+        self.assertRaises(ValueError, self.hp.ud_grade, self.m, n.empty(48),
+            mode='median')
+        hp = h.HealpixBase(8, 'RING')
+        self.assertRaises(ValueError, hp.ud_grade, self.m, n.empty(48))
+
 if False:
   class TestMemLeaks(unittest.TestCase):
     def setUp(self):
@@ -41,6 +265,13 @@ class TestSuite(unittest.TestSuite):
 
         loader = unittest.TestLoader()
         self.addTests(loader.loadTestsFromTestCase(TestHealpix))
+        self.addTests(loader.loadTestsFromTestCase(TestBatch))
+        self.addTests(loader.loadTestsFromTestCase(TestInterp))
+        self.addTests(loader.loadTestsFromTestCase(TestBase2))
+        self.addTests(loader.loadTestsFromTestCase(TestScatter))
+        self.addTests(loader.loadTestsFromTestCase(TestQuery))
+        self.addTests(loader.loadTestsFromTestCase(TestReorder))
+        self.addTests(loader.loadTestsFromTestCase(TestUdGrade))
         #self.addTests(loader.loadTestsFromTestCase(TestMemLeaks))
 
 if __name__ == '__main__':
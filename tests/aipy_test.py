@@ -6,6 +6,7 @@ import unittest
 
 import _alm_test
 import _healpix_test
+import healpix_test
 import amp_test
 import coord_test
 import deconv_test
@@ -26,6 +27,7 @@ class TestSuite(unittest.TestSuite):
 
                 self.addTest(_alm_test.TestSuite())
                 self.addTest(_healpix_test.TestSuite())
+                self.addTest(healpix_test.TestSuite())
                 self.addTest(amp_test.TestSuite())
                 self.addTest(coord_test.TestSuite())
                 self.addTest(deconv_test.TestSuite())
@@ -0,0 +1,48 @@
+# -*- coding: utf-8 -*-
+import sys
+import unittest
+import timeit
+
+class TestSpeed(unittest.TestCase):
+    def _crd_speed(self, scheme):
+        setup = '''
+import numpy as n, aipy as a
+hpb = a._healpix.HealpixBase(nside=2048, scheme='%s')
+px = n.arange(0, hpb.npix(), 16)
+th,phi = hpb.px2crd(px, ncrd=2)
+x,y,z = hpb.px2crd(px, ncrd=3)
+''' % scheme
+        for name, expr in [('crd2px th,phi', 'hpb.crd2px(th,phi,nthreads=1)'),
+                ('crd2px x,y,z', 'hpb.crd2px(x,y,z,nthreads=1)'),
+                ('px2crd th,phi', 'hpb.px2crd(px,ncrd=2,nthreads=1)'),
+                ('px2crd x,y,z', 'hpb.px2crd(px,ncrd=3,nthreads=1)')]:
+            t = timeit.Timer(expr, setup=setup)
+            sys.stderr.write("%s %s: %.1f ns/px ... " % (name, scheme,
+                t.timeit(number=5) / 5 / (12*2048**2/16) * 1e9))
+    def test_ring(self):
+        """Test the speed of RING crd2px/px2crd at nside 2048"""
+        self._crd_speed('RING')
+    def test_nest(self):
+        """Test the speed of NEST crd2px/px2crd at nside 2048"""
+        self._crd_speed('NEST')
+    def test_change_scheme(self):
+        """Test the speed of changing the scheme of a map at nside 4096"""
+        setup = '''
+import numpy as n, aipy as a
+hpm = a.healpix.HealpixMap(nside=4096, scheme='NEST')
+'''
+        t = timeit.Timer("hpm.change_scheme('RING'); hpm.change_scheme('NEST')",
+            setup=setup)
+        sys.stderr.write("change_scheme: %.2f s ... " % (t.timeit(number=2) / 4))
+
+class TestSuite(unittest.TestSuite):
+    """A unittest.TestSuite class which contains all of the aipy._healpix speed tests."""
+
+    def __init__(self):
+        unittest.TestSuite.__init__(self)
+
+        loader = unittest.TestLoader()
+        self.addTests(loader.loadTestsFromTestCase(TestSpeed))
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,175 @@
+# -*- coding: utf-8 -*-
+import unittest, os, tempfile
+import aipy as a, numpy as n, pyfits
+
+class TestFits(unittest.TestCase):
+    def setUp(self):
+        fd, self.filename = tempfile.mkstemp(suffix='.fits')
+        os.close(fd)
+    def tearDown(self):
+        os.remove(self.filename)
+    def test_hpm(self):
+        """Test that a HealpixMap survives a trip through a fits file"""
+        for scheme in ('RING', 'NEST'):
+            for dtype in (n.float32, n.double, n.complex64, n.int16):
+                h = a.healpix.HealpixMap(16, scheme, dtype=dtype)
+                h.map = n.arange(h.npix()).astype(dtype)
+                h.to_fits(self.filename)
+                h2 = a.healpix.HealpixMap(fromfits=self.filename)
+                self.assertEqual(h2.scheme(), scheme)
+                self.assertEqual(h2.get_dtype(), h.get_dtype())
+                self.assertTrue(n.all(h2.map == h.map))
+                # The file is readable by pyfits too
+                hdu = pyfits.open(self.filename)[1]
+                self.assertEqual(hdu.header['ORDERING'][:4], scheme)
+                self.assertTrue(n.all(hdu.data.field(0) == h.map))
+        self.assertRaises(IndexError, h2.from_fits, self.filename, colnum=1)
+    def test_map(self):
+        """Test that a Map survives a trip through a fits file"""
+        m = a.map.Map(nside=8, nindices=2)
+        m.map.map = n.arange(m.npix(), dtype=n.double)
+        m.wgt.map = n.ones(m.npix())
+        for i,ind in enumerate(m.ind): ind.map = i + n.zeros(m.npix())
+        m.to_fits(self.filename, clobber=True, history='made by\ntest_map')
+        self.assertRaises(IOError, m.to_fits, self.filename)
+        m2 = a.map.Map(fromfits=self.filename)
+        self.assertEqual(len(m2.ind), 2)
+        self.assertTrue(n.all(m2.map.map == m.map.map))
+        self.assertTrue(n.all(m2.wgt.map == m.wgt.map))
+        self.assertTrue(n.all(m2.ind[1].map == 1))
+        hdr = pyfits.open(self.filename)[0].header
+        self.assertTrue('test_map' in str(hdr))
+
+class TestSparse(unittest.TestCase):
+    def setUp(self):
+        fd, self.filename = tempfile.mkstemp(suffix='.fits')
+        os.close(fd)
+        self.s = a.healpix.SparseHealpixMap(64, nlayers=2)
+        self.px = n.array([5, 900, 5, 40000, 12], dtype=n.long)
+        self.s.add(self.px, [[1, 2, 3, 4, 5], 1])
+    def tearDown(self):
+        os.remove(self.filename)
+    def test_add_get(self):
+        """Test that a SparseHealpixMap accumulates only the cells added"""
+        s = self.s
+        self.assertTrue(n.all(s.cells == a.healpix.nuniq([5,12,900,40000],6)))
+        v = s.get([5, 12, 900, 40000, 6])
+        self.assertTrue(n.all(v[0] == [4, 5, 2, 4, 0]))
+        self.assertTrue(n.all(v[1] == [2, 1, 1, 1, 0]))
+        s.add(n.array([900, 7]), [[1, 1], [0, 0]])
+        self.assertEqual(len(s.cells), 5)
+        self.assertEqual(s.get([900])[0,0], 3)
+        th,phi = s.px2crd(n.array([900]), ncrd=2)
+        self.assertEqual(s[th,phi][0,0], 3)
+        self.assertRaises(ValueError, s.add, [s.npix()], [[1], [1]])
+        self.assertRaises(ValueError, s.add, [1], [1])
+    def test_multi_order(self):
+        """Test that coarse cells stand for all of the pixels under them"""
+        s = self.s
+        s.add([40000], [[10], [0]], order=4)
+        order,px = a.healpix.nuniq2px(s.cells)
+        self.assertEqual(list(order), [4, 6, 6, 6, 6])
+        self.assertEqual(px[0], 40000 / 16)
+        v = s.get(n.arange(40000 / 16 * 16, 40000 / 16 * 16 + 16))[0]
+        self.assertTrue(n.all(v[v != 14] == 10))
+        self.assertEqual(n.sum(v == 14), 1)
+        d = s.to_dense(0)
+        self.assertTrue(n.all(d == s.get(n.arange(s.npix()))[0]))
+    def test_dense(self):
+        """Test conversion to and from dense HealpixMaps"""
+        h = self.s.to_hpm(layer=0, scheme='RING')
+        self.assertEqual(h.scheme(), 'RING')
+        self.assertEqual(n.sum(h.map != 0), 4)
+        s2 = a.healpix.SparseHealpixMap(64)
+        s2.from_hpm(h)
+        self.assertTrue(n.all(s2.cells == self.s.cells))
+        self.assertTrue(n.all(s2.vals[0] == self.s.vals[0]))
+    def test_fits(self):
+        """Test that a SparseHealpixMap survives a trip through a fits file"""
+        for order in (None, 2):
+            self.s.add([1000], [[1], [2]], order=order)
+            self.s.to_fits(self.filename)
+            s2 = a.healpix.SparseHealpixMap(fromfits=self.filename)
+            self.assertEqual(s2.nside(), 64)
+            self.assertTrue(n.all(s2.cells == self.s.cells))
+            self.assertTrue(n.all(s2.vals == self.s.vals))
+            hdu = pyfits.open(self.filename)[1]
+            self.assertEqual(hdu.header['INDXSCHM'], 'EXPLICIT')
+            self.assertEqual(len(hdu.data), len(self.s.cells))
+        self.assertEqual(hdu.header['ORDERING'], 'NUNIQ')
+        # A full sky map is read as the cells of its nonzero pixels
+        h = a.healpix.HealpixMap(64, 'RING')
+        h[n.array([7, 100])] = [1, 2]
+        h.to_fits(self.filename)
+        s2 = a.healpix.SparseHealpixMap(fromfits=self.filename)
+        self.assertTrue(n.all(s2.to_hpm().map == h.map))
+    def test_map(self):
+        """Test that a SparseMap matches a Map with the same data"""
+        m = a.map.Map(nside=32, nindices=1)
+        s = a.map.SparseMap(nside=32, nindices=1)
+        th = n.array([.1, .2, .1, 2.])
+        phi = n.array([1., 2., 1., 3.])
+        w, f = n.array([1., 2, 3, 4]), n.array([5., 6, 7, 8])
+        for d in (m, s): d.add((th,phi), w, f, [n.array([1., 1, 2, 2])])
+        m2 = s.to_map()
+        for h1,h2 in zip([m.map, m.wgt] + m.ind, [m2.map, m2.wgt] + m2.ind):
+            self.assertTrue(n.all(h1.map == h2.map))
+        self.assertTrue(n.all(s[th,phi][0] == m[th,phi][0]))
+        s2 = a.map.SparseMap(nside=32, nindices=1)
+        s2.from_map(m)
+        self.assertTrue(n.all(s2.smap.vals == s.smap.vals))
+        s.to_fits(self.filename, clobber=True)
+        s3 = a.map.SparseMap(fromfits=self.filename)
+        self.assertTrue(n.all(s3.smap.vals == s.smap.vals))
+
+class TestHealpixMap(unittest.TestCase):
+    def test_add_layouts(self):
+        """Test that add and assignment work on strided, byte-swapped and
+        bool maps"""
+        px = n.array([3, 3, 5])
+        for m in (n.zeros(2*48)[::2], n.zeros(48, dtype='>f8'),
+                n.zeros(48, dtype='<f8')):
+            h = a.healpix.HealpixMap(2, 'RING')
+            h.set_map(m, scheme='RING')
+            h.add(px, [1., 2., 4.])
+            self.assertEqual(h[3], 3.); self.assertEqual(h[5], 4.)
+            h[px] = [1., 1., 1.]
+            self.assertEqual(h[3], 2.); self.assertEqual(h[5], 1.)
+            self.assertEqual(h.map.sum(), 3.)
+        h = a.healpix.HealpixMap(2, 'RING', dtype=n.bool)
+        h.add(px, [True, False, False])
+        self.assertTrue(h[3]); self.assertFalse(h[5])
+        self.assertEqual(h.map.sum(), 1)
+    def test_change_scheme_swapped(self):
+        """Test changing the scheme of a byte-swapped map"""
+        h1 = a.healpix.HealpixMap(4, 'RING')
+        h1.set_map(n.arange(192, dtype=n.double), scheme='RING')
+        h2 = a.healpix.HealpixMap(4, 'RING')
+        h2.set_map(n.arange(192, dtype='>f8'), scheme='RING')
+        h1.change_scheme('NEST'); h2.change_scheme('NEST')
+        self.assertTrue(n.all(h1.map == h2.map))
+        self.assertEqual(h2.map.dtype, n.dtype('>f8'))
+        h3 = a.healpix.HealpixMap(4, 'RING', dtype='>f8')
+        h3.from_hpm(h2)
+        self.assertTrue(n.all(h3.map == n.arange(192)))
+    def test_map_layouts(self):
+        """Test Map.add on a byte-swapped weight map"""
+        m = a.map.Map(nside=2)
+        m.wgt.set_map(n.zeros(48, dtype='>f8'), scheme=m.wgt.scheme())
+        m.add(n.array([1, 1]), n.array([1., 2.]), n.array([3., 4.]))
+        self.assertEqual(m.wgt[1], 3.)
+        self.assertEqual(m[1], 11. / 3)
+
+class TestSuite(unittest.TestSuite):
+    """A unittest.TestSuite class which contains all of the aipy.healpix unit tests."""
+
+    def __init__(self):
+        unittest.TestSuite.__init__(self)
+
+        loader = unittest.TestLoader()
+        self.addTests(loader.loadTestsFromTestCase(TestFits))
+        self.addTests(loader.loadTestsFromTestCase(TestSparse))
+        self.addTests(loader.loadTestsFromTestCase(TestHealpixMap))
+
+if __name__ == '__main__':
+    unittest.main()
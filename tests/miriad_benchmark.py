@@ -0,0 +1,42 @@
+# -*- coding: utf-8 -*-
+import sys
+import unittest
+import timeit
+
+class TestSpeed(unittest.TestCase):
+    def _corrj_speed(self, nchan):
+        # Only the per-record scaling and int16 (un)packing is timed, without
+        # file i/o.  Build with AIPY_NOSIMD=1 to time the plain C loops.
+        setup = '''
+import numpy as n, aipy as a
+nchan, nrec = %d, 500
+data = n.random.normal(size=(nrec,nchan)) * 100
+data = (data + 1j*data[::-1]).astype(n.complex64)
+packed, tscale = a._miriad.corrj_pack(data)
+''' % nchan
+        import aipy as a
+        kind = a._miriad.SIMD and 'SSE2' or 'scalar'
+        for name, expr in [('pack', 'a._miriad.corrj_pack(data)'),
+                ('unpack', 'a._miriad.corrj_unpack(packed, tscale)')]:
+            t = timeit.Timer(expr, setup=setup)
+            us = t.timeit(number=20) / 20 / 500 * 1e6
+            sys.stderr.write("%s %s %d chan: %.2f us/record, %.0f Mchan/s ... "
+                % (kind, name, nchan, us, nchan / us))
+    def test_corrj_1024(self):
+        """Test the speed of 'j' corr scaling and packing for 1024 channels"""
+        self._corrj_speed(1024)
+    def test_corrj_4096(self):
+        """Test the speed of 'j' corr scaling and packing for 4096 channels"""
+        self._corrj_speed(4096)
+
+class TestSuite(unittest.TestSuite):
+    """A unittest.TestSuite class which contains all of the aipy.miriad speed tests."""
+
+    def __init__(self):
+        unittest.TestSuite.__init__(self)
+
+        loader = unittest.TestLoader()
+        self.addTests(loader.loadTestsFromTestCase(TestSpeed))
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,8 +1,57 @@
 # -*- coding: utf-8 -*-
 import tempfile
-import unittest, numpy as np, os
+import unittest, numpy as np, os, struct
 import aipy.miriad as m, aipy._miriad as _m
 
+def write_sma_mir(mirdir, nint=5, nchan=(1,8,8), ants=(1,2,3)):
+    """Write a minimal big-endian SMA MIR data set: one source, both
+    sidebands of every baseline, and a continuum band plus len(nchan)-1
+    spectral chunks.  The real part of each channel is 100*(bl+1)+sb and
+    the imaginary part is the chunk number."""
+    os.mkdir(mirdir)
+    f = lambda name: open(os.path.join(mirdir, name), 'wb')
+    pos = dict(zip(ants, (0., 10., 25.)))
+    bls = [(i,j) for i in ants for j in ants if i < j]
+    inh, blh, sph, sch = f('in_read'), f('bl_read'), f('sp_read'), f('sch_read')
+    blhid, sphid = 0, 0
+    for t in range(nint):
+        inhid = t + 1
+        inh.write(struct.pack('>ihiiihfffhhdfhdddfiihhffhhhddfff',
+            1, 0, 1, inhid, t, 0, 180., 60., .01*t, 0, 0, 1. + t/360.,
+            0., 0, 0., 0., 0., 10., 1, 1, 1, 0, 0., 0., 0, 0, 0,
+            1., .5, 2000., 0., 0.))
+        recs = []
+        for sb in (0,1):
+            for b,(i,j) in enumerate(bls):
+                blhid += 1
+                blh.write(struct.pack('>iihhfhhhhhhfffffffffffdfffihhhfffi',
+                    blhid, inhid, sb, 0, 0., 0, 0, 0, 0, 0, 0,
+                    10.*(b+1), 5.*(b+1), 1., 0., 0., 0., 0., 0., 0., 0.,
+                    0., 0., 0., 0., 0., b+1, i, j, 0,
+                    pos[j] - pos[i], 0., 0., 0))
+                for band,nch in enumerate(nchan):
+                    sphid += 1
+                    sph.write(struct.pack('>iiihhhhfdfhdffffhfhhiihdhhhhh',
+                        sphid, blhid, inhid, 0, 0, band, 0, 0., 0., 0., 0,
+                        230. + band, .8125, 100., 10., 1., 0, 0., nch, 1,
+                        0, 0, 0, 230. + band, 0, 0, 0, 0, 0))
+                    data = [100*(b+1) + sb, band] * nch
+                    recs.append(struct.pack('>hhih%dh' % len(data),
+                        100, 0, 0, 0, *data))
+        recs = b''.join(recs)
+        sch.write(struct.pack('>i4sii', inhid, b'I2-C', len(recs), len(recs)))
+        sch.write(recs)
+    codes = [('ref_time', 0, 'Feb 16, 2005'), ('vctype', 0, 'vlsr'),
+        ('source', 1, '3c273')]
+    codes += [('band', k, k == 0 and 'c1' or 's%d' % k)
+        for k in range(len(nchan))]
+    cd = f('codes_read')
+    for name,icode,code in codes:
+        cd.write(struct.pack('>12sh26sh', name.encode(), icode, code.encode(),
+            1))
+    f('eng_read').close()
+    for fd in (inh, blh, sph, sch, cd): fd.close()
+
 class TestMiriadUV(unittest.TestCase):
     def setUp(self):
         self.tmppath = tempfile.mkdtemp(prefix='miriad-test-', suffix='.tmp')
@@ -48,6 +97,230 @@ class TestMiriadUV(unittest.TestCase):
         self.assertEqual(t, 12345.6789)
         self.assertTrue(np.all(uvw == np.array([1,2,3], dtype=np.double)))
         self.assertTrue(np.all(d == self.data))
+    def test_raw_flags(self):
+        """Test that raw_read/raw_write flags follow numpy's mask convention"""
+        uv = m.UV(self.filename2, status='new')
+        uv.add_var('nchan', 'i')
+        uv['nchan'] = 40
+        uvw = np.array([1,2,3], dtype=np.double)
+        data = np.arange(40).astype(np.complex64)
+        mask = (np.arange(40) % 3 == 0)
+        uv.raw_write((uvw,12345.6789,(0,1)), data, mask)
+        uv.raw_write((uvw,12345.6789,(0,1)), data,
+            np.logical_not(mask).astype(np.int32), 1)
+        # Integer flags are never taken as a mask, or a bool mask as valid
+        self.assertRaises(ValueError, uv.raw_write, (uvw,12345.6789,(0,1)),
+            data, mask.astype(np.int32))
+        self.assertRaises(ValueError, uv.raw_write, (uvw,12345.6789,(0,1)),
+            data, mask, 1)
+        self.assertRaises(ValueError, _m.UV.write_block, uv,
+            uvw.reshape((1,3)), np.zeros(1), np.zeros(1, dtype=np.int32),
+            np.ones(1, dtype=np.int32), data.reshape((1,40)),
+            mask.astype(np.int32).reshape((1,40)))
+        del(uv)
+        uv = m.UV(self.filename2)
+        for rec in range(2):
+            p, d, f, nread = uv.raw_read(42)
+            self.assertEqual(nread, 40)
+            self.assertEqual(f.dtype, np.bool)
+            self.assertTrue(np.all(f[:40] == mask))
+            self.assertTrue(np.all(f[40:]))
+    def test_write_block(self):
+        """Test writing a block of records with one call"""
+        nrec = 30
+        uvw = np.arange(3*nrec, dtype=np.double).reshape((nrec,3))
+        t = 12345.6789 + np.arange(nrec) // 3
+        i, j = np.arange(nrec) % 3, np.arange(nrec) % 4
+        data = np.arange(4*nrec).reshape((nrec,4)) * (1+1j)
+        data = np.ma.array(data, mask=(data.real % 5 == 0))
+        uv = m.UV(self.filename2, status='new', corrmode='r')
+        uv.add_var('nchan', 'i'); uv['nchan'] = 4
+        uv.add_var('pol', 'i'); uv['pol'] = -5
+        uv.write_block(uvw, t, i, j, data)
+        del(uv)
+        uv = m.UV(self.filename2)
+        for k,((p_uvw,p_t,p_bl),d) in enumerate(uv.all()):
+            self.assertTrue(np.all(p_uvw == uvw[k]))
+            self.assertEqual(p_t, t[k])
+            self.assertEqual(p_bl, (i[k],j[k]))
+            self.assertEqual(uv['pol'], -5)
+            self.assertTrue(np.all(d == data[k]))
+            self.assertTrue(np.all(d.mask == data.mask[k]))
+        self.assertEqual(k, nrec-1)
+    def test_bufsize(self):
+        """Test reading and writing with a large i/o buffer"""
+        nrec, nchan = 50, 2048
+        data = np.arange(nrec*nchan).reshape((nrec,nchan)) * (1-1j)
+        data = np.ma.array(data, mask=(data.real % 7 == 0))
+        uv = m.UV(self.filename2, status='new', bufsize=1<<20)
+        uv.add_var('nchan', 'i'); uv['nchan'] = nchan
+        uvw = np.array([1,2,3], dtype=np.double)
+        for k in range(nrec): uv.write((uvw,12345.6789+k,(0,1)), data[k])
+        uv.write_block(np.resize(uvw,(nrec,3)), 12346.+np.arange(nrec),
+            np.zeros(nrec), np.ones(nrec), data)
+        del(uv)
+        for bufsize in [0, 1<<20, 3<<20]:
+            uv = m.UV(self.filename2, bufsize=bufsize)
+            for k,(p,d) in enumerate(uv.all()):
+                self.assertTrue(np.all(d == data[k % nrec]))
+                self.assertTrue(np.all(d.mask == data.mask[k % nrec]))
+            self.assertEqual(k, 2*nrec-1)
+            del(uv)
+    def test_compress(self):
+        """Test writing, reading, and appending to compressed visdata"""
+        nrec, nchan = 400, 256
+        data = np.arange(nrec*nchan).reshape((nrec,nchan)) % 17 * (1+1j)
+        data = np.ma.array(data, mask=(data.real == 0))
+        uvw = np.array([1,2,3], dtype=np.double)
+        uv = m.UV(self.filename2, status='new', compress=True)
+        uv.add_var('nchan', 'i'); uv['nchan'] = nchan
+        for k in range(nrec/2): uv.write((uvw,12345.+k,(0,1)), data[k])
+        del(uv)
+        uv = m.UV(self.filename2, status='append')
+        for k in range(nrec/2,nrec): uv.write((uvw,12345.+k,(0,1)), data[k])
+        del(uv)
+        visdata = os.path.join(self.filename2, 'visdata')
+        self.assertEqual(open(visdata).read(4), '\x89MIR')
+        self.assertTrue(os.path.getsize(visdata) < nrec*nchan*8 / 4)
+        uv = m.UV(self.filename2)
+        for k,((p_uvw,t,bl),d) in enumerate(uv.all()):
+            self.assertEqual(t, 12345.+k)
+            self.assertTrue(np.all(d == data[k]))
+            self.assertTrue(np.all(d.mask == data.mask[k]))
+        self.assertEqual(k, nrec-1)
+        uv.seek(12345.+300)
+        (p_uvw,t,bl),d = uv.read()
+        self.assertEqual(t, 12345.+300)
+        self.assertTrue(np.all(d == data[300]))
+    def test_compress_trailer(self):
+        """Test reading compressed visdata with and without the block table"""
+        import struct
+        nrec, nchan = 400, 256
+        data = np.arange(nrec*nchan).reshape((nrec,nchan)) % 17 * (1+1j)
+        uvw = np.array([1,2,3], dtype=np.double)
+        uv = m.UV(self.filename2, status='new', compress=True)
+        uv.add_var('nchan', 'i'); uv['nchan'] = nchan
+        for k in range(nrec): uv.write((uvw,12345.+k,(0,1)), data[k])
+        del(uv)
+        visdata = os.path.join(self.filename2, 'visdata')
+        tail = open(visdata, 'rb').read()[-24:]
+        self.assertEqual(tail[-8:], '\x89MIRZIDX')
+        hi, lo, nblk = struct.unpack('>iIi', tail[:12])
+        self.assertTrue(nblk > 1)
+        # A file cut off before its trailer is read by walking the blocks.
+        f = open(visdata, 'r+b'); f.truncate((hi << 32) + lo); f.close()
+        uv = m.UV(self.filename2)
+        for k,((p_uvw,t,bl),d) in enumerate(uv.all()):
+            self.assertEqual(t, 12345.+k)
+            self.assertTrue(np.all(d == data[k]))
+        self.assertEqual(k, nrec-1)
+    def test_errors(self):
+        """Test that MIRIAD errors report their own message in each thread"""
+        import threading
+        names = [os.path.join(self.tmppath, 'missing%d.uv' % k) for k in range(4)]
+        errs = {}
+        def opener(name):
+            try: m.UV(name)
+            except(RuntimeError), e: errs[name] = str(e)
+        threads = [threading.Thread(target=opener, args=(n,)) for n in names]
+        for t in threads: t.start()
+        for t in threads: t.join()
+        for n in names: self.assertTrue(n in errs[n])
+        uv = m.UV(self.filename1)
+        self.assertEqual(uv['nchan'], 4)
+    def test_parallel_write(self):
+        """Test writing different Miriad UV files from parallel threads"""
+        import threading
+        nrec = 2000
+        names = [os.path.join(self.tmppath, 'par%d.uv' % k) for k in range(4)]
+        def writer(k):
+            uv = m.UV(names[k], status='new', corrmode='r')
+            # Give each file its own variable indices
+            for v in ['v%d' % x for x in range(k)] + ['nchan', 'pol']:
+                uv.add_var(v, 'i')
+            uv['nchan'] = 4
+            uvw = np.array([1,2,3], dtype=np.double)
+            for r in range(nrec):
+                uv['pol'] = -5 - (r + k) % 4
+                uv.write((uvw, r, (k,r % 8)), self.data * (r + k))
+        threads = [threading.Thread(target=writer, args=(k,))
+            for k in range(len(names))]
+        for t in threads: t.start()
+        for t in threads: t.join()
+        for k,name in enumerate(names):
+            uv = m.UV(name)
+            for r,((uvw,t,bl),d) in enumerate(uv.all()):
+                self.assertEqual(uv['pol'], -5 - (r + k) % 4)
+                self.assertEqual((t,bl), (r,(k,r % 8)))
+                self.assertTrue(np.all(d == self.data * (r + k)))
+            self.assertEqual(r, nrec-1)
+    def test_sma_errors(self):
+        """Test that a bad SMA conversion raises instead of exiting"""
+        mirdir = os.path.join(self.tmppath, 'missing.mir')
+        self.assertRaises(RuntimeError, m.sma_to_uv, mirdir, self.filename2)
+        self.assertRaises(ValueError, m.sma_to_uv, mirdir, self.filename2,
+            pol='xy')
+        uv = m.UV(self.filename1)
+        self.assertRaises(ValueError, uv._sma_read, mirdir)
+        self.assertEqual(uv['nchan'], 4)
+    def test_sma_to_uv(self):
+        """Test converting a small SMA data set"""
+        mirdir = os.path.join(self.tmppath, 'test.mir')
+        write_sma_mir(mirdir)
+        m.sma_to_uv(mirdir, self.filename2)
+        uv = m.UV(self.filename2)
+        self.assertEqual(uv['source'], '3c273')
+        self.assertEqual(uv['nchan'], 16)
+        self.assertEqual(uv['nspect'], 2)
+        recs = [(t, bl, d) for (uvw,t,bl),d in uv.all()]
+        self.assertEqual(len(recs), 15)
+        self.assertEqual(len(set([t for t,bl,d in recs])), 5)
+        recs = [(bl, d) for t,bl,d in recs]
+        self.assertEqual([bl for bl,d in recs[:3]], [(0,1),(0,2),(1,2)])
+        for k,(bl,d) in enumerate(recs):
+            self.assertTrue(np.allclose(d.real, 1e8 * (k % 3 + 1), rtol=1e-3))
+            self.assertTrue(np.allclose(d.imag[:8], 1e6, rtol=1e-2))
+            self.assertTrue(np.allclose(d.imag[8:], 2e6, rtol=1e-2))
+        del(uv)
+        filename3 = os.path.join(self.tmppath, 'test3.uv')
+        m.sma_to_uv(mirdir, filename3, sb=1, rsnchan=4)
+        uv = m.UV(filename3)
+        self.assertEqual(uv['nchan'], 8)
+        (uvw,t,bl),d = uv.read()
+        self.assertTrue(np.allclose(d.real, 1.01e8, rtol=1e-3))
+        self.assertTrue(np.allclose(d.imag[:4], -1e6, rtol=1e-2))
+        del(uv)
+        filename4 = os.path.join(self.tmppath, 'test4.uv')
+        m.sma_to_uv(mirdir, filename4, scans=(1,2))
+        uv = m.UV(filename4)
+        times = [t for (uvw,t,bl),d in uv.all()]
+        self.assertEqual(len(times), 6)
+        self.assertEqual(len(set(times)), 2)
+    def test_header_arrays(self):
+        """Test reading and writing whole header items as arrays"""
+        uv = m.UV(self.filename2, status='new')
+        bp = (np.arange(1000) * (1+2j)).astype(np.complex64)
+        uv['bandpass'] = bp
+        uv['freq0'] = 0.1
+        uv['history'] = 'x' * 5000
+        h = uv.haccess('ngains', 'write')
+        offset = _m.hwrite_init(h, 'i')
+        self.assertEqual(_m.hwrite_array(h, offset, np.arange(10), 'i'), 40)
+        self.assertRaises(ValueError, _m.hwrite_array, h, offset, [2**40], 'i')
+        _m.hdaccess(h)
+        del(uv)
+        uv = m.UV(self.filename2)
+        self.assertTrue(np.all(uv['bandpass'] == bp))
+        self.assertEqual(uv['freq0'], 0.1)
+        self.assertEqual(uv['history'], 'x' * 5000)
+        h = uv.haccess('ngains', 'read')
+        t, offset = _m.hread_init(h)
+        self.assertEqual(t, 'i')
+        d = _m.hread_array(h, offset + 8, 'i', 3)
+        self.assertEqual(d.dtype, np.int32)
+        self.assertTrue(np.all(d == [2,3,4]))
+        self.assertRaises(IOError, _m.hread_array, h, offset, 'i', 11)
+        _m.hdaccess(h)
     def tearDown(self):
         os.system("rm -rf %s" % self.tmppath)
 
@@ -91,6 +364,241 @@ class TestMiriadUV_corrj(unittest.TestCase):
         self.assertEqual(t, 12345.6789)
         self.assertTrue(np.all(uvw == np.array([1,2,3], dtype=np.double)))
         self.assertTrue(np.all(np.abs(d - self.data) < 1e-4))
+    def test_corrj_pack(self):
+        """Test the 'j' corr encoding used by the benchmarks"""
+        data = np.array([self.data.data, 2*self.data.data])
+        packed, tscale = _m.corrj_pack(data)
+        self.assertEqual(packed.shape, (2,8))
+        self.assertTrue(np.allclose(tscale, [4./32767, 8./32767]))
+        ints = packed.view('>i2')
+        self.assertTrue(np.all(ints[0] == [0,8191,16383,0,0,24575,32767,0]))
+        d = _m.corrj_unpack(packed, tscale)
+        self.assertTrue(np.all(np.abs(d - data) < 1e-3))
+    def test_nan(self):
+        """Test that a NaN does not spoil the scaling of a 'j' record"""
+        filename2 = os.path.join(self.tmppath, 'test2.uv')
+        uv = m.UV(filename2, status='new', corrmode='j')
+        uv.add_var('nchan', 'i')
+        uv['nchan'] = 5
+        uvw = np.array([1,2,3], dtype=np.double)
+        data = np.array([1,2j,3,4j,5], dtype=np.complex64)
+        # A NaN in the SSE2 part of the record and one in its scalar tail
+        for k in (0, 4):
+            d = data.copy(); d[k] = complex(d[k].real, np.nan)
+            uv.raw_write((uvw,12345.6789,(0,1)), d, np.zeros(5, dtype=np.bool))
+        del(uv)
+        uv = m.UV(filename2)
+        for k in (0, 4):
+            p, d, f, nread = uv.raw_read(5)
+            good = np.arange(5) != k
+            self.assertTrue(np.all(np.abs(d[good] - data[good]) < 1e-3))
+    def tearDown(self):
+        os.system("rm -rf %s" % self.tmppath)
+
+class TestMiriadUV_index(unittest.TestCase):
+    def setUp(self):
+        self.tmppath = tempfile.mkdtemp(prefix='miriad-test-', suffix='.tmp')
+        self.filename1 = os.path.join(self.tmppath, 'test1.uv')
+        uv = m.UV(self.filename1, status='new', corrmode='r')
+        uv['history'] = 'Made this file from scratch.\n'
+        uv.add_var('nchan', 'i')
+        uv.add_var('pol', 'i')
+        uv.add_var('lst', 'd')
+        uv['nchan'] = 4
+        self.times = [2455000. + 0.01*t for t in range(200)]
+        for t in self.times:
+            uv['lst'] = t - 2455000. # only written when it changes
+            for i in range(3):
+                for j in range(i,3):
+                    for pol in [-5,-6]:
+                        uv['pol'] = pol
+                        uvw = np.array([i,j,t], dtype=np.double)
+                        data = np.ma.array([t,i,j,pol], mask=[0,0,1,0], 
+                            dtype=np.complex64)
+                        uv.write((uvw,t,(i,j)), data)
+        del(uv)
+    def test_seek(self):
+        """Test seeking to a record in a Miriad UV file"""
+        for trial in range(2): # Build the index, then load it
+            uv = m.UV(self.filename1)
+            uv.seek(self.times[150], bl=(1,2), pol='yy')
+            (uvw,t,bl),d = uv.read()
+            self.assertEqual(t, self.times[150])
+            self.assertEqual(bl, (1,2))
+            self.assertEqual(uv['pol'], -6)
+            self.assertAlmostEqual(uv['lst'], t - 2455000.)
+            self.assertTrue(np.all(d.mask == [0,0,1,0]))
+            self.assertEqual(d[3], -6)
+            (uvw,t,bl),d = uv.read()
+            self.assertEqual(bl, (2,2))
+            self.assertEqual(uv['pol'], -5)
+            del(uv)
+        uv = m.UV(self.filename1)
+        self.assertRaises(IOError, uv.seek, self.times[-1] + 1)
+    def test_rewind(self):
+        """Test that rewind restores the variables of the first record"""
+        uv = m.UV(self.filename1)
+        self.assertEqual(uv['lst'], 0.)
+        self.assertEqual(uv['pol'], -5)
+        recs = [(p,uv['lst']) for p,d in uv.all()]
+        self.assertAlmostEqual(uv['lst'], self.times[-1] - 2455000.)
+        uv.rewind()
+        self.assertEqual(uv['lst'], 0.)
+        self.assertEqual(uv['pol'], -5)
+        for k,(p,d) in enumerate(uv.all()):
+            self.assertEqual(p[1:], recs[k][0][1:])
+            self.assertEqual(uv['lst'], recs[k][1])
+    def test_read_chans(self):
+        """Test decoding only a subset of channels"""
+        uv = m.UV(self.filename1)
+        full = [(p,d) for p,d in uv.all()]
+        for chans in [[1,2], [0,3], [3,1,2], slice(None,None,2), [2]]:
+            uv.rewind()
+            for k,(p,d) in enumerate(uv.all(chans=chans)):
+                self.assertEqual(p[1:], full[k][0][1:])
+                self.assertTrue(np.all(d.data == full[k][1].data[chans]))
+                self.assertTrue(np.all(d.mask == full[k][1].mask[chans]))
+            self.assertEqual(k, len(full)-1)
+        (uvw,t,(i,j)),d = m.read_many([self.filename1], chans=[0,2])
+        self.assertEqual(d.shape, (len(full), 2))
+        self.assertTrue(np.all(d.mask[:,1]))
+        self.assertRaises(IndexError, uv.read, chans=[4])
+    def test_read_many(self):
+        """Test reading several Miriad UV files in parallel threads"""
+        (uvw,t,(i,j)),d = m.read_many([self.filename1]*3, nthreads=2)
+        uv = m.UV(self.filename1)
+        recs = [(p,dd) for p,dd in uv.all()]
+        self.assertEqual(len(t), 3*len(recs))
+        self.assertEqual(d.shape, (3*len(recs), 4))
+        for k in range(len(t)):
+            (p_uvw,p_t,(p_i,p_j)),p_d = recs[k % len(recs)]
+            self.assertEqual(t[k], p_t)
+            self.assertEqual((i[k],j[k]), (p_i,p_j))
+            self.assertTrue(np.all(uvw[k] == p_uvw))
+            self.assertTrue(np.all(d[k] == p_d))
+            self.assertTrue(np.all(d.mask[k] == p_d.mask))
+        self.assertRaises(RuntimeError, m.read_many, 
+            [self.filename1, os.path.join(self.tmppath, 'missing.uv')])
+    def test_select(self):
+        """Test time and antennae selection using the record index"""
+        uv = m.UV(self.filename1)
+        uv.select('antennae', 0, 2)
+        uv.select('time', self.times[100], self.times[109])
+        recs = [(t,bl,uv['lst']) for (uvw,t,bl),d in uv.all()]
+        self.assertEqual(len(recs), 20)
+        for t,bl,lst in recs:
+            self.assertEqual(bl, (0,2))
+            self.assertAlmostEqual(lst, t - 2455000.)
+    def test_columnar(self):
+        """Test exporting to and reading from columnar files"""
+        dirname = os.path.join(self.tmppath, 'test1.col')
+        m.uv_to_columnar(self.filename1, dirname, chunk=500)
+        cuv = m.ColumnarUV(dirname)
+        uv = m.UV(self.filename1)
+        self.assertEqual(cuv.nrec, 200*12)
+        self.assertEqual(cuv.data.shape, (200*12, 4))
+        self.assertEqual(cuv['nchan'], 4)
+        for ((uvw,t,bl),d),((c_uvw,c_t,c_bl),c_d) in zip(uv.all(), cuv.all()):
+            self.assertEqual(t, c_t)
+            self.assertEqual(bl, c_bl)
+            self.assertEqual(uv['pol'], cuv['pol'])
+            self.assertTrue(np.all(uvw == c_uvw))
+            self.assertTrue(np.all(d == c_d))
+            self.assertTrue(np.all(d.mask == c_d.mask))
+        cuv.select('antennae', 0, 2)
+        cuv.select('time', self.times[100], self.times[109])
+        cuv.select('polarization', -6, 0)
+        recs = [(t,bl,cuv['pol']) for (uvw,t,bl),d in cuv.all()]
+        self.assertEqual(len(recs), 10)
+        for t,bl,pol in recs:
+            self.assertEqual(bl, (0,2))
+            self.assertEqual(pol, -6)
+            self.assertTrue(self.times[100] <= t <= self.times[109])
+        cuv.select('clear', 0, 0)
+        cuv.select('auto', 0, 0, include=0)
+        self.assertEqual(len(cuv.selected()), 200*6)
+    def test_waterfalls(self):
+        """Test transposing into per-baseline waterfalls"""
+        dirname = os.path.join(self.tmppath, 'test1.wf')
+        m.uv_to_waterfalls(self.filename1, dirname, maxmem=10000)
+        wf = m.WaterfallUV(dirname)
+        self.assertEqual(len(wf.keys()), 12)
+        uv = m.UV(self.filename1)
+        t, i, j, pol = uv._records()
+        self.assertEqual(len(t), 200*12)
+        waterfalls = {}
+        for (uvw,t,bl),d in uv.all():
+            key = (bl, uv['pol'])
+            waterfalls[key] = waterfalls.get(key, []) + [(t,uvw,d)]
+        for (bl,pol),recs in waterfalls.items():
+            times, d = wf.waterfall(bl, pol)
+            self.assertEqual(d.shape, (200,4))
+            self.assertTrue(np.all(times == [r[0] for r in recs]))
+            self.assertTrue(np.all(wf.uvw[wf.rows(bl,pol)] == [r[1] for r in recs]))
+            self.assertTrue(np.all(d == np.ma.array([r[2] for r in recs])))
+            self.assertTrue(np.all(d.mask == [r[2].mask for r in recs]))
+        times, d = wf.waterfall((1,2), 'yy')
+        self.assertTrue(np.all(d[:,3] == -6))
+    def test_waterfalls_selected(self):
+        """Test that waterfalls of a UV with a select hold every record"""
+        dirname = os.path.join(self.tmppath, 'test1.wf')
+        m.uv_to_waterfalls(self.filename1, dirname, maxmem=10000)
+        wf1 = m.WaterfallUV(dirname)
+        uv = m.UV(self.filename1)
+        uv.select('antennae', 1, 2)
+        dirname = os.path.join(self.tmppath, 'test2.wf')
+        m.uv_to_waterfalls(uv, dirname, maxmem=10000)
+        wf2 = m.WaterfallUV(dirname)
+        self.assertEqual(sorted(wf1.keys()), sorted(wf2.keys()))
+        for i,j,pol in wf1.keys():
+            t1, d1 = wf1.waterfall((i,j), pol)
+            t2, d2 = wf2.waterfall((i,j), pol)
+            self.assertTrue(np.all(t1 == t2))
+            self.assertTrue(np.all(d1 == d2))
+    def tearDown(self):
+        os.system("rm -rf %s" % self.tmppath)
+
+class TestMiriadImage(unittest.TestCase):
+    def setUp(self):
+        self.tmppath = tempfile.mkdtemp(prefix='miriad-test-', suffix='.tmp')
+        self.filename = os.path.join(self.tmppath, 'cube.im')
+        self.cube = np.arange(6*4*5, dtype=np.float32).reshape((6,4,5))
+        img = m.Image(self.filename, status='new', shape=(5,4,6))
+        img['crval3'] = 1.5e8
+        img['bunit'] = 'JY/BEAM'
+        for k, plane in enumerate(self.cube):
+            mask = np.zeros(plane.shape, dtype=np.bool); mask[1,3] = True
+            img.write(k, np.ma.array(plane, mask=mask))
+        img.close()
+    def test_planes(self):
+        """Test writing an image cube by planes and reading it back"""
+        img = m.Image(self.filename)
+        self.assertEqual(img.shape, (5,4,6))
+        self.assertEqual(img['crval3'], 1.5e8)
+        self.assertEqual(img['bunit'], 'JY/BEAM')
+        self.assertEqual(img['naxis'], 3)
+        self.assertRaises(KeyError, img.__getitem__, 'crval4')
+        for k, d in enumerate(img.planes()):
+            self.assertEqual(d.shape, (4,5))
+            self.assertTrue(np.all(d.data == self.cube[k]))
+            self.assertEqual(d.mask.sum(), 1)
+            self.assertTrue(d.mask[1,3])
+        self.assertEqual(k, 5)
+        self.assertRaises(IndexError, img.read, 6)
+    def test_spectra(self):
+        """Test reading spectra along the third axis of an image cube"""
+        img = m.Image(self.filename)
+        for k, d in enumerate(img.spectra()):
+            x, y = k % 5, k / 5
+            self.assertEqual(d.shape, (6,))
+            self.assertTrue(np.all(d.data == self.cube[:,y,x]))
+            self.assertEqual(np.all(d.mask), (x,y) == (3,1))
+        self.assertEqual(k, 19)
+        self.assertEqual(img.setup('z', blc=(1,1,2), trc=(2,3,4)), 6)
+        d = img.read(5)
+        self.assertTrue(np.all(d.data == self.cube[2:5,3,2]))
+        img.close()
+        self.assertRaises(ValueError, _m.xyzread, 0, 0)
     def tearDown(self):
         os.system("rm -rf %s" % self.tmppath)
 
@@ -102,6 +610,8 @@ class TestSuite(unittest.TestSuite):
 
         loader = unittest.TestLoader()
         self.addTests(loader.loadTestsFromTestCase(TestMiriadUV))
+        self.addTests(loader.loadTestsFromTestCase(TestMiriadUV_index))
+        self.addTests(loader.loadTestsFromTestCase(TestMiriadImage))
 
 if __name__ == '__main__':
     unittest.main()